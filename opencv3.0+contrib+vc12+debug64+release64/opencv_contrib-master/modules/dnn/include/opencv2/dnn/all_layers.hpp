@@ -340,43 +340,55 @@ namespace dnn
 
     /* Activations */
 
-    class CV_EXPORTS ReLULayer : public Layer
+    class CV_EXPORTS ActivationLayer : public Layer
+    {
+    public:
+        /** @brief Applies the activation function to @p len values of the same channel.
+         *  @param src input values.
+         *  @param dst output values, can be equal to @p src.
+         *  @param len number of values.
+         *  @param channel index of the channel, which the values belong to.
+         */
+        virtual void forwardPlane(const float* src, float* dst, int len, int channel) const = 0;
+    };
+
+    class CV_EXPORTS ReLULayer : public ActivationLayer
     {
     public:
         static Ptr<ReLULayer> create(const LayerParams &params);
     };
 
-    class CV_EXPORTS ChannelsPReLULayer : public Layer
+    class CV_EXPORTS ChannelsPReLULayer : public ActivationLayer
     {
     public:
         static Ptr<ChannelsPReLULayer> create(const LayerParams& params);
     };
 
-    class CV_EXPORTS TanHLayer : public Layer
+    class CV_EXPORTS TanHLayer : public ActivationLayer
     {
     public:
         static Ptr<TanHLayer> create(const LayerParams &params);
     };
 
-    class CV_EXPORTS SigmoidLayer : public Layer
+    class CV_EXPORTS SigmoidLayer : public ActivationLayer
     {
     public:
         static Ptr<SigmoidLayer> create(const LayerParams &params);
     };
 
-    class CV_EXPORTS BNLLLayer : public Layer
+    class CV_EXPORTS BNLLLayer : public ActivationLayer
     {
     public:
         static Ptr<BNLLLayer> create(const LayerParams &params);
     };
 
-    class CV_EXPORTS AbsLayer : public Layer
+    class CV_EXPORTS AbsLayer : public ActivationLayer
     {
     public:
         static Ptr<AbsLayer> create(const LayerParams &params);
     };
 
-    class CV_EXPORTS PowerLayer : public Layer
+    class CV_EXPORTS PowerLayer : public ActivationLayer
     {
     public:
         static Ptr<PowerLayer> create(const LayerParams &params);
@@ -136,6 +136,12 @@ public:
     template<typename T>
     const T &set(const String &key, const T &value);
 
+    //! Iterators over the key-value pairs, ordered by keys.
+    std::map<String, DictValue>::const_iterator begin() const;
+
+    /** @overload */
+    std::map<String, DictValue>::const_iterator end() const;
+
     friend std::ostream &operator<<(std::ostream &stream, const Dict &dict);
 };
 
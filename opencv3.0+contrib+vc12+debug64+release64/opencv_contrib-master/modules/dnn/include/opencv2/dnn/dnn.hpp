@@ -46,6 +46,13 @@
 #include <opencv2/core.hpp>
 #include <opencv2/dnn/dict.hpp>
 
+#if !defined(CV_DNN_ASYNC) && (__cplusplus >= 201103L || (defined(_MSC_VER) && _MSC_VER >= 1800))
+#  define CV_DNN_ASYNC 1
+#endif
+#ifdef CV_DNN_ASYNC
+#  include <future>
+#endif
+
 namespace cv
 {
 namespace dnn //! This namespace is used for dnn module functionlaity.
@@ -127,6 +134,48 @@ namespace dnn //! This namespace is used for dnn module functionlaity.
          */
         virtual int outputNameToIndex(String outputName);
 
+        /** @brief Returns true if forward() can compute the first output blob over the memory of the first input blob.
+         *
+         * Network memory planner uses this hint to run the layer in-place when its input blob isn't needed by other layers.
+         * In this case the first output blob has the same type and number of elements as the first input blob.
+         * @see Net::enableMemoryReuse()
+         */
+        virtual bool supportInPlace() const;
+
+        /** @brief Tries to merge computations of the subsequent layer @p top into this layer.
+         *  @param top layer which takes the first output of this layer as its only input.
+         *  @returns true if this layer will produce the output of @p top so @p top mustn't be computed.
+         *
+         * Empty @p top cancels all previously merged layers.
+         * @see Net::enableFusion()
+         */
+        virtual bool fuse(const Ptr<Layer> &top);
+
+        /** @brief Returns parameters of per-channel affine transformation @f$ y_c = scale_c x_c + shift_c @f$ if the layer is such one.
+         *  @param[out] scale per-channel multipliers or empty Mat if the layer doesn't scale input.
+         *  @param[out] shift per-channel addends or empty Mat if the layer doesn't shift input.
+         *
+         * Both Mats are empty for layers which can't be presented as per-channel affine transformation.
+         */
+        virtual void getScaleShift(Mat &scale, Mat &shift) const;
+
+        /** @brief Switches the layer to 8-bit integer computations.
+         *  @param inputRanges maximal absolute values of the layer inputs collected by Net::calibrate().
+         *  @returns true if the layer quantizes its computations.
+         *
+         * Empty @p inputRanges switches the layer back to floating point computations.
+         * @see Net::enableInt8()
+         */
+        virtual bool quantize(const std::vector<float> &inputRanges);
+
+        /** @brief Estimates number of floating point operations of a single forward pass.
+         *  @param inputs input blobs of the allocated layer.
+         *  @param outputs output blobs of the allocated layer.
+         *  @returns estimated number of operations or 0 if the layer doesn't provide an estimation.
+         *  @see Net::getProfile()
+         */
+        virtual int64 getFLOPS(const std::vector<Mat*> &inputs, const std::vector<Mat> &outputs) const;
+
         CV_PROP String name; //!< Name of the layer instance, can be used for logging or other internal purposes.
         CV_PROP String type; //!< Type name which was used for creating layer by layer factory.
 
@@ -136,6 +185,55 @@ namespace dnn //! This namespace is used for dnn module functionlaity.
         virtual ~Layer();
     };
 
+    /** @brief Profile of a single layer collected by Net::enableProfiling().
+     *
+     * Times are given in milliseconds, memory traffic is estimated as the size of the input, output and weight blobs.
+     */
+    struct CV_EXPORTS LayerProfile
+    {
+        LayerProfile();
+
+        String name;                    //!< name of the layer
+        String type;                    //!< type of the layer
+        int runs;                       //!< number of profiled forward passes of the layer
+        double meanTime;                //!< average time of the layer
+        double minTime;                 //!< minimal time of the layer
+        double maxTime;                 //!< maximal time of the layer
+        int64 flops;                    //!< estimated number of floating point operations, see Layer::getFLOPS()
+        int64 bytes;                    //!< estimated number of bytes read and written by the layer
+        int64 outputBytes;              //!< size of the output blobs in bytes
+        std::vector<std::vector<int> > outputShapes; //!< shapes of the output blobs
+        bool fused;                     //!< the layer is merged into a preceding one and isn't computed separately
+    };
+
+    /** @brief Per-layer profile of the network collected by Net::enableProfiling(). */
+    struct CV_EXPORTS NetProfile
+    {
+        NetProfile();
+
+        int runs;                         //!< number of profiled forward passes of the network
+        double meanTime;                  //!< average time of a forward pass in milliseconds
+        int64 flops;                      //!< sum of the estimated operations of the layers
+        int64 bytes;                      //!< sum of the estimated memory traffic of the layers
+        std::vector<LayerProfile> layers; //!< profiles of the layers in order of execution
+    };
+
+    /** @brief Statistics of the asynchronous forward passes of the network, see Net::forwardAsync().
+     *
+     * Times are given in milliseconds and averaged over the completed requests.
+     */
+    struct CV_EXPORTS AsyncForwardStats
+    {
+        AsyncForwardStats();
+
+        size_t queueDepth;              //!< number of requests which are waiting in the queue or being computed
+        size_t completedRequests;       //!< number of requests computed since the first forwardAsync() call
+        double queueTime;               //!< time between forwardAsync() call and start of the computations
+        double forwardTime;             //!< time of the computations of the whole network
+        std::vector<String> layerNames; //!< names of the computed layers in order of execution
+        std::vector<double> layerTimes; //!< time of every layer including waiting for other requests computed by it
+    };
+
     /** @brief This class allows to create and manipulate comprehensive artificial neural networks.
      *
      * Neural network is presented as directed acyclic graph (DAG), where vertices are Layer instances,
@@ -275,8 +373,123 @@ namespace dnn //! This namespace is used for dnn module functionlaity.
         /** @brief Returns indexes of layers with unconnected outputs.
          */
         CV_WRAP std::vector<int> getUnconnectedOutLayers() const;
-    private:
 
+        /** @brief Enables or disables sharing of memory between output blobs of different layers.
+         *  @param enable if true then the network computes lifetimes of the intermediate blobs during allocate()
+         *  and reuses their buffers for blobs, whose lifetimes don't overlap. Layers which support it
+         *  (see Layer::supportInPlace()) are computed in-place over their input blobs.
+         *
+         * Memory reuse is disabled by default. When it is enabled only outputs of layers with unconnected outputs,
+         * outputs of the layer passed to forward() and blobs listed in keepBlobs() are guaranteed to be valid after forward(),
+         * getBlob() throws an exception for blobs overwritten by other layers.
+         */
+        CV_WRAP void enableMemoryReuse(bool enable = true);
+
+        /** @brief Specifies layer output blobs which must stay valid after forward() regardless of network optimizations.
+         *  @param outputNames descriptors of the blobs, see connect(String, String) to know format of the descriptor.
+         */
+        CV_WRAP void keepBlobs(const std::vector<String> &outputNames);
+
+        /** @brief Returns memory occupied by the output blobs of the network layers (network input blobs aren't counted).
+         *  @param[out] blobsBytes amount of memory which the blobs would occupy if each of them had own buffer.
+         *  @param[out] plannedBytes amount of memory actually allocated for the blobs by the memory planner.
+         *  @details Both values are computed by allocate() and are equal when memory reuse is disabled.
+         */
+        CV_WRAP void getMemoryConsumption(CV_OUT size_t &blobsBytes, CV_OUT size_t &plannedBytes);
+
+        /** @brief Enables or disables merging of layers at setup time.
+         *  @param enable if true then BatchNorm, Scale and activation layers which follow a convolution
+         *  are folded into its weights and output loop (see Layer::fuse()).
+         *
+         * Fusion is enabled by default. Outputs of the merged layers except the last one aren't computed,
+         * so getBlob() throws an exception for them. Blobs listed in keepBlobs() are never merged away.
+         */
+        CV_WRAP void enableFusion(bool enable = true);
+
+        /** @brief Collects ranges of the intermediate blobs which are required for 8-bit inference.
+         *  @param samples representative network inputs, each of them is set to the blob @p inputName and forwarded.
+         *  @param inputName descriptor of the network input blob, see connect(String, String).
+         *
+         * Maximal absolute value of every blob is accumulated over all samples. Previous ranges are discarded.
+         */
+        CV_WRAP void calibrate(const std::vector<Mat> &samples, const String &inputName = String());
+
+        /** @brief Enables or disables 8-bit integer computations.
+         *  @param enable if true then layers which support it (see Layer::quantize()) quantize their weights
+         *  per output channel and their inputs with the ranges collected by calibrate().
+         *
+         * Quantized layers accumulate products of 8-bit values in 32-bit integers and produce floating point outputs,
+         * so the rest of the network is unaffected. Layers with uncalibrated inputs are computed in floating point.
+         * 8-bit mode is disabled by default.
+         */
+        CV_WRAP void enableInt8(bool enable = true);
+
+        /** @brief Limits the number of threads which layers of the network use for parallel computations.
+         *  @param nthreads maximal number of threads, non-positive value removes the limit.
+         *
+         * Layers split their parallel loops into at most @p nthreads stripes while allocate() and forward()
+         * of this network run. The global cv::setNumThreads() value and other parallel_for_ callers are
+         * unaffected, so processes running several networks can share CPU cores between them
+         * without oversubscription.
+         */
+        CV_WRAP void setNumThreads(int nthreads);
+
+        /** @brief Enables or disables collection of per-layer timings in forward().
+         *  @param enable if true then every forward() call measures time of each computed layer.
+         *
+         * Enabling the profiling clears previously collected statistics. When it is disabled forward()
+         * does no additional work. Asynchronous requests (see forwardAsync()) aren't profiled.
+         */
+        CV_WRAP void enableProfiling(bool enable = true);
+
+        /** @brief Returns timings of the layers averaged over the profiled forward passes together with
+         *  estimated FLOPs and memory traffic computed from shapes of the allocated blobs.
+         */
+        NetProfile getProfile() const;
+
+        /** @brief Writes the profiled forward passes in Chrome trace event format.
+         *  @param path output JSON file, it can be opened by chrome://tracing.
+         *
+         * Every layer of every profiled forward pass is written as a separate event, at most
+         * 100000 most recent events are kept.
+         */
+        CV_WRAP void writeTrace(const String &path) const;
+
+        /** @brief Saves the imported network into the native binary format.
+         *  @param path output file path.
+         *
+         * The file contains the graph of the network (layer types, parameters and connections) and a section with
+         * raw data of the layer blobs, every blob is aligned to 64 bytes. Parameters are stored as they were
+         * imported, changes made by setParam() aren't saved. Use readNetFromNative() to load the file.
+         */
+        CV_WRAP void writeNative(const String &path) const;
+
+#ifdef CV_DNN_ASYNC
+        /** @brief Runs forward pass of the whole network asynchronously.
+         *  @param inputs blobs of the network inputs in order of setNetInputs(), one blob for a network with single input.
+         *  @param outputNames descriptors of the blobs to return (see connect(String, String)),
+         *  the first outputs of the layers with unconnected outputs are returned if it is empty.
+         *  @returns future which gets the requested blobs.
+         *
+         * Every request has own set of intermediate blobs, so several requests can be computed at the same time
+         * by different layers of the network: a layer processes one request at a time and passes it to the next layer.
+         * The call blocks while the queue of the requests is full, see setAsyncQueueSize().
+         * Requests with new input shapes wait for completion of all previous requests and reallocate the network.
+         *
+         * Synchronous methods mustn't be used while there are uncompleted asynchronous requests.
+         */
+        std::future<std::vector<Mat> > forwardAsync(const std::vector<Mat> &inputs,
+                                                    const std::vector<String> &outputNames = std::vector<String>());
+
+        /** @brief Sets maximal number of requests which are queued or computed by forwardAsync() at the same time.
+         *  @param maxRequests capacity of the queue, it is equal to 4 by default.
+         */
+        void setAsyncQueueSize(int maxRequests);
+
+        /** @brief Returns queue depth and latencies of the stages of the asynchronous requests. */
+        AsyncForwardStats getAsyncStats() const;
+#endif
+    private:
         struct Impl;
         Ptr<Impl> impl;
     };
@@ -314,6 +527,14 @@ namespace dnn //! This namespace is used for dnn module functionlaity.
       */
     CV_EXPORTS_W Net readNetFromTorch(const String &model, bool isBinary = true);
 
+    /** @brief Reads a network saved by Net::writeNative().
+      * @details The file is memory-mapped and layer blobs are created as headers over the mapped weights
+      * without copying them, so loading takes time proportional to the size of the graph and pages of
+      * the weights are read from disk on first use. The mapping is copy-on-write. Every blob holds a reference
+      * to it, so blobs obtained by Net::getParam() stay valid after the network is destroyed.
+      */
+    CV_EXPORTS_W Net readNetFromNative(const String &path);
+
     /** @brief Creates the importer of <a href="http://www.tensorflow.org">TensorFlow</a> framework network.
      *  @param model   path to the .pb file with binary protobuf description of the network architecture.
      *  @returns Pointer to the created importer, NULL in failure cases.
@@ -355,6 +576,32 @@ namespace dnn //! This namespace is used for dnn module functionlaity.
     CV_EXPORTS Mat blobFromImage(const Mat& image, double scalefactor=1.0, bool swapRB=true);
     CV_EXPORTS Mat blobFromImages(const std::vector<Mat>& image, double scalefactor=1.0, bool swapRB=true);
 
+    /** @brief Converts a batch of images into a 4-dimensional NCHW blob in a single pass.
+     *  @param images input images, 8-bit or 32-bit floating point, with 1, 3 or 4 channels.
+     *  The alpha channel is dropped.
+     *  @param blob output blob of shape [images.size(), C, size.height, size.width], C is 1 for
+     *  gray images and 3 otherwise. It is reallocated only if its shape differs, so a preallocated
+     *  blob (or a header pointing into a bigger batch buffer) is filled in place.
+     *  @param size spatial size of the blob. Images are resized with bilinear interpolation.
+     *  An empty size keeps the size of the images, which must be equal then.
+     *  @param mean values subtracted from the channels, in the order of the blob channels.
+     *  @param scalefactor multiplier applied after the mean subtraction.
+     *  @param swapRB swaps the first and the last channels of 3- and 4-channel images.
+     *  @param crop if true, an image is resized preserving its aspect ratio so that it covers
+     *  @p size and then the center part is cropped. Otherwise it is resized to @p size directly.
+     *
+     *  Conversion, resizing, mean subtraction, scaling and channel swapping are fused,
+     *  no intermediate images are allocated.
+     */
+    CV_EXPORTS void blobFromImages(const std::vector<Mat>& images, Mat& blob, Size size = Size(),
+                                   const Scalar& mean = Scalar(), double scalefactor = 1.0,
+                                   bool swapRB = true, bool crop = false);
+
+    /** @overload */
+    CV_EXPORTS void blobFromImage(const Mat& image, Mat& blob, Size size = Size(),
+                                  const Scalar& mean = Scalar(), double scalefactor = 1.0,
+                                  bool swapRB = true, bool crop = false);
+
 //! @}
 }
 }
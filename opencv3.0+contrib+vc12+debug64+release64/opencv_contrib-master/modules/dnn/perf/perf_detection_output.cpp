@@ -0,0 +1,74 @@
+#include "perf_precomp.hpp"
+
+namespace cvtest
+{
+
+using std::tr1::tuple;
+using std::tr1::get;
+using namespace perf;
+using namespace testing;
+using namespace cv;
+using namespace cv::dnn;
+
+// Number of priors of SSD300 and number of classes of VOC and COCO models.
+typedef tuple<int, int> DetectionOutputParam;
+typedef TestBaseWithParam<DetectionOutputParam> DetectionOutputPerfTest;
+
+PERF_TEST_P( DetectionOutputPerfTest, perf, Combine(
+    Values(8732),
+    Values(21, 91))
+)
+{
+    RNG rng(0);
+
+    int numPriors  = get<0>(GetParam());
+    int numClasses = get<1>(GetParam());
+
+    int priorsSize[] = {1, 2, numPriors * 4};
+    Mat priors(3, priorsSize, CV_32F);
+    float* p = priors.ptr<float>();
+    for (int k = 0; k < numPriors; k++)
+    {
+        float cx = rng.uniform(0.f, 1.f), cy = rng.uniform(0.f, 1.f);
+        float w = rng.uniform(0.02f, 0.8f), h = rng.uniform(0.02f, 0.8f);
+        p[k*4] = cx - w/2; p[k*4+1] = cy - h/2;
+        p[k*4+2] = cx + w/2; p[k*4+3] = cy + h/2;
+        float variances[] = {0.1f, 0.1f, 0.2f, 0.2f};
+        std::copy(variances, variances + 4, p + (numPriors + k) * 4);
+    }
+    Mat loc(1, numPriors * 4, CV_32F), conf(1, numPriors * numClasses, CV_32F);
+    rng.fill(loc, RNG::UNIFORM, -1, 1);
+    rng.fill(conf, RNG::UNIFORM, 0, 0.1);
+
+    LayerParams lp;
+    lp.set("num_classes", numClasses);
+    lp.set("share_location", true);
+    lp.set("background_label_id", 0);
+    lp.set("nms_threshold", 0.45f);
+    lp.set("top_k", 400);
+    lp.set("keep_top_k", 200);
+    lp.set("confidence_threshold", 0.01f);
+    lp.set("code_type", "CENTER_SIZE");
+
+    std::vector<Mat*> inpBlobs;
+    inpBlobs.push_back(&loc);
+    inpBlobs.push_back(&conf);
+    inpBlobs.push_back(&priors);
+    std::vector<Mat> outBlobs(1);
+
+    cv::setNumThreads(cv::getNumberOfCPUs());
+
+    Ptr<Layer> layer = cv::dnn::LayerFactory::createLayerInstance("DetectionOutput", lp);
+    layer->allocate(inpBlobs, outBlobs);
+
+    declare.tbb_threads(cv::getNumThreads());
+
+    TEST_CYCLE()
+    {
+        layer->forward(inpBlobs, outBlobs);
+    }
+
+    SANITY_CHECK_NOTHING();
+}
+
+}
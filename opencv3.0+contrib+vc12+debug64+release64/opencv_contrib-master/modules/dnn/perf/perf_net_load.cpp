@@ -0,0 +1,98 @@
+#include "perf_precomp.hpp"
+#include <cstdio>
+#include <fstream>
+
+namespace cvtest
+{
+
+using namespace perf;
+using namespace cv;
+using namespace cv::dnn;
+
+#ifdef __linux__
+//resets peak resident set size of the process (VmHWM), supported since Linux 4.0
+static void resetPeakMemory()
+{
+    std::ofstream fs("/proc/self/clear_refs");
+    fs << "5";
+}
+
+//returns peak resident set size of the process in kilobytes or -1
+static int peakMemoryKb()
+{
+    std::ifstream fs("/proc/self/status");
+    std::string line;
+    while (std::getline(fs, line))
+    {
+        if (line.compare(0, 6, "VmHWM:") == 0)
+            return atoi(line.c_str() + 6);
+    }
+    return -1;
+}
+#else
+static void resetPeakMemory() {}
+static int peakMemoryKb() { return -1; }
+#endif
+
+//loads the network once outside of the timed loop and records growth of the peak resident memory
+template<typename LoadFunc>
+static void recordPeakMemory(LoadFunc load)
+{
+    resetPeakMemory();
+    int base = peakMemoryKb();
+    {
+        Net net = load();
+        ASSERT_FALSE(net.empty());
+    }
+    int peak = peakMemoryKb();
+    if (base >= 0 && peak >= 0)
+        ::testing::Test::RecordProperty("peak_rss_kb", peak - base);
+}
+
+static Net loadCaffeGoogLeNet()
+{
+    const std::string proto = findDataFile("dnn/bvlc_googlenet.prototxt", false);
+    const std::string model = findDataFile("dnn/bvlc_googlenet.caffemodel", false);
+    return readNetFromCaffe(proto, model);
+}
+
+static std::string nativePath;
+
+static Net loadNativeGoogLeNet()
+{
+    return readNetFromNative(nativePath);
+}
+
+PERF_TEST(NetLoad, Caffe_GoogLeNet)
+{
+    recordPeakMemory(loadCaffeGoogLeNet);
+
+    Net net;
+    TEST_CYCLE()
+    {
+        net = loadCaffeGoogLeNet();
+    }
+
+    SANITY_CHECK_NOTHING();
+}
+
+PERF_TEST(NetLoad, Native_GoogLeNet)
+{
+    nativePath = cv::tempfile(".cvdnn");
+    loadCaffeGoogLeNet().writeNative(nativePath);
+    recordPeakMemory(loadNativeGoogLeNet);
+
+    {
+        Net net;
+        TEST_CYCLE()
+        {
+            net = Net();
+            net = loadNativeGoogLeNet();
+        }
+    }
+    remove(nativePath.c_str());
+
+    SANITY_CHECK_NOTHING();
+}
+
+}
@@ -40,11 +40,21 @@
 //M*/
 
 #include "precomp.hpp"
+#include "opencv2/core/hal/intrin.hpp"
+#include "native/native_io.hpp"
 #include <set>
 #include <algorithm>
 #include <iostream>
 #include <sstream>
 #include <iterator>
+#include <deque>
+#include <fstream>
+#include <float.h>
+#ifdef CV_DNN_ASYNC
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#endif
 
 using namespace cv;
 using namespace cv::dnn;
@@ -67,64 +77,314 @@ static String toString(const T &v)
     return ss.str();
 }
 
-Mat blobFromImage(const Mat& image_, double scalefactor, bool swapRB)
+namespace
+{
+
+// Sampling plan of a single image: maps output pixels of the blob plane
+// onto the source image (resize and center crop are folded into it).
+struct BlobImagePlan
 {
     Mat image;
-    if(image_.depth() == CV_8U)
+    float scale;
+    bool direct;            // no resampling, only an integer crop offset
+    int cropX, cropY;
+    float fy;
+    std::vector<int> xofs;  // element offsets of the left/right neighbours
+    std::vector<float> xalpha;
+
+    void init(const Mat& img, Size dstSize, bool crop, float scale_)
     {
-        image_.convertTo(image, CV_32F, scalefactor);
+        image = img;
+        scale = scale_;
+        Size rsize = dstSize;
+        if (crop)
+        {
+            float rf = std::max(dstSize.width / (float)img.cols, dstSize.height / (float)img.rows);
+            rsize = Size(cvRound(img.cols * rf), cvRound(img.rows * rf));
+        }
+        cropX = (rsize.width - dstSize.width) / 2;
+        cropY = (rsize.height - dstSize.height) / 2;
+        direct = rsize == img.size();
+        fy = img.rows / (float)rsize.height;
+        if (direct)
+            return;
+
+        int cn = img.channels(), width = dstSize.width;
+        float fx = img.cols / (float)rsize.width;
+        xofs.resize(width*2);
+        xalpha.resize(width);
+        for (int x = 0; x < width; x++)
+        {
+            float sx = (x + cropX + 0.5f)*fx - 0.5f;
+            int x0 = cvFloor(sx);
+            float a = sx - x0;
+            if (x0 < 0)
+            {
+                x0 = 0;
+                a = 0.f;
+            }
+            if (x0 >= img.cols - 1)
+            {
+                x0 = img.cols - 1;
+                a = 0.f;
+            }
+            xofs[x*2] = x0*cn;
+            xofs[x*2 + 1] = std::min(x0 + 1, img.cols - 1)*cn;
+            xalpha[x] = a;
+        }
     }
-    else
-        image = image_;
-    CV_Assert(image.dims == 2 && image.depth() == CV_32F);
-    int nch = image.channels();
-    CV_Assert(nch == 3 || nch == 4);
-    int sz[] = { 1, 3, image.rows, image.cols };
-    Mat blob(4, sz, CV_32F);
-    Mat ch[4];
-    for( int j = 0; j < 3; j++ )
-        ch[j] = Mat(image.rows, image.cols, CV_32F, blob.ptr(0, j));
-    if(swapRB)
-        std::swap(ch[0], ch[2]);
-    split(image, ch);
-    return blob;
+};
+
+#if CV_SIMD128
+static inline void v_expand_f32(const v_uint8x16& v, v_float32x4& f0, v_float32x4& f1,
+                                v_float32x4& f2, v_float32x4& f3)
+{
+    v_uint16x8 w0, w1;
+    v_uint32x4 d0, d1, d2, d3;
+    v_expand(v, w0, w1);
+    v_expand(w0, d0, d1);
+    v_expand(w1, d2, d3);
+    f0 = v_cvt_f32(v_reinterpret_as_s32(d0));
+    f1 = v_cvt_f32(v_reinterpret_as_s32(d1));
+    f2 = v_cvt_f32(v_reinterpret_as_s32(d2));
+    f3 = v_cvt_f32(v_reinterpret_as_s32(d3));
 }
 
-Mat blobFromImages(const std::vector<Mat>& images, double scalefactor, bool swapRB)
+static inline void v_store_normalized(float* dst, const v_uint8x16& v,
+                                      const v_float32x4& s, const v_float32x4& b)
 {
-    size_t i, nimages = images.size();
-    if(nimages == 0)
-        return Mat();
-    Mat image0 = images[0];
-    int nch = image0.channels();
-    CV_Assert(image0.dims == 2 && (nch == 3 || nch == 4));
-    int sz[] = { (int)nimages, 3, image0.rows, image0.cols };
-    Mat blob(4, sz, CV_32F), image;
-    Mat ch[4];
+    v_float32x4 f0, f1, f2, f3;
+    v_expand_f32(v, f0, f1, f2, f3);
+    v_store(dst, v_muladd(f0, s, b));
+    v_store(dst + 4, v_muladd(f1, s, b));
+    v_store(dst + 8, v_muladd(f2, s, b));
+    v_store(dst + 12, v_muladd(f3, s, b));
+}
+#endif
 
-    for( i = 0; i < nimages; i++ )
+// dst[c][x] = src[x*scn + c]*scale + bias[c]
+static void normalizeRow(const uchar* src, int scn, int cn, int width,
+                         float* const* dst, float scale, const float* bias)
+{
+    int x = 0;
+#if CV_SIMD128
+    v_float32x4 s = v_setall_f32(scale);
+    v_float32x4 b0 = v_setall_f32(bias[0]);
+    if (scn == 1)
+    {
+        for (; x <= width - 16; x += 16)
+            v_store_normalized(dst[0] + x, v_load(src + x), s, b0);
+    }
+    else if (scn == 3 || scn == 4)
     {
-        Mat image_ = images[i];
-        if(image_.depth() == CV_8U)
+        v_float32x4 b1 = v_setall_f32(bias[1]), b2 = v_setall_f32(bias[2]);
+        v_uint8x16 c0, c1, c2, c3;
+        for (; x <= width - 16; x += 16)
         {
-            image_.convertTo(image, CV_32F, scalefactor);
+            if (scn == 3)
+                v_load_deinterleave(src + x*3, c0, c1, c2);
+            else
+                v_load_deinterleave(src + x*4, c0, c1, c2, c3);
+            v_store_normalized(dst[0] + x, c0, s, b0);
+            v_store_normalized(dst[1] + x, c1, s, b1);
+            v_store_normalized(dst[2] + x, c2, s, b2);
         }
-        else
-            image = image_;
-        CV_Assert(image.depth() == CV_32F);
-        nch = image.channels();
-        CV_Assert(image.dims == 2 && (nch == 3 || nch == 4));
-        CV_Assert(image.size() == image0.size());
-
-        for( int j = 0; j < 3; j++ )
-            ch[j] = Mat(image.rows, image.cols, CV_32F, blob.ptr((int)i, j));
-        if(swapRB)
-            std::swap(ch[0], ch[2]);
-        split(image, ch);
     }
+#endif
+    for (; x < width; x++)
+        for (int c = 0; c < cn; c++)
+            dst[c][x] = src[x*scn + c]*scale + bias[c];
+}
+
+static void normalizeRow(const float* src, int scn, int cn, int width,
+                         float* const* dst, float scale, const float* bias)
+{
+    for (int c = 0; c < cn; c++)
+    {
+        float* d = dst[c];
+        const float* s = src + c;
+        float b = bias[c];
+        for (int x = 0; x < width; x++)
+            d[x] = s[x*scn]*scale + b;
+    }
+}
+
+// Horizontal pass of the bilinear interpolation, planar output: buf[c*width + x].
+template<typename T>
+static void resampleRow(const T* src, const BlobImagePlan& p, int cn, int width, float* buf)
+{
+    const int* xofs = &p.xofs[0];
+    const float* xalpha = &p.xalpha[0];
+    for (int x = 0; x < width; x++)
+    {
+        const T* s0 = src + xofs[x*2];
+        const T* s1 = src + xofs[x*2 + 1];
+        float a = xalpha[x];
+        for (int c = 0; c < cn; c++)
+            buf[c*width + x] = s0[c] + ((float)s1[c] - (float)s0[c])*a;
+    }
+}
+
+// Vertical pass: dst = (r0 + (r1 - r0)*wy)*scale + bias
+static void blendRows(const float* r0, const float* r1, float wy, int width,
+                      float* dst, float scale, float bias)
+{
+    int x = 0;
+#if CV_SIMD128
+    v_float32x4 w = v_setall_f32(wy), s = v_setall_f32(scale), b = v_setall_f32(bias);
+    for (; x <= width - 4; x += 4)
+    {
+        v_float32x4 v0 = v_load(r0 + x), v1 = v_load(r1 + x);
+        v_store(dst + x, v_muladd(v_muladd(v1 - v0, w, v0), s, b));
+    }
+#endif
+    for (; x < width; x++)
+        dst[x] = (r0[x] + (r1[x] - r0[x])*wy)*scale + bias;
+}
+
+class BlobFromImagesInvoker : public ParallelLoopBody
+{
+public:
+    BlobFromImagesInvoker(const std::vector<BlobImagePlan>& plans_, Mat& blob_,
+                          const Scalar& mean_, bool swapRB_)
+        : plans(&plans_), blob(&blob_), swapRB(swapRB_)
+    {
+        for (int c = 0; c < 3; c++)
+            mean[c] = (float)mean_[c];
+    }
+
+    void operator()(const Range& r) const
+    {
+        int cn = blob->size[1], rows = blob->size[2], width = blob->size[3];
+        AutoBuffer<float> _buf(width*cn*2);
+        float* hbuf0 = _buf;
+        float* hbuf1 = hbuf0 + width*cn;
+
+        for (int row = r.start; row < r.end; row++)
+        {
+            int i = row / rows, y = row - i*rows;
+            const BlobImagePlan& p = (*plans)[i];
+            const Mat& img = p.image;
+            int scn = img.channels();
+
+            // Output planes and biases indexed by the source channel.
+            float* dst[3];
+            float bias[3];
+            for (int c = 0; c < cn; c++)
+            {
+                int oc = swapRB && cn == 3 ? 2 - c : c;
+                dst[c] = blob->ptr<float>(i, oc, y);
+                bias[c] = -mean[oc]*p.scale;
+            }
+
+            if (p.direct)
+            {
+                int sy = y + p.cropY;
+                if (img.depth() == CV_8U)
+                    normalizeRow(img.ptr<uchar>(sy) + p.cropX*scn, scn, cn, width, dst, p.scale, bias);
+                else
+                    normalizeRow(img.ptr<float>(sy) + p.cropX*scn, scn, cn, width, dst, p.scale, bias);
+                continue;
+            }
+
+            float sy = (y + p.cropY + 0.5f)*p.fy - 0.5f;
+            int y0 = cvFloor(sy);
+            float wy = sy - y0;
+            if (y0 < 0)
+            {
+                y0 = 0;
+                wy = 0.f;
+            }
+            if (y0 >= img.rows - 1)
+            {
+                y0 = img.rows - 1;
+                wy = 0.f;
+            }
+            int y1 = std::min(y0 + 1, img.rows - 1);
+
+            if (img.depth() == CV_8U)
+            {
+                resampleRow(img.ptr<uchar>(y0), p, cn, width, hbuf0);
+                resampleRow(img.ptr<uchar>(y1), p, cn, width, hbuf1);
+            }
+            else
+            {
+                resampleRow(img.ptr<float>(y0), p, cn, width, hbuf0);
+                resampleRow(img.ptr<float>(y1), p, cn, width, hbuf1);
+            }
+            for (int c = 0; c < cn; c++)
+                blendRows(hbuf0 + c*width, hbuf1 + c*width, wy, width, dst[c], p.scale, bias[c]);
+        }
+    }
+
+    const std::vector<BlobImagePlan>* plans;
+    Mat* blob;
+    float mean[3];
+    bool swapRB;
+};
+
+static void blobFromImagesImpl(const std::vector<Mat>& images, Mat& blob, Size size,
+                               const Scalar& mean, double scalefactor, bool scaleFloat,
+                               bool swapRB, bool crop)
+{
+    size_t i, nimages = images.size();
+    CV_Assert(nimages > 0);
+    const Mat& image0 = images[0];
+    int nch = image0.channels();
+    bool keepSize = size.width <= 0 || size.height <= 0;
+    if (keepSize)
+        size = image0.size();
+
+    std::vector<BlobImagePlan> plans(nimages);
+    for (i = 0; i < nimages; i++)
+    {
+        const Mat& image = images[i];
+        int depth = image.depth();
+        CV_Assert(image.dims == 2 && !image.empty());
+        CV_Assert(depth == CV_8U || depth == CV_32F);
+        CV_Assert(image.channels() == nch && (nch == 1 || nch == 3 || nch == 4));
+        CV_Assert(!keepSize || image.size() == size);
+        float scale = depth == CV_8U || scaleFloat ? (float)scalefactor : 1.f;
+        plans[i].init(image, size, crop, scale);
+    }
+
+    int sz[] = { (int)nimages, nch == 1 ? 1 : 3, size.height, size.width };
+    blob.create(4, sz, CV_32F);
+
+    int total = (int)nimages*size.height;
+    parallel_for_(Range(0, total), BlobFromImagesInvoker(plans, blob, mean, swapRB),
+                  (double)total*size.width*sz[1]/(1 << 16));
+}
+
+}
+
+Mat blobFromImage(const Mat& image, double scalefactor, bool swapRB)
+{
+    Mat blob;
+    blobFromImagesImpl(std::vector<Mat>(1, image), blob, Size(), Scalar(), scalefactor, false, swapRB, false);
     return blob;
 }
 
+Mat blobFromImages(const std::vector<Mat>& images, double scalefactor, bool swapRB)
+{
+    Mat blob;
+    if (!images.empty())
+        blobFromImagesImpl(images, blob, Size(), Scalar(), scalefactor, false, swapRB, false);
+    return blob;
+}
+
+void blobFromImage(const Mat& image, Mat& blob, Size size, const Scalar& mean,
+                   double scalefactor, bool swapRB, bool crop)
+{
+    blobFromImagesImpl(std::vector<Mat>(1, image), blob, size, mean, scalefactor, true, swapRB, crop);
+}
+
+void blobFromImages(const std::vector<Mat>& images, Mat& blob, Size size, const Scalar& mean,
+                    double scalefactor, bool swapRB, bool crop)
+{
+    blobFromImagesImpl(images, blob, size, mean, scalefactor, true, swapRB, crop);
+}
+
 
 struct LayerPin
 {
@@ -143,13 +403,176 @@ struct LayerPin
     {
         return (lid == r.lid && oid == r.oid);
     }
+
+    bool operator<(const LayerPin &r) const
+    {
+        return lid < r.lid || (lid == r.lid && oid < r.oid);
+    }
+};
+
+//checks that both blobs are parts of the same memory buffer
+static bool blobsOverlap(const Mat &a, const Mat &b)
+{
+    return a.datastart && b.datastart && a.datastart < b.dataend && b.datastart < a.dataend;
+}
+
+//Pool of memory buffers which are shared by output blobs of layers with non-overlapping lifetimes.
+//Each buffer counts the number of pending reads of the blobs stored in it (i.e. the number of
+//not yet computed consumer layers) and becomes free when the counter reaches zero.
+class BlobManager
+{
+public:
+    BlobManager() : totalMemory(0) {}
+
+    void reset()
+    {
+        buffers.clear();
+        pins.clear();
+        totalMemory = 0;
+    }
+
+    //returns id of the smallest free buffer which is able to hold the blob, creates new buffer if there is no one
+    int acquireBuffer(int depth, size_t total)
+    {
+        int bestId = -1;
+        for (size_t i = 0; i < buffers.size(); i++)
+        {
+            const Buffer &buf = buffers[i];
+            if (buf.used || buf.data.depth() != depth || buf.data.total() < total)
+                continue;
+            if (bestId < 0 || buf.data.total() < buffers[bestId].data.total())
+                bestId = (int)i;
+        }
+
+        if (bestId < 0)
+        {
+            Buffer buf;
+            buf.data.create(1, (int)total, CV_MAKETYPE(depth, 1));
+            buffers.push_back(buf);
+            totalMemory += total * buf.data.elemSize();
+            bestId = (int)buffers.size() - 1;
+        }
+
+        buffers[bestId].used = true;
+        return bestId;
+    }
+
+    //binds the blob to the buffer and returns header of the blob placed in the buffer
+    Mat assignBuffer(const LayerPin &pin, int bufId, const Mat &shape)
+    {
+        Buffer &buf = buffers[bufId];
+        buf.used = true;
+        buf.generation++;
+        pins[pin] = PinInfo(bufId, buf.generation, true);
+        return buf.data.colRange(0, (int)shape.total()).reshape(1, shape.dims, shape.size.p);
+    }
+
+    //binds the blob which shares the memory with other blob (e.g. reshaped or in-place activation output)
+    void aliasBuffer(const LayerPin &pin, int bufId)
+    {
+        pins[pin] = PinInfo(bufId, buffers[bufId].generation, false);
+    }
+
+    void unbind(const LayerPin &pin)
+    {
+        pins.erase(pin);
+    }
+
+    int getBufferId(const LayerPin &pin) const
+    {
+        std::map<LayerPin, PinInfo>::const_iterator it = pins.find(pin);
+        return (it != pins.end()) ? it->second.bufId : -1;
+    }
+
+    bool isOwner(const LayerPin &pin) const
+    {
+        std::map<LayerPin, PinInfo>::const_iterator it = pins.find(pin);
+        return it != pins.end() && it->second.owner;
+    }
+
+    int numReferences(int bufId) const
+    {
+        return buffers[bufId].refs;
+    }
+
+    bool isPinned(int bufId) const
+    {
+        return buffers[bufId].pinned;
+    }
+
+    void addReferences(int bufId, int numRefs, bool pinned)
+    {
+        buffers[bufId].refs += numRefs;
+        buffers[bufId].pinned |= pinned;
+    }
+
+    void releaseReference(int bufId)
+    {
+        CV_Assert(buffers[bufId].refs > 0);
+        buffers[bufId].refs--;
+    }
+
+    void freeIfUnused(int bufId)
+    {
+        Buffer &buf = buffers[bufId];
+        if (buf.refs == 0 && !buf.pinned)
+            buf.used = false;
+    }
+
+    //should be called after the blob was computed by forward pass
+    void markWritten(const LayerPin &pin)
+    {
+        std::map<LayerPin, PinInfo>::const_iterator it = pins.find(pin);
+        if (it != pins.end() && it->second.owner)
+            buffers[it->second.bufId].activeGeneration = it->second.generation;
+    }
+
+    //returns true if the blob memory was reused by other blob during the last forward pass
+    bool isOverwritten(const LayerPin &pin) const
+    {
+        std::map<LayerPin, PinInfo>::const_iterator it = pins.find(pin);
+        if (it == pins.end())
+            return false;
+        const Buffer &buf = buffers[it->second.bufId];
+        return buf.activeGeneration >= 0 && buf.activeGeneration != it->second.generation;
+    }
+
+    size_t getTotalMemory() const
+    {
+        return totalMemory;
+    }
+
+private:
+    struct Buffer
+    {
+        Buffer() : refs(0), generation(0), activeGeneration(-1), used(false), pinned(false) {}
+
+        Mat data;
+        int refs;
+        int generation, activeGeneration;
+        bool used, pinned;
+    };
+
+    struct PinInfo
+    {
+        PinInfo(int bufId_ = -1, int generation_ = 0, bool owner_ = false)
+            : bufId(bufId_), generation(generation_), owner(owner_) {}
+
+        int bufId;
+        int generation;
+        bool owner;
+    };
+
+    std::vector<Buffer> buffers;
+    std::map<LayerPin, PinInfo> pins;
+    size_t totalMemory;
 };
 
 struct LayerData
 {
-    LayerData() {}
+    LayerData() : skip(false), fusedInto(-1) {}
     LayerData(int _id, const String &_name, const String &_type, LayerParams &_params)
-        : id(_id), name(_name), type(_type), params(_params)
+        : id(_id), name(_name), type(_type), params(_params), skip(false), fusedInto(-1)
     {
         //add logging info
         params.name = name;
@@ -170,6 +593,8 @@ struct LayerData
     std::vector<Mat*> inputBlobs;
 
     int flag;
+    bool skip;      //the layer is computed by the preceding layer, which it was merged into
+    int fusedInto;  //id of the last merged layer, whose result overwrites output of this layer
 
     Ptr<Layer> getLayerInstance()
     {
@@ -203,10 +628,55 @@ struct DataLayer : public Layer
         outNames.assign(names.begin(), names.end());
     }
 
+    const std::vector<String> &getNames() const
+    {
+        return outNames;
+    }
+
 private:
     std::vector<String> outNames;
 };
 
+namespace
+{
+struct ThreadsLimitData
+{
+    ThreadsLimitData() : nthreads(0) {}
+    int nthreads;
+};
+
+//limit of the network which runs on the thread, other threads and parallel_for_ callers are unaffected
+static TLSData<ThreadsLimitData> threadsLimitTLS;
+
+//applies the per-network limit of threads to the layers within the scope
+class ThreadsLimit
+{
+public:
+    explicit ThreadsLimit(int nthreads)
+    {
+        ThreadsLimitData* data = threadsLimitTLS.get();
+        prevThreads = data->nthreads;
+        data->nthreads = nthreads;
+    }
+
+    ~ThreadsLimit()
+    {
+        threadsLimitTLS.get()->nthreads = prevThreads;
+    }
+
+private:
+    int prevThreads;
+};
+}
+
+double limitStripes(double nstripes)
+{
+    int nthreads = threadsLimitTLS.get()->nthreads;
+    if (nthreads <= 0)
+        return nstripes;
+    return nstripes > 0 ? std::min(nstripes, (double)nthreads) : (double)nthreads;
+}
+
 struct Net::Impl
 {
     Impl()
@@ -222,6 +692,39 @@ struct Net::Impl
 
         lastLayerId = 1;
         netWasAllocated = false;
+        memoryReuse = false;
+        fusion = true;
+        int8 = false;
+        calibrating = false;
+        savedInt8 = savedMemoryReuse = false;
+        numThreads = 0;
+        blobsBytes = plannedBytes = 0;
+        allocationId = 0;
+        profiling = false;
+        profileRuns = 0;
+        profileTime = 0;
+        profileStartTick = 0;
+#ifdef CV_DNN_ASYNC
+        asyncCapacity = 4;
+        asyncInFlight = 0;
+        asyncStop = false;
+        asyncPlanId = -1;
+        asyncCompleted = 0;
+        asyncQueueTime = asyncForwardTime = 0;
+#endif
+    }
+
+    ~Impl()
+    {
+#ifdef CV_DNN_ASYNC
+        {
+            std::lock_guard<std::mutex> lock(asyncMutex);
+            asyncStop = true;
+        }
+        asyncCond.notify_all();
+        for (size_t i = 0; i < asyncWorkers.size(); i++)
+            asyncWorkers[i].join();
+#endif
     }
 
     Ptr<DataLayer> netInputLayer;
@@ -235,16 +738,256 @@ struct Net::Impl
 
     bool netWasAllocated;
 
+    bool fusion;
+    bool memoryReuse;
+    bool int8, calibrating;
+    bool savedInt8, savedMemoryReuse;
+    int numThreads;
+    std::map<LayerPin, float> blobRanges;
+    BlobManager blobManager;
+    std::set<LayerPin> blobsToKeep;
+    std::map<LayerPin, int> numConsumers;
+    size_t blobsBytes, plannedBytes;
+    int allocationId;
+
+    struct LayerTiming
+    {
+        LayerTiming() : runs(0), total(0), minTime(DBL_MAX), maxTime(0), fused(false) {}
+
+        int runs;
+        double total, minTime, maxTime;
+        bool fused;  //the layer is merged into another one and isn't computed
+    };
+
+    struct TraceEvent
+    {
+        int lid;  //-1 for the whole forward pass
+        int64 start, end;
+    };
+
+    enum { MAX_TRACE_EVENTS = 100000 };
+
+    bool profiling;
+    std::vector<int> profileOrder;  //layers in order of their first execution
+    std::map<int, LayerTiming> layerTimings;
+    int profileRuns;
+    double profileTime;
+    std::deque<TraceEvent> traceEvents;
+    int64 profileStartTick;
+
+#ifdef CV_DNN_ASYNC
+    struct AsyncRequest
+    {
+        std::vector<Mat> inputs;
+        std::vector<LayerPin> outputPins;
+        std::promise<std::vector<Mat> > result;
+        int64 submitTick;
+    };
+
+    size_t asyncCapacity, asyncInFlight;
+    bool asyncStop;
+    std::deque<std::shared_ptr<AsyncRequest> > asyncQueue;
+    std::vector<std::thread> asyncWorkers;
+    std::mutex asyncMutex;
+    std::condition_variable asyncCond;   //new requests or stop
+    std::condition_variable asyncSpace;  //completed requests
+
+    //execution plan of the allocated network, built only when there are no requests in flight
+    int asyncPlanId;
+    std::vector<int> asyncOrder;
+    std::map<int, std::vector<std::pair<int, ptrdiff_t> > > asyncAliases;  //outputs which are views of inputs
+    std::map<int, Ptr<std::mutex> > layerMutexes;
+
+    std::mutex asyncStatsMutex;
+    size_t asyncCompleted;
+    double asyncQueueTime, asyncForwardTime;
+    std::vector<double> asyncLayerTimes;
+#endif
+
     void setUpNet()
     {
         if (!netWasAllocated)
         {
+            fuseLayers();
+            quantizeLayers();
             allocateLayers();
             computeNetOutputLayers();
 
             netWasAllocated = true;
+            allocationId++;
+        }
+    }
+
+#ifdef CV_DNN_ASYNC
+    void addToAsyncOrder(int lid, std::set<int> &visited)
+    {
+        if (!visited.insert(lid).second)
+            return;
+
+        LayerData &ld = layers[lid];
+        for (set<int>::iterator i = ld.inputLayersId.begin(); i != ld.inputLayersId.end(); i++)
+            addToAsyncOrder(*i, visited);
+
+        asyncOrder.push_back(lid);
+    }
+
+    void buildAsyncPlan()
+    {
+        std::set<int> visited;
+        asyncOrder.clear();
+        asyncAliases.clear();
+
+        MapIdToLayerData::iterator it;
+        for (it = layers.begin(); it != layers.end(); it++)
+            addToAsyncOrder(it->first, visited);
+
+        //outputs of layers like Reshape or merged layers share memory with the inputs,
+        //so the same views are made over blobs of every request
+        for (it = layers.begin(); it != layers.end(); it++)
+        {
+            LayerData &ld = it->second;
+            std::vector<std::pair<int, ptrdiff_t> > &aliases = asyncAliases[it->first];
+            aliases.assign(ld.outputBlobs.size(), std::make_pair(-1, (ptrdiff_t)0));
+            if (it->first == 0)
+                continue;
+
+            for (size_t i = 0; i < ld.outputBlobs.size(); i++)
+            {
+                const Mat &out = ld.outputBlobs[i];
+                for (size_t j = 0; j < ld.inputBlobs.size() && aliases[i].first < 0 && !out.empty(); j++)
+                {
+                    const Mat &inp = *ld.inputBlobs[j];
+                    if (!inp.empty() && out.data >= inp.datastart && out.data < inp.dataend)
+                        aliases[i] = std::make_pair((int)j, (ptrdiff_t)(out.data - inp.data));
+                }
+            }
+
+            if (layerMutexes.find(it->first) == layerMutexes.end())
+                layerMutexes[it->first] = Ptr<std::mutex>(new std::mutex());
+        }
+
+        std::lock_guard<std::mutex> lock(asyncStatsMutex);
+        asyncCompleted = 0;
+        asyncQueueTime = asyncForwardTime = 0;
+        asyncLayerTimes.assign(asyncOrder.size(), 0.);
+        asyncPlanId = allocationId;
+    }
+
+    std::vector<Mat> runAsyncRequest(AsyncRequest &req, std::vector<double> &layerTimes)
+    {
+        ThreadsLimit limit(numThreads);
+        std::map<int, std::vector<Mat> > blobs;
+        layerTimes.assign(asyncOrder.size(), 0.);
+
+        for (size_t k = 0; k < asyncOrder.size(); k++)
+        {
+            int lid = asyncOrder[k];
+            LayerData &ld = layers.find(lid)->second;
+            std::vector<Mat> &outs = blobs[lid];
+
+            if (lid == 0)
+            {
+                outs = req.inputs;
+                continue;
+            }
+
+            std::vector<Mat*> inps(ld.inputBlobsId.size());
+            for (size_t i = 0; i < inps.size(); i++)
+            {
+                LayerPin pin = ld.inputBlobsId[i];
+                std::vector<Mat> &src = blobs[pin.lid];
+                CV_Assert(pin.oid < (int)src.size());
+                inps[i] = &src[pin.oid];
+            }
+
+            const std::vector<std::pair<int, ptrdiff_t> > &aliases = asyncAliases.find(lid)->second;
+            outs.resize(ld.outputBlobs.size());
+            for (size_t i = 0; i < outs.size(); i++)
+            {
+                const Mat &ref = ld.outputBlobs[i];
+                if (ref.empty())
+                    continue;
+
+                if (aliases[i].first >= 0)
+                {
+                    uchar* data = inps[aliases[i].first]->data + aliases[i].second;
+                    outs[i] = Mat(ref.dims, ref.size.p, ref.type(), data, ref.step.p);
+                }
+                else
+                    outs[i].create(ref.dims, ref.size.p, ref.type());
+            }
+
+            int64 t0 = getTickCount();
+            if (!ld.skip)
+            {
+                //a layer computes one request at a time, the others wait and are pipelined behind it
+                std::lock_guard<std::mutex> lock(*layerMutexes.find(lid)->second);
+                ld.layerInstance->forward(inps, outs);
+            }
+            layerTimes[k] = (getTickCount() - t0) * 1000. / getTickFrequency();
+        }
+
+        std::vector<Mat> results(req.outputPins.size());
+        for (size_t i = 0; i < results.size(); i++)
+            results[i] = blobs[req.outputPins[i].lid][req.outputPins[i].oid];
+        return results;
+    }
+
+    void asyncWorker()
+    {
+        std::vector<double> layerTimes;
+        for (;;)
+        {
+            std::shared_ptr<AsyncRequest> req;
+            {
+                std::unique_lock<std::mutex> lock(asyncMutex);
+                while (!asyncStop && asyncQueue.empty())
+                    asyncCond.wait(lock);
+                if (asyncQueue.empty())
+                    return;
+
+                req = asyncQueue.front();
+                asyncQueue.pop_front();
+                asyncInFlight++;
+            }
+
+            int64 startTick = getTickCount();
+            std::vector<Mat> results;
+            std::exception_ptr error;
+            try
+            {
+                results = runAsyncRequest(*req, layerTimes);
+            }
+            catch (...)
+            {
+                error = std::current_exception();
+            }
+            int64 endTick = getTickCount();
+
+            {
+                std::lock_guard<std::mutex> lock(asyncStatsMutex);
+                double msPerTick = 1000. / getTickFrequency();
+                asyncCompleted++;
+                asyncQueueTime += (startTick - req->submitTick) * msPerTick;
+                asyncForwardTime += (endTick - startTick) * msPerTick;
+                for (size_t k = 0; k < layerTimes.size() && k < asyncLayerTimes.size(); k++)
+                    asyncLayerTimes[k] += layerTimes[k];
+            }
+
+            {
+                std::lock_guard<std::mutex> lock(asyncMutex);
+                asyncInFlight--;
+            }
+            asyncSpace.notify_all();
+
+            //statistics are complete when the future becomes ready
+            if (error)
+                req->result.set_exception(error);
+            else
+                req->result.set_value(results);
         }
     }
+#endif
 
     int getLayerId(const String &layerName)
     {
@@ -375,97 +1118,342 @@ struct Net::Impl
         ldOut.requiredOutputs.insert(outNum);
     }
 
-    void computeNetOutputLayers()
+    void computeNetOutputLayers()
+    {
+        netOutputs.clear();
+
+        MapIdToLayerData::iterator it;
+        for (it = layers.begin(); it != layers.end(); it++)
+        {
+            int lid = it->first;
+            LayerData &ld = it->second;
+
+            if (ld.requiredOutputs.size() == 0)
+                netOutputs.push_back(lid);
+        }
+
+        #ifndef NDEBUG
+        std::cout << "\nNet Outputs(" << netOutputs.size() << "):\n";
+        for (size_t i = 0; i < netOutputs.size(); i++)
+            std::cout << layers[netOutputs[i]].name << "\n";
+        #endif
+    }
+
+    #define CV_RETHROW_ERROR(err, newmsg)\
+        cv::error(err.code, newmsg, err.func.c_str(), err.file.c_str(), err.line)
+
+    void allocateLayer(int lid)
+    {
+        LayerData &ld = layers[lid];
+
+        //already allocated
+        if (ld.flag)
+            return;
+
+        size_t ninputs = ld.inputBlobsId.size();
+#if 0
+        printf("layer %s:", ld.name.c_str());
+        for (size_t i = 0; i < ninputs; i++)
+        {
+            int inp_lid = ld.inputBlobsId[i].lid;
+            LayerData &inp_ld = layers[inp_lid];
+            int inp_outputs = (int)inp_ld.outputBlobs.size();
+            std::cout << " " << inp_ld.name << "(" << inp_outputs;
+
+            for( int j = 0; j < inp_outputs; j++ )
+            {
+                std::cout << (j == 0 ? ": " : ", ") << inp_ld.outputBlobs[j].size;
+            }
+            std::cout << ")";
+        }
+        printf("\n");
+#endif
+
+        //determine parent layers
+        for (size_t i = 0; i < ninputs; i++)
+            ld.inputLayersId.insert(ld.inputBlobsId[i].lid);
+
+        //allocate parents
+        for (set<int>::iterator i = ld.inputLayersId.begin(); i != ld.inputLayersId.end(); i++)
+            allocateLayer(*i);
+
+        //bind inputs
+        ld.inputBlobs.resize(ninputs);
+        for (size_t i = 0; i < ninputs; i++)
+        {
+            LayerPin from = ld.inputBlobsId[i];
+            CV_Assert(from.valid());
+            CV_DbgAssert(layers.count(from.lid) && (int)layers[from.lid].outputBlobs.size() > from.oid);
+            ld.inputBlobs[i] = &layers[from.lid].outputBlobs[from.oid];
+        }
+
+        //allocate layer
+        ld.outputBlobs.resize(std::max((size_t)1, ld.requiredOutputs.size())); //layer produce at least one output blob
+        //try
+        {
+            Ptr<Layer> layerPtr = ld.getLayerInstance();
+            if (ld.skip)
+            {
+                //output of the merged layer is computed over its input
+                CV_Assert(ninputs == 1 && ld.outputBlobs.size() == 1);
+                ld.outputBlobs[0] = *ld.inputBlobs[0];
+            }
+            else
+                layerPtr->allocate(ld.inputBlobs, ld.outputBlobs);
+            if (lid != 0)
+                planLayerMemory(ld);
+#if 0
+            std::cout << "\toutputs:";
+            size_t noutputs = ld.outputBlobs.size();
+            for (size_t j = 0; j < noutputs; j++)
+            {
+                std::cout << (j == 0 ? " " : ", ") << ld.outputBlobs[j].size;
+            }
+            std::cout << "\n";
+#endif
+        }
+        /*catch (const cv::Exception &err)
+        {
+            CV_RETHROW_ERROR(err, format("The following error occured while making allocate() for layer \"%s\": %s", ld.name.c_str(), err.err.c_str()));
+        }*/
+
+        ld.flag = 1;
+    }
+
+    //merges chains of layers like Convolution -> BatchNorm -> Scale -> ReLU into their first layer
+    void fuseLayers()
+    {
+        MapIdToLayerData::iterator it;
+        std::map<LayerPin, int> consumers, consumerId;
+
+        for (it = layers.begin(); it != layers.end(); it++)
+        {
+            LayerData &ld = it->second;
+            ld.skip = false;
+            ld.fusedInto = -1;
+            if (it->first != 0 && ld.layerInstance)
+                ld.layerInstance->fuse(Ptr<Layer>());
+
+            for (size_t i = 0; i < ld.inputBlobsId.size(); i++)
+            {
+                consumers[ld.inputBlobsId[i]]++;
+                consumerId[ld.inputBlobsId[i]] = it->first;
+            }
+        }
+
+        if (!fusion)
+            return;
+
+        for (it = layers.begin(); it != layers.end(); it++)
+        {
+            LayerData &ld = it->second;
+            if (it->first == 0 || ld.skip || ld.inputBlobsId.size() != 1)
+                continue;
+
+            Ptr<Layer> layer = ld.getLayerInstance();
+            std::vector<int> chain;
+            int cur = it->first;
+
+            for (;;)
+            {
+                LayerPin pin(cur, 0);
+                LayerData &curLd = layers[cur];
+                if (curLd.requiredOutputs.size() != 1 || consumers[pin] != 1 || blobsToKeep.count(pin))
+                    break;
+
+                LayerData &top = layers[consumerId[pin]];
+                if (top.inputBlobsId.size() != 1 || !layer->fuse(top.getLayerInstance()))
+                    break;
+
+                chain.push_back(cur);
+                top.skip = true;
+                cur = top.id;
+            }
+
+            for (size_t i = 0; i < chain.size(); i++)
+                layers[chain[i]].fusedInto = cur;
+        }
+    }
+
+    //switches layers with calibrated inputs to 8-bit computations
+    void quantizeLayers()
+    {
+        MapIdToLayerData::iterator it;
+        for (it = layers.begin(); it != layers.end(); it++)
+        {
+            LayerData &ld = it->second;
+            if (it->first == 0 || !ld.layerInstance)
+                continue;
+
+            std::vector<float> ranges;
+            for (size_t i = 0; int8 && i < ld.inputBlobsId.size(); i++)
+            {
+                std::map<LayerPin, float>::iterator r = blobRanges.find(ld.inputBlobsId[i]);
+                if (r == blobRanges.end())
+                {
+                    ranges.clear();
+                    break;
+                }
+                ranges.push_back(r->second);
+            }
+
+            ld.layerInstance->quantize(ranges);
+        }
+    }
+
+    //ranges are collected in floating point mode without memory reuse, so that every blob has own buffer
+    void setCalibrationMode(bool enable)
+    {
+        if (enable)
+        {
+            savedInt8 = int8;
+            savedMemoryReuse = memoryReuse;
+            int8 = memoryReuse = false;
+        }
+        else
+        {
+            int8 = savedInt8;
+            memoryReuse = savedMemoryReuse;
+        }
+        calibrating = enable;
+        netWasAllocated = false;
+    }
+
+    void updateRanges(LayerData &ld)
     {
-        netOutputs.clear();
-
-        MapIdToLayerData::iterator it;
-        for (it = layers.begin(); it != layers.end(); it++)
+        for (size_t i = 0; i < ld.outputBlobs.size(); i++)
         {
-            int lid = it->first;
-            LayerData &ld = it->second;
+            const Mat &blob = ld.outputBlobs[i];
+            if (blob.empty() || blob.depth() != CV_32F)
+                continue;
 
-            if (ld.requiredOutputs.size() == 0)
-                netOutputs.push_back(lid);
-        }
+            double minVal, maxVal;
+            minMaxIdx(blob.reshape(1, 1), &minVal, &maxVal);
 
-        #ifndef NDEBUG
-        std::cout << "\nNet Outputs(" << netOutputs.size() << "):\n";
-        for (size_t i = 0; i < netOutputs.size(); i++)
-            std::cout << layers[netOutputs[i]].name << "\n";
-        #endif
+            float &range = blobRanges[LayerPin(ld.id, (int)i)];
+            range = std::max(range, (float)std::max(-minVal, maxVal));
+        }
     }
 
-    #define CV_RETHROW_ERROR(err, newmsg)\
-        cv::error(err.code, newmsg, err.func.c_str(), err.file.c_str(), err.line)
-
-    void allocateLayer(int lid)
+    void planLayerMemory(LayerData &ld)
     {
-        LayerData &ld = layers[lid];
+        size_t i, j, ninputs = ld.inputBlobs.size(), noutputs = ld.outputBlobs.size();
+        std::vector<bool> aliased(noutputs, false);
 
-        //already allocated
-        if (ld.flag)
+        for (i = 0; i < noutputs; i++)
+        {
+            const Mat &out = ld.outputBlobs[i];
+            //layers with empty outputs (e.g. Permute without permutation) assign them in forward()
+            for (j = 0; j < ninputs && !aliased[i]; j++)
+                aliased[i] = out.empty() ? j == 0 : blobsOverlap(out, *ld.inputBlobs[j]);
+            if (!aliased[i])
+                blobsBytes += out.total() * out.elemSize();
+        }
+
+        if (!memoryReuse)
             return;
 
-        size_t ninputs = ld.inputBlobsId.size();
-#if 0
-        printf("layer %s:", ld.name.c_str());
-        for (size_t i = 0; i < ninputs; i++)
+        Ptr<Layer> layer = ld.layerInstance;
+        std::vector<int> outBuffers(noutputs, -1);
+        std::vector<const uchar*> outData(noutputs, (const uchar*)NULL);
+
+        for (i = 0; i < noutputs; i++)
         {
-            int inp_lid = ld.inputBlobsId[i].lid;
-            LayerData &inp_ld = layers[inp_lid];
-            int inp_outputs = (int)inp_ld.outputBlobs.size();
-            std::cout << " " << inp_ld.name << "(" << inp_outputs;
+            Mat &out = ld.outputBlobs[i];
+            LayerPin pin(ld.id, (int)i);
 
-            for( int j = 0; j < inp_outputs; j++ )
+            if (aliased[i])
             {
-                std::cout << (j == 0 ? ": " : ", ") << inp_ld.outputBlobs[j].size;
+                for (j = 0; j < ninputs && outBuffers[i] < 0; j++)
+                {
+                    if (out.empty() ? j == 0 : blobsOverlap(out, *ld.inputBlobs[j]))
+                        outBuffers[i] = blobManager.getBufferId(ld.inputBlobsId[j]);
+                }
+                if (outBuffers[i] >= 0)
+                    blobManager.aliasBuffer(pin, outBuffers[i]);
+                continue;
             }
-            std::cout << ")";
-        }
-        printf("\n");
-#endif
 
-        //determine parent layers
-        for (size_t i = 0; i < ninputs; i++)
-            ld.inputLayersId.insert(ld.inputBlobsId[i].lid);
+            if (out.empty() || !out.isContinuous() || out.channels() != 1)
+            {
+                plannedBytes += out.total() * out.elemSize();
+                continue;
+            }
 
-        //allocate parents
-        for (set<int>::iterator i = ld.inputLayersId.begin(); i != ld.inputLayersId.end(); i++)
-            allocateLayer(*i);
+            int bufId = -1;
+            if (i == 0 && ninputs > 0 && layer->supportInPlace())
+            {
+                const Mat &inp = *ld.inputBlobs[0];
+                int inpBufId = blobManager.getBufferId(ld.inputBlobsId[0]);
+
+                if (inpBufId >= 0 && inp.type() == out.type() && inp.total() == out.total() &&
+                    !blobManager.isPinned(inpBufId))
+                {
+                    //the layer would read an already overwritten value through other inputs
+                    //sharing the buffer, e.g. Eltwise(x, x)
+                    bool sharedInput = false;
+                    for (j = 1; j < ninputs; j++)
+                        sharedInput |= blobManager.getBufferId(ld.inputBlobsId[j]) == inpBufId;
+
+                    //nobody will read the input blob after this layer
+                    if (!sharedInput && blobManager.numReferences(inpBufId) == 1)
+                        bufId = inpBufId;
+                }
+            }
 
-        //bind inputs
-        ld.inputBlobs.resize(ninputs);
-        for (size_t i = 0; i < ninputs; i++)
+            if (bufId < 0)
+                bufId = blobManager.acquireBuffer(out.depth(), out.total());
+
+            out = blobManager.assignBuffer(pin, bufId, out);
+            outBuffers[i] = bufId;
+            outData[i] = out.data;
+        }
+
+        if (std::count(outData.begin(), outData.end(), (const uchar*)NULL) < (int)noutputs)
         {
-            LayerPin from = ld.inputBlobsId[i];
-            CV_Assert(from.valid());
-            CV_DbgAssert(layers.count(from.lid) && (int)layers[from.lid].outputBlobs.size() > from.oid);
-            ld.inputBlobs[i] = &layers[from.lid].outputBlobs[from.oid];
+            //let the layer update its internal state with respect to new outputs
+            layer->allocate(ld.inputBlobs, ld.outputBlobs);
         }
 
-        //allocate layer
-        ld.outputBlobs.resize(std::max((size_t)1, ld.requiredOutputs.size())); //layer produce at least one output blob
-        //try
+        for (i = 0; i < noutputs; i++)
         {
-            Ptr<Layer> layerPtr = ld.getLayerInstance();
-            layerPtr->allocate(ld.inputBlobs, ld.outputBlobs);
-#if 0
-            std::cout << "\toutputs:";
-            size_t noutputs = ld.outputBlobs.size();
-            for (size_t j = 0; j < noutputs; j++)
+            if (outBuffers[i] < 0)
+                continue;
+
+            LayerPin pin(ld.id, (int)i);
+            if (outData[i] && ld.outputBlobs[i].data != outData[i])
             {
-                std::cout << (j == 0 ? " " : ", ") << ld.outputBlobs[j].size;
+                //the layer has reallocated the output by itself
+                blobManager.unbind(pin);
+                blobManager.freeIfUnused(outBuffers[i]);
+                plannedBytes += ld.outputBlobs[i].total() * ld.outputBlobs[i].elemSize();
+                outBuffers[i] = -1;
+                continue;
             }
-            std::cout << "\n";
-#endif
+
+            bool keep = ld.requiredOutputs.empty() || blobsToKeep.count(pin) != 0;
+            std::map<LayerPin, int>::const_iterator it = numConsumers.find(pin);
+            blobManager.addReferences(outBuffers[i], (it != numConsumers.end()) ? it->second : 0, keep);
         }
-        /*catch (const cv::Exception &err)
-        {
-            CV_RETHROW_ERROR(err, format("The following error occured while making allocate() for layer \"%s\": %s", ld.name.c_str(), err.err.c_str()));
-        }*/
 
-        ld.flag = 1;
+        //inputs which aren't required by following layers return their buffers to the pool
+        for (j = 0; j < ninputs; j++)
+        {
+            int bufId = blobManager.getBufferId(ld.inputBlobsId[j]);
+            if (bufId >= 0)
+                blobManager.releaseReference(bufId);
+        }
+        for (j = 0; j < ninputs; j++)
+        {
+            int bufId = blobManager.getBufferId(ld.inputBlobsId[j]);
+            if (bufId >= 0)
+                blobManager.freeIfUnused(bufId);
+        }
+        for (i = 0; i < noutputs; i++)
+        {
+            if (outBuffers[i] >= 0)
+                blobManager.freeIfUnused(outBuffers[i]);
+        }
     }
 
     void allocateLayers()
@@ -474,11 +1462,31 @@ struct Net::Impl
         for (it = layers.begin(); it != layers.end(); it++)
             it->second.flag = 0;
 
+        blobManager.reset();
+        numConsumers.clear();
+        blobsBytes = plannedBytes = 0;
+
+        for (it = layers.begin(); it != layers.end(); it++)
+        {
+            LayerData &ld = it->second;
+            for (size_t i = 0; i < ld.inputBlobsId.size(); i++)
+                numConsumers[ld.inputBlobsId[i]]++;
+
+            //previous outputs might be shared buffers or aliases of merged layers
+            if (it->first != 0)
+                ld.outputBlobs.clear();
+        }
+
         for (it = layers.begin(); it != layers.end(); it++)
         {
             int lid = it->first;
             allocateLayer(lid);
         }
+
+        if (memoryReuse)
+            plannedBytes += blobManager.getTotalMemory();
+        else
+            plannedBytes = blobsBytes;
     }
 
     void forwardLayer(LayerData &ld, bool clearFlags = true)
@@ -502,9 +1510,26 @@ struct Net::Impl
 
         //forward itself
         //try
+        if (!ld.skip)
         {
+            int64 startTick = profiling ? getTickCount() : 0;
             ld.layerInstance->forward(ld.inputBlobs, ld.outputBlobs);
+            if (profiling)
+                addTiming(ld.id, startTick, getTickCount());
+
+            if (memoryReuse)
+            {
+                for (size_t i = 0; i < ld.outputBlobs.size(); i++)
+                    blobManager.markWritten(LayerPin(ld.id, (int)i));
+            }
         }
+
+        else if (profiling)
+            addTiming(ld.id, 0, 0, true);
+
+        //outputs of merged layers are aliases of the computed blob, so their ranges are collected too
+        if (calibrating)
+            updateRanges(ld);
         /*catch (const cv::Exception &err)
         {
             CV_RETHROW_ERROR(err, format("The following error occured while making forward() for layer \"%s\": %s", ld.name.c_str(), err.err.c_str()));
@@ -513,6 +1538,49 @@ struct Net::Impl
         ld.flag = 1;
     }
 
+    void resetProfile()
+    {
+        profileOrder.clear();
+        layerTimings.clear();
+        traceEvents.clear();
+        profileRuns = 0;
+        profileTime = 0;
+        profileStartTick = getTickCount();
+    }
+
+    //registers a computed or merged (fused == true) layer, or a whole forward pass (lid == -1)
+    void addTiming(int lid, int64 startTick, int64 endTick, bool fused = false)
+    {
+        double ms = (endTick - startTick) * 1000. / getTickFrequency();
+        if (lid < 0)
+        {
+            profileRuns++;
+            profileTime += ms;
+        }
+        else
+        {
+            std::map<int, LayerTiming>::iterator it = layerTimings.find(lid);
+            if (it == layerTimings.end())
+            {
+                profileOrder.push_back(lid);
+                it = layerTimings.insert(std::make_pair(lid, LayerTiming())).first;
+            }
+            LayerTiming &t = it->second;
+            t.fused = fused;
+            if (fused)
+                return;
+            t.runs++;
+            t.total += ms;
+            t.minTime = std::min(t.minTime, ms);
+            t.maxTime = std::max(t.maxTime, ms);
+        }
+
+        TraceEvent e = { lid, startTick, endTick };
+        traceEvents.push_back(e);
+        if (traceEvents.size() > (size_t)MAX_TRACE_EVENTS)
+            traceEvents.pop_front();
+    }
+
     void forwardAll()
     {
         MapIdToLayerData::iterator it;
@@ -578,17 +1646,22 @@ void Net::connect(String _outPin, String _inPin)
 
 void Net::allocate()
 {
+    ThreadsLimit limit(impl->numThreads);
     impl->setUpNet();
 }
 
 void Net::forward(LayerId toLayer)
 {
+    ThreadsLimit limit(impl->numThreads);
     impl->setUpNet();
 
+    int64 startTick = impl->profiling ? getTickCount() : 0;
     if (toLayer.isString() && toLayer.get<String>().empty())
         impl->forwardAll();
     else
         impl->forwardLayer(impl->getLayerData(toLayer));
+    if (impl->profiling)
+        impl->addTiming(-1, startTick, getTickCount());
 }
 
 void Net::setNetInputs(const std::vector<String> &inputBlobNames)
@@ -606,8 +1679,9 @@ void Net::setBlob(String outputName, const Mat &blob_)
     ld.outputBlobs.resize( std::max(pin.oid+1, (int)ld.requiredOutputs.size()) );
     MatSize prevShape = ld.outputBlobs[pin.oid].size;
     ld.outputBlobs[pin.oid] = blob_.clone();
+    impl->blobManager.unbind(pin);
 
-    impl->netWasAllocated = prevShape == blob_.size;
+    impl->netWasAllocated = impl->netWasAllocated && prevShape == blob_.size;
 }
 
 Mat Net::getBlob(String outputName)
@@ -622,6 +1696,17 @@ Mat Net::getBlob(String outputName)
         CV_Error(Error::StsOutOfRange, "Layer \"" + ld.name + "\" produce only " + toString(ld.outputBlobs.size()) +
                                        " outputs, the #" + toString(pin.oid) + " was requsted");
     }
+    if (ld.fusedInto >= 0)
+    {
+        CV_Error(Error::StsError, "Layer \"" + ld.name + "\" was merged with the following layers up to \"" +
+                                  impl->layers[ld.fusedInto].name + "\" and its output isn't computed. "
+                                  "Use Net::keepBlobs() or Net::enableFusion(false) to get it");
+    }
+    if (impl->memoryReuse && impl->blobManager.isOverwritten(pin))
+    {
+        CV_Error(Error::StsError, "Memory of the blob \"" + outputName + "\" was reused by other layers. "
+                                  "Use Net::keepBlobs() to retain it after forward pass");
+    }
     return ld.outputBlobs[pin.oid];
 }
 
@@ -714,6 +1799,334 @@ std::vector<int> Net::getUnconnectedOutLayers() const
     return layersIds;
 }
 
+void Net::enableMemoryReuse(bool enable)
+{
+    if (impl->memoryReuse == enable)
+        return;
+
+    impl->memoryReuse = enable;
+    impl->netWasAllocated = false;
+}
+
+void Net::enableFusion(bool enable)
+{
+    if (impl->fusion == enable)
+        return;
+
+    impl->fusion = enable;
+    impl->netWasAllocated = false;
+}
+
+void Net::calibrate(const std::vector<Mat> &samples, const String &inputName)
+{
+    impl->setCalibrationMode(true);
+    impl->blobRanges.clear();
+
+    try
+    {
+        for (size_t i = 0; i < samples.size(); i++)
+        {
+            setBlob(inputName, samples[i]);
+            forward();
+        }
+    }
+    catch (...)
+    {
+        impl->setCalibrationMode(false);
+        throw;
+    }
+
+    impl->setCalibrationMode(false);
+}
+
+LayerProfile::LayerProfile()
+    : runs(0), meanTime(0), minTime(0), maxTime(0), flops(0), bytes(0), outputBytes(0), fused(false) {}
+
+NetProfile::NetProfile()
+    : runs(0), meanTime(0), flops(0), bytes(0) {}
+
+AsyncForwardStats::AsyncForwardStats()
+    : queueDepth(0), completedRequests(0), queueTime(0), forwardTime(0) {}
+
+#ifdef CV_DNN_ASYNC
+std::future<std::vector<Mat> > Net::forwardAsync(const std::vector<Mat> &inputs, const std::vector<String> &outputNames)
+{
+    CV_Assert(!inputs.empty());
+
+    std::shared_ptr<Impl::AsyncRequest> req(new Impl::AsyncRequest());
+    for (size_t i = 0; i < inputs.size(); i++)
+        req->inputs.push_back(inputs[i].clone());
+
+    std::unique_lock<std::mutex> lock(impl->asyncMutex);
+    while (impl->asyncQueue.size() + impl->asyncInFlight >= impl->asyncCapacity)
+        impl->asyncSpace.wait(lock);
+
+    LayerData &inpLd = impl->layers[0];
+    bool sameShapes = inpLd.outputBlobs.size() == inputs.size();
+    for (size_t i = 0; sameShapes && i < inputs.size(); i++)
+        sameShapes = inpLd.outputBlobs[i].size == inputs[i].size && inpLd.outputBlobs[i].type() == inputs[i].type();
+
+    if (!sameShapes || !impl->netWasAllocated || impl->asyncPlanId != impl->allocationId)
+    {
+        //layers are reallocated only when no requests use them
+        while (!impl->asyncQueue.empty() || impl->asyncInFlight > 0)
+            impl->asyncSpace.wait(lock);
+
+        if (!sameShapes)
+        {
+            inpLd.outputBlobs.resize(inputs.size());
+            for (size_t i = 0; i < inputs.size(); i++)
+                inpLd.outputBlobs[i] = inputs[i].clone();
+            impl->netWasAllocated = false;
+        }
+
+        ThreadsLimit limit(impl->numThreads);
+        impl->setUpNet();
+        impl->buildAsyncPlan();
+    }
+
+    if (outputNames.empty())
+    {
+        std::vector<int> outLayers = getUnconnectedOutLayers();
+        for (size_t i = 0; i < outLayers.size(); i++)
+            req->outputPins.push_back(LayerPin(outLayers[i], 0));
+    }
+    for (size_t i = 0; i < outputNames.size(); i++)
+    {
+        LayerPin pin = impl->getPinByAlias(outputNames[i]);
+        if (!pin.valid())
+            CV_Error(Error::StsObjectNotFound, "Requested blob \"" + outputNames[i] + "\" not found");
+        req->outputPins.push_back(pin);
+    }
+
+    std::future<std::vector<Mat> > result = req->result.get_future();
+    req->submitTick = getTickCount();
+    impl->asyncQueue.push_back(req);
+
+    while (impl->asyncWorkers.size() < impl->asyncCapacity)
+        impl->asyncWorkers.push_back(std::thread(&Impl::asyncWorker, impl.get()));
+
+    lock.unlock();
+    impl->asyncCond.notify_one();
+    return result;
+}
+
+void Net::setAsyncQueueSize(int maxRequests)
+{
+    CV_Assert(maxRequests > 0);
+
+    std::lock_guard<std::mutex> lock(impl->asyncMutex);
+    impl->asyncCapacity = (size_t)maxRequests;
+}
+
+AsyncForwardStats Net::getAsyncStats() const
+{
+    AsyncForwardStats stats;
+    std::lock_guard<std::mutex> lock(impl->asyncMutex);
+    stats.queueDepth = impl->asyncQueue.size() + impl->asyncInFlight;
+
+    std::lock_guard<std::mutex> statsLock(impl->asyncStatsMutex);
+    stats.completedRequests = impl->asyncCompleted;
+    double n = std::max((double)impl->asyncCompleted, 1.);
+    stats.queueTime = impl->asyncQueueTime / n;
+    stats.forwardTime = impl->asyncForwardTime / n;
+    for (size_t k = 0; k < impl->asyncLayerTimes.size(); k++)
+    {
+        stats.layerNames.push_back(impl->layers[impl->asyncOrder[k]].name);
+        stats.layerTimes.push_back(impl->asyncLayerTimes[k] / n);
+    }
+    return stats;
+}
+#endif
+
+void Net::setNumThreads(int nthreads)
+{
+    impl->numThreads = nthreads;
+}
+
+void Net::enableInt8(bool enable)
+{
+    if (impl->int8 == enable)
+        return;
+
+    impl->int8 = enable;
+    impl->netWasAllocated = false;
+}
+
+void Net::enableProfiling(bool enable)
+{
+    if (enable)
+        impl->resetProfile();
+    impl->profiling = enable;
+}
+
+static int64 blobBytes(const Mat &m)
+{
+    return (int64)(m.total() * m.elemSize());
+}
+
+NetProfile Net::getProfile() const
+{
+    NetProfile profile;
+    profile.runs = impl->profileRuns;
+    profile.meanTime = impl->profileRuns > 0 ? impl->profileTime / impl->profileRuns : 0;
+
+    for (size_t k = 0; k < impl->profileOrder.size(); k++)
+    {
+        int lid = impl->profileOrder[k];
+        const LayerData &ld = impl->layers[lid];
+        const Impl::LayerTiming &t = impl->layerTimings[lid];
+
+        LayerProfile lp;
+        lp.name = ld.name;
+        lp.type = ld.type;
+        lp.fused = t.fused;
+        lp.runs = t.runs;
+        if (t.runs > 0)
+        {
+            lp.meanTime = t.total / t.runs;
+            lp.minTime = t.minTime;
+            lp.maxTime = t.maxTime;
+        }
+
+        for (size_t i = 0; i < ld.outputBlobs.size(); i++)
+        {
+            const Mat &m = ld.outputBlobs[i];
+            lp.outputShapes.push_back(std::vector<int>(m.size.p, m.size.p + m.dims));
+            lp.outputBytes += blobBytes(m);
+        }
+        if (ld.layerInstance)
+        {
+            lp.flops = ld.layerInstance->getFLOPS(ld.inputBlobs, ld.outputBlobs);
+            //merged layers work over the output of the computing layer in place
+            if (!ld.skip)
+            {
+                lp.bytes = lp.outputBytes;
+                for (size_t i = 0; i < ld.inputBlobs.size(); i++)
+                    lp.bytes += blobBytes(*ld.inputBlobs[i]);
+                for (size_t i = 0; i < ld.layerInstance->blobs.size(); i++)
+                    lp.bytes += blobBytes(ld.layerInstance->blobs[i]);
+            }
+        }
+
+        profile.flops += lp.flops;
+        profile.bytes += lp.bytes;
+        profile.layers.push_back(lp);
+    }
+    return profile;
+}
+
+static String escapeJSON(const String &str)
+{
+    String res;
+    for (size_t i = 0; i < str.size(); i++)
+    {
+        char c = str[i];
+        if (c == '"' || c == '\\')
+            res += '\\';
+        if ((uchar)c >= 32)
+            res += c;
+    }
+    return res;
+}
+
+void Net::writeTrace(const String &path) const
+{
+    std::ofstream fs(path.c_str());
+    if (!fs.is_open())
+        CV_Error(Error::StsError, "Can't open \"" + path + "\" for writing");
+
+    double usPerTick = 1e6 / getTickFrequency();
+    fs << "{\"traceEvents\":[";
+    for (size_t k = 0; k < impl->traceEvents.size(); k++)
+    {
+        const Impl::TraceEvent &e = impl->traceEvents[k];
+        String name = "forward", cat = "Net";
+        if (e.lid >= 0)
+        {
+            const LayerData &ld = impl->layers[e.lid];
+            name = escapeJSON(ld.name);
+            cat = escapeJSON(ld.type);
+        }
+        fs << (k ? ",\n" : "\n")
+           << "{\"name\":\"" << name << "\",\"cat\":\"" << cat << "\",\"ph\":\"X\""
+           << format(",\"ts\":%.3f,\"dur\":%.3f", (e.start - impl->profileStartTick) * usPerTick,
+                     (e.end - e.start) * usPerTick)
+           << ",\"pid\":0,\"tid\":" << (e.lid < 0 ? 0 : 1) << "}";
+    }
+    fs << "\n],\"displayTimeUnit\":\"ms\"}\n";
+    if (!fs)
+        CV_Error(Error::StsError, "Failed to write \"" + path + "\"");
+}
+
+void Net::writeNative(const String &path) const
+{
+    std::map<int, int> lidToIndex;
+    std::vector<NativeLayer> nativeLayers;
+    lidToIndex[0] = 0;
+
+    Impl::MapIdToLayerData::const_iterator it;
+    for (it = impl->layers.begin(); it != impl->layers.end(); it++)
+    {
+        if (it->first == 0)
+            continue;
+        const LayerData &ld = it->second;
+        nativeLayers.push_back(NativeLayer());
+        NativeLayer &l = nativeLayers.back();
+        l.name = ld.name;
+        l.type = ld.type;
+        l.params = ld.params;
+        lidToIndex[ld.id] = (int)nativeLayers.size();
+
+        for (size_t i = 0; i < ld.inputBlobsId.size(); i++)
+        {
+            const LayerPin &pin = ld.inputBlobsId[i];
+            CV_Assert(pin.valid() && lidToIndex.count(pin.lid));
+            l.inputs.push_back(std::make_pair(lidToIndex[pin.lid], pin.oid));
+        }
+    }
+
+    writeNativeNet(path, impl->netInputLayer->getNames(), nativeLayers);
+}
+
+Net readNetFromNative(const String &path)
+{
+    std::vector<String> netInputs;
+    std::vector<NativeLayer> nativeLayers;
+    readNativeNet(path, netInputs, nativeLayers);
+
+    Net net;
+    std::vector<int> ids(nativeLayers.size() + 1, 0);
+    for (size_t i = 0; i < nativeLayers.size(); i++)
+    {
+        NativeLayer &l = nativeLayers[i];
+        ids[i + 1] = net.addLayer(l.name, l.type, l.params);
+        for (size_t j = 0; j < l.inputs.size(); j++)
+            net.connect(ids[l.inputs[j].first], l.inputs[j].second, ids[i + 1], (int)j);
+    }
+    net.setNetInputs(netInputs);
+    return net;
+}
+
+void Net::keepBlobs(const std::vector<String> &outputNames)
+{
+    impl->blobsToKeep.clear();
+    for (size_t i = 0; i < outputNames.size(); i++)
+    {
+        LayerPin pin = impl->getPinByAlias(outputNames[i]);
+        if (!pin.valid())
+            CV_Error(Error::StsObjectNotFound, "Requested blob \"" + outputNames[i] + "\" not found");
+        impl->blobsToKeep.insert(pin);
+    }
+    impl->netWasAllocated = false;
+}
+
+void Net::getMemoryConsumption(size_t &blobsBytes, size_t &plannedBytes)
+{
+    impl->setUpNet();
+    blobsBytes = impl->blobsBytes;
+    plannedBytes = impl->plannedBytes;
+}
 
 //////////////////////////////////////////////////////////////////////////
 
@@ -744,6 +2157,32 @@ int Layer::outputNameToIndex(String)
     return -1;
 }
 
+bool Layer::supportInPlace() const
+{
+    return false;
+}
+
+bool Layer::fuse(const Ptr<Layer>&)
+{
+    return false;
+}
+
+bool Layer::quantize(const std::vector<float>&)
+{
+    return false;
+}
+
+int64 Layer::getFLOPS(const std::vector<Mat*>&, const std::vector<Mat>&) const
+{
+    return 0;
+}
+
+void Layer::getScaleShift(Mat &scale, Mat &shift) const
+{
+    scale.release();
+    shift.release();
+}
+
 template <typename T>
 static void vecToPVec(const std::vector<T> &v, std::vector<T*> &pv)
 {
@@ -52,6 +52,46 @@ public:
         cv::pow(blobs[1]*varMeanScale + epsilon, -0.5, invStdMat);
     }
 
+    bool supportInPlace() const
+    {
+        return true;
+    }
+
+    void getScaleShift(Mat &scale, Mat &shift) const
+    {
+        int weightsBlobIndex = 2;
+        int biasBlobIndex = weightsBlobIndex + hasWeights;
+
+        float meanScale = 1.f;
+        if (!hasWeights && !hasBias && blobs.size() > 2)
+        {
+            meanScale = *blobs[2].ptr<float>();
+            if (meanScale != 0)
+                meanScale = 1/meanScale;
+        }
+
+        int n = (int)blobs[0].total();
+        scale.create(n, 1, CV_32F);
+        shift.create(n, 1, CV_32F);
+        for (int i = 0; i < n; i++)
+        {
+            float mean = blobs[0].at<float>(i)*meanScale;
+            float invstd = 1.f/std::sqrt(blobs[1].at<float>(i)*meanScale + epsilon);
+            float w = hasWeights ? blobs[weightsBlobIndex].at<float>(i) : 1;
+            float b = hasBias ? blobs[biasBlobIndex].at<float>(i) : 0;
+            scale.at<float>(i) = w*invstd;
+            shift.at<float>(i) = b - mean*w*invstd;
+        }
+    }
+
+    int64 getFLOPS(const std::vector<Mat*> &inputs, const std::vector<Mat> &) const
+    {
+        int64 flops = 0;
+        for (size_t i = 0; i < inputs.size(); i++)
+            flops += 2 * (int64)inputs[i]->total();
+        return flops;
+    }
+
     void forward(std::vector<Mat*> &inputs, std::vector<Mat> &outputs)
     {
         CV_Assert(inputs.size() == 1);
@@ -43,6 +43,8 @@
 #include "layers_common.hpp"
 #include "op_im2col.hpp"
 #include "op_blas.hpp"
+#include "op_conv.hpp"
+#include "op_quant.hpp"
 #include <opencv2/dnn/shape_utils.hpp>
 #include <iostream>
 
@@ -63,6 +65,7 @@ public:
         inpGroupCn = outGroupCn = 0;
         ksize = 0;
         bias = false;
+        engine = ENGINE_IM2ROW;
 #ifdef HAVE_LAPACK
         int nthreads = cv::getThreadNum();
         if (getBlasThreads() != nthreads)
@@ -87,6 +90,7 @@ public:
         }
 
         computeInpOutShape(input);
+        prepareWeights();
 
         if (bias)
         {
@@ -101,11 +105,24 @@ public:
             outputs[i].create(4, sz, input.type());
         }
 
-        if (!is1x1())
+        chooseEngine(input);
+
+        if (!is1x1() && (engine == ENGINE_IM2ROW || engine == ENGINE_INT8))
         {
             colRowBlob.create((int)colRowBlobShape.size(), &colRowBlobShape[0], input.type());
             colRowBlob.setTo(0);
         }
+        else
+        {
+            colRowBlob.release();
+        }
+    }
+
+    virtual void prepareWeights() {}
+
+    virtual void chooseEngine(const Mat &)
+    {
+        engine = ENGINE_IM2ROW;
     }
 
     void init()
@@ -123,6 +140,16 @@ public:
         (dilation.height == 1 && dilation.width == 1);
     }
 
+    enum Engine
+    {
+        ENGINE_IM2ROW,      //!< im2row + GEMM, general case
+        ENGINE_1X1,         //!< GEMM directly over input planes
+        ENGINE_DEPTHWISE,   //!< direct convolution of each channel with its own kernel
+        ENGINE_WINOGRAD,    //!< Winograd F(2x2, 3x3) or F(4x4, 3x3) for 3x3 kernels with unit stride
+        ENGINE_INT8         //!< im2row + GEMM over 8-bit quantized weights and input
+    };
+
+    int engine;
     int numOutput, group;
     int inpH, inpW, inpCn;
     int outH, outW, outCn;
@@ -138,6 +165,20 @@ public:
 class ConvolutionLayerImpl : public BaseConvolutionLayerImpl
 {
 public:
+    ConvolutionLayerImpl()
+    {
+        winogradTile = 0;
+        int8Mode = false;
+        int8InputScale = 1.f;
+    }
+
+    bool quantize(const std::vector<float> &inputRanges)
+    {
+        int8Mode = inputRanges.size() == 1 && blobs[0].type() == CV_32F;
+        int8InputScale = int8Mode ? int8Scale(inputRanges[0]) : 1.f;
+        return int8Mode;
+    }
+
     void computeInpOutShape(const Mat &input)
     {
         CV_Assert(!bias || blobs[1].total() == (size_t)blobs[0].size[0]);
@@ -173,39 +214,238 @@ public:
         colRowBlobShape.push_back(ksize);
     }
 
+    bool fuse(const Ptr<Layer> &top)
+    {
+        if (top.empty())
+        {
+            fusedScale.release();
+            fusedShift.release();
+            activ.release();
+            return false;
+        }
+
+        //nothing can be merged after the nonlinearity
+        if (!activ.empty())
+            return false;
+
+        Ptr<ActivationLayer> activLayer = top.dynamicCast<ActivationLayer>();
+        if (!activLayer.empty())
+        {
+            activ = activLayer;
+            return true;
+        }
+
+        Mat scale, shift;
+        top->getScaleShift(scale, shift);
+
+        size_t n = (size_t)blobs[0].size[0];
+        if ((scale.empty() && shift.empty()) || blobs[0].type() != CV_32F ||
+            (!scale.empty() && scale.total() != n) || (!shift.empty() && shift.total() != n))
+            return false;
+
+        if (fusedScale.empty())
+        {
+            fusedScale = Mat::ones((int)n, 1, CV_32F);
+            fusedShift = Mat::zeros((int)n, 1, CV_32F);
+        }
+        if (!scale.empty())
+        {
+            fusedScale = fusedScale.mul(scale.reshape(1, (int)n));
+            fusedShift = fusedShift.mul(scale.reshape(1, (int)n));
+        }
+        if (!shift.empty())
+            fusedShift += shift.reshape(1, (int)n);
+
+        return true;
+    }
+
+    //folds merged per-channel scales and shifts into the weights and biases
+    void prepareWeights()
+    {
+        weightsMat = blobs[0].reshape(1, outCn);
+        biasesMat  = bias ? blobs[1].reshape(1, outCn) : Mat();
+
+        if (!fusedScale.empty())
+        {
+            weightsMat = weightsMat.clone();
+            for (int k = 0; k < outCn; k++)
+                weightsMat.row(k) *= fusedScale.at<float>(k);
+
+            Mat b = bias ? biasesMat : Mat::zeros(outCn, 1, CV_32F);
+            biasesMat = b.mul(fusedScale) + fusedShift;
+            bias = true;
+        }
+
+        //each output channel gets own symmetric scale
+        if (int8Mode)
+            quantizeRowsInt8(weightsMat, weightsInt8, weightsScales);
+        else
+        {
+            weightsInt8.release();
+            weightsScales.release();
+        }
+    }
+
+    //rows of dst are output planes starting from the channel cn0
+    void applyActivation(Mat &dst, int cn0)
+    {
+        if (activ.empty())
+            return;
+
+        int len = outH*outW;
+        for (int k = 0; k < dst.rows; k++)
+        {
+            float* ptr = dst.ptr<float>(k);
+            activ->forwardPlane(ptr, ptr, len, (cn0 + k) % outCn);
+        }
+    }
+
+    //the fastest kernel is selected once per input shape
+    void chooseEngine(const Mat &input)
+    {
+        engine = ENGINE_IM2ROW;
+        packedWeights.clear();
+        if (input.type() != CV_32F)
+            return;
+
+        bool unitDilation = dilation.height == 1 && dilation.width == 1;
+
+        //depthwise convolution is too small for GEMM and stays in floating point
+        if (inpGroupCn == 1 && outGroupCn == 1)
+        {
+            engine = ENGINE_DEPTHWISE;
+        }
+        else if (int8Mode)
+        {
+            engine = ENGINE_INT8;
+        }
+        else if (is1x1() && pad.height == 0 && pad.width == 0 && outH == inpH && outW == inpW)
+        {
+            engine = ENGINE_1X1;
+        }
+        else if (kernel.height == 3 && kernel.width == 3 && stride.height == 1 && stride.width == 1 &&
+                 unitDilation && inpGroupCn >= 8 && outGroupCn >= 8)
+        {
+            engine = ENGINE_WINOGRAD;
+
+            //larger tiles have less arithmetic but lose more on the borders of small maps
+            winogradTile = (outH >= 8 && outW >= 8) ? 4 : 2;
+            winogradWeightsMats.resize(group);
+            for (int g = 0; g < group; g++)
+            {
+                const float* groupWeights = weightsMat.ptr<float>(g*outGroupCn);
+                winogradWeights(groupWeights, outGroupCn, inpGroupCn, winogradTile, winogradWeightsMats[g]);
+            }
+        }
+        else
+        {
+            winogradWeightsMats.clear();
+            winogradTile = 0;
+        }
+
+        //weights are the constant left operand of the GEMM engines, so they are packed only once
+        if (engine == ENGINE_IM2ROW || engine == ENGINE_1X1)
+        {
+            packedWeights.resize(group);
+            for (int g = 0; g < group; g++)
+                packedWeights[g].pack(weightsMat.rowRange(_Range(g * outGroupCn, outGroupCn)), true);
+        }
+    }
+
+    void initBiases(Mat &dstMat, int cn0)
+    {
+        for (int k = 0; k < dstMat.rows; k++)
+            dstMat.row(k).setTo(biasesMat.at<float>(cn0 + k));
+    }
+
+    int64 getFLOPS(const std::vector<Mat*> &inputs, const std::vector<Mat> &outputs) const
+    {
+        CV_Assert(inputs.size() == outputs.size());
+        int64 flops = 0;
+        for (size_t i = 0; i < outputs.size(); i++)
+            flops += 2 * (int64)outputs[i].total() * (inputs[i]->size[1] / group) * kernel.area();
+        return flops;
+    }
+
     void forward(std::vector<Mat*> &inputs, std::vector<Mat> &outputs)
     {
         CV_Assert(inputs.size() > 0);
 
-        Mat weightsMat = blobs[0].reshape(1, outCn);
-        Mat biasesMat  = bias ? blobs[1].reshape(1, outCn) : Mat();
-
         for (size_t ii = 0; ii < outputs.size(); ii++)
         {
             int numImg = inputs[ii]->size[0];
             Mat inpMat = *inputs[ii];
             Mat outMat = outputs[ii].reshape(1, numImg*group*outGroupCn);
 
+            if (engine == ENGINE_DEPTHWISE)
+            {
+                depthwiseConvolution(inpMat.ptr<float>(), numImg*inpCn, inpCn, inpH, inpW, weightsMat.ptr<float>(),
+                                     kernel.height, kernel.width, pad.height, pad.width,
+                                     stride.height, stride.width, dilation.height, dilation.width,
+                                     bias ? biasesMat.ptr<float>() : 0, outH, outW, outMat.ptr<float>());
+                applyActivation(outMat, 0);
+                continue;
+            }
+
             for (int n = 0; n < numImg; n++)
             {
                 for (int g = 0; g < group; g++)
                 {
                     Mat curInp = slice(inpMat, n, _Range(g * inpGroupCn, inpGroupCn));
 
-                    im2row(curInp, colRowBlob);
-
                     _Range kerRange(g * outGroupCn, outGroupCn);
-                    Mat kerMat = weightsMat.rowRange(kerRange);
-
                     _Range outRange((g + n * group) * outGroupCn, outGroupCn);
                     Mat dstMat = outMat.rowRange(outRange);
 
-                    dnn::gemm(kerMat, colRowBlob, 1, dstMat, 0, GEMM_2_T);
+                    if (engine == ENGINE_WINOGRAD)
+                    {
+                        winogradConvolution(curInp.ptr<float>(), inpGroupCn, inpH, inpW, pad.height, pad.width,
+                                            winogradWeightsMats[g], outGroupCn, winogradTile,
+                                            bias ? biasesMat.ptr<float>(kerRange.start) : 0,
+                                            outH, outW, dstMat.ptr<float>());
+                    }
+                    else if (engine == ENGINE_INT8)
+                    {
+                        im2row(curInp, colRowBlob);
 
-                    if (bias)
+                        colRowInt8.create(colRowBlob.rows, colRowBlob.cols, CV_8S);
+                        quantizeInt8(colRowBlob.ptr<float>(), colRowInt8.ptr<schar>(), colRowBlob.total(), int8InputScale);
+
+                        gemmInt8(weightsInt8.rowRange(kerRange), weightsScales.ptr<float>(kerRange.start),
+                                 colRowInt8, int8InputScale, bias ? biasesMat.ptr<float>(kerRange.start) : 0,
+                                 dstMat.ptr<float>(), outH*outW, 1);
+                    }
+                    else if (engine == ENGINE_1X1)
+                    {
+                        //input planes are already rows of the GEMM operand, bias initializes the result
+                        if (bias)
+                            initBiases(dstMat, kerRange.start);
+                        dnn::gemm(packedWeights[g], curInp.reshape(1, inpGroupCn), 1, dstMat, bias ? 1 : 0);
+                    }
+                    else
                     {
-                        dnn::gemm(biasesMat.rowRange(kerRange), biasOnesBlob, 1, dstMat, 1);
+                        im2row(curInp, colRowBlob);
+
+                        if (!packedWeights.empty())
+                        {
+                            if (bias)
+                                initBiases(dstMat, kerRange.start);
+                            dnn::gemm(packedWeights[g], colRowBlob, 1, dstMat, bias ? 1 : 0, GEMM_2_T);
+                        }
+                        else
+                        {
+                            Mat kerMat = weightsMat.rowRange(kerRange);
+
+                            dnn::gemm(kerMat, colRowBlob, 1, dstMat, 0, GEMM_2_T);
+
+                            if (bias)
+                            {
+                                dnn::gemm(biasesMat.rowRange(kerRange), biasOnesBlob, 1, dstMat, 1);
+                            }
+                        }
                     }
+
+                    applyActivation(dstMat, kerRange.start);
                 }
             }
         }
@@ -224,6 +464,18 @@ public:
                             dilation.height, dilation.width, outH, outW, dstRow.ptr<float>());
         }
     }
+
+    int winogradTile;
+    std::vector<Mat> winogradWeightsMats;
+    std::vector<PackedGemmMatrix> packedWeights;
+
+    Mat weightsMat, biasesMat;
+    Mat fusedScale, fusedShift;
+    Ptr<ActivationLayer> activ;
+
+    bool int8Mode;
+    float int8InputScale;
+    Mat weightsInt8, weightsScales, colRowInt8;
 };
 
 class DeConvolutionLayerImpl : public BaseConvolutionLayerImpl
@@ -267,6 +519,15 @@ public:
         }
     }
 
+    int64 getFLOPS(const std::vector<Mat*> &inputs, const std::vector<Mat> &outputs) const
+    {
+        CV_Assert(inputs.size() == outputs.size());
+        int64 flops = 0;
+        for (size_t i = 0; i < inputs.size(); i++)
+            flops += 2 * (int64)inputs[i]->total() * (outputs[i].size[1] / group) * kernel.area();
+        return flops;
+    }
+
     void forward(std::vector<Mat *> &inputs, std::vector<Mat> &outputs)
     {
         Mat weightsMat = blobs[0].reshape(1, inpCn);
@@ -41,39 +41,160 @@
 
 #include "../precomp.hpp"
 #include "layers_common.hpp"
+#include "opencv2/core/hal/intrin.hpp"
 #include <float.h>
 #include <string>
-#include <caffe.pb.h>
+#include <algorithm>
 
 namespace cv
 {
 namespace dnn
 {
 
-namespace util
+namespace
 {
 
-template <typename T>
-std::string to_string(T value)
+// Bounding boxes stored as separate coordinate arrays, so that decoding and
+// overlap computation process four boxes per SIMD instruction.
+struct BBoxSoA
 {
-    std::ostringstream stream;
-    stream << value;
-    return stream.str();
+    std::vector<float> xmin, ymin, xmax, ymax, size;
+
+    void resize(size_t n)
+    {
+        xmin.resize(n);
+        ymin.resize(n);
+        xmax.resize(n);
+        ymax.resize(n);
+        size.resize(n);
+    }
+};
+
+// Orders (score, index) pairs by descending score. Ties are resolved by index,
+// which gives the same order as a stable sort of the candidates.
+struct ScoreIndexGreater
+{
+    bool operator()(const std::pair<float, int>& a, const std::pair<float, int>& b) const
+    {
+        return a.first > b.first || (a.first == b.first && a.second < b.second);
+    }
+};
+
+struct ScoreLabelIndexGreater
+{
+    bool operator()(const std::pair<float, std::pair<int, int> >& a,
+                    const std::pair<float, std::pair<int, int> >& b) const
+    {
+        return a.first > b.first || (a.first == b.first && a.second < b.second);
+    }
+};
+
+// Collects the candidates with score above the threshold sorted in descending
+// order. If top_k is not -1 only the best top_k candidates are selected.
+void getMaxScoreIndex(const float* scores, int scoreStep, int n,
+                      float threshold, int topK,
+                      std::vector<std::pair<float, int> >& scoreIndex)
+{
+    scoreIndex.clear();
+    for (int i = 0; i < n; i++)
+    {
+        float score = scores[i * scoreStep];
+        if (score > threshold)
+            scoreIndex.push_back(std::make_pair(score, i));
+    }
+
+    if (topK > -1 && topK < (int)scoreIndex.size())
+    {
+        std::partial_sort(scoreIndex.begin(), scoreIndex.begin() + topK,
+                          scoreIndex.end(), ScoreIndexGreater());
+        scoreIndex.resize(topK);
+    }
+    else
+    {
+        std::sort(scoreIndex.begin(), scoreIndex.end(), ScoreIndexGreater());
+    }
+}
+
+// Checks whether the box overlaps any of the first n kept boxes with
+// intersection over union above the threshold.
+bool overlapsAny(const BBoxSoA& kept, int n,
+                 float xmin, float ymin, float xmax, float ymax, float size,
+                 float threshold)
+{
+    const float *kx0 = &kept.xmin[0], *ky0 = &kept.ymin[0];
+    const float *kx1 = &kept.xmax[0], *ky1 = &kept.ymax[0];
+    const float *ksize = &kept.size[0];
+    int k = 0;
+#if CV_SIMD128
+    v_float32x4 vx0 = v_setall_f32(xmin), vy0 = v_setall_f32(ymin);
+    v_float32x4 vx1 = v_setall_f32(xmax), vy1 = v_setall_f32(ymax);
+    v_float32x4 vsize = v_setall_f32(size), vthr = v_setall_f32(threshold);
+    v_float32x4 z = v_setzero_f32();
+    for (; k <= n - 4; k += 4)
+    {
+        v_float32x4 w = v_min(v_load(kx1 + k), vx1) - v_max(v_load(kx0 + k), vx0);
+        v_float32x4 h = v_min(v_load(ky1 + k), vy1) - v_max(v_load(ky0 + k), vy0);
+        v_float32x4 inter = w * h;
+        v_float32x4 iou = inter / (vsize + v_load(ksize + k) - inter);
+        if (v_check_any((w > z) & (h > z) & (iou > vthr)))
+            return true;
+    }
+#endif
+    for (; k < n; k++)
+    {
+        float w = std::min(kx1[k], xmax) - std::max(kx0[k], xmin);
+        float h = std::min(ky1[k], ymax) - std::max(ky0[k], ymin);
+        if (w > 0 && h > 0)
+        {
+            float inter = w * h;
+            if (inter / (size + ksize[k] - inter) > threshold)
+                return true;
+        }
+    }
+    return false;
 }
 
-template <typename T>
-void make_error(const std::string& message1, const T& message2)
+// Greedy non-maximum suppression of a single class, see https://goo.gl/jV3JYS
+//    scores: confidences of the boxes, every scoreStep-th element.
+//    indices: the kept indices of bboxes after nms in descending score order.
+void applyNMSFast(const BBoxSoA& bboxes, const float* scores, int scoreStep,
+                  float scoreThreshold, float nmsThreshold, int topK,
+                  std::vector<std::pair<float, int> >& scoreIndex, BBoxSoA& kept,
+                  std::vector<int>& indices)
 {
-    std::string error(message1);
-    error += std::string(util::to_string<int>(message2));
-    CV_Error(Error::StsBadArg, error.c_str());
+    getMaxScoreIndex(scores, scoreStep, (int)bboxes.xmin.size(),
+                     scoreThreshold, topK, scoreIndex);
+
+    indices.clear();
+    if (scoreIndex.empty())
+        return;
+
+    // Kept boxes are copied into a compact array so that every candidate is
+    // tested against them with contiguous loads.
+    kept.resize(std::max(kept.xmin.size(), scoreIndex.size()));
+    int numKept = 0;
+    for (size_t j = 0; j < scoreIndex.size(); j++)
+    {
+        int idx = scoreIndex[j].second;
+        float xmin = bboxes.xmin[idx], ymin = bboxes.ymin[idx];
+        float xmax = bboxes.xmax[idx], ymax = bboxes.ymax[idx];
+        float size = bboxes.size[idx];
+        if (overlapsAny(kept, numKept, xmin, ymin, xmax, ymax, size, nmsThreshold))
+            continue;
+
+        indices.push_back(idx);
+        kept.xmin[numKept] = xmin;
+        kept.ymin[numKept] = ymin;
+        kept.xmax[numKept] = xmax;
+        kept.ymax[numKept] = ymax;
+        kept.size[numKept] = size;
+        numKept++;
+    }
 }
 
-template <typename T>
-bool SortScorePairDescend(const std::pair<float, T>& pair1,
-                          const std::pair<float, T>& pair2)
+inline float clip01(float v)
 {
-    return pair1.first > pair2.first;
+    return std::max(std::min(v, 1.f), 0.f);
 }
 
 }
@@ -87,7 +208,7 @@ public:
 
     int _backgroundLabelId;
 
-    typedef caffe::PriorBoxParameter_CodeType CodeType;
+    enum CodeType { CORNER = 1, CENTER_SIZE = 2 };
     CodeType _codeType;
 
     bool _varianceEncodedInTarget;
@@ -103,8 +224,16 @@ public:
     enum { _numAxes = 4 };
     static const std::string _layerName;
 
-    typedef std::map<int, std::vector<caffe::NormalizedBBox> > LabelBBox;
-
+    // Buffers reused between forward passes. Priors are the same for all the
+    // images of a batch; for CENTER_SIZE coding their centers and sizes are
+    // precomputed once per pass.
+    BBoxSoA _priorBBoxes;
+    std::vector<float> _priorVariances[4];
+    std::vector<float> _priorCenterX, _priorCenterY, _priorWidth, _priorHeight;
+    // Decoded boxes of every (image, location class) pair.
+    std::vector<BBoxSoA> _decodedBBoxes;
+    // Indices kept by NMS for every (image, class) pair.
+    std::vector<std::vector<int> > _nmsIndices;
     bool getParameterDict(const LayerParams &params,
                           const std::string &parameterName,
                           DictValue& result)
@@ -149,11 +278,11 @@ public:
     {
         String codeTypeString = params.get<String>("code_type").toLowerCase();
         if (codeTypeString == "corner")
-            _codeType = caffe::PriorBoxParameter_CodeType_CORNER;
+            _codeType = CORNER;
         else if (codeTypeString == "center_size")
-            _codeType = caffe::PriorBoxParameter_CodeType_CENTER_SIZE;
+            _codeType = CENTER_SIZE;
         else
-            _codeType = caffe::PriorBoxParameter_CodeType_CORNER;
+            _codeType = CORNER;
     }
 
     DetectionOutputLayerImpl(const LayerParams &params)
@@ -204,604 +333,331 @@ public:
         outputs[0].create(4, outputShape, CV_32F);
     }
 
-    void forward(std::vector<Mat*> &inputs,
-                                       std::vector<Mat> &outputs)
+    // Get prior bounding boxes from prior_data.
+    //    prior_data: 1 x 2 x num_priors * 4 x 1 blob, coordinates followed by variances.
+    void getPriorBBoxes(const float* priorData)
     {
-        const float* locationData = inputs[0]->ptr<float>();
-        const float* confidenceData = inputs[1]->ptr<float>();
-        const float* priorData = inputs[2]->ptr<float>();
-
-        // Retrieve all location predictions.
-        std::vector<LabelBBox> allLocationPredictions;
-        GetLocPredictions(locationData, _num, _numPriors, _numLocClasses,
-                          _shareLocation, &allLocationPredictions);
+        int n = _numPriors;
+        _priorBBoxes.resize(n);
+        for (int k = 0; k < 4; k++)
+            _priorVariances[k].resize(n);
 
-        // Retrieve all confidences.
-        std::vector<std::map<int, std::vector<float> > > allConfidenceScores;
-        GetConfidenceScores(confidenceData, _num, _numPriors, _numClasses,
-                            &allConfidenceScores);
-
-        // Retrieve all prior bboxes. It is same within a batch since we assume all
-        // images in a batch are of same dimension.
-        std::vector<caffe::NormalizedBBox> priorBBoxes;
-        std::vector<std::vector<float> > priorVariances;
-        GetPriorBBoxes(priorData, _numPriors, &priorBBoxes, &priorVariances);
-
-        // Decode all loc predictions to bboxes.
-        std::vector<LabelBBox> allDecodedBBoxes;
-        DecodeBBoxesAll(allLocationPredictions, priorBBoxes, priorVariances, _num,
-                        _shareLocation, _numLocClasses, _backgroundLabelId,
-                        _codeType, _varianceEncodedInTarget, &allDecodedBBoxes);
-
-        int numKept = 0;
-        std::vector<std::map<int, std::vector<int> > > allIndices;
-        for (int i = 0; i < _num; ++i)
+        const float* varData = priorData + n * 4;
+        for (int i = 0; i < n; i++)
         {
-            const LabelBBox& decodeBBoxes = allDecodedBBoxes[i];
-            const std::map<int, std::vector<float> >& confidenceScores =
-            allConfidenceScores[i];
-            std::map<int, std::vector<int> > indices;
-            int numDetections = 0;
-            for (int c = 0; c < (int)_numClasses; ++c)
-            {
-                if (c == _backgroundLabelId)
-                {
-                    // Ignore background class.
-                    continue;
-                }
-                if (confidenceScores.find(c) == confidenceScores.end())
-                {
-                    // Something bad happened if there are no predictions for current label.
-                    util::make_error<int>("Could not find confidence predictions for label ", c);
-                }
-
-                const std::vector<float>& scores = confidenceScores.find(c)->second;
-                int label = _shareLocation ? -1 : c;
-                if (decodeBBoxes.find(label) == decodeBBoxes.end())
-                {
-                    // Something bad happened if there are no predictions for current label.
-                    util::make_error<int>("Could not find location predictions for label ", label);
-                    continue;
-                }
-                const std::vector<caffe::NormalizedBBox>& bboxes =
-                decodeBBoxes.find(label)->second;
-                ApplyNMSFast(bboxes, scores, _confidenceThreshold, _nmsThreshold,
-                             _topK, &(indices[c]));
-                numDetections += indices[c].size();
-            }
-            if (_keepTopK > -1 && numDetections > _keepTopK)
-            {
-                std::vector<std::pair<float, std::pair<int, int> > > scoreIndexPairs;
-                for (std::map<int, std::vector<int> >::iterator it = indices.begin();
-                     it != indices.end(); ++it)
-                {
-                    int label = it->first;
-                    const std::vector<int>& labelIndices = it->second;
-                    if (confidenceScores.find(label) == confidenceScores.end())
-                    {
-                        // Something bad happened for current label.
-                        util::make_error<int>("Could not find location predictions for label ", label);
-                        continue;
-                    }
-                    const std::vector<float>& scores = confidenceScores.find(label)->second;
-                    for (size_t j = 0; j < labelIndices.size(); ++j)
-                    {
-                        size_t idx = labelIndices[j];
-                        CV_Assert(idx < scores.size());
-                        scoreIndexPairs.push_back(
-                                                  std::make_pair(scores[idx], std::make_pair(label, idx)));
-                    }
-                }
-                // Keep outputs k results per image.
-                std::sort(scoreIndexPairs.begin(), scoreIndexPairs.end(),
-                          util::SortScorePairDescend<std::pair<int, int> >);
-                scoreIndexPairs.resize(_keepTopK);
-                // Store the new indices.
-                std::map<int, std::vector<int> > newIndices;
-                for (size_t j = 0; j < scoreIndexPairs.size(); ++j)
-                {
-                    int label = scoreIndexPairs[j].second.first;
-                    int idx = scoreIndexPairs[j].second.second;
-                    newIndices[label].push_back(idx);
-                }
-                allIndices.push_back(newIndices);
-                numKept += _keepTopK;
-            }
-            else
-            {
-                allIndices.push_back(indices);
-                numKept += numDetections;
-            }
+            _priorBBoxes.xmin[i] = priorData[i * 4];
+            _priorBBoxes.ymin[i] = priorData[i * 4 + 1];
+            _priorBBoxes.xmax[i] = priorData[i * 4 + 2];
+            _priorBBoxes.ymax[i] = priorData[i * 4 + 3];
+            for (int k = 0; k < 4; k++)
+                _priorVariances[k][i] = varData[i * 4 + k];
         }
 
-        if (numKept == 0)
+        if (_codeType == CENTER_SIZE)
         {
-            CV_ErrorNoReturn(Error::StsError, "Couldn't find any detections");
-            return;
-        }
-        int outputShape[] = {1, 1, numKept, 7};
-        outputs[0].create(4, outputShape, CV_32F);
-        float* outputsData = outputs[0].ptr<float>();
-
-        int count = 0;
-        for (int i = 0; i < _num; ++i)
-        {
-            const std::map<int, std::vector<float> >& confidenceScores =
-            allConfidenceScores[i];
-            const LabelBBox& decodeBBoxes = allDecodedBBoxes[i];
-            for (std::map<int, std::vector<int> >::iterator it = allIndices[i].begin();
-                 it != allIndices[i].end(); ++it)
+            _priorCenterX.resize(n);
+            _priorCenterY.resize(n);
+            _priorWidth.resize(n);
+            _priorHeight.resize(n);
+            for (int i = 0; i < n; i++)
             {
-                int label = it->first;
-                if (confidenceScores.find(label) == confidenceScores.end())
-                {
-                    // Something bad happened if there are no predictions for current label.
-                    util::make_error<int>("Could not find confidence predictions for label ", label);
-                    continue;
-                }
-                const std::vector<float>& scores = confidenceScores.find(label)->second;
-                int locLabel = _shareLocation ? -1 : label;
-                if (decodeBBoxes.find(locLabel) == decodeBBoxes.end())
-                {
-                    // Something bad happened if there are no predictions for current label.
-                    util::make_error<int>("Could not find location predictions for label ", locLabel);
-                    continue;
-                }
-                const std::vector<caffe::NormalizedBBox>& bboxes =
-                decodeBBoxes.find(locLabel)->second;
-                std::vector<int>& indices = it->second;
+                float priorWidth = _priorBBoxes.xmax[i] - _priorBBoxes.xmin[i];
+                CV_Assert(priorWidth > 0);
 
-                for (size_t j = 0; j < indices.size(); ++j)
-                {
-                    int idx = indices[j];
-                    outputsData[count * 7] = i;
-                    outputsData[count * 7 + 1] = label;
-                    outputsData[count * 7 + 2] = scores[idx];
-                    caffe::NormalizedBBox clipBBox;
-                    ClipBBox(bboxes[idx], &clipBBox);
-                    outputsData[count * 7 + 3] = clipBBox.xmin();
-                    outputsData[count * 7 + 4] = clipBBox.ymin();
-                    outputsData[count * 7 + 5] = clipBBox.xmax();
-                    outputsData[count * 7 + 6] = clipBBox.ymax();
+                float priorHeight = _priorBBoxes.ymax[i] - _priorBBoxes.ymin[i];
+                CV_Assert(priorHeight > 0);
 
-                    ++count;
-                }
+                _priorWidth[i] = priorWidth;
+                _priorHeight[i] = priorHeight;
+                _priorCenterX[i] = (_priorBBoxes.xmin[i] + _priorBBoxes.xmax[i]) * 0.5f;
+                _priorCenterY[i] = (_priorBBoxes.ymin[i] + _priorBBoxes.ymax[i]) * 0.5f;
             }
         }
     }
 
-    // Compute bbox size.
-    float BBoxSize(const caffe::NormalizedBBox& bbox,
-                   const bool normalized=true)
+    // Decode the location predictions of one (image, class) pair.
+    //    locData: predictions of the first prior, next prior starts locStep elements further.
+    void decodeBBoxes(const float* locData, int locStep, BBoxSoA& bboxes) const
     {
-        if (bbox.xmax() < bbox.xmin() || bbox.ymax() < bbox.ymin())
+        int n = _numPriors;
+        bboxes.resize(n);
+        float *xmin = &bboxes.xmin[0], *ymin = &bboxes.ymin[0];
+        float *xmax = &bboxes.xmax[0], *ymax = &bboxes.ymax[0];
+        float *size = &bboxes.size[0];
+
+        // Variance is either encoded in the target, then the offset predictions
+        // are used as is, or in the prior boxes and the offsets are scaled.
+        std::vector<float> ones;
+        const float* var[4];
+        if (_varianceEncodedInTarget)
         {
-            // If bbox is invalid (e.g. xmax < xmin or ymax < ymin), return 0.
-            return 0;
+            ones.assign(n, 1.f);
+            var[0] = var[1] = var[2] = var[3] = &ones[0];
         }
         else
         {
-            if (bbox.has_size())
+            for (int k = 0; k < 4; k++)
+                var[k] = &_priorVariances[k][0];
+        }
+
+        if (_codeType == CORNER)
+        {
+            const float *px0 = &_priorBBoxes.xmin[0], *py0 = &_priorBBoxes.ymin[0];
+            const float *px1 = &_priorBBoxes.xmax[0], *py1 = &_priorBBoxes.ymax[0];
+            int i = 0;
+#if CV_SIMD128
+            for (; i <= n - 4; i += 4)
             {
-                return bbox.size();
+                const float* loc = locData + i * locStep;
+                v_float32x4 l0, l1, l2, l3;
+                v_transpose4x4(v_load(loc), v_load(loc + locStep),
+                               v_load(loc + locStep * 2), v_load(loc + locStep * 3),
+                               l0, l1, l2, l3);
+                v_store(xmin + i, v_load(px0 + i) + v_load(var[0] + i) * l0);
+                v_store(ymin + i, v_load(py0 + i) + v_load(var[1] + i) * l1);
+                v_store(xmax + i, v_load(px1 + i) + v_load(var[2] + i) * l2);
+                v_store(ymax + i, v_load(py1 + i) + v_load(var[3] + i) * l3);
             }
-            else
+#endif
+            for (; i < n; i++)
             {
-                float width = bbox.xmax() - bbox.xmin();
-                float height = bbox.ymax() - bbox.ymin();
-                if (normalized)
-                {
-                    return width * height;
-                }
-                else
-                {
-                    // If bbox is not within range [0, 1].
-                    return (width + 1) * (height + 1);
-                }
+                const float* loc = locData + i * locStep;
+                xmin[i] = px0[i] + var[0][i] * loc[0];
+                ymin[i] = py0[i] + var[1][i] * loc[1];
+                xmax[i] = px1[i] + var[2][i] * loc[2];
+                ymax[i] = py1[i] + var[3][i] * loc[3];
             }
         }
-    }
-
-    // Clip the caffe::NormalizedBBox such that the range for each corner is [0, 1].
-    void ClipBBox(const caffe::NormalizedBBox& bbox,
-                  caffe::NormalizedBBox* clipBBox)
-    {
-        clipBBox->set_xmin(std::max(std::min(bbox.xmin(), 1.f), 0.f));
-        clipBBox->set_ymin(std::max(std::min(bbox.ymin(), 1.f), 0.f));
-        clipBBox->set_xmax(std::max(std::min(bbox.xmax(), 1.f), 0.f));
-        clipBBox->set_ymax(std::max(std::min(bbox.ymax(), 1.f), 0.f));
-        clipBBox->clear_size();
-        clipBBox->set_size(BBoxSize(*clipBBox));
-        clipBBox->set_difficult(bbox.difficult());
-    }
-
-    // Decode a bbox according to a prior bbox.
-    void DecodeBBox(const caffe::NormalizedBBox& priorBBox, const std::vector<float>& priorVariance,
-                    const CodeType codeType, const bool varianceEncodedInTarget,
-                    const caffe::NormalizedBBox& bbox, caffe::NormalizedBBox* decodeBBox)
-    {
-        if (codeType == caffe::PriorBoxParameter_CodeType_CORNER)
+        else if (_codeType == CENTER_SIZE)
         {
-            if (varianceEncodedInTarget)
+            const float *pcx = &_priorCenterX[0], *pcy = &_priorCenterY[0];
+            const float *pw = &_priorWidth[0], *ph = &_priorHeight[0];
+
+            // Centers go to xmin/ymin and scaled log-sizes to xmax/ymax first,
+            // then the corners are restored in place.
+            int i = 0;
+#if CV_SIMD128
+            for (; i <= n - 4; i += 4)
             {
-                // variance is encoded in target, we simply need to add the offset
-                // predictions.
-                decodeBBox->set_xmin(priorBBox.xmin() + bbox.xmin());
-                decodeBBox->set_ymin(priorBBox.ymin() + bbox.ymin());
-                decodeBBox->set_xmax(priorBBox.xmax() + bbox.xmax());
-                decodeBBox->set_ymax(priorBBox.ymax() + bbox.ymax());
+                const float* loc = locData + i * locStep;
+                v_float32x4 l0, l1, l2, l3;
+                v_transpose4x4(v_load(loc), v_load(loc + locStep),
+                               v_load(loc + locStep * 2), v_load(loc + locStep * 3),
+                               l0, l1, l2, l3);
+                v_store(xmin + i, v_load(var[0] + i) * l0 * v_load(pw + i) + v_load(pcx + i));
+                v_store(ymin + i, v_load(var[1] + i) * l1 * v_load(ph + i) + v_load(pcy + i));
+                v_store(xmax + i, v_load(var[2] + i) * l2);
+                v_store(ymax + i, v_load(var[3] + i) * l3);
             }
-            else
+#endif
+            for (; i < n; i++)
             {
-                // variance is encoded in bbox, we need to scale the offset accordingly.
-                decodeBBox->set_xmin(
-                                     priorBBox.xmin() + priorVariance[0] * bbox.xmin());
-                decodeBBox->set_ymin(
-                                     priorBBox.ymin() + priorVariance[1] * bbox.ymin());
-                decodeBBox->set_xmax(
-                                     priorBBox.xmax() + priorVariance[2] * bbox.xmax());
-                decodeBBox->set_ymax(
-                                     priorBBox.ymax() + priorVariance[3] * bbox.ymax());
+                const float* loc = locData + i * locStep;
+                xmin[i] = var[0][i] * loc[0] * pw[i] + pcx[i];
+                ymin[i] = var[1][i] * loc[1] * ph[i] + pcy[i];
+                xmax[i] = var[2][i] * loc[2];
+                ymax[i] = var[3][i] * loc[3];
             }
-        }
-        else if (codeType == caffe::PriorBoxParameter_CodeType_CENTER_SIZE)
-        {
-            float priorWidth = priorBBox.xmax() - priorBBox.xmin();
-            CV_Assert(priorWidth > 0);
-
-            float priorHeight = priorBBox.ymax() - priorBBox.ymin();
-            CV_Assert(priorHeight > 0);
 
-            float priorCenterX = (priorBBox.xmin() + priorBBox.xmax()) / 2.;
-            float priorCenterY = (priorBBox.ymin() + priorBBox.ymax()) / 2.;
+            for (i = 0; i < n; i++)
+            {
+                xmax[i] = std::exp(xmax[i]) * pw[i] * 0.5f;
+                ymax[i] = std::exp(ymax[i]) * ph[i] * 0.5f;
+            }
 
-            float decodeBBoxCenterX, decodeBBoxCenterY;
-            float decodeBBoxWidth, decodeBBoxHeight;
-            if (varianceEncodedInTarget)
+            i = 0;
+#if CV_SIMD128
+            for (; i <= n - 4; i += 4)
             {
-                // variance is encoded in target, we simply need to retore the offset
-                // predictions.
-                decodeBBoxCenterX = bbox.xmin() * priorWidth + priorCenterX;
-                decodeBBoxCenterY = bbox.ymin() * priorHeight + priorCenterY;
-                decodeBBoxWidth = exp(bbox.xmax()) * priorWidth;
-                decodeBBoxHeight = exp(bbox.ymax()) * priorHeight;
+                v_float32x4 cx = v_load(xmin + i), cy = v_load(ymin + i);
+                v_float32x4 hw = v_load(xmax + i), hh = v_load(ymax + i);
+                v_store(xmin + i, cx - hw);
+                v_store(ymin + i, cy - hh);
+                v_store(xmax + i, cx + hw);
+                v_store(ymax + i, cy + hh);
             }
-            else
+#endif
+            for (; i < n; i++)
             {
-                // variance is encoded in bbox, we need to scale the offset accordingly.
-                decodeBBoxCenterX =
-                priorVariance[0] * bbox.xmin() * priorWidth + priorCenterX;
-                decodeBBoxCenterY =
-                priorVariance[1] * bbox.ymin() * priorHeight + priorCenterY;
-                decodeBBoxWidth =
-                exp(priorVariance[2] * bbox.xmax()) * priorWidth;
-                decodeBBoxHeight =
-                exp(priorVariance[3] * bbox.ymax()) * priorHeight;
+                float cx = xmin[i], cy = ymin[i], hw = xmax[i], hh = ymax[i];
+                xmin[i] = cx - hw;
+                ymin[i] = cy - hh;
+                xmax[i] = cx + hw;
+                ymax[i] = cy + hh;
             }
-
-            decodeBBox->set_xmin(decodeBBoxCenterX - decodeBBoxWidth / 2.);
-            decodeBBox->set_ymin(decodeBBoxCenterY - decodeBBoxHeight / 2.);
-            decodeBBox->set_xmax(decodeBBoxCenterX + decodeBBoxWidth / 2.);
-            decodeBBox->set_ymax(decodeBBoxCenterY + decodeBBoxHeight / 2.);
         }
         else
         {
             CV_Error(Error::StsBadArg, "Unknown LocLossType.");
         }
-        float bboxSize = BBoxSize(*decodeBBox);
-        decodeBBox->set_size(bboxSize);
-    }
 
-    // Decode a set of bboxes according to a set of prior bboxes.
-    void DecodeBBoxes(const std::vector<caffe::NormalizedBBox>& priorBBoxes,
-                      const std::vector<std::vector<float> >& priorVariances,
-                      const CodeType codeType, const bool varianceEncodedInTarget,
-                      const std::vector<caffe::NormalizedBBox>& bboxes,
-                      std::vector<caffe::NormalizedBBox>* decodeBBoxes)
-    {
-        CV_Assert(priorBBoxes.size() == priorVariances.size());
-        CV_Assert(priorBBoxes.size() == bboxes.size());
-        int numBBoxes = priorBBoxes.size();
-        if (numBBoxes >= 1)
+        // Box size, zero for invalid boxes (e.g. xmax < xmin or ymax < ymin).
+        int i = 0;
+#if CV_SIMD128
+        v_float32x4 z = v_setzero_f32();
+        for (; i <= n - 4; i += 4)
         {
-            CV_Assert(priorVariances[0].size() == 4);
+            v_float32x4 w = v_load(xmax + i) - v_load(xmin + i);
+            v_float32x4 h = v_load(ymax + i) - v_load(ymin + i);
+            v_store(size + i, (w * h) & (w >= z) & (h >= z));
         }
-        decodeBBoxes->clear();
-        for (int i = 0; i < numBBoxes; ++i)
+#endif
+        for (; i < n; i++)
         {
-            caffe::NormalizedBBox decodeBBox;
-            DecodeBBox(priorBBoxes[i], priorVariances[i], codeType,
-                       varianceEncodedInTarget, bboxes[i], &decodeBBox);
-            decodeBBoxes->push_back(decodeBBox);
+            float w = xmax[i] - xmin[i], h = ymax[i] - ymin[i];
+            size[i] = w >= 0 && h >= 0 ? w * h : 0.f;
         }
     }
 
-    // Decode all bboxes in a batch.
-    void DecodeBBoxesAll(const std::vector<LabelBBox>& allLocPreds,
-                         const std::vector<caffe::NormalizedBBox>& priorBBoxes,
-                         const std::vector<std::vector<float> >& priorVariances,
-                         const size_t num, const bool shareLocation,
-                         const int numLocClasses, const int backgroundLabelId,
-                         const CodeType codeType, const bool varianceEncodedInTarget,
-                         std::vector<LabelBBox>* allDecodeBBoxes)
+    class NMSInvoker : public ParallelLoopBody
     {
-        CV_Assert(allLocPreds.size() == num);
-        allDecodeBBoxes->clear();
-        allDecodeBBoxes->resize(num);
-        for (size_t i = 0; i < num; ++i)
+    public:
+        NMSInvoker(DetectionOutputLayerImpl& layer_, const float* confData_)
+            : layer(&layer_), confData(confData_)
         {
-            // Decode predictions into bboxes.
-            LabelBBox& decodeBBoxes = (*allDecodeBBoxes)[i];
-            for (int c = 0; c < numLocClasses; ++c)
-            {
-                int label = shareLocation ? -1 : c;
-                if (label == backgroundLabelId)
-                {
-                    // Ignore background class.
-                    continue;
-                }
-                if (allLocPreds[i].find(label) == allLocPreds[i].end())
-                {
-                    // Something bad happened if there are no predictions for current label.
-                    util::make_error<int>("Could not find location predictions for label ", label);
-                }
-                const std::vector<caffe::NormalizedBBox>& labelLocPreds =
-                allLocPreds[i].find(label)->second;
-                DecodeBBoxes(priorBBoxes, priorVariances,
-                             codeType, varianceEncodedInTarget,
-                             labelLocPreds, &(decodeBBoxes[label]));
-            }
         }
-    }
 
-    // Get prior bounding boxes from prior_data.
-    //    prior_data: 1 x 2 x num_priors * 4 x 1 blob.
-    //    num_priors: number of priors.
-    //    prior_bboxes: stores all the prior bboxes in the format of caffe::NormalizedBBox.
-    //    prior_variances: stores all the variances needed by prior bboxes.
-    void GetPriorBBoxes(const float* priorData, const int& numPriors,
-                        std::vector<caffe::NormalizedBBox>* priorBBoxes,
-                        std::vector<std::vector<float> >* priorVariances)
-    {
-        priorBBoxes->clear();
-        priorVariances->clear();
-        for (int i = 0; i < numPriors; ++i)
+        int numTasks() const
         {
-            int startIdx = i * 4;
-            caffe::NormalizedBBox bbox;
-            bbox.set_xmin(priorData[startIdx]);
-            bbox.set_ymin(priorData[startIdx + 1]);
-            bbox.set_xmax(priorData[startIdx + 2]);
-            bbox.set_ymax(priorData[startIdx + 3]);
-            float bboxSize = BBoxSize(bbox);
-            bbox.set_size(bboxSize);
-            priorBBoxes->push_back(bbox);
+            return layer->_num * (int)layer->_numClasses;
         }
 
-        for (int i = 0; i < numPriors; ++i)
+        void operator()(const Range& r) const
         {
-            int startIdx = (numPriors + i) * 4;
-            std::vector<float> var;
-            for (int j = 0; j < 4; ++j)
-            {
-                var.push_back(priorData[startIdx + j]);
-            }
-            priorVariances->push_back(var);
-        }
-    }
+            const int numClasses = layer->_numClasses;
+            const int numPriors = layer->_numPriors;
+            std::vector<std::pair<float, int> > scoreIndex;
+            BBoxSoA kept;
 
-    // Scale the caffe::NormalizedBBox w.r.t. height and width.
-    void ScaleBBox(const caffe::NormalizedBBox& bbox,
-                   const int height, const int width,
-                   caffe::NormalizedBBox* scaleBBox)
-    {
-        scaleBBox->set_xmin(bbox.xmin() * width);
-        scaleBBox->set_ymin(bbox.ymin() * height);
-        scaleBBox->set_xmax(bbox.xmax() * width);
-        scaleBBox->set_ymax(bbox.ymax() * height);
-        scaleBBox->clear_size();
-        bool normalized = !(width > 1 || height > 1);
-        scaleBBox->set_size(BBoxSize(*scaleBBox, normalized));
-        scaleBBox->set_difficult(bbox.difficult());
-    }
-
-    // Get location predictions from loc_data.
-    //    loc_data: num x num_preds_per_class * num_loc_classes * 4 blob.
-    //    num: the number of images.
-    //    num_preds_per_class: number of predictions per class.
-    //    num_loc_classes: number of location classes. It is 1 if share_location is
-    //      true; and is equal to number of classes needed to predict otherwise.
-    //    share_location: if true, all classes share the same location prediction.
-    //    loc_preds: stores the location prediction, where each item contains
-    //      location prediction for an image.
-    void GetLocPredictions(const float* locData, const int num,
-                           const int numPredsPerClass, const int numLocClasses,
-                           const bool shareLocation, std::vector<LabelBBox>* locPreds)
-    {
-        locPreds->clear();
-        if (shareLocation)
-        {
-            CV_Assert(numLocClasses == 1);
-        }
-        locPreds->resize(num);
-        for (int i = 0; i < num; ++i)
-        {
-            LabelBBox& labelBBox = (*locPreds)[i];
-            for (int p = 0; p < numPredsPerClass; ++p)
+            for (int t = r.start; t < r.end; t++)
             {
-                int startIdx = p * numLocClasses * 4;
-                for (int c = 0; c < numLocClasses; ++c)
+                int i = t / numClasses, c = t % numClasses;
+                std::vector<int>& indices = layer->_nmsIndices[t];
+                indices.clear();
+                if (c == layer->_backgroundLabelId)
                 {
-                    int label = shareLocation ? -1 : c;
-                    if (labelBBox.find(label) == labelBBox.end())
-                    {
-                        labelBBox[label].resize(numPredsPerClass);
-                    }
-                    labelBBox[label][p].set_xmin(locData[startIdx + c * 4]);
-                    labelBBox[label][p].set_ymin(locData[startIdx + c * 4 + 1]);
-                    labelBBox[label][p].set_xmax(locData[startIdx + c * 4 + 2]);
-                    labelBBox[label][p].set_ymax(locData[startIdx + c * 4 + 3]);
+                    // Ignore background class.
+                    continue;
                 }
+
+                int locLabel = layer->_shareLocation ? 0 : c;
+                const BBoxSoA& bboxes = layer->_decodedBBoxes[i * layer->_numLocClasses + locLabel];
+                const float* scores = confData + (size_t)i * numPriors * numClasses + c;
+                applyNMSFast(bboxes, scores, numClasses, layer->_confidenceThreshold,
+                             layer->_nmsThreshold, layer->_topK, scoreIndex, kept, indices);
             }
-            locData += numPredsPerClass * numLocClasses * 4;
         }
-    }
 
-    // Get confidence predictions from conf_data.
-    //    conf_data: num x num_preds_per_class * num_classes blob.
-    //    num: the number of images.
-    //    num_preds_per_class: number of predictions per class.
-    //    num_classes: number of classes.
-    //    conf_preds: stores the confidence prediction, where each item contains
-    //      confidence prediction for an image.
-    void GetConfidenceScores(const float* confData, const int num,
-                             const int numPredsPerClass, const int numClasses,
-                             std::vector<std::map<int, std::vector<float> > >* confPreds)
+    private:
+        DetectionOutputLayerImpl* layer;
+        const float* confData;
+    };
+
+    void forward(std::vector<Mat*> &inputs,
+                                       std::vector<Mat> &outputs)
     {
-        confPreds->clear();
-        confPreds->resize(num);
-        for (int i = 0; i < num; ++i)
+        const float* locationData = inputs[0]->ptr<float>();
+        const float* confidenceData = inputs[1]->ptr<float>();
+        const float* priorData = inputs[2]->ptr<float>();
+
+        getPriorBBoxes(priorData);
+
+        // Decode all loc predictions to bboxes.
+        _decodedBBoxes.resize(_num * _numLocClasses);
+        for (int i = 0; i < _num; ++i)
         {
-            std::map<int, std::vector<float> >& labelScores = (*confPreds)[i];
-            for (int p = 0; p < numPredsPerClass; ++p)
+            for (int c = 0; c < _numLocClasses; ++c)
             {
-                int startIdx = p * numClasses;
-                for (int c = 0; c < numClasses; ++c)
+                if (!_shareLocation && c == _backgroundLabelId)
                 {
-                    labelScores[c].push_back(confData[startIdx + c]);
+                    // Ignore background class.
+                    continue;
                 }
+                const float* locData = locationData + ((size_t)i * _numPriors * _numLocClasses + c) * 4;
+                decodeBBoxes(locData, _numLocClasses * 4, _decodedBBoxes[i * _numLocClasses + c]);
             }
-            confData += numPredsPerClass * numClasses;
         }
-    }
-
-    // Do non maximum suppression given bboxes and scores.
-    // Inspired by Piotr Dollar's NMS implementation in EdgeBox.
-    // https://goo.gl/jV3JYS
-    //    bboxes: a set of bounding boxes.
-    //    scores: a set of corresponding confidences.
-    //    score_threshold: a threshold used to filter detection results.
-    //    nms_threshold: a threshold used in non maximum suppression.
-    //    top_k: if not -1, keep at most top_k picked indices.
-    //    indices: the kept indices of bboxes after nms.
-    void ApplyNMSFast(const std::vector<caffe::NormalizedBBox>& bboxes,
-                      const std::vector<float>& scores,
-                      const float score_threshold,
-                      const float nms_threshold, const int top_k,
-                      std::vector<int>* indices)
-    {
-        // Sanity check.
-        CV_Assert(bboxes.size() == scores.size());
 
-        // Get top_k scores (with corresponding indices).
-        std::vector<std::pair<float, int> > score_index_vec;
-        GetMaxScoreIndex(scores, score_threshold, top_k, &score_index_vec);
+        // Classes are suppressed independently.
+        _nmsIndices.resize(_num * _numClasses);
+        NMSInvoker invoker(*this, confidenceData);
+        parallel_for_(Range(0, invoker.numTasks()), invoker, limitStripes());
 
-        // Do nms.
-        indices->clear();
-        while (score_index_vec.size() != 0)
+        int numKept = 0;
+        std::vector<std::pair<float, std::pair<int, int> > > scoreIndexPairs;
+        for (int i = 0; i < _num; ++i)
         {
-            const int idx = score_index_vec.front().second;
-            bool keep = true;
-            for (size_t k = 0; k < indices->size(); ++k)
+            std::vector<int>* indices = &_nmsIndices[i * _numClasses];
+            const float* scores = confidenceData + (size_t)i * _numPriors * _numClasses;
+            int numDetections = 0;
+            for (int c = 0; c < (int)_numClasses; ++c)
+                numDetections += (int)indices[c].size();
+
+            if (_keepTopK > -1 && numDetections > _keepTopK)
             {
-                if (keep)
+                scoreIndexPairs.clear();
+                for (int c = 0; c < (int)_numClasses; ++c)
                 {
-                    const int kept_idx = (*indices)[k];
-                    float overlap = JaccardOverlap(bboxes[idx], bboxes[kept_idx]);
-                    keep = overlap <= nms_threshold;
+                    for (size_t j = 0; j < indices[c].size(); ++j)
+                    {
+                        int idx = indices[c][j];
+                        scoreIndexPairs.push_back(std::make_pair(scores[idx * _numClasses + c],
+                                                                 std::make_pair(c, idx)));
+                    }
+                    indices[c].clear();
                 }
-                else
+                // Keep outputs k results per image.
+                std::partial_sort(scoreIndexPairs.begin(), scoreIndexPairs.begin() + _keepTopK,
+                                  scoreIndexPairs.end(), ScoreLabelIndexGreater());
+                for (int j = 0; j < _keepTopK; ++j)
                 {
-                    break;
+                    int label = scoreIndexPairs[j].second.first;
+                    indices[label].push_back(scoreIndexPairs[j].second.second);
                 }
+                numKept += _keepTopK;
             }
-            if (keep)
+            else
             {
-                indices->push_back(idx);
+                numKept += numDetections;
             }
-            score_index_vec.erase(score_index_vec.begin());
         }
-    }
 
-    // Get max scores with corresponding indices.
-    //    scores: a set of scores.
-    //    threshold: only consider scores higher than the threshold.
-    //    top_k: if -1, keep all; otherwise, keep at most top_k.
-    //    score_index_vec: store the sorted (score, index) pair.
-    void GetMaxScoreIndex(const std::vector<float>& scores, const float threshold,const int top_k,
-                          std::vector<std::pair<float, int> >* score_index_vec)
-    {
-        // Generate index score pairs.
-        for (size_t i = 0; i < scores.size(); ++i)
+        if (numKept == 0)
         {
-            if (scores[i] > threshold)
-            {
-                score_index_vec->push_back(std::make_pair(scores[i], i));
-            }
+            CV_ErrorNoReturn(Error::StsError, "Couldn't find any detections");
+            return;
         }
+        int outputShape[] = {1, 1, numKept, 7};
+        outputs[0].create(4, outputShape, CV_32F);
+        float* outputsData = outputs[0].ptr<float>();
 
-        // Sort the score pair according to the scores in descending order
-        std::stable_sort(score_index_vec->begin(), score_index_vec->end(),
-                         util::SortScorePairDescend<int>);
-
-        // Keep top_k scores if needed.
-        if (top_k > -1 && top_k < (int)score_index_vec->size())
+        int count = 0;
+        for (int i = 0; i < _num; ++i)
         {
-            score_index_vec->resize(top_k);
-        }
-    }
+            const float* scores = confidenceData + (size_t)i * _numPriors * _numClasses;
+            for (int label = 0; label < (int)_numClasses; ++label)
+            {
+                const std::vector<int>& indices = _nmsIndices[i * _numClasses + label];
+                if (indices.empty())
+                    continue;
 
-    // Compute the intersection between two bboxes.
-    void IntersectBBox(const caffe::NormalizedBBox& bbox1,
-                       const caffe::NormalizedBBox& bbox2,
-                       caffe::NormalizedBBox* intersect_bbox) {
-        if (bbox2.xmin() > bbox1.xmax() || bbox2.xmax() < bbox1.xmin() ||
-            bbox2.ymin() > bbox1.ymax() || bbox2.ymax() < bbox1.ymin())
-        {
-            // Return [0, 0, 0, 0] if there is no intersection.
-            intersect_bbox->set_xmin(0);
-            intersect_bbox->set_ymin(0);
-            intersect_bbox->set_xmax(0);
-            intersect_bbox->set_ymax(0);
-        }
-        else
-        {
-            intersect_bbox->set_xmin(std::max(bbox1.xmin(), bbox2.xmin()));
-            intersect_bbox->set_ymin(std::max(bbox1.ymin(), bbox2.ymin()));
-            intersect_bbox->set_xmax(std::min(bbox1.xmax(), bbox2.xmax()));
-            intersect_bbox->set_ymax(std::min(bbox1.ymax(), bbox2.ymax()));
-        }
-    }
+                int locLabel = _shareLocation ? 0 : label;
+                const BBoxSoA& bboxes = _decodedBBoxes[i * _numLocClasses + locLabel];
+                for (size_t j = 0; j < indices.size(); ++j)
+                {
+                    int idx = indices[j];
+                    float* dst = outputsData + count * 7;
+                    dst[0] = i;
+                    dst[1] = label;
+                    dst[2] = scores[idx * _numClasses + label];
+                    dst[3] = clip01(bboxes.xmin[idx]);
+                    dst[4] = clip01(bboxes.ymin[idx]);
+                    dst[5] = clip01(bboxes.xmax[idx]);
+                    dst[6] = clip01(bboxes.ymax[idx]);
 
-    // Compute the jaccard (intersection over union IoU) overlap between two bboxes.
-    float JaccardOverlap(const caffe::NormalizedBBox& bbox1,
-                         const caffe::NormalizedBBox& bbox2,
-                         const bool normalized=true)
-    {
-        caffe::NormalizedBBox intersect_bbox;
-        IntersectBBox(bbox1, bbox2, &intersect_bbox);
-        float intersect_width, intersect_height;
-        if (normalized)
-        {
-            intersect_width = intersect_bbox.xmax() - intersect_bbox.xmin();
-            intersect_height = intersect_bbox.ymax() - intersect_bbox.ymin();
-        }
-        else
-        {
-            intersect_width = intersect_bbox.xmax() - intersect_bbox.xmin() + 1;
-            intersect_height = intersect_bbox.ymax() - intersect_bbox.ymin() + 1;
-        }
-        if (intersect_width > 0 && intersect_height > 0)
-        {
-            float intersect_size = intersect_width * intersect_height;
-            float bbox1_size = BBoxSize(bbox1);
-            float bbox2_size = BBoxSize(bbox2);
-            return intersect_size / (bbox1_size + bbox2_size - intersect_size);
-        }
-        else
-        {
-            return 0.;
+                    ++count;
+                }
+            }
         }
     }
 };
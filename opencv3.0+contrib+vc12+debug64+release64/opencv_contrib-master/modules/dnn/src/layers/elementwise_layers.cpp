@@ -57,12 +57,26 @@ public:
             CV_Assert(src.type() == CV_32F);
             PBody<float> body(dst, func);
             if( run_parallel )
-                cv::parallel_for_(sizeRange, body);
+                cv::parallel_for_(sizeRange, body, limitStripes());
             else
                 body(sizeRange);
         }
     }
 
+    int64 getFLOPS(const std::vector<Mat*> &inputs, const std::vector<Mat> &) const
+    {
+        int64 flops = 0;
+        for (size_t i = 0; i < inputs.size(); i++)
+            flops += func.getFLOPSPerElement() * (int64)inputs[i]->total();
+        return flops;
+    }
+
+    void forwardPlane(const float* src, float* dst, int len, int) const
+    {
+        for (int i = 0; i < len; i++)
+            dst[i] = func(src[i]);
+    }
+
     Func func;
     bool run_parallel;
 };
@@ -79,6 +93,8 @@ struct ReLUFunctor
     {
         return (x >= (TFloat)0) ? x : (TFloat)slope * x;
     }
+
+    int64 getFLOPSPerElement() const { return 1; }
 };
 
 struct TanHFunctor
@@ -90,6 +106,8 @@ struct TanHFunctor
     {
         return tanh(x);
     }
+
+    int64 getFLOPSPerElement() const { return 1; }
 };
 
 struct SigmoidFunctor
@@ -101,6 +119,8 @@ struct SigmoidFunctor
     {
         return (TFloat)1 / ((TFloat)1 + exp(-x));
     }
+
+    int64 getFLOPSPerElement() const { return 3; }
 };
 
 struct AbsValFunctor
@@ -112,6 +132,8 @@ struct AbsValFunctor
     {
         return abs(x);
     }
+
+    int64 getFLOPSPerElement() const { return 1; }
 };
 
 struct BNLLFunctor
@@ -123,6 +145,8 @@ struct BNLLFunctor
     {
         return log((TFloat)1 + exp(-abs(x)));
     }
+
+    int64 getFLOPSPerElement() const { return 5; }
 };
 
 struct PowerFunctor
@@ -141,6 +165,8 @@ struct PowerFunctor
     {
         return pow((TFloat)shift + (TFloat)scale * x, (TFloat)power);
     }
+
+    int64 getFLOPSPerElement() const { return power == 1 ? 2 : 10; }
 };
 
 struct PowerFunctor1
@@ -158,6 +184,8 @@ struct PowerFunctor1
     {
         return (TFloat)shift + (TFloat)scale * x;
     }
+
+    int64 getFLOPSPerElement() const { return 2; }
 };
 
 class ChannelsPReLULayerImpl : public ChannelsPReLULayer
@@ -182,6 +210,16 @@ public:
         }
     }
 
+    bool supportInPlace() const
+    {
+        return true;
+    }
+
+    int64 getFLOPS(const std::vector<Mat*> &inputs, const std::vector<Mat> &) const
+    {
+        return 2*(int64)inputs[0]->total();
+    }
+
     void forward(std::vector<Mat*> &inputs, std::vector<Mat> &outputs)
     {
         CV_Assert(inputs.size() == 1);
@@ -214,6 +252,16 @@ public:
             }
         }
     }
+
+    void forwardPlane(const float* src, float* dst, int len, int channel) const
+    {
+        float slopeWeight = blobs[0].at<float>(channel);
+        for (int i = 0; i < len; i++)
+        {
+            float val = src[i];
+            dst[i] = val*(val >= 0.f ? 1.f : slopeWeight);
+        }
+    }
 };
 
 #define ACTIVATION_CREATOR_FOR(_Layer, _Functor, ...) \
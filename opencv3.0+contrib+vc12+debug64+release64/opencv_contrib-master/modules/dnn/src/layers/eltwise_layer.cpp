@@ -96,19 +96,98 @@ public:
         outputs[0].create(inputs[0]->dims, inputs[0]->size.p, inputs[0]->type());
     }
 
+    //the first input is read before it is overwritten by the result
+    bool supportInPlace() const
+    {
+        return true;
+    }
+
+    //every task combines all inputs over a stripe of elements, so the stripe stays in cache
+    class EltwiseInvoker : public ParallelLoopBody
+    {
+    public:
+        enum { STRIPE_SIZE = 4096 };
+
+        EltwiseInvoker(const EltwiseLayerImpl &layer_, const std::vector<Mat*> &inputs_, Mat &output_)
+            : layer(&layer_), inputs(&inputs_), output(&output_) {}
+
+        int numTasks() const
+        {
+            return (int)((output->total() + STRIPE_SIZE - 1) / STRIPE_SIZE);
+        }
+
+        void operator()(const Range &range) const
+        {
+            size_t total = output->total();
+            size_t i0 = range.start * (size_t)STRIPE_SIZE, i1 = std::min(range.end * (size_t)STRIPE_SIZE, total);
+            size_t len = i1 - i0, ninputs = inputs->size();
+            const std::vector<int> &coeffs = layer->coeffs;
+            float* dst = output->ptr<float>() + i0;
+
+            const float* src = (*inputs)[0]->ptr<float>() + i0;
+            float c = coeffs.empty() ? 1.f : (float)coeffs[0];
+            for (size_t i = 0; i < len; i++)
+                dst[i] = layer->op == SUM ? src[i]*c : src[i];
+
+            for (size_t k = 1; k < ninputs; k++)
+            {
+                src = (*inputs)[k]->ptr<float>() + i0;
+                switch (layer->op)
+                {
+                    case SUM:
+                        c = coeffs.empty() ? 1.f : (float)coeffs[k];
+                        for (size_t i = 0; i < len; i++)
+                            dst[i] += src[i]*c;
+                        break;
+                    case PROD:
+                        for (size_t i = 0; i < len; i++)
+                            dst[i] *= src[i];
+                        break;
+                    default:
+                        for (size_t i = 0; i < len; i++)
+                            dst[i] = std::max(dst[i], src[i]);
+                        break;
+                }
+            }
+        }
+
+    private:
+        const EltwiseLayerImpl* layer;
+        const std::vector<Mat*>* inputs;
+        Mat* output;
+    };
+
+    int64 getFLOPS(const std::vector<Mat*> &inputs, const std::vector<Mat> &outputs) const
+    {
+        int64 perInput = op == SUM && !coeffs.empty() ? 2 : 1;
+        return perInput * (int64)(inputs.size() - 1) * (int64)outputs[0].total();
+    }
+
     void forward(std::vector<Mat *> &inputs, std::vector<Mat> &outputs)
     {
         Mat& output = outputs[0];
+
+        bool fastPath = output.type() == CV_32F && output.isContinuous() && (op == SUM || op == PROD || op == MAX);
+        for (size_t i = 0; i < inputs.size(); i++)
+            fastPath = fastPath && inputs[i]->type() == CV_32F && inputs[i]->isContinuous();
+
+        if (fastPath)
+        {
+            EltwiseInvoker invoker(*this, inputs, output);
+            parallel_for_(Range(0, invoker.numTasks()), invoker, limitStripes());
+            return;
+        }
+
         switch (op)
         {
             case SUM:
                 CV_Assert(coeffs.size() == 0 || coeffs.size() == inputs.size());
                 if (0 < coeffs.size())
                 {
-                    output.setTo(0.);
-                    for (size_t i = 0; i < inputs.size(); i++)
+                    inputs[0]->convertTo(output, output.type(), coeffs[0]);
+                    for (size_t i = 1; i < inputs.size(); i++)
                     {
-                        output += *inputs[i] * coeffs[i];
+                        scaleAdd(*inputs[i], coeffs[i], output, output);
                     }
                 }
                 else
@@ -121,10 +200,10 @@ public:
                 }
                 break;
             case PROD:
-                output.setTo(1.);
-                for (size_t i = 0; i < inputs.size(); i++)
+                multiply(*inputs[0], *inputs[1], output);
+                for (size_t i = 2; i < inputs.size(); i++)
                 {
-                    output = output.mul(*inputs[i]);
+                    multiply(output, *inputs[i], output);
                 }
                 break;
             case MAX:
@@ -42,6 +42,7 @@
 #include "../precomp.hpp"
 #include "layers_common.hpp"
 #include "op_blas.hpp"
+#include "op_quant.hpp"
 #include <opencv2/dnn/shape_utils.hpp>
 
 namespace cv
@@ -55,6 +56,8 @@ public:
     FullyConnectedLayerImpl(const LayerParams& params)
     {
         setParamsFrom(params);
+        int8Mode = false;
+        int8InputScale = 1.f;
         CV_Assert(1 <= blobs.size() && blobs.size() <= 2);
 
         numOutput = params.get<int>("num_output");
@@ -92,6 +95,26 @@ public:
         biasOnesBlob.create(outerSize, 1, dtype);
         biasOnesBlob.setTo(1.);
 
+        //weights are repacked for the GEMM kernel on every allocation, so the net picks up
+        //replaced or edited blobs the same way as the unpacked path does
+        if (dtype == CV_32F)
+            packedWeights.pack(blobs[0], false, true);
+        else
+            packedWeights.release();
+
+        if (int8Mode && dtype == CV_32F)
+        {
+            //each output neuron gets own symmetric scale
+            quantizeRowsInt8(blobs[0], weightsInt8, weightsScales);
+            inputInt8.create(outerSize, innerSize, CV_8S);
+        }
+        else
+        {
+            weightsInt8.release();
+            weightsScales.release();
+            inputInt8.release();
+        }
+
         output.resize(input.size());
         for (size_t i = 0; i < input.size(); i++)
         {
@@ -100,6 +123,21 @@ public:
         }
     }
 
+    bool quantize(const std::vector<float> &inputRanges)
+    {
+        int8Mode = inputRanges.size() == 1 && blobs[0].type() == CV_32F;
+        int8InputScale = int8Mode ? int8Scale(inputRanges[0]) : 1.f;
+        return int8Mode;
+    }
+
+    int64 getFLOPS(const std::vector<Mat*> &, const std::vector<Mat> &outputs) const
+    {
+        int64 flops = 0;
+        for (size_t i = 0; i < outputs.size(); i++)
+            flops += 2 * (int64)outputs[i].total() * innerSize;
+        return flops;
+    }
+
     void forward(std::vector<Mat*> &input, std::vector<Mat> &output)
     {
         const Mat &weight = blobs[0];
@@ -114,6 +152,27 @@ public:
         {
             Mat srcMat = input[i]->reshape(1, outerSize);
             Mat dstMat = output[i].reshape(1, outerSize);
+
+            if (!weightsInt8.empty())
+            {
+                quantizeInt8(srcMat.ptr<float>(), inputInt8.ptr<schar>(), srcMat.total(), int8InputScale);
+                gemmInt8(weightsInt8, weightsScales.ptr<float>(), inputInt8, int8InputScale,
+                         bias ? biasMat->ptr<float>() : 0, dstMat.ptr<float>(), 1, numOutput);
+                continue;
+            }
+
+            if (dtype == CV_32F)
+            {
+                //bias initializes the result which GEMM accumulates to
+                if (bias)
+                {
+                    for (int j = 0; j < outerSize; j++)
+                        biasMat->copyTo(dstMat.row(j));
+                }
+                dnn::gemm(srcMat, packedWeights, 1, dstMat, bias ? 1 : 0);
+                continue;
+            }
+
             dnn::gemm(srcMat, weight, 1, dstMat, 0, GEMM_2_T);
 
             if (bias)
@@ -125,6 +184,11 @@ public:
     int numOutput, innerSize, outerSize;
     bool bias;
     Mat biasOnesBlob;
+    PackedGemmMatrix packedWeights;
+
+    bool int8Mode;
+    float int8InputScale;
+    Mat weightsInt8, weightsScales, inputInt8;
 };
 
 Ptr<InnerProductLayer> InnerProductLayer::create(const LayerParams& params)
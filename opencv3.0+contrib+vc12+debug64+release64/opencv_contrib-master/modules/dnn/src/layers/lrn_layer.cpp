@@ -89,6 +89,13 @@ public:
         outputs[0].create(inp0.dims, inp0.size.p, inp0.type());
     }
 
+    int64 getFLOPS(const std::vector<Mat*> &inputs, const std::vector<Mat> &) const
+    {
+        //squares, sliding sum over the window and pow() of the scale
+        int64 total = (int64)inputs[0]->total();
+        return type == CHANNEL_NRM ? total * 15 : total * (2 * size * size + 12);
+    }
+
     void forward(std::vector<Mat*> &inputs, std::vector<Mat> &outputs)
     {
         Mat &src = *inputs[0];
@@ -108,76 +115,129 @@ public:
         }
     }
 
-    void channelNormalization(Mat &srcBlob, Mat &dstBlob)
+    //every task normalizes a stripe of pixels of one sample through all channels
+    class ChannelNormInvoker : public ParallelLoopBody
     {
-        int num = srcBlob.size[0];
-        int channels = srcBlob.size[1];
-        int ksize = (size - 1) / 2;
-        int sizeNormFactor = normBySize ? size : 1;
+    public:
+        enum { STRIPE_SIZE = 256 };
 
-        Mat srcMat = srcBlob.clone();
-        Mat dstMat = dstBlob;
-
-        for (int n = 0; n < num; n++)
+        ChannelNormInvoker(const LRNLayerImpl &layer_, const Mat &src_, Mat &dst_)
+            : layer(&layer_), src(&src_), dst(&dst_)
         {
-            Mat accum = getPlane(dstMat, n, channels-1); //trick for memory saving
-            accum.setTo(0);
+            planeSize = (int)src->total(2);
+            nstripes = (planeSize + STRIPE_SIZE - 1) / STRIPE_SIZE;
+        }
 
-            for (int cn = 0; cn < std::min(ksize, channels); cn++)
-                cv::accumulateSquare(getPlane(srcMat, n, cn), accum);
+        int numTasks() const { return src->size[0] * nstripes; }
 
-            for (int cn = 0; cn < channels; cn++)
+        void operator()(const Range &range) const
+        {
+            int channels = src->size[1];
+            int ksize = (layer->size - 1) / 2;
+            float alpha = (float)(layer->alpha / (layer->normBySize ? layer->size : 1));
+            float bias = (float)layer->bias, beta = (float)layer->beta;
+            AutoBuffer<float> accumBuf(STRIPE_SIZE);
+            float* accum = accumBuf;
+
+            for (int t = range.start; t < range.end; t++)
             {
-                if (cn + ksize < channels)
+                int n = t / nstripes;
+                int p0 = (t % nstripes) * STRIPE_SIZE, len = std::min(planeSize - p0, (int)STRIPE_SIZE);
+                const float* srcData = src->ptr<float>(n) + p0;
+                float* dstData = dst->ptr<float>(n) + p0;
+
+                for (int i = 0; i < len; i++)
+                    accum[i] = 0.f;
+
+                for (int cn = 0; cn < std::min(ksize, channels); cn++)
                 {
-                    cv::accumulateSquare(getPlane(srcMat, n, cn + ksize), accum);
+                    const float* s = srcData + (size_t)cn*planeSize;
+                    for (int i = 0; i < len; i++)
+                        accum[i] += s[i]*s[i];
                 }
 
-                if (cn - ksize - 1 >= 0)
+                for (int cn = 0; cn < channels; cn++)
                 {
-                    //subtractSquare
-                    Mat left = getPlane(srcMat, n, cn - ksize - 1);
-                    cv::pow(left, 2, left);
-                    cv::subtract(accum, left, accum);
+                    if (cn + ksize < channels)
+                    {
+                        const float* s = srcData + (size_t)(cn + ksize)*planeSize;
+                        for (int i = 0; i < len; i++)
+                            accum[i] += s[i]*s[i];
+                    }
+
+                    if (cn - ksize - 1 >= 0)
+                    {
+                        const float* s = srcData + (size_t)(cn - ksize - 1)*planeSize;
+                        for (int i = 0; i < len; i++)
+                            accum[i] -= s[i]*s[i];
+                    }
+
+                    const float* s = srcData + (size_t)cn*planeSize;
+                    float* d = dstData + (size_t)cn*planeSize;
+                    for (int i = 0; i < len; i++)
+                        d[i] = s[i] / std::pow(bias + alpha*accum[i], beta);
                 }
-
-                Mat dst = getPlane(dstMat, n, cn);
-                accum.convertTo(dst, dst.type(), alpha/sizeNormFactor, bias);
-                cv::pow(dst, beta, dst);
-                cv::divide(getPlane(srcMat, n, cn), dst, dst);
             }
         }
+
+    private:
+        const LRNLayerImpl* layer;
+        const Mat* src;
+        Mat* dst;
+        int planeSize, nstripes;
+    };
+
+    void channelNormalization(Mat &srcBlob, Mat &dstBlob)
+    {
+        CV_Assert(srcBlob.type() == CV_32F && srcBlob.isContinuous() && dstBlob.isContinuous());
+
+        ChannelNormInvoker invoker(*this, srcBlob, dstBlob);
+        parallel_for_(Range(0, invoker.numTasks()), invoker, limitStripes());
     }
 
-    void sqrBoxFilter_(const Mat &src, Mat &dst)
+    void sqrBoxFilter_(const Mat &src, Mat &dst) const
     {
         Mat srcRawWrapper(src.rows, src.cols, src.type(), src.data, src.step[0]);
         cv::sqrBoxFilter(srcRawWrapper, dst, dst.depth(), Size(size, size), Point(-1, -1), false, BORDER_CONSTANT);
     }
 
-    void spatialNormalization(Mat &srcBlob, Mat &dstBlob)
+    //planes of all samples are normalized independently
+    class SpatialNormInvoker : public ParallelLoopBody
     {
-        int num = srcBlob.size[0];
-        int channels = srcBlob.size[1];
-        int sizeNormFactor = normBySize ? size*size : 1;
-
-        Mat srcMat = srcBlob;
-        Mat dstMat = dstBlob;
+    public:
+        SpatialNormInvoker(const LRNLayerImpl &layer_, Mat &src_, Mat &dst_)
+            : layer(&layer_), src(&src_), dst(&dst_) {}
 
-        for (int n = 0; n < num; n++)
+        void operator()(const Range &range) const
         {
-            for (int cn = 0; cn < channels; cn++)
+            int channels = src->size[1];
+            int sizeNormFactor = layer->normBySize ? layer->size*layer->size : 1;
+
+            for (int p = range.start; p < range.end; p++)
             {
-                Mat src = getPlane(srcMat, n, cn);
-                Mat dst = getPlane(dstMat, n, cn);
+                int n = p / channels, cn = p % channels;
+                Mat srcPlane = getPlane(*src, n, cn);
+                Mat dstPlane = getPlane(*dst, n, cn);
 
-                sqrBoxFilter_(src, dst);
+                layer->sqrBoxFilter_(srcPlane, dstPlane);
 
-                dst.convertTo(dst, dst.type(), alpha/sizeNormFactor, bias);
-                cv::pow(dst, beta, dst);
-                cv::divide(src, dst, dst);
+                dstPlane.convertTo(dstPlane, dstPlane.type(), layer->alpha/sizeNormFactor, layer->bias);
+                cv::pow(dstPlane, layer->beta, dstPlane);
+                cv::divide(srcPlane, dstPlane, dstPlane);
             }
         }
+
+    private:
+        const LRNLayerImpl* layer;
+        Mat *src, *dst;
+    };
+
+    void spatialNormalization(Mat &srcBlob, Mat &dstBlob)
+    {
+        int num = srcBlob.size[0];
+        int channels = srcBlob.size[1];
+
+        parallel_for_(Range(0, num*channels), SpatialNormInvoker(*this, srcBlob, dstBlob), limitStripes());
     }
 
     Mat buf;
@@ -70,6 +70,14 @@ public:
         }
     }
 
+    int64 getFLOPS(const std::vector<Mat*> &inputs, const std::vector<Mat> &) const
+    {
+        int64 flops = 0;
+        for (size_t i = 0; i < inputs.size(); i++)
+            flops += (normVariance ? 6 : 3) * (int64)inputs[i]->total();
+        return flops;
+    }
+
     void forward(std::vector<Mat *> &inputs, std::vector<Mat> &outputs)
     {
         for (size_t inpIdx = 0; inpIdx < inputs.size(); inpIdx++)
@@ -84,18 +92,36 @@ public:
             Mat inpMat = inpBlob.reshape(1, newRows);
             Mat outMat = outBlob.reshape(1, newRows);
 
+            parallel_for_(Range(0, newRows), MVNInvoker(*this, inpMat, outMat), limitStripes());
+        }
+    }
+
+    //rows (planes or whole samples) are normalized independently
+    class MVNInvoker : public ParallelLoopBody
+    {
+    public:
+        MVNInvoker(const MVNLayerImpl &layer_, const Mat &inpMat_, Mat &outMat_)
+            : layer(&layer_), inpMat(&inpMat_), outMat(&outMat_) {}
+
+        void operator()(const Range &range) const
+        {
             Scalar mean, dev;
-            for ( i = 0; i < newRows; i++)
+            for (int i = range.start; i < range.end; i++)
             {
-                Mat inpRow = inpMat.row(i);
-                Mat outRow = outMat.row(i);
+                Mat inpRow = inpMat->row(i);
+                Mat outRow = outMat->row(i);
 
-                cv::meanStdDev(inpRow, mean, (normVariance) ? dev : noArray());
-                double alpha = (normVariance) ? 1/(eps + dev[0]) : 1;
+                cv::meanStdDev(inpRow, mean, (layer->normVariance) ? dev : noArray());
+                double alpha = (layer->normVariance) ? 1/(layer->eps + dev[0]) : 1;
                 inpRow.convertTo(outRow, outRow.type(), alpha, -mean[0] * alpha);
             }
         }
-    }
+
+    private:
+        const MVNLayerImpl* layer;
+        const Mat* inpMat;
+        Mat* outMat;
+    };
 };
 
 Ptr<MVNLayer> MVNLayer::create(const LayerParams& params)
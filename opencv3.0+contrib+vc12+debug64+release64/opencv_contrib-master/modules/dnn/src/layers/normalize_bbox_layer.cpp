@@ -164,62 +164,105 @@ public:
         }
     }
 
-    void forward(std::vector<Mat*> &inputs, std::vector<Mat> &outputs)
+    //every task normalizes a stripe of pixels of one sample or the whole sample if norm is computed across spatial
+    class NormalizeInvoker : public ParallelLoopBody
     {
-        Mat zeroBuffer(_channels, _channelSize, CV_32F, Scalar(0));
-        Mat absDiff;
+    public:
+        enum { STRIPE_SIZE = 1024 };
 
-        for (size_t j = 0; j < inputs.size(); j++)
+        NormalizeInvoker(const NormalizeBBoxLayerImpl &layer_, const Mat &src_, Mat &dst_)
+            : layer(&layer_), src(&src_), dst(&dst_)
         {
-            for (size_t n = 0; n < _num; ++n)
-            {
-                Mat src = Mat(_channels, _channelSize, CV_32F, inputs[j]->ptr<float>(n));
-                Mat dst = Mat(_channels, _channelSize, CV_32F, outputs[j].ptr<float>(n));
+            nstripes = layer->_across_spatial ? 1 : (int)((layer->_channelSize + STRIPE_SIZE - 1) / STRIPE_SIZE);
+        }
 
-                _buffer = src.mul(src);
+        int numTasks() const { return (int)layer->_num * nstripes; }
 
-                if (_across_spatial)
-                {
-                    absdiff(_buffer, zeroBuffer, absDiff);
+        void operator()(const Range &range) const
+        {
+            size_t channels = layer->_channels, channelSize = layer->_channelSize;
+            const float* scale = layer->_scale.ptr<float>();
+            AutoBuffer<float> normBuf(layer->_across_spatial ? 1 : STRIPE_SIZE);
+            float* norm = normBuf;
 
-                    // add eps to avoid overflow
-                    double absSum = sum(absDiff)[0] + _eps;
+            for (int t = range.start; t < range.end; t++)
+            {
+                int n = t / nstripes;
+                size_t i0 = layer->_across_spatial ? 0 : (t % nstripes) * STRIPE_SIZE;
+                size_t len = layer->_across_spatial ? channelSize : std::min(channelSize - i0, (size_t)STRIPE_SIZE);
+                const float* srcData = src->ptr<float>(n) + i0;
+                float* dstData = dst->ptr<float>(n) + i0;
 
-                    float norm = sqrt(absSum);
-                    dst = src / norm;
+                if (layer->_across_spatial)
+                {
+                    // add eps to avoid overflow
+                    double absSum = layer->_eps;
+                    for (size_t c = 0; c < channels; c++)
+                    {
+                        const float* s = srcData + c*channelSize;
+                        for (size_t i = 0; i < len; i++)
+                            absSum += s[i]*s[i];
+                    }
+                    float invNorm = (float)(1. / std::sqrt(absSum));
+
+                    for (size_t c = 0; c < channels; c++)
+                    {
+                        const float* s = srcData + c*channelSize;
+                        float* d = dstData + c*channelSize;
+                        float k = invNorm * scale[layer->_channel_shared ? 0 : c];
+                        for (size_t i = 0; i < len; i++)
+                            d[i] = s[i]*k;
+                    }
                 }
                 else
                 {
-                    Mat norm(_channelSize, 1, _buffer.type()); // 1 x _channelSize
-
-                    // (_channels x_channelSize)T * _channels x 1 -> _channelSize x 1
-                    gemmCPU(_buffer, _sumChannelMultiplier, 1, norm, 0, GEMM_1_T);
-
-                    // compute norm
-                    pow(norm, 0.5f, norm);
+                    for (size_t i = 0; i < len; i++)
+                        norm[i] = 0.f;
+
+                    for (size_t c = 0; c < channels; c++)
+                    {
+                        const float* s = srcData + c*channelSize;
+                        for (size_t i = 0; i < len; i++)
+                            norm[i] += s[i]*s[i];
+                    }
+
+                    // an all-zero pixel (common after ReLU) stays zero instead of becoming 0*inf
+                    for (size_t i = 0; i < len; i++)
+                        norm[i] = norm[i] > 0.f ? 1.f / std::sqrt(norm[i]) : 0.f;
+
+                    for (size_t c = 0; c < channels; c++)
+                    {
+                        const float* s = srcData + c*channelSize;
+                        float* d = dstData + c*channelSize;
+                        float k = scale[layer->_channel_shared ? 0 : c];
+                        for (size_t i = 0; i < len; i++)
+                            d[i] = s[i]*norm[i]*k;
+                    }
+                }
+            }
+        }
 
-                    // scale the layer
-                    // _channels x 1 * (_channelSize x 1)T -> _channels x _channelSize
-                    gemmCPU(_sumChannelMultiplier, norm, 1, _buffer, 0, GEMM_2_T);
+    private:
+        const NormalizeBBoxLayerImpl* layer;
+        const Mat* src;
+        Mat* dst;
+        int nstripes;
+    };
 
-                    dst = src / _buffer;
-                }
+    int64 getFLOPS(const std::vector<Mat*> &inputs, const std::vector<Mat> &) const
+    {
+        //squares, sums and scaling by the norm and the channel weights
+        return 4 * (int64)inputs[0]->total();
+    }
 
-                // scale the output
-                if (_channel_shared)
-                {
-                    // _scale: 1 x 1
-                    dst *= _scale.at<float>(0, 0);
-                }
-                else
-                {
-                    // _scale: _channels x 1
-                    // _channels x 1 * 1 x _channelSize -> _channels x _channelSize
-                    gemmCPU(_scale, _sumSpatialMultiplier, 1, _buffer, 0);
+    void forward(std::vector<Mat*> &inputs, std::vector<Mat> &outputs)
+    {
+        CV_Assert(_scale.isContinuous() && _scale.total() >= (_channel_shared ? 1 : _channels));
 
-                    dst = dst.mul(_buffer);
-                }
-            }
+        for (size_t j = 0; j < inputs.size(); j++)
+        {
+            NormalizeInvoker invoker(*this, *inputs[j], outputs[j]);
+            parallel_for_(Range(0, invoker.numTasks()), invoker, limitStripes());
         }
     }
 
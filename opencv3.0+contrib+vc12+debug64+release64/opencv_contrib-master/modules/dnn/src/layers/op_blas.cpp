@@ -4,6 +4,7 @@
 #include "opencv_lapack.h"
 #endif
 
+#include "opencv2/core/hal/intrin.hpp"
 #include <iostream>
 
 namespace cv
@@ -29,74 +30,273 @@ inline void SwapRowCols(const Mat &A, int &rows, int &cols, bool isTrans)
 }
 
 
-class GEMMInvoker : public ParallelLoopBody
+#ifndef HAVE_LAPACK
+//Register block of the micro-kernel: GEMM_MR rows of A by GEMM_NR columns of B
+enum { GEMM_MR = 4, GEMM_NR = 8 };
+//Depth of the K-blocks, packed B panel of GEMM_KC x GEMM_NR floats stays in L1 cache
+enum { GEMM_KC = 256 };
+//Numbers of A and B panels in the block of C computed by one parallel task, A panels stay in L2 cache
+enum { GEMM_MC_PANELS = 16, GEMM_NC_PANELS = 32 };
+
+//Packs op(X) of size rows x cols into panels of `width` rows (left operand) or columns (right operand),
+//so that the panel elements used by one step of the micro-kernel are contiguous.
+class GEMMPackInvoker : public ParallelLoopBody
 {
 public:
-    GEMMInvoker(const Mat* _a, const Mat* _b, double _alpha, Mat* _c, double _beta)
+    GEMMPackInvoker(const Mat &X_, bool trans_, bool left_, int K_, float* dst_)
+        : X(&X_), trans(trans_), left(left_), K(K_), dst(dst_)
+    {
+        width = left ? GEMM_MR : GEMM_NR;
+        //number of rows of A or columns of B
+        n = left ? (trans ? X->cols : X->rows) : (trans ? X->rows : X->cols);
+    }
+
+    int numPanels() const
     {
-        a = _a;
-        b = _b;
-        c = _c;
-        alpha = _alpha;
-        beta = _beta;
+        return (n + width - 1) / width;
     }
 
     void operator()(const Range& range) const
     {
-        int mmax = a->rows;
-        int nmax = range.end - range.start;
-        int kmax = a->cols;
-        int m, n, k;
-        AutoBuffer<float> buf(nmax);
-        float* ptr = buf;
-        if( mmax %2 != 0 )
-            memset(ptr, 0, nmax*sizeof(ptr[0]));
-
-        for( m = 0; m < mmax; m += 2 )
+        const float* x = X->ptr<float>();
+        size_t ldx = X->step1();
+
+        for (int p = range.start; p < range.end; p++)
         {
-            float* dst0 = c->ptr<float>(m) + range.start;
-            float* dst1 = m+1 < mmax ? c->ptr<float>(m+1) + range.start : ptr;
-            const float* aptr0 = a->ptr<float>(m);
-            const float* aptr1 = m+1 < mmax ? a->ptr<float>(m+1) : aptr0;
+            int i0 = p * width, w = std::min(n - i0, width);
+            float* d = dst + (size_t)i0 * K;
 
-            if( beta != 1 )
+            //A panel takes rows of A, B panel takes columns of B
+            bool contiguousRows = left ? !trans : trans;
+            if (contiguousRows)
             {
-                if( beta == 0 )
-                    for( n = 0; n < nmax; n++ )
-                    {
-                        dst0[n] = 0.f;
-                        dst1[n] = 0.f;
-                    }
-                else
-                    for( n = 0; n < nmax; n++ )
-                    {
-                        dst0[n] *= (float)beta;
-                        dst1[n] *= (float)beta;
-                    }
+                for (int r = 0; r < w; r++)
+                {
+                    const float* src = x + (size_t)(i0 + r) * ldx;
+                    for (int k = 0; k < K; k++)
+                        d[k*width + r] = src[k];
+                }
             }
+            else
+            {
+                for (int k = 0; k < K; k++)
+                {
+                    const float* src = x + (size_t)k * ldx + i0;
+                    for (int r = 0; r < w; r++)
+                        d[k*width + r] = src[r];
+                }
+            }
+
+            for (int k = 0; k < K; k++)
+                for (int r = w; r < width; r++)
+                    d[k*width + r] = 0.f;
+        }
+    }
+
+private:
+    const Mat* X;
+    bool trans, left;
+    int K, width, n;
+    float* dst;
+};
+
+static void packMatrix(const Mat &X, bool trans, bool left, int K, Mat &packed)
+{
+    GEMMPackInvoker invoker(X, trans, left, K, 0);
+    int width = left ? GEMM_MR : GEMM_NR;
+    packed.create(1, invoker.numPanels() * width * K, CV_32F);
+
+    invoker = GEMMPackInvoker(X, trans, left, K, packed.ptr<float>());
+    parallel_for_(Range(0, invoker.numPanels()), invoker, limitStripes());
+}
+
+//Computes GEMM_MR x GEMM_NR block of C = alpha*A*B + beta*C over kc elements of packed panels
+static void gemmMicroKernel(int kc, const float* a, const float* b, float* c, size_t ldc,
+                            int mr, int nr, float alpha, float beta)
+{
+    float buf[GEMM_MR*GEMM_NR];
+
+#if CV_SIMD128
+    v_float32x4 c00 = v_setzero_f32(), c01 = v_setzero_f32();
+    v_float32x4 c10 = v_setzero_f32(), c11 = v_setzero_f32();
+    v_float32x4 c20 = v_setzero_f32(), c21 = v_setzero_f32();
+    v_float32x4 c30 = v_setzero_f32(), c31 = v_setzero_f32();
+
+    for (int k = 0; k < kc; k++, a += GEMM_MR, b += GEMM_NR)
+    {
+        v_float32x4 b0 = v_load(b), b1 = v_load(b + 4);
+        v_float32x4 a0 = v_setall_f32(a[0]), a1 = v_setall_f32(a[1]);
+        c00 = v_muladd(a0, b0, c00); c01 = v_muladd(a0, b1, c01);
+        c10 = v_muladd(a1, b0, c10); c11 = v_muladd(a1, b1, c11);
+        a0 = v_setall_f32(a[2]); a1 = v_setall_f32(a[3]);
+        c20 = v_muladd(a0, b0, c20); c21 = v_muladd(a0, b1, c21);
+        c30 = v_muladd(a1, b0, c30); c31 = v_muladd(a1, b1, c31);
+    }
+
+    v_store(buf, c00);      v_store(buf + 4, c01);
+    v_store(buf + 8, c10);  v_store(buf + 12, c11);
+    v_store(buf + 16, c20); v_store(buf + 20, c21);
+    v_store(buf + 24, c30); v_store(buf + 28, c31);
+#else
+    for (int i = 0; i < GEMM_MR*GEMM_NR; i++)
+        buf[i] = 0.f;
+
+    for (int k = 0; k < kc; k++, a += GEMM_MR, b += GEMM_NR)
+        for (int r = 0; r < GEMM_MR; r++)
+            for (int j = 0; j < GEMM_NR; j++)
+                buf[r*GEMM_NR + j] += a[r]*b[j];
+#endif
 
-            for( k = 0; k < kmax; k++ )
+    for (int r = 0; r < mr; r++, c += ldc)
+    {
+        const float* bufRow = buf + r*GEMM_NR;
+        if (beta == 0.f)
+            for (int j = 0; j < nr; j++)
+                c[j] = alpha*bufRow[j];
+        else
+            for (int j = 0; j < nr; j++)
+                c[j] = beta*c[j] + alpha*bufRow[j];
+    }
+}
+
+//Multiplies packed operands, the work is split into 2D grid of C blocks
+class GEMMPackedInvoker : public ParallelLoopBody
+{
+public:
+    GEMMPackedInvoker(const float* pa_, const float* pb_, int M_, int N_, int K_,
+                      float alpha_, float beta_, Mat &C_)
+        : pa(pa_), pb(pb_), M(M_), N(N_), K(K_), alpha(alpha_), beta(beta_), C(&C_)
+    {
+        mTasks = (M + GEMM_MC_PANELS*GEMM_MR - 1) / (GEMM_MC_PANELS*GEMM_MR);
+        nTasks = (N + GEMM_NC_PANELS*GEMM_NR - 1) / (GEMM_NC_PANELS*GEMM_NR);
+    }
+
+    int numTasks() const
+    {
+        return mTasks * nTasks;
+    }
+
+    void operator()(const Range& range) const
+    {
+        size_t ldc = C->step1();
+
+        for (int t = range.start; t < range.end; t++)
+        {
+            int i0 = (t / nTasks) * GEMM_MC_PANELS*GEMM_MR, i1 = std::min(M, i0 + GEMM_MC_PANELS*GEMM_MR);
+            int j0 = (t % nTasks) * GEMM_NC_PANELS*GEMM_NR, j1 = std::min(N, j0 + GEMM_NC_PANELS*GEMM_NR);
+
+            for (int k0 = 0; k0 < K; k0 += GEMM_KC)
             {
-                float alpha0 = (float)(alpha*aptr0[k]);
-                float alpha1 = (float)(alpha*aptr1[k]);
-                const float* bptr = b->ptr<float>(k) + range.start;
+                int kc = std::min(K - k0, (int)GEMM_KC);
+                float blockBeta = k0 == 0 ? beta : 1.f;
 
-                for( n = 0; n < nmax; n++ )
+                for (int j = j0; j < j1; j += GEMM_NR)
                 {
-                    float d0 = dst0[n] + alpha0*bptr[n];
-                    float d1 = dst1[n] + alpha1*bptr[n];
-                    dst0[n] = d0;
-                    dst1[n] = d1;
+                    const float* bp = pb + (size_t)j*K + (size_t)k0*GEMM_NR;
+                    for (int i = i0; i < i1; i += GEMM_MR)
+                    {
+                        const float* ap = pa + (size_t)i*K + (size_t)k0*GEMM_MR;
+                        gemmMicroKernel(kc, ap, bp, C->ptr<float>(i) + j, ldc,
+                                        std::min(i1 - i, (int)GEMM_MR), std::min(j1 - j, (int)GEMM_NR),
+                                        alpha, blockBeta);
+                    }
                 }
             }
         }
     }
 
-    const Mat *a, *b;
-    Mat* c;
-    double alpha, beta;
+private:
+    const float *pa, *pb;
+    int M, N, K;
+    float alpha, beta;
+    Mat* C;
+    int mTasks, nTasks;
 };
 
+static void gemmPacked(const float* pa, const float* pb, int M, int N, int K, double alpha, Mat &C, double beta)
+{
+    if (K == 0)
+    {
+        if (beta == 0)
+            C.setTo(0);
+        else
+            C *= beta;
+        return;
+    }
+
+    GEMMPackedInvoker invoker(pa, pb, M, N, K, (float)alpha, (float)beta, C);
+    parallel_for_(Range(0, invoker.numTasks()), invoker, limitStripes());
+}
+#endif
+
+static void prepareOutput(Mat &C, int rows, int cols, double beta)
+{
+    if (beta == 0)
+        C.create(rows, cols, CV_32F);
+    CV_Assert(C.rows == rows && C.cols == cols && C.type() == CV_32F);
+}
+
+PackedGemmMatrix::PackedGemmMatrix() : rows(0), cols(0), trans(false), left(true) {}
+
+void PackedGemmMatrix::pack(const Mat &X, bool left_, bool trans_)
+{
+    CV_Assert(X.dims == 2 && X.type() == CV_32F);
+
+    origin = X;
+    left = left_;
+    trans = trans_;
+    SwapRowCols(X, rows, cols, trans);
+
+    #ifndef HAVE_LAPACK
+    packMatrix(origin, trans, left, left ? cols : rows, data);
+    #endif
+}
+
+void PackedGemmMatrix::release()
+{
+    origin.release();
+    data.release();
+    rows = cols = 0;
+}
+
+void gemm(const PackedGemmMatrix &A, const Mat &B, double alpha, Mat &C, double beta, int flags)
+{
+    CV_Assert(!A.empty() && A.left && (flags & ~GEMM_2_T) == 0);
+
+    bool transB = (flags & GEMM_2_T) != 0;
+    int Brows, Bcols;
+    SwapRowCols(B, Brows, Bcols, transB);
+    CV_Assert(B.type() == CV_32F && A.cols == Brows);
+    prepareOutput(C, A.rows, Bcols, beta);
+
+    #ifdef HAVE_LAPACK
+    gemmCPU(A.origin, B, alpha, C, beta, flags | (A.trans ? GEMM_1_T : 0));
+    #else
+    Mat packedB;
+    packMatrix(B, transB, false, Brows, packedB);
+    gemmPacked(A.data.ptr<float>(), packedB.ptr<float>(), A.rows, Bcols, A.cols, alpha, C, beta);
+    #endif
+}
+
+void gemm(const Mat &A, const PackedGemmMatrix &B, double alpha, Mat &C, double beta, int flags)
+{
+    CV_Assert(!B.empty() && !B.left && (flags & ~GEMM_1_T) == 0);
+
+    bool transA = (flags & GEMM_1_T) != 0;
+    int Arows, Acols;
+    SwapRowCols(A, Arows, Acols, transA);
+    CV_Assert(A.type() == CV_32F && Acols == B.rows);
+    prepareOutput(C, Arows, B.cols, beta);
+
+    #ifdef HAVE_LAPACK
+    gemmCPU(A, B.origin, alpha, C, beta, flags | (B.trans ? GEMM_2_T : 0));
+    #else
+    Mat packedA;
+    packMatrix(A, transA, true, Acols, packedA);
+    gemmPacked(packedA.ptr<float>(), B.data.ptr<float>(), Arows, B.cols, Acols, alpha, C, beta);
+    #endif
+}
+
 void gemmCPU(const Mat &A, const Mat &B, double alpha, Mat &C, double beta, int flags /*= 0*/)
 {
     #ifdef HAVE_LAPACK
@@ -137,11 +337,19 @@ void gemmCPU(const Mat &A, const Mat &B, double alpha, Mat &C, double beta, int
         CV_Error(Error::BadDepth, "Only floating point types are supported");
     }
     #else
-    if( C.type() == CV_32F && flags == 0 )
+    if (A.type() == CV_32F && B.type() == CV_32F && C.type() == CV_32F && !(flags & GEMM_3_T) &&
+        A.dims == 2 && B.dims == 2 && A.data != C.data && B.data != C.data)
     {
-        GEMMInvoker invoker(&A, &B, alpha, &C, beta);
-        double granularity = 10000000./((double)A.rows*A.cols);
-        parallel_for_(Range(0, B.cols), invoker, granularity);
+        bool transA = (flags & GEMM_1_T) != 0, transB = (flags & GEMM_2_T) != 0;
+        int Arows, Acols, Brows, Bcols;
+        SwapRowCols(A, Arows, Acols, transA);
+        SwapRowCols(B, Brows, Bcols, transB);
+        CV_Assert(Acols == Brows && C.rows == Arows && C.cols == Bcols);
+
+        Mat packedA, packedB;
+        packMatrix(A, transA, true, Acols, packedA);
+        packMatrix(B, transB, false, Brows, packedB);
+        gemmPacked(packedA.ptr<float>(), packedB.ptr<float>(), Arows, Bcols, Acols, alpha, C, beta);
     }
     else
         cv::gemm(A, B, alpha, C, beta, C, flags);
@@ -54,6 +54,28 @@ namespace dnn
     void gemm(InputArray A, InputArray B, double alpha, InputOutputArray C, double beta, int flags = 0);
 
     void gemmCPU(const Mat &A, const Mat &B, double alpha, Mat &C, double beta, int flags = 0);
+
+    //Constant GEMM operand (e.g. layer weights) rearranged once into the panels consumed by the GEMM kernel
+    class PackedGemmMatrix
+    {
+    public:
+        PackedGemmMatrix();
+
+        //packs op(X) to be used as the left (@p left is true) or right operand
+        void pack(const Mat &X, bool left, bool trans = false);
+        void release();
+        bool empty() const { return origin.empty(); }
+
+        int rows, cols;     //size of op(X)
+        bool trans, left;
+        Mat origin, data;
+    };
+
+    //computes C = alpha*A*op(B) + beta*C, only GEMM_2_T flag is allowed
+    void gemm(const PackedGemmMatrix &A, const Mat &B, double alpha, Mat &C, double beta, int flags = 0);
+
+    //computes C = alpha*op(A)*B + beta*C, only GEMM_1_T flag is allowed
+    void gemm(const Mat &A, const PackedGemmMatrix &B, double alpha, Mat &C, double beta, int flags = 0);
 }
 }
 #endif
@@ -0,0 +1,396 @@
+/*M///////////////////////////////////////////////////////////////////////////////////////
+//
+//  IMPORTANT: READ BEFORE DOWNLOADING, COPYING, INSTALLING OR USING.
+//
+//  By downloading, copying, installing or using the software you agree to this license.
+//  If you do not agree to this license, do not download, install,
+//  copy or use the software.
+//
+//
+//                           License Agreement
+//                For Open Source Computer Vision Library
+//
+// Copyright (C) 2013, OpenCV Foundation, all rights reserved.
+// Third party copyrights are property of their respective owners.
+//
+// Redistribution and use in source and binary forms, with or without modification,
+// are permitted provided that the following conditions are met:
+//
+//   * Redistribution's of source code must retain the above copyright notice,
+//     this list of conditions and the following disclaimer.
+//
+//   * Redistribution's in binary form must reproduce the above copyright notice,
+//     this list of conditions and the following disclaimer in the documentation
+//     and/or other materials provided with the distribution.
+//
+//   * The name of the copyright holders may not be used to endorse or promote products
+//     derived from this software without specific prior written permission.
+//
+// This software is provided by the copyright holders and contributors "as is" and
+// any express or implied warranties, including, but not limited to, the implied
+// warranties of merchantability and fitness for a particular purpose are disclaimed.
+// In no event shall the Intel Corporation or contributors be liable for any direct,
+// indirect, incidental, special, exemplary, or consequential damages
+// (including, but not limited to, procurement of substitute goods or services;
+// loss of use, data, or profits; or business interruption) however caused
+// and on any theory of liability, whether in contract, strict liability,
+// or tort (including negligence or otherwise) arising in any way out of
+// the use of this software, even if advised of the possibility of such damage.
+//
+//M*/
+
+#include "../precomp.hpp"
+#include "op_conv.hpp"
+#include "op_blas.hpp"
+#include "opencv2/core/hal/intrin.hpp"
+
+namespace cv
+{
+namespace dnn
+{
+
+//Transformation matrices of Winograd minimal filtering algorithm F(M x M, 3 x 3), see A. Lavin, S. Gray
+//"Fast Algorithms for Convolutional Neural Networks". Output tile M x M is computed from (M+2) x (M+2) input tile.
+template<int M> struct WinogradTables;
+
+template<> struct WinogradTables<2>
+{
+    enum { ALPHA = 4 };
+    static const float BT[4][4], G[4][3], AT[2][4];
+};
+
+const float WinogradTables<2>::BT[4][4] =
+{
+    { 1.f,  0.f, -1.f,  0.f },
+    { 0.f,  1.f,  1.f,  0.f },
+    { 0.f, -1.f,  1.f,  0.f },
+    { 0.f,  1.f,  0.f, -1.f }
+};
+
+const float WinogradTables<2>::G[4][3] =
+{
+    { 1.f,   0.f,  0.f },
+    { 0.5f,  0.5f, 0.5f },
+    { 0.5f, -0.5f, 0.5f },
+    { 0.f,   0.f,  1.f }
+};
+
+const float WinogradTables<2>::AT[2][4] =
+{
+    { 1.f, 1.f,  1.f,  0.f },
+    { 0.f, 1.f, -1.f, -1.f }
+};
+
+template<> struct WinogradTables<4>
+{
+    enum { ALPHA = 6 };
+    static const float BT[6][6], G[6][3], AT[4][6];
+};
+
+const float WinogradTables<4>::BT[6][6] =
+{
+    { 4.f,  0.f, -5.f,  0.f, 1.f, 0.f },
+    { 0.f, -4.f, -4.f,  1.f, 1.f, 0.f },
+    { 0.f,  4.f, -4.f, -1.f, 1.f, 0.f },
+    { 0.f, -2.f, -1.f,  2.f, 1.f, 0.f },
+    { 0.f,  2.f, -1.f, -2.f, 1.f, 0.f },
+    { 0.f,  4.f,  0.f, -5.f, 0.f, 1.f }
+};
+
+const float WinogradTables<4>::G[6][3] =
+{
+    {  1.f/4,   0.f,     0.f    },
+    { -1.f/6,  -1.f/6,  -1.f/6  },
+    { -1.f/6,   1.f/6,  -1.f/6  },
+    {  1.f/24,  1.f/12,  1.f/6  },
+    {  1.f/24, -1.f/12,  1.f/6  },
+    {  0.f,     0.f,     1.f    }
+};
+
+const float WinogradTables<4>::AT[4][6] =
+{
+    { 1.f, 1.f,  1.f, 1.f,  1.f, 0.f },
+    { 0.f, 1.f, -1.f, 2.f, -2.f, 0.f },
+    { 0.f, 1.f,  1.f, 4.f,  4.f, 0.f },
+    { 0.f, 1.f, -1.f, 8.f, -8.f, 1.f }
+};
+
+template<int M>
+static void winogradWeights_(const float* weights, int outCn, int inpCn, Mat &U)
+{
+    typedef WinogradTables<M> T;
+    const int A = T::ALPHA;
+
+    U.create(A*A*outCn, inpCn, CV_32F);
+
+    for (int k = 0; k < outCn; k++)
+    {
+        for (int c = 0; c < inpCn; c++)
+        {
+            const float* g = weights + (k*inpCn + c)*9;
+            float tmp[A][3];
+
+            for (int i = 0; i < A; i++)
+                for (int j = 0; j < 3; j++)
+                    tmp[i][j] = T::G[i][0]*g[j] + T::G[i][1]*g[3 + j] + T::G[i][2]*g[6 + j];
+
+            for (int i = 0; i < A; i++)
+                for (int j = 0; j < A; j++)
+                    U.at<float>((i*A + j)*outCn + k, c) = tmp[i][0]*T::G[j][0] + tmp[i][1]*T::G[j][1] + tmp[i][2]*T::G[j][2];
+        }
+    }
+}
+
+void winogradWeights(const float* weights, int outCn, int inpCn, int tile, Mat &transformedWeights)
+{
+    if (tile == 2)
+        winogradWeights_<2>(weights, outCn, inpCn, transformedWeights);
+    else if (tile == 4)
+        winogradWeights_<4>(weights, outCn, inpCn, transformedWeights);
+    else
+        CV_Error(Error::StsBadArg, "Unsupported Winograd tile size");
+}
+
+//Each stripe transforms a block of input tiles, multiplies them by transformed weights
+//(ALPHA^2 independent matrix products over channels) and applies inverse transform.
+template<int M>
+class WinogradInvoker : public ParallelLoopBody
+{
+public:
+    typedef WinogradTables<M> T;
+    enum { A = T::ALPHA };
+
+    WinogradInvoker(const float* src_, int inpCn_, int inpH_, int inpW_, int padH_, int padW_,
+                    const Mat &U_, int outCn_, const float* bias_, int outH_, int outW_, float* dst_,
+                    int blockSize_)
+        : src(src_), inpCn(inpCn_), inpH(inpH_), inpW(inpW_), padH(padH_), padW(padW_),
+          U(&U_), outCn(outCn_), bias(bias_), outH(outH_), outW(outW_), dst(dst_), blockSize(blockSize_)
+    {
+        tilesX = (outW + M - 1) / M;
+        ntiles = tilesX * ((outH + M - 1) / M);
+    }
+
+    void operator()(const Range &r) const
+    {
+        Mat V, Mres;
+
+        for (int b = r.start; b < r.end; b++)
+        {
+            int p0 = b * blockSize, p1 = std::min(p0 + blockSize, ntiles), np = p1 - p0;
+
+            V.create(A*A*inpCn, np, CV_32F);
+            Mres.create(A*A*outCn, np, CV_32F);
+
+            for (int c = 0; c < inpCn; c++)
+            {
+                const float* plane = src + (size_t)c*inpH*inpW;
+
+                for (int p = p0; p < p1; p++)
+                {
+                    int y0 = (p / tilesX)*M - padH, x0 = (p % tilesX)*M - padW;
+                    float d[A][A], tmp[A][A];
+
+                    for (int i = 0; i < A; i++)
+                    {
+                        int y = y0 + i;
+                        for (int j = 0; j < A; j++)
+                        {
+                            int x = x0 + j;
+                            d[i][j] = (0 <= y && y < inpH && 0 <= x && x < inpW) ? plane[y*inpW + x] : 0.f;
+                        }
+                    }
+
+                    for (int i = 0; i < A; i++)
+                        for (int j = 0; j < A; j++)
+                        {
+                            float s = 0.f;
+                            for (int l = 0; l < A; l++)
+                                s += T::BT[i][l]*d[l][j];
+                            tmp[i][j] = s;
+                        }
+
+                    for (int i = 0; i < A; i++)
+                        for (int j = 0; j < A; j++)
+                        {
+                            float s = 0.f;
+                            for (int l = 0; l < A; l++)
+                                s += tmp[i][l]*T::BT[j][l];
+                            V.ptr<float>((i*A + j)*inpCn + c)[p - p0] = s;
+                        }
+                }
+            }
+
+            for (int xi = 0; xi < A*A; xi++)
+            {
+                Mat Ux = U->rowRange(xi*outCn, (xi + 1)*outCn);
+                Mat Vx = V.rowRange(xi*inpCn, (xi + 1)*inpCn);
+                Mat Mx = Mres.rowRange(xi*outCn, (xi + 1)*outCn);
+                gemmCPU(Ux, Vx, 1, Mx, 0);
+            }
+
+            for (int k = 0; k < outCn; k++)
+            {
+                float biasVal = bias ? bias[k] : 0.f;
+                float* out = dst + (size_t)k*outH*outW;
+
+                for (int p = p0; p < p1; p++)
+                {
+                    int oy0 = (p / tilesX)*M, ox0 = (p % tilesX)*M;
+                    float m[A][A], tmp[M][A];
+
+                    for (int i = 0; i < A; i++)
+                        for (int j = 0; j < A; j++)
+                            m[i][j] = Mres.ptr<float>((i*A + j)*outCn + k)[p - p0];
+
+                    for (int i = 0; i < M; i++)
+                        for (int j = 0; j < A; j++)
+                        {
+                            float s = 0.f;
+                            for (int l = 0; l < A; l++)
+                                s += T::AT[i][l]*m[l][j];
+                            tmp[i][j] = s;
+                        }
+
+                    for (int i = 0; i < M && oy0 + i < outH; i++)
+                        for (int j = 0; j < M && ox0 + j < outW; j++)
+                        {
+                            float s = biasVal;
+                            for (int l = 0; l < A; l++)
+                                s += tmp[i][l]*T::AT[j][l];
+                            out[(oy0 + i)*outW + ox0 + j] = s;
+                        }
+                }
+            }
+        }
+    }
+
+    int numBlocks() const
+    {
+        return (ntiles + blockSize - 1) / blockSize;
+    }
+
+private:
+    const float* src;
+    int inpCn, inpH, inpW, padH, padW;
+    const Mat* U;
+    int outCn;
+    const float* bias;
+    int outH, outW;
+    float* dst;
+    int blockSize, tilesX, ntiles;
+};
+
+template<int M>
+static void winogradConvolution_(const float* src, int inpCn, int inpH, int inpW, int padH, int padW,
+                                 const Mat &U, int outCn, const float* bias, int outH, int outW, float* dst)
+{
+    //blocks of tiles bound size of the transformed data and give the work for all threads
+    const int maxBlockSize = 256, minBlockSize = 16;
+    int ntiles = ((outH + M - 1) / M) * ((outW + M - 1) / M);
+    int nblocks = std::max(getNumThreads(), (ntiles + maxBlockSize - 1) / maxBlockSize);
+    int blockSize = std::max((ntiles + nblocks - 1) / nblocks, minBlockSize);
+
+    WinogradInvoker<M> invoker(src, inpCn, inpH, inpW, padH, padW, U, outCn, bias, outH, outW, dst, blockSize);
+    parallel_for_(Range(0, invoker.numBlocks()), invoker, limitStripes());
+}
+
+void winogradConvolution(const float* src, int inpCn, int inpH, int inpW, int padH, int padW,
+                         const Mat &transformedWeights, int outCn, int tile, const float* bias,
+                         int outH, int outW, float* dst)
+{
+    CV_Assert(transformedWeights.type() == CV_32F && transformedWeights.cols == inpCn);
+    CV_Assert(transformedWeights.rows == (tile + 2)*(tile + 2)*outCn);
+
+    if (tile == 2)
+        winogradConvolution_<2>(src, inpCn, inpH, inpW, padH, padW, transformedWeights, outCn, bias, outH, outW, dst);
+    else if (tile == 4)
+        winogradConvolution_<4>(src, inpCn, inpH, inpW, padH, padW, transformedWeights, outCn, bias, outH, outW, dst);
+    else
+        CV_Error(Error::StsBadArg, "Unsupported Winograd tile size");
+}
+
+class DepthwiseConvInvoker : public ParallelLoopBody
+{
+public:
+    DepthwiseConvInvoker(const float* src_, int channels_, int inpH_, int inpW_,
+                         const float* weights_, int kernelH_, int kernelW_, int padH_, int padW_,
+                         int strideH_, int strideW_, int dilationH_, int dilationW_,
+                         const float* bias_, int outH_, int outW_, float* dst_)
+        : src(src_), channels(channels_), inpH(inpH_), inpW(inpW_),
+          weights(weights_), kernelH(kernelH_), kernelW(kernelW_), padH(padH_), padW(padW_),
+          strideH(strideH_), strideW(strideW_), dilationH(dilationH_), dilationW(dilationW_),
+          bias(bias_), outH(outH_), outW(outW_), dst(dst_)
+    {
+    }
+
+    void operator()(const Range &r) const
+    {
+        for (int p = r.start; p < r.end; p++)
+        {
+            int c = p % channels;
+            const float* w = weights + c*kernelH*kernelW;
+            const float* inp = src + (size_t)p*inpH*inpW;
+            float* out = dst + (size_t)p*outH*outW;
+            float biasVal = bias ? bias[c] : 0.f;
+
+            for (int oy = 0; oy < outH; oy++)
+            {
+                float* outRow = out + oy*outW;
+                for (int ox = 0; ox < outW; ox++)
+                    outRow[ox] = biasVal;
+
+                for (int ky = 0; ky < kernelH; ky++)
+                {
+                    int iy = oy*strideH - padH + ky*dilationH;
+                    if (iy < 0 || iy >= inpH)
+                        continue;
+                    const float* inpRow = inp + iy*inpW;
+
+                    for (int kx = 0; kx < kernelW; kx++)
+                    {
+                        float wval = w[ky*kernelW + kx];
+                        int ix0 = kx*dilationW - padW;
+
+                        //range of output columns which read the input row inside of its bounds
+                        int x0 = ix0 >= 0 ? 0 : (-ix0 + strideW - 1) / strideW;
+                        int x1 = ix0 > inpW - 1 ? 0 : std::min(outW, (inpW - 1 - ix0) / strideW + 1);
+                        int ox = x0;
+
+#if CV_SIMD128
+                        if (strideW == 1)
+                        {
+                            v_float32x4 vw = v_setall_f32(wval);
+                            for (; ox <= x1 - 4; ox += 4)
+                                v_store(outRow + ox, v_muladd(v_load(inpRow + ox + ix0), vw, v_load(outRow + ox)));
+                        }
+#endif
+                        for (; ox < x1; ox++)
+                            outRow[ox] += wval*inpRow[ox*strideW + ix0];
+                    }
+                }
+            }
+        }
+    }
+
+private:
+    const float* src;
+    int channels, inpH, inpW;
+    const float* weights;
+    int kernelH, kernelW, padH, padW, strideH, strideW, dilationH, dilationW;
+    const float* bias;
+    int outH, outW;
+    float* dst;
+};
+
+void depthwiseConvolution(const float* src, int nplanes, int channels, int inpH, int inpW,
+                          const float* weights, int kernelH, int kernelW, int padH, int padW,
+                          int strideH, int strideW, int dilationH, int dilationW,
+                          const float* bias, int outH, int outW, float* dst)
+{
+    DepthwiseConvInvoker invoker(src, channels, inpH, inpW, weights, kernelH, kernelW, padH, padW,
+                                 strideH, strideW, dilationH, dilationW, bias, outH, outW, dst);
+    parallel_for_(Range(0, nplanes), invoker, limitStripes());
+}
+
+}
+}
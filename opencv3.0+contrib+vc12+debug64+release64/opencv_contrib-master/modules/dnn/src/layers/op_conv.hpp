@@ -0,0 +1,69 @@
+/*M///////////////////////////////////////////////////////////////////////////////////////
+//
+//  IMPORTANT: READ BEFORE DOWNLOADING, COPYING, INSTALLING OR USING.
+//
+//  By downloading, copying, installing or using the software you agree to this license.
+//  If you do not agree to this license, do not download, install,
+//  copy or use the software.
+//
+//
+//                           License Agreement
+//                For Open Source Computer Vision Library
+//
+// Copyright (C) 2013, OpenCV Foundation, all rights reserved.
+// Third party copyrights are property of their respective owners.
+//
+// Redistribution and use in source and binary forms, with or without modification,
+// are permitted provided that the following conditions are met:
+//
+//   * Redistribution's of source code must retain the above copyright notice,
+//     this list of conditions and the following disclaimer.
+//
+//   * Redistribution's in binary form must reproduce the above copyright notice,
+//     this list of conditions and the following disclaimer in the documentation
+//     and/or other materials provided with the distribution.
+//
+//   * The name of the copyright holders may not be used to endorse or promote products
+//     derived from this software without specific prior written permission.
+//
+// This software is provided by the copyright holders and contributors "as is" and
+// any express or implied warranties, including, but not limited to, the implied
+// warranties of merchantability and fitness for a particular purpose are disclaimed.
+// In no event shall the Intel Corporation or contributors be liable for any direct,
+// indirect, incidental, special, exemplary, or consequential damages
+// (including, but not limited to, procurement of substitute goods or services;
+// loss of use, data, or profits; or business interruption) however caused
+// and on any theory of liability, whether in contract, strict liability,
+// or tort (including negligence or otherwise) arising in any way out of
+// the use of this software, even if advised of the possibility of such damage.
+//
+//M*/
+
+#ifndef __OPENCV_DNN_LAYERS_OP_CONV_HPP__
+#define __OPENCV_DNN_LAYERS_OP_CONV_HPP__
+#include "../precomp.hpp"
+
+namespace cv
+{
+namespace dnn
+{
+
+//Prepares weights of 3x3 convolution (outCn x inpCn x 3 x 3) for Winograd F(tile x tile, 3 x 3) algorithm.
+//The result has (tile+2)^2 blocks of outCn x inpCn matrices.
+void winogradWeights(const float* weights, int outCn, int inpCn, int tile, Mat &transformedWeights);
+
+//Computes 3x3 convolution with unit stride and dilation using Winograd F(tile x tile, 3 x 3) algorithm, tile is 2 or 4.
+void winogradConvolution(const float* src, int inpCn, int inpH, int inpW, int padH, int padW,
+                         const Mat &transformedWeights, int outCn, int tile, const float* bias,
+                         int outH, int outW, float* dst);
+
+//Convolves each of nplanes input planes with its own kernel, plane p uses kernel and bias with index p % channels.
+void depthwiseConvolution(const float* src, int nplanes, int channels, int inpH, int inpW,
+                          const float* weights, int kernelH, int kernelW, int padH, int padW,
+                          int strideH, int strideW, int dilationH, int dilationW,
+                          const float* bias, int outH, int outW, float* dst);
+
+}
+}
+
+#endif
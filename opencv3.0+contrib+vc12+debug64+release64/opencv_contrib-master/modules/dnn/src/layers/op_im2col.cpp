@@ -87,7 +87,7 @@ public:
         t.width_col = width_col;
         t.channels_col = channels * kernel_h * kernel_w;
 
-        cv::parallel_for_(Range(0, t.channels_col), t);
+        cv::parallel_for_(Range(0, t.channels_col), t, limitStripes());
     }
 
     virtual void operator ()(const Range &r) const
@@ -157,7 +157,7 @@ public:
 #if 1
         t(Range(0, total));
 #else
-        cv::parallel_for_(Range(0, total), t, 16);
+        cv::parallel_for_(Range(0, total), t, limitStripes(16));
 #endif
     }
 
@@ -277,7 +277,7 @@ public:
         t.width_col = (width + 2 * pad_w - kernel_w) / stride_w + 1;
         int img_total = channels * height * width;
 
-        cv::parallel_for_(Range(0, img_total), t);
+        cv::parallel_for_(Range(0, img_total), t, limitStripes());
     }
 
     virtual void operator ()(const Range &r) const
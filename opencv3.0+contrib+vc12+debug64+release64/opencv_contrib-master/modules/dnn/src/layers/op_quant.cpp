@@ -0,0 +1,194 @@
+/*M///////////////////////////////////////////////////////////////////////////////////////
+//
+//  IMPORTANT: READ BEFORE DOWNLOADING, COPYING, INSTALLING OR USING.
+//
+//  By downloading, copying, installing or using the software you agree to this license.
+//  If you do not agree to this license, do not download, install,
+//  copy or use the software.
+//
+//
+//                           License Agreement
+//                For Open Source Computer Vision Library
+//
+// Copyright (C) 2013, OpenCV Foundation, all rights reserved.
+// Third party copyrights are property of their respective owners.
+//
+// Redistribution and use in source and binary forms, with or without modification,
+// are permitted provided that the following conditions are met:
+//
+//   * Redistribution's of source code must retain the above copyright notice,
+//     this list of conditions and the following disclaimer.
+//
+//   * Redistribution's in binary form must reproduce the above copyright notice,
+//     this list of conditions and the following disclaimer in the documentation
+//     and/or other materials provided with the distribution.
+//
+//   * The name of the copyright holders may not be used to endorse or promote products
+//     derived from this software without specific prior written permission.
+//
+// This software is provided by the copyright holders and contributors "as is" and
+// any express or implied warranties, including, but not limited to, the implied
+// warranties of merchantability and fitness for a particular purpose are disclaimed.
+// In no event shall the Intel Corporation or contributors be liable for any direct,
+// indirect, incidental, special, exemplary, or consequential damages
+// (including, but not limited to, procurement of substitute goods or services;
+// loss of use, data, or profits; or business interruption) however caused
+// and on any theory of liability, whether in contract, strict liability,
+// or tort (including negligence or otherwise) arising in any way out of
+// the use of this software, even if advised of the possibility of such damage.
+//
+//M*/
+
+#include "../precomp.hpp"
+#include "op_quant.hpp"
+#include "opencv2/core/hal/intrin.hpp"
+
+namespace cv
+{
+namespace dnn
+{
+
+float int8Scale(float range)
+{
+    return range > 0.f ? range / 127.f : 1.f;
+}
+
+void quantizeInt8(const float* src, schar* dst, size_t len, float scale)
+{
+    float invScale = 1.f / scale;
+    size_t i = 0;
+
+#if CV_SIMD128
+    v_float32x4 vinv = v_setall_f32(invScale);
+    v_int8x16 vmin = v_setall_s8(-127);
+    for (; i + 16 <= len; i += 16)
+    {
+        v_int32x4 q0 = v_round(v_load(src + i) * vinv);
+        v_int32x4 q1 = v_round(v_load(src + i + 4) * vinv);
+        v_int32x4 q2 = v_round(v_load(src + i + 8) * vinv);
+        v_int32x4 q3 = v_round(v_load(src + i + 12) * vinv);
+        v_int8x16 q = v_pack(v_pack(q0, q1), v_pack(q2, q3));
+        v_store(dst + i, v_max(q, vmin));
+    }
+#endif
+
+    for (; i < len; i++)
+        dst[i] = saturate_cast<schar>(std::max(cvRound(src[i] * invScale), -127));
+}
+
+void quantizeRowsInt8(const Mat &src, Mat &dst, Mat &scales)
+{
+    CV_Assert(src.dims == 2 && src.type() == CV_32F);
+
+    dst.create(src.rows, src.cols, CV_8S);
+    scales.create(src.rows, 1, CV_32F);
+
+    for (int i = 0; i < src.rows; i++)
+    {
+        double minVal, maxVal;
+        minMaxLoc(src.row(i), &minVal, &maxVal);
+        float scale = int8Scale((float)std::max(-minVal, maxVal));
+
+        scales.at<float>(i) = scale;
+        quantizeInt8(src.ptr<float>(i), dst.ptr<schar>(i), src.cols, scale);
+    }
+}
+
+//Every task computes a block of rows of A against all rows of B,
+//the inner step multiplies MR rows of A by two rows of B sharing the loaded vectors.
+class GemmInt8Invoker : public ParallelLoopBody
+{
+public:
+    enum { MR = 4, BLOCK_ROWS = 16 };
+
+    GemmInt8Invoker(const Mat &A_, const float* scalesA_, const Mat &B_, float scaleB_, const float* bias_,
+                    float* C_, size_t stepI_, size_t stepJ_)
+        : A(&A_), B(&B_), scalesA(scalesA_), scaleB(scaleB_), bias(bias_), C(C_), stepI(stepI_), stepJ(stepJ_)
+    {
+    }
+
+    void operator()(const Range &range) const
+    {
+        int M = A->rows, N = B->rows, K = A->cols;
+        int i0 = range.start*BLOCK_ROWS, i1 = std::min(range.end*BLOCK_ROWS, M);
+
+        for (int i = i0; i < i1; i += MR)
+        {
+            int mr = std::min(i1 - i, (int)MR);
+            const schar* a[MR];
+            for (int r = 0; r < MR; r++)
+                a[r] = A->ptr<schar>(i + std::min(r, mr - 1));
+
+            for (int j = 0; j < N; j += 2)
+            {
+                int nr = std::min(N - j, 2);
+                const schar* b0 = B->ptr<schar>(j);
+                const schar* b1 = B->ptr<schar>(j + nr - 1);
+                int acc[MR][2];
+                int k = 0;
+
+#if CV_SIMD128
+                v_int32x4 s00 = v_setzero_s32(), s01 = v_setzero_s32();
+                v_int32x4 s10 = v_setzero_s32(), s11 = v_setzero_s32();
+                v_int32x4 s20 = v_setzero_s32(), s21 = v_setzero_s32();
+                v_int32x4 s30 = v_setzero_s32(), s31 = v_setzero_s32();
+                for (; k + 8 <= K; k += 8)
+                {
+                    v_int16x8 vb0 = v_load_expand(b0 + k), vb1 = v_load_expand(b1 + k);
+                    v_int16x8 va = v_load_expand(a[0] + k);
+                    s00 += v_dotprod(va, vb0); s01 += v_dotprod(va, vb1);
+                    va = v_load_expand(a[1] + k);
+                    s10 += v_dotprod(va, vb0); s11 += v_dotprod(va, vb1);
+                    va = v_load_expand(a[2] + k);
+                    s20 += v_dotprod(va, vb0); s21 += v_dotprod(va, vb1);
+                    va = v_load_expand(a[3] + k);
+                    s30 += v_dotprod(va, vb0); s31 += v_dotprod(va, vb1);
+                }
+                acc[0][0] = v_reduce_sum(s00); acc[0][1] = v_reduce_sum(s01);
+                acc[1][0] = v_reduce_sum(s10); acc[1][1] = v_reduce_sum(s11);
+                acc[2][0] = v_reduce_sum(s20); acc[2][1] = v_reduce_sum(s21);
+                acc[3][0] = v_reduce_sum(s30); acc[3][1] = v_reduce_sum(s31);
+#else
+                for (int r = 0; r < MR; r++)
+                    acc[r][0] = acc[r][1] = 0;
+#endif
+
+                for (; k < K; k++)
+                {
+                    for (int r = 0; r < MR; r++)
+                    {
+                        acc[r][0] += a[r][k]*b0[k];
+                        acc[r][1] += a[r][k]*b1[k];
+                    }
+                }
+
+                for (int r = 0; r < mr; r++)
+                {
+                    float scale = scalesA[i + r]*scaleB, shift = bias ? bias[i + r] : 0.f;
+                    for (int c = 0; c < nr; c++)
+                        C[(i + r)*stepI + (j + c)*stepJ] = acc[r][c]*scale + shift;
+                }
+            }
+        }
+    }
+
+private:
+    const Mat *A, *B;
+    const float* scalesA;
+    float scaleB;
+    const float* bias;
+    float* C;
+    size_t stepI, stepJ;
+};
+
+void gemmInt8(const Mat &A, const float* scalesA, const Mat &B, float scaleB, const float* bias,
+              float* C, size_t stepI, size_t stepJ)
+{
+    CV_Assert(A.dims == 2 && B.dims == 2 && A.type() == CV_8S && B.type() == CV_8S && A.cols == B.cols);
+
+    int nblocks = (A.rows + GemmInt8Invoker::BLOCK_ROWS - 1) / GemmInt8Invoker::BLOCK_ROWS;
+    parallel_for_(Range(0, nblocks), GemmInt8Invoker(A, scalesA, B, scaleB, bias, C, stepI, stepJ), limitStripes());
+}
+
+}
+}
@@ -0,0 +1,68 @@
+/*M///////////////////////////////////////////////////////////////////////////////////////
+//
+//  IMPORTANT: READ BEFORE DOWNLOADING, COPYING, INSTALLING OR USING.
+//
+//  By downloading, copying, installing or using the software you agree to this license.
+//  If you do not agree to this license, do not download, install,
+//  copy or use the software.
+//
+//
+//                           License Agreement
+//                For Open Source Computer Vision Library
+//
+// Copyright (C) 2013, OpenCV Foundation, all rights reserved.
+// Third party copyrights are property of their respective owners.
+//
+// Redistribution and use in source and binary forms, with or without modification,
+// are permitted provided that the following conditions are met:
+//
+//   * Redistribution's of source code must retain the above copyright notice,
+//     this list of conditions and the following disclaimer.
+//
+//   * Redistribution's in binary form must reproduce the above copyright notice,
+//     this list of conditions and the following disclaimer in the documentation
+//     and/or other materials provided with the distribution.
+//
+//   * The name of the copyright holders may not be used to endorse or promote products
+//     derived from this software without specific prior written permission.
+//
+// This software is provided by the copyright holders and contributors "as is" and
+// any express or implied warranties, including, but not limited to, the implied
+// warranties of merchantability and fitness for a particular purpose are disclaimed.
+// In no event shall the Intel Corporation or contributors be liable for any direct,
+// indirect, incidental, special, exemplary, or consequential damages
+// (including, but not limited to, procurement of substitute goods or services;
+// loss of use, data, or profits; or business interruption) however caused
+// and on any theory of liability, whether in contract, strict liability,
+// or tort (including negligence or otherwise) arising in any way out of
+// the use of this software, even if advised of the possibility of such damage.
+//
+//M*/
+
+#ifndef __OPENCV_DNN_LAYERS_OP_QUANT_HPP__
+#define __OPENCV_DNN_LAYERS_OP_QUANT_HPP__
+#include "../precomp.hpp"
+
+namespace cv
+{
+namespace dnn
+{
+
+//Returns scale of symmetric 8-bit quantization of values within [-range, range].
+float int8Scale(float range);
+
+//Computes dst = saturate(round(src / scale)) clamped to [-127, 127].
+void quantizeInt8(const float* src, schar* dst, size_t len, float scale);
+
+//Quantizes each row of 2D float matrix with its own symmetric scale, scales are returned as rows x 1 float matrix.
+void quantizeRowsInt8(const Mat &src, Mat &dst, Mat &scales);
+
+//Computes C(i, j) = dot(A_i, B_j) * scalesA[i] * scaleB + bias[i] over rows of 8-bit matrices with int32 accumulation,
+//C(i, j) is stored at C[i*stepI + j*stepJ]. Bias is optional.
+void gemmInt8(const Mat &A, const float* scalesA, const Mat &B, float scaleB, const float* bias,
+              float* C, size_t stepI, size_t stepJ);
+
+}
+}
+
+#endif
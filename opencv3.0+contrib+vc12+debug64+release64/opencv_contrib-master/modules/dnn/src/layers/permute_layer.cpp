@@ -131,6 +131,9 @@ public:
     {
         if(!_needsPermute)
         {
+            outputs.resize(inputs.size());
+            for (size_t i = 0; i < inputs.size(); i++)
+                outputs[i] = *inputs[i];
             return;
         }
 
@@ -168,10 +171,7 @@ public:
         }
         else
         {
-            size_t i, j, count = _count, numAxes = _numAxes;
-            const size_t* newStride = &_newStride[0];
-            const size_t* oldStride = &_oldStride[0];
-            const size_t* order = &_order[0];
+            size_t i, count = _count, numAxes = _numAxes;
 
             for (k = 0; k < ninputs; k++)
             {
@@ -190,24 +190,54 @@ public:
                 CV_Assert(inp.isContinuous() && out.isContinuous());
                 CV_Assert(inp.type() == CV_32F && out.type() == CV_32F);
 
-                const float *srcData = inp.ptr<float>();
-                float *dstData = out.ptr<float>();
+                size_t rowSize = _newDimensionSize[numAxes - 1];
+                parallel_for_(Range(0, (int)(count / rowSize)), PermuteInvoker(*this, inp, out), limitStripes());
+            }
+        }
+    }
+
+    //every task copies a set of rows of the output, i.e. elements with the same indices except the last one
+    class PermuteInvoker : public ParallelLoopBody
+    {
+    public:
+        PermuteInvoker(const PermuteLayerImpl &layer_, const Mat &inp_, Mat &out_)
+            : layer(&layer_), inp(&inp_), out(&out_) {}
+
+        void operator()(const Range &range) const
+        {
+            size_t j, numAxes = layer->_numAxes;
+            const size_t* newStride = &layer->_newStride[0];
+            const size_t* oldStride = &layer->_oldStride[0];
+            const size_t* order = &layer->_order[0];
+            size_t rowSize = layer->_newDimensionSize[numAxes - 1];
+            size_t rowStep = oldStride[order[numAxes - 1]];
 
-                for (i = 0; i < count; ++i)
+            const float *srcData = inp->ptr<float>();
+            float *dstData = out->ptr<float>();
+
+            for (int row = range.start; row < range.end; ++row)
+            {
+                size_t oldPosition = 0;
+                size_t newPosition = row * rowSize;
+                float* dst = dstData + newPosition;
+
+                for (j = 0; j < numAxes - 1; ++j)
                 {
-                    size_t oldPosition = 0;
-                    size_t newPosition = i;
-
-                    for (j = 0; j < numAxes; ++j)
-                    {
-                        oldPosition += (newPosition / newStride[j]) * oldStride[order[j]];
-                        newPosition %= newStride[j];
-                    }
-                    dstData[i] = srcData[oldPosition];
+                    oldPosition += (newPosition / newStride[j]) * oldStride[order[j]];
+                    newPosition %= newStride[j];
                 }
+
+                const float* src = srcData + oldPosition;
+                for (size_t i = 0; i < rowSize; ++i)
+                    dst[i] = src[i*rowStep];
             }
         }
-    }
+
+    private:
+        const PermuteLayerImpl* layer;
+        const Mat* inp;
+        Mat* out;
+    };
 
     size_t _count;
     std::vector<size_t> _order;
@@ -109,6 +109,15 @@ public:
         }
     }
 
+    int64 getFLOPS(const std::vector<Mat*> &, const std::vector<Mat> &outputs) const
+    {
+        //one comparison or addition per kernel element, average pooling divides once per output
+        int64 flops = 0;
+        for (size_t i = 0; i < outputs.size(); i++)
+            flops += (int64)outputs[i].total() * (kernel.area() + (type == AVE ? 1 : 0));
+        return flops;
+    }
+
     void forward(std::vector<Mat*> &inputs, std::vector<Mat> &outputs)
     {
         for (size_t ii = 0; ii < inputs.size(); ii++)
@@ -128,82 +137,110 @@ public:
         }
     }
 
+    //planes of all samples are pooled independently
+    class PoolingInvoker : public ParallelLoopBody
+    {
+    public:
+        PoolingInvoker(const PoolingLayerImpl &layer_, const Mat &src_, Mat &dst_, Mat *mask_)
+            : layer(&layer_), src(&src_), dst(&dst_), mask(mask_) {}
+
+        void operator()(const Range &range) const
+        {
+            if (mask)
+                layer->maxPooling(*src, *dst, *mask, range);
+            else
+                layer->avePooling(*src, *dst, range);
+        }
+
+    private:
+        const PoolingLayerImpl* layer;
+        const Mat* src;
+        Mat *dst, *mask;
+    };
+
     void maxPooling(Mat &src, Mat &dst, Mat &mask)
     {
         CV_DbgAssert(dst.size[2] == out.height && dst.size[3] == out.width);
+        parallel_for_(Range(0, src.size[0]*src.size[1]), PoolingInvoker(*this, src, dst, &mask), limitStripes());
+    }
 
-        for (int n = 0; n < src.size[0]; ++n)
+    void avePooling(Mat &src, Mat &dst)
+    {
+        parallel_for_(Range(0, src.size[0]*src.size[1]), PoolingInvoker(*this, src, dst, 0), limitStripes());
+    }
+
+    void maxPooling(const Mat &src, Mat &dst, Mat &mask, const Range &planes) const
+    {
+        int channels = src.size[1];
+        for (int p = planes.start; p < planes.end; ++p)
         {
-            for (int c = 0; c < src.size[1]; ++c)
-            {
-                const float *srcData = src.ptr<float>(n, c);
-                float *dstData = dst.ptr<float>(n, c);
-                float *dstMaskData = mask.ptr<float>(n, c);
+            int n = p / channels, c = p % channels;
+            const float *srcData = src.ptr<float>(n, c);
+            float *dstData = dst.ptr<float>(n, c);
+            float *dstMaskData = mask.ptr<float>(n, c);
 
-                for (int ph = 0; ph < out.height; ++ph)
+            for (int ph = 0; ph < out.height; ++ph)
+            {
+                for (int pw = 0; pw < out.width; ++pw)
                 {
-                    for (int pw = 0; pw < out.width; ++pw)
-                    {
-                        int hstart = ph * stride.height - pad.height;
-                        int wstart = pw * stride.width - pad.width;
-                        int hend = min(hstart + kernel.height, inp.height);
-                        int wend = min(wstart + kernel.width, inp.width);
-                        hstart = max(hstart, 0);
-                        wstart = max(wstart, 0);
-                        const int poolIndex = ph * out.width + pw;
-                        float max_val = -FLT_MAX;
-                        int max_index = -1;
-
-                        for (int h = hstart; h < hend; ++h)
-                            for (int w = wstart; w < wend; ++w)
+                    int hstart = ph * stride.height - pad.height;
+                    int wstart = pw * stride.width - pad.width;
+                    int hend = min(hstart + kernel.height, inp.height);
+                    int wend = min(wstart + kernel.width, inp.width);
+                    hstart = max(hstart, 0);
+                    wstart = max(wstart, 0);
+                    const int poolIndex = ph * out.width + pw;
+                    float max_val = -FLT_MAX;
+                    int max_index = -1;
+
+                    for (int h = hstart; h < hend; ++h)
+                        for (int w = wstart; w < wend; ++w)
+                        {
+                            const int index = h * inp.width + w;
+                            if (srcData[index] > max_val)
                             {
-                                const int index = h * inp.width + w;
-                                if (srcData[index] > max_val)
-                                {
-                                    max_val = srcData[index];
-                                    max_index = index;
-                                }
+                                max_val = srcData[index];
+                                max_index = index;
                             }
+                        }
 
-                        dstData[poolIndex] = max_val;
-                        dstMaskData[poolIndex] = max_index;
-                    }
+                    dstData[poolIndex] = max_val;
+                    dstMaskData[poolIndex] = max_index;
                 }
             }
         }
     }
 
-    void avePooling(Mat &src, Mat &dst)
+    void avePooling(const Mat &src, Mat &dst, const Range &planes) const
     {
-        for (int n = 0; n < src.size[0]; ++n)
+        int channels = src.size[1];
+        for (int p = planes.start; p < planes.end; ++p)
         {
-            for (int c = 0; c < src.size[1]; ++c)
-            {
-                const float *srcData = src.ptr<float>(n, c);
-                float *dstData = dst.ptr<float>(n, c);
+            int n = p / channels, c = p % channels;
+            const float *srcData = src.ptr<float>(n, c);
+            float *dstData = dst.ptr<float>(n, c);
 
-                for (int ph = 0; ph < out.height; ++ph)
+            for (int ph = 0; ph < out.height; ++ph)
+            {
+                for (int pw = 0; pw < out.width; ++pw)
                 {
-                    for (int pw = 0; pw < out.width; ++pw)
-                    {
-                        int hstart = ph * stride.height - pad.height;
-                        int wstart = pw * stride.width - pad.width;
-                        int hend = min(hstart + kernel.height, inp.height + pad.height);
-                        int wend = min(wstart + kernel.width, inp.width + pad.width);
-                        int poolSize = (hend - hstart) * (wend - wstart);
-                        hstart = max(hstart, 0);
-                        wstart = max(wstart, 0);
-                        hend = min(hend, inp.height);
-                        wend = min(wend, inp.width);
-
-                        dstData[ph * out.width + pw] = 0.f;
-
-                        for (int h = hstart; h < hend; ++h)
-                            for (int w = wstart; w < wend; ++w)
-                                dstData[ph * out.width + pw] += srcData[h * inp.width + w];
-
-                        dstData[ph * out.width + pw] /= poolSize;
-                    }
+                    int hstart = ph * stride.height - pad.height;
+                    int wstart = pw * stride.width - pad.width;
+                    int hend = min(hstart + kernel.height, inp.height + pad.height);
+                    int wend = min(wstart + kernel.width, inp.width + pad.width);
+                    int poolSize = (hend - hstart) * (wend - wstart);
+                    hstart = max(hstart, 0);
+                    wstart = max(wstart, 0);
+                    hend = min(hend, inp.height);
+                    wend = min(wend, inp.width);
+
+                    dstData[ph * out.width + pw] = 0.f;
+
+                    for (int h = hstart; h < hend; ++h)
+                        for (int w = wstart; w < wend; ++w)
+                            dstData[ph * out.width + pw] += srcData[h * inp.width + w];
+
+                    dstData[ph * out.width + pw] /= poolSize;
                 }
             }
         }
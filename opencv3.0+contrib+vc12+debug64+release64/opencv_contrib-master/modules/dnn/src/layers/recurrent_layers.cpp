@@ -41,6 +41,7 @@
 
 #include "../precomp.hpp"
 #include "op_blas.hpp"
+#include "opencv2/core/hal/intrin.hpp"
 #include <iostream>
 #include <iterator>
 #include <cmath>
@@ -51,40 +52,99 @@ namespace cv
 namespace dnn
 {
 
-template<typename Dtype>
-static void tanh(const Mat &src, Mat &dst)
+#if CV_SIMD128
+//exp(x) by reduction x = n*ln(2) + r, |r| <= ln(2)/2, and a polynomial approximation of exp(r),
+//relative error is below 1e-6 over the whole range of float
+static inline v_float32x4 v_exp_approx(const v_float32x4 &x_)
 {
-    MatConstIterator_<Dtype> itSrc = src.begin<Dtype>();
-    MatIterator_<Dtype> itDst = dst.begin<Dtype>();
+    v_float32x4 x = v_min(v_max(x_, v_setall_f32(-87.3f)), v_setall_f32(88.3f));
+    v_int32x4 n = v_round(x * v_setall_f32(1.44269504088896341f));
+    v_float32x4 fn = v_cvt_f32(n);
+    x = v_muladd(fn, v_setall_f32(-0.693359375f), x);
+    x = v_muladd(fn, v_setall_f32(2.12194440e-4f), x);
+
+    v_float32x4 p = v_setall_f32(1.9875691500E-4f);
+    p = v_muladd(p, x, v_setall_f32(1.3981999507E-3f));
+    p = v_muladd(p, x, v_setall_f32(8.3334519073E-3f));
+    p = v_muladd(p, x, v_setall_f32(4.1665795894E-2f));
+    p = v_muladd(p, x, v_setall_f32(1.6666665459E-1f));
+    p = v_muladd(p, x, v_setall_f32(5.0000001201E-1f));
+    p = v_muladd(p, x*x, x + v_setall_f32(1.f));
+
+    v_float32x4 pow2n = v_reinterpret_as_f32((n + v_setall_s32(127)) << 23);
+    return p * pow2n;
+}
 
-    for (; itSrc != src.end<Dtype>(); itSrc++, itDst++)
-        *itDst = std::tanh(*itSrc);
+static inline v_float32x4 v_sigmoid(const v_float32x4 &x)
+{
+    v_float32x4 one = v_setall_f32(1.f);
+    return one / (one + v_exp_approx(v_setzero_f32() - x));
+}
+
+static inline v_float32x4 v_tanh(const v_float32x4 &x)
+{
+    //tanh(x) = 2 / (1 + exp(-2x)) - 1
+    v_float32x4 one = v_setall_f32(1.f);
+    v_float32x4 e = v_exp_approx(x * v_setall_f32(-2.f));
+    return v_setall_f32(2.f) / (one + e) - one;
 }
+#endif
 
-//TODO: make utils method
-static void tanh(const Mat &src, Mat &dst)
+static inline float sigmoid(float x)
 {
-    dst.create(src.dims, (const int*)src.size, src.type());
-
-    if (src.type() == CV_32F)
-        tanh<float>(src, dst);
-    else if (src.type() == CV_64F)
-        tanh<double>(src, dst);
-    else
-        CV_Error(Error::StsUnsupportedFormat, "Function supports only floating point types");
+    return 1.f / (1.f + std::exp(-x));
 }
 
-static void sigmoid(const Mat &src, Mat &dst)
+static void tanh(const float* src, float* dst, int len)
 {
-    cv::exp(-src, dst);
-    cv::pow(1 + dst, -1, dst);
+    int i = 0;
+#if CV_SIMD128
+    for (; i <= len - 4; i += 4)
+        v_store(dst + i, v_tanh(v_load(src + i)));
+#endif
+    for (; i < len; i++)
+        dst[i] = std::tanh(src[i]);
+}
+
+//computes c_t and h_t of one sample from the gate preactivations laid out as [i, f, o, g]
+static void lstmCell(const float* gates, float* c, float* h, int n)
+{
+    const float *gateI = gates, *gateF = gates + n, *gateO = gates + 2*n, *gateG = gates + 3*n;
+    int j = 0;
+#if CV_SIMD128
+    for (; j <= n - 4; j += 4)
+    {
+        v_float32x4 i = v_sigmoid(v_load(gateI + j));
+        v_float32x4 f = v_sigmoid(v_load(gateF + j));
+        v_float32x4 o = v_sigmoid(v_load(gateO + j));
+        v_float32x4 g = v_tanh(v_load(gateG + j));
+        v_float32x4 cj = v_muladd(f, v_load(c + j), i * g);  // c_t = f_t (*) c_{t-1} + i_t (*) g_t
+        v_store(c + j, cj);
+        v_store(h + j, o * v_tanh(cj));                       // h_t = o_t (*) tanh(c_t)
+    }
+#endif
+    for (; j < n; j++)
+    {
+        float cj = sigmoid(gateF[j]) * c[j] + sigmoid(gateI[j]) * std::tanh(gateG[j]);
+        c[j] = cj;
+        h[j] = sigmoid(gateO[j]) * std::tanh(cj);
+    }
+}
+
+//initializes every row of dst with the bias row
+static void fillRows(Mat &dst, const Mat &bias)
+{
+    Mat b = bias.reshape(1, 1);
+    for (int i = 0; i < dst.rows; i++)
+        b.copyTo(dst.row(i));
 }
 
 class LSTMLayerImpl : public LSTMLayer
 {
     int numOut, numTimeStamps, numSamples, numInp;
     Mat hInternal, cInternal;
-    Mat gates, dummyOnes;
+    Mat gates;  //preactivations of the gates of all timestamps
+    PackedGemmMatrix packedWh, packedWx;
     bool allocated;
 
     std::vector<int> outTailShape;                 //shape of single output sample
@@ -248,52 +308,43 @@ public:
             cInternal = cInternal.reshape(1, outTsMatShape);
         }
 
-        gates.create(numSamples, 4*numOut, dtype);
+        gates.create(numTimeStamps*numSamples, 4*numOut, dtype);
 
-        dummyOnes.create(numSamples, 1, dtype);
-        dummyOnes.setTo(1.);
+        //weights are reused on every forward pass and Wh on every timestamp,
+        //so they are packed for the GEMM kernel beforehand
+        packedWh.pack(Wh, false, true);
+        packedWx.pack(Wx, false, true);
 
         allocated = true;
     }
 
-    void forward(std::vector<Mat*> &input, std::vector<Mat> &output)
+    int64 getFLOPS(const std::vector<Mat*> &, const std::vector<Mat> &) const
     {
-        const Mat &Wh = blobs[0];
-        const Mat &Wx = blobs[1];
-        const Mat &bias = blobs[2];
+        //two GEMMs for the gates and about 10 operations per cell for the activations and the cell update
+        int64 steps = (int64)numTimeStamps * numSamples;
+        return steps * (2 * 4 * numOut * (int64)(numInp + numOut) + 10 * numOut);
+    }
 
+    void forward(std::vector<Mat*> &input, std::vector<Mat> &output)
+    {
         int numSamplesTotal = numTimeStamps*numSamples;
         Mat xTs = input[0]->reshape(1, numSamplesTotal);
 
         Mat hOutTs = output[0].reshape(1, numSamplesTotal);
         Mat cOutTs = produceCellOutput ? output[1].reshape(1, numSamplesTotal) : Mat();
 
+        //input projections don't depend on the state, so they are computed for all timestamps by one GEMM
+        fillRows(gates, blobs[2]);                  // b
+        dnn::gemm(xTs, packedWx, 1, gates, 1);      //+Wx * x_t
+
         for (int ts = 0; ts < numTimeStamps; ts++)
         {
             Range curRowRange(ts*numSamples, (ts + 1)*numSamples);
-            Mat xCurr = xTs.rowRange(curRowRange);
-
-            dnn::gemm(xCurr, Wx, 1, gates, 0, GEMM_2_T);      // Wx * x_t
-            dnn::gemm(hInternal, Wh, 1, gates, 1, GEMM_2_T);  //+Wh * h_{t-1}
-            dnn::gemm(dummyOnes, bias, 1, gates, 1);          //+b
+            Mat gatesCurr = gates.rowRange(curRowRange);
+            dnn::gemm(hInternal, packedWh, 1, gatesCurr, 1);  //+Wh * h_{t-1}
 
-            Mat getesIFO = gates.colRange(0, 3*numOut);
-            Mat gateI = gates.colRange(0*numOut, 1*numOut);
-            Mat gateF = gates.colRange(1*numOut, 2*numOut);
-            Mat gateO = gates.colRange(2*numOut, 3*numOut);
-            Mat gateG = gates.colRange(3*numOut, 4*numOut);
-
-            sigmoid(getesIFO, getesIFO);
-            tanh(gateG, gateG);
-
-            //compute c_t
-            multiply(gateF, cInternal, gateF);  // f_t (*) c_{t-1}
-            multiply(gateI, gateG, gateI);      // i_t (*) g_t
-            add(gateF, gateI, cInternal);       // c_t = f_t (*) c_{t-1} + i_t (*) g_t
-
-            //compute h_t
-            tanh(cInternal, hInternal);
-            multiply(gateO, hInternal, hInternal);
+            for (int i = 0; i < numSamples; i++)
+                lstmCell(gatesCurr.ptr<float>(i), cInternal.ptr<float>(i), hInternal.ptr<float>(i), numOut);
 
             //save results in output blobs
             hInternal.copyTo(hOutTs.rowRange(curRowRange));
@@ -332,7 +383,8 @@ class RNNLayerImpl : public RNNLayer
     int dtype;
     Mat Whh, Wxh, bh;
     Mat Who, bo;
-    Mat hCurr, hPrev, dummyBiasOnes;
+    Mat hPrev, hAll;
+    PackedGemmMatrix packedWhh, packedWxh, packedWho;
     bool produceH;
 
 public:
@@ -388,16 +440,19 @@ public:
         numSamples = inp0.size[1];
         numSamplesTotal = numTimestamps * numSamples;
 
-        hCurr.create(numSamples, numH, dtype);
         hPrev.create(numSamples, numH, dtype);
         hPrev.setTo(0.);
 
-        dummyBiasOnes.create(numSamples, 1, dtype);
-        dummyBiasOnes.setTo(1.);
         bh = bh.reshape(1, 1); //is 1 x numH Mat
         bo = bo.reshape(1, 1); //is 1 x numO Mat
 
+        packedWhh.pack(Whh, false, true);
+        packedWxh.pack(Wxh, false, true);
+        packedWho.pack(Who, false, true);
+
         reshapeOutput(output);
+        if (!produceH)
+            hAll.create(numSamplesTotal, numH, dtype);
     }
 
     void reshapeOutput(std::vector<Mat> &output)
@@ -412,30 +467,36 @@ public:
         }
     }
 
+    int64 getFLOPS(const std::vector<Mat*> &, const std::vector<Mat> &) const
+    {
+        int64 steps = (int64)numTimestamps * numSamples;
+        return steps * (2 * numH * (int64)(numX + numH) + 2 * numO * (int64)numH + 2 * (numH + numO));
+    }
+
     void forward(std::vector<Mat*> &input, std::vector<Mat> &output)
     {
         Mat xTs = input[0]->reshape(1, numSamplesTotal);
         Mat oTs = output[0].reshape(1, numSamplesTotal);
-        Mat hTs = produceH ? output[1].reshape(1, numSamplesTotal) : Mat();
+        Mat hTs = produceH ? output[1].reshape(1, numSamplesTotal) : hAll;
+
+        //only the recurrent term depends on the previous timestamp, input and output projections
+        //of all timestamps are computed by single GEMMs
+        fillRows(hTs, bh);                         // b_h
+        dnn::gemm(xTs, packedWxh, 1, hTs, 1);      //+W_{xh} * x_{curr}
 
         for (int ts = 0; ts < numTimestamps; ts++)
         {
-            Range curRowRange = Range(ts * numSamples, (ts + 1) * numSamples);
-            Mat xCurr = xTs.rowRange(curRowRange);
-
-            dnn::gemm(hPrev, Whh, 1, hCurr, 0, GEMM_2_T); // W_{hh} * h_{prev}
-            dnn::gemm(xCurr, Wxh, 1, hCurr, 1, GEMM_2_T); //+W_{xh} * x_{curr}
-            dnn::gemm(dummyBiasOnes, bh, 1, hCurr, 1);    //+bh
-            tanh(hCurr, hPrev);
-
-            Mat oCurr = oTs.rowRange(curRowRange);
-            dnn::gemm(hPrev, Who, 1, oCurr, 0, GEMM_2_T); // W_{ho} * h_{prev}
-            dnn::gemm(dummyBiasOnes, bo, 1, oCurr, 1);    //+b_o
-            tanh(oCurr, oCurr);
-
-            if (produceH)
-                hPrev.copyTo(hTs.rowRange(curRowRange));
+            Mat hCurr = hTs.rowRange(ts * numSamples, (ts + 1) * numSamples);
+            Mat hLast = ts == 0 ? hPrev : hTs.rowRange((ts - 1) * numSamples, ts * numSamples);
+            dnn::gemm(hLast, packedWhh, 1, hCurr, 1);  //+W_{hh} * h_{prev}
+            CV_Assert(hCurr.isContinuous());
+            tanh(hCurr.ptr<float>(), hCurr.ptr<float>(), (int)hCurr.total());
         }
+        hTs.rowRange((numTimestamps - 1) * numSamples, numSamplesTotal).copyTo(hPrev);
+
+        fillRows(oTs, bo);                         // b_o
+        dnn::gemm(hTs, packedWho, 1, oTs, 1);      //+W_{ho} * h_{curr}
+        tanh(oTs.ptr<float>(), oTs.ptr<float>(), (int)oTs.total());
     }
 };
 
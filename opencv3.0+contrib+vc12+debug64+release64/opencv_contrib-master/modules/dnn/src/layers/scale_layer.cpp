@@ -39,6 +39,28 @@ public:
         }
     }
 
+    bool supportInPlace() const
+    {
+        return true;
+    }
+
+    void getScaleShift(Mat &scale, Mat &shift) const
+    {
+        scale = blobs[0].reshape(1, (int)blobs[0].total());
+        if (hasBias)
+            shift = blobs[1].reshape(1, (int)blobs[1].total());
+        else
+            shift = Mat::zeros(scale.rows, 1, CV_32F);
+    }
+
+    int64 getFLOPS(const std::vector<Mat*> &inputs, const std::vector<Mat> &) const
+    {
+        int64 flops = 0;
+        for (size_t i = 0; i < inputs.size(); i++)
+            flops += (hasBias ? 2 : 1) * (int64)inputs[i]->total();
+        return flops;
+    }
+
     void forward(std::vector<Mat*> &inputs, std::vector<Mat> &outputs)
     {
         for (size_t ii = 0; ii < outputs.size(); ii++)
@@ -41,6 +41,7 @@
 
 #include "../precomp.hpp"
 #include "layers_common.hpp"
+#include "opencv2/core/hal/hal.hpp"
 #include <algorithm>
 #include <stdlib.h>
 using std::max;
@@ -79,6 +80,12 @@ public:
         outputs[0].create(inp0.dims, inp0.size.p, inp0.type());
     }
 
+    int64 getFLOPS(const std::vector<Mat*> &inputs, const std::vector<Mat> &) const
+    {
+        //max, subtraction, exp, sum and division per element
+        return 5 * (int64)inputs[0]->total();
+    }
+
     void forward(std::vector<Mat*> &inputs, std::vector<Mat> &outputs)
     {
         const Mat &src = *inputs[0];
@@ -87,66 +94,94 @@ public:
         CV_Assert(src.type() == CV_32F);
         CV_Assert(src.isContinuous() && dst.isContinuous());
 
-        const float *srcPtr = src.ptr<float>();
-        float *dstPtr = dst.ptr<float>();
-        float *bufPtr = buf.ptr<float>();
-
-        size_t outerStep = src.total(axis);
-        size_t cnStep = src.total(axis + 1);
-
-        //compute max along axis
-        for (size_t outerDim = 0; outerDim < outerSize; outerDim++)
-        {
-            size_t srcOffset = outerDim * outerStep;
-            size_t bufOffset = outerDim * cnStep;
-
-            memcpy(bufPtr + bufOffset, srcPtr + srcOffset, innerSize * sizeof(float));
+        SoftmaxInvoker invoker(*this, src, dst, buf);
+        parallel_for_(Range(0, invoker.numTasks()), invoker, limitStripes());
+    }
 
-            for (size_t cnDim = 1; cnDim < channels; cnDim++)
-            {
-                for (size_t i = 0; i < innerSize; i++)
-                    bufPtr[bufOffset + i] = std::max(bufPtr[bufOffset + i], srcPtr[srcOffset + cnDim * cnStep + i]);
-            }
-        }
+    //every task computes softmax of a stripe of inner elements of one outer slice
+    class SoftmaxInvoker : public ParallelLoopBody
+    {
+    public:
+        enum { STRIPE_SIZE = 1024 };
 
-        //subtract max
-        for (size_t outerDim = 0; outerDim < outerSize; outerDim++)
+        SoftmaxInvoker(const SoftMaxLayerImpl &layer_, const Mat &src_, Mat &dst_, Mat &buf_)
+            : layer(&layer_), src(&src_), dst(&dst_), buf(&buf_)
         {
-            size_t srcOffset = outerDim * outerStep;
-            size_t bufOffset = outerDim * cnStep;
-
-            for (size_t cnDim = 0; cnDim < channels; cnDim++)
-            {
-                for (size_t i = 0; i < innerSize; i++)
-                    dstPtr[srcOffset + cnDim * cnStep + i] = srcPtr[srcOffset + cnDim * cnStep + i] - bufPtr[bufOffset + i];
-            }
+            nstripes = (int)((layer->innerSize + STRIPE_SIZE - 1) / STRIPE_SIZE);
         }
 
-        cv::exp(dst, dst);
+        int numTasks() const { return (int)layer->outerSize * nstripes; }
 
-        for (size_t outerDim = 0; outerDim < outerSize; outerDim++)
+        void operator()(const Range &range) const
         {
-            size_t srcOffset = outerDim * outerStep;
-            size_t bufOffset = outerDim * cnStep;
+            const float *srcPtr = src->ptr<float>();
+            float *dstPtr = dst->ptr<float>();
+            float *bufPtr = buf->ptr<float>();
 
-            //sum exp along axis
-            for (size_t i = 0; i < innerSize; i++)
-                bufPtr[bufOffset + i] = 0.f;
+            size_t channels = layer->channels, innerSize = layer->innerSize;
+            size_t cnStep = innerSize, outerStep = channels * innerSize;
 
-            for (size_t cnDim = 0; cnDim < channels; cnDim++)
+            for (int t = range.start; t < range.end; t++)
             {
-                for (size_t i = 0; i < innerSize; i++)
-                    bufPtr[bufOffset + i] += dstPtr[srcOffset + cnDim * cnStep + i];
-            }
-
-            //divide by computed sum
-            for (size_t cnDim = 0; cnDim < channels; cnDim++)
-            {
-                for (size_t i = 0; i < innerSize; i++)
-                    dstPtr[srcOffset + cnDim * cnStep + i] /= bufPtr[bufOffset + i];
+                size_t outerDim = t / nstripes;
+                size_t i0 = (t % nstripes) * STRIPE_SIZE, i1 = std::min(i0 + STRIPE_SIZE, innerSize);
+                size_t srcOffset = outerDim * outerStep + i0;
+                size_t bufOffset = outerDim * cnStep + i0;
+                size_t len = i1 - i0;
+
+                //compute max along axis
+                memcpy(bufPtr + bufOffset, srcPtr + srcOffset, len * sizeof(float));
+
+                for (size_t cnDim = 1; cnDim < channels; cnDim++)
+                {
+                    for (size_t i = 0; i < len; i++)
+                        bufPtr[bufOffset + i] = std::max(bufPtr[bufOffset + i], srcPtr[srcOffset + cnDim * cnStep + i]);
+                }
+
+                //subtract max
+                for (size_t cnDim = 0; cnDim < channels; cnDim++)
+                {
+                    for (size_t i = 0; i < len; i++)
+                        dstPtr[srcOffset + cnDim * cnStep + i] = srcPtr[srcOffset + cnDim * cnStep + i] - bufPtr[bufOffset + i];
+                }
+
+                //the whole slice is contiguous when it isn't split into stripes
+                if (nstripes == 1)
+                    hal::exp32f(dstPtr + srcOffset, dstPtr + srcOffset, (int)outerStep);
+                else
+                {
+                    for (size_t cnDim = 0; cnDim < channels; cnDim++)
+                        hal::exp32f(dstPtr + srcOffset + cnDim * cnStep, dstPtr + srcOffset + cnDim * cnStep, (int)len);
+                }
+
+                //sum exp along axis
+                for (size_t i = 0; i < len; i++)
+                    bufPtr[bufOffset + i] = 0.f;
+
+                for (size_t cnDim = 0; cnDim < channels; cnDim++)
+                {
+                    for (size_t i = 0; i < len; i++)
+                        bufPtr[bufOffset + i] += dstPtr[srcOffset + cnDim * cnStep + i];
+                }
+
+                //divide by computed sum
+                for (size_t i = 0; i < len; i++)
+                    bufPtr[bufOffset + i] = 1.f / bufPtr[bufOffset + i];
+
+                for (size_t cnDim = 0; cnDim < channels; cnDim++)
+                {
+                    for (size_t i = 0; i < len; i++)
+                        dstPtr[srcOffset + cnDim * cnStep + i] *= bufPtr[bufOffset + i];
+                }
             }
         }
-    }
+
+    private:
+        const SoftMaxLayerImpl* layer;
+        const Mat* src;
+        Mat *dst, *buf;
+        int nstripes;
+    };
 
     int axis, axisRaw;
     Mat buf;
@@ -0,0 +1,492 @@
+/*M///////////////////////////////////////////////////////////////////////////////////////
+//
+//  IMPORTANT: READ BEFORE DOWNLOADING, COPYING, INSTALLING OR USING.
+//
+//  By downloading, copying, installing or using the software you agree to this license.
+//  If you do not agree to this license, do not download, install,
+//  copy or use the software.
+//
+//
+//                           License Agreement
+//                For Open Source Computer Vision Library
+//
+// Copyright (C) 2013, OpenCV Foundation, all rights reserved.
+// Third party copyrights are property of their respective owners.
+//
+// Redistribution and use in source and binary forms, with or without modification,
+// are permitted provided that the following conditions are met:
+//
+//   * Redistribution's of source code must retain the above copyright notice,
+//     this list of conditions and the following disclaimer.
+//
+//   * Redistribution's in binary form must reproduce the above copyright notice,
+//     this list of conditions and the following disclaimer in the documentation
+//     and/or other materials provided with the distribution.
+//
+//   * The name of the copyright holders may not be used to endorse or promote products
+//     derived from this software without specific prior written permission.
+//
+// This software is provided by the copyright holders and contributors "as is" and
+// any express or implied warranties, including, but not limited to, the implied
+// warranties of merchantability and fitness for a particular purpose are disclaimed.
+// In no event shall the Intel Corporation or contributors be liable for any direct,
+// indirect, incidental, special, exemplary, or consequential damages
+// (including, but not limited to, procurement of substitute goods or services;
+// loss of use, data, or profits; or business interruption) however caused
+// and on any theory of liability, whether in contract, strict liability,
+// or tort (including negligence or otherwise) arising in any way out of
+// the use of this software, even if advised of the possibility of such damage.
+//
+//M*/
+
+#include "../precomp.hpp"
+#include "native_io.hpp"
+#include <fstream>
+#include <set>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace cv
+{
+namespace dnn
+{
+
+/*
+ * File layout (little-endian):
+ *   header   : magic "CVDNNBIN", uint32 version, uint32 reserved,
+ *              uint64 graph offset, uint64 graph size, uint64 weights offset, uint64 weights size
+ *   graph    : uint32 number of net inputs, strings
+ *              uint32 number of layers, then for every layer:
+ *                string name, string type,
+ *                uint32 number of params, for every param: string key, int32 type, uint32 count, values
+ *                uint32 number of blobs, for every blob: int32 type, int32 dims, int32 shape[dims], uint64 offset
+ *                uint32 number of inputs, for every input: int32 layer index, int32 output index
+ *   weights  : raw data of the blobs, each one aligned to NATIVE_ALIGNMENT bytes
+ * Strings are stored as uint32 length followed by the characters.
+ */
+
+static const char nativeMagic[8] = { 'C', 'V', 'D', 'N', 'N', 'B', 'I', 'N' };
+static const unsigned nativeVersion = 1;
+
+struct NativeHeader
+{
+    char magic[8];
+    unsigned version;
+    unsigned reserved;
+    uint64 graphOffset, graphSize;
+    uint64 weightsOffset, weightsSize;
+};
+
+//Allocator of blobs which are headers over the mapped file. Every blob holds a reference
+//to the mapping, so the memory stays valid as long as any blob (or a copy of its header) is alive.
+class MappedFileAllocator : public MatAllocator
+{
+public:
+    UMatData* allocate(int dims, const int* sizes, int type, void* data, size_t* step,
+                       int flags, UMatUsageFlags usageFlags) const
+    {
+        return Mat::getStdAllocator()->allocate(dims, sizes, type, data, step, flags, usageFlags);
+    }
+
+    bool allocate(UMatData* u, int, UMatUsageFlags) const
+    {
+        return u->data != 0;
+    }
+
+    void deallocate(UMatData* u) const
+    {
+        CV_Assert(u->urefcount == 0 && u->refcount == 0);
+        delete (Ptr<MappedFile>*)u->userdata;
+        delete u;
+    }
+
+    Mat wrap(const Ptr<MappedFile> &file, int dims, const int* shape, int type, uchar* data) const
+    {
+        Mat m(dims, shape, type, data);
+        UMatData* u = new UMatData(this);
+        u->data = u->origdata = data;
+        u->size = m.total()*m.elemSize();
+        u->flags |= UMatData::USER_ALLOCATED;
+        u->userdata = new Ptr<MappedFile>(file);
+        u->refcount = 1;
+        m.u = u;
+        return m;
+    }
+};
+
+static MappedFileAllocator mappedFileAllocator;
+
+static inline uint64 alignOffset(uint64 offset)
+{
+    return (offset + NATIVE_ALIGNMENT - 1) & ~(uint64)(NATIVE_ALIGNMENT - 1);
+}
+
+class NativeWriter
+{
+public:
+    template<typename T>
+    void put(const T &v)
+    {
+        const uchar* p = (const uchar*)&v;
+        buf.insert(buf.end(), p, p + sizeof(T));
+    }
+
+    void putString(const String &s)
+    {
+        put((unsigned)s.size());
+        buf.insert(buf.end(), s.begin(), s.end());
+    }
+
+    std::vector<uchar> buf;
+};
+
+class NativeReader
+{
+public:
+    NativeReader(const uchar* begin, const uchar* end_) : ptr(begin), end(end_) {}
+
+    template<typename T>
+    T get()
+    {
+        require(sizeof(T));
+        T v;
+        memcpy(&v, ptr, sizeof(T));
+        ptr += sizeof(T);
+        return v;
+    }
+
+    String getString()
+    {
+        size_t len = get<unsigned>();
+        require(len);
+        String s((const char*)ptr, len);
+        ptr += len;
+        return s;
+    }
+
+    //checks that at least n items of the given size are left, so the counts read from
+    //the file can be used to allocate memory
+    void requireItems(size_t n, size_t itemSize)
+    {
+        if ((size_t)(end - ptr) / itemSize < n)
+            CV_Error(Error::StsParseError, "Native network file is truncated");
+    }
+
+private:
+    void require(size_t n)
+    {
+        if ((size_t)(end - ptr) < n)
+            CV_Error(Error::StsParseError, "Native network file is truncated");
+    }
+
+    const uchar* ptr;
+    const uchar* end;
+};
+
+static void writeParam(NativeWriter &w, const String &key, const DictValue &v)
+{
+    int n = v.size();
+    w.putString(key);
+    if (v.isInt())
+    {
+        w.put((int)Param::INT);
+        w.put((unsigned)n);
+        for (int i = 0; i < n; i++)
+            w.put(v.get<int64>(i));
+    }
+    else if (v.isReal())
+    {
+        w.put((int)Param::REAL);
+        w.put((unsigned)n);
+        for (int i = 0; i < n; i++)
+            w.put(v.get<double>(i));
+    }
+    else
+    {
+        CV_Assert(v.isString());
+        w.put((int)Param::STRING);
+        w.put((unsigned)n);
+        for (int i = 0; i < n; i++)
+            w.putString(v.get<String>(i));
+    }
+}
+
+static DictValue readParam(NativeReader &r)
+{
+    int type = r.get<int>();
+    unsigned count = r.get<unsigned>();
+    r.requireItems(count, type == Param::STRING ? sizeof(unsigned) : sizeof(int64));
+    int n = (int)count;
+    if (type == Param::INT)
+    {
+        std::vector<int64> vals(n);
+        for (int i = 0; i < n; i++)
+            vals[i] = r.get<int64>();
+        return DictValue::arrayInt(vals.begin(), n);
+    }
+    if (type == Param::REAL)
+    {
+        std::vector<double> vals(n);
+        for (int i = 0; i < n; i++)
+            vals[i] = r.get<double>();
+        return DictValue::arrayReal(vals.begin(), n);
+    }
+    if (type != Param::STRING)
+        CV_Error(Error::StsParseError, "Unknown type of layer parameter in native network file");
+    std::vector<String> vals(n);
+    for (int i = 0; i < n; i++)
+        vals[i] = r.getString();
+    return DictValue::arrayString(vals.begin(), n);
+}
+
+void writeNativeNet(const String &path, const std::vector<String> &netInputs,
+                    const std::vector<NativeLayer> &layers)
+{
+    NativeWriter w;
+    std::vector<Mat> blobs;
+    uint64 weightsSize = 0;
+
+    w.put((unsigned)netInputs.size());
+    for (size_t i = 0; i < netInputs.size(); i++)
+        w.putString(netInputs[i]);
+
+    w.put((unsigned)layers.size());
+    for (size_t i = 0; i < layers.size(); i++)
+    {
+        const NativeLayer &l = layers[i];
+        w.putString(l.name);
+        w.putString(l.type);
+
+        unsigned nparams = 0;
+        for (std::map<String, DictValue>::const_iterator it = l.params.begin(); it != l.params.end(); ++it)
+            nparams++;
+        w.put(nparams);
+        for (std::map<String, DictValue>::const_iterator it = l.params.begin(); it != l.params.end(); ++it)
+            writeParam(w, it->first, it->second);
+
+        w.put((unsigned)l.params.blobs.size());
+        for (size_t j = 0; j < l.params.blobs.size(); j++)
+        {
+            Mat blob = l.params.blobs[j];
+            if (!blob.isContinuous())
+                blob = blob.clone();
+            w.put(blob.type());
+            w.put(blob.dims);
+            for (int k = 0; k < blob.dims; k++)
+                w.put(blob.size[k]);
+            weightsSize = alignOffset(weightsSize);
+            w.put(weightsSize);
+            weightsSize += blob.total()*blob.elemSize();
+            blobs.push_back(blob);
+        }
+
+        w.put((unsigned)l.inputs.size());
+        for (size_t j = 0; j < l.inputs.size(); j++)
+        {
+            w.put(l.inputs[j].first);
+            w.put(l.inputs[j].second);
+        }
+    }
+
+    NativeHeader hdr;
+    memset(&hdr, 0, sizeof(hdr));
+    memcpy(hdr.magic, nativeMagic, sizeof(nativeMagic));
+    hdr.version = nativeVersion;
+    hdr.graphOffset = alignOffset(sizeof(hdr));
+    hdr.graphSize = w.buf.size();
+    hdr.weightsOffset = alignOffset(hdr.graphOffset + hdr.graphSize);
+    hdr.weightsSize = weightsSize;
+
+    std::ofstream fs(path.c_str(), std::ios::binary);
+    if (!fs.is_open())
+        CV_Error(Error::StsError, "Can't open \"" + path + "\" for writing");
+
+    static const char zeros[NATIVE_ALIGNMENT] = { 0 };
+    fs.write((const char*)&hdr, sizeof(hdr));
+    fs.write(zeros, (std::streamsize)(hdr.graphOffset - sizeof(hdr)));
+    if (!w.buf.empty())
+        fs.write((const char*)&w.buf[0], (std::streamsize)w.buf.size());
+    fs.write(zeros, (std::streamsize)(hdr.weightsOffset - hdr.graphOffset - hdr.graphSize));
+    uint64 pos = 0;
+    for (size_t i = 0; i < blobs.size(); i++)
+    {
+        uint64 start = alignOffset(pos);
+        fs.write(zeros, (std::streamsize)(start - pos));
+        size_t sz = blobs[i].total()*blobs[i].elemSize();
+        fs.write((const char*)blobs[i].data, (std::streamsize)sz);
+        pos = start + sz;
+    }
+
+    if (!fs)
+        CV_Error(Error::StsError, "Failed to write \"" + path + "\"");
+}
+
+void readNativeNet(const String &path, std::vector<String> &netInputs,
+                   std::vector<NativeLayer> &layers)
+{
+    Ptr<MappedFile> file = MappedFile::open(path);
+    const uchar* base = file->data();
+    size_t fileSize = file->size();
+
+    NativeHeader hdr;
+    if (fileSize < sizeof(hdr))
+        CV_Error(Error::StsParseError, "\"" + path + "\" is not a native network file");
+    memcpy(&hdr, base, sizeof(hdr));
+    if (memcmp(hdr.magic, nativeMagic, sizeof(nativeMagic)) != 0)
+        CV_Error(Error::StsParseError, "\"" + path + "\" is not a native network file");
+    if (hdr.version != nativeVersion)
+        CV_Error(Error::StsNotImplemented, "Unsupported version of native network file \"" + path + "\"");
+    //offsets and sizes are compared by subtraction, so large values can't overflow the checks
+    if (hdr.graphOffset > fileSize || hdr.graphSize > fileSize - hdr.graphOffset ||
+        hdr.weightsOffset > fileSize || hdr.weightsSize > fileSize - hdr.weightsOffset ||
+        hdr.weightsOffset % NATIVE_ALIGNMENT != 0)
+        CV_Error(Error::StsParseError, "Native network file \"" + path + "\" is corrupted");
+
+    NativeReader r(base + hdr.graphOffset, base + hdr.graphOffset + hdr.graphSize);
+    uchar* weights = (uchar*)base + hdr.weightsOffset;
+
+    unsigned count = r.get<unsigned>();
+    r.requireItems(count, sizeof(unsigned));
+    netInputs.resize(count);
+    for (size_t i = 0; i < netInputs.size(); i++)
+        netInputs[i] = r.getString();
+
+    count = r.get<unsigned>();
+    r.requireItems(count, 3*sizeof(unsigned));
+    layers.resize(count);
+    for (size_t i = 0; i < layers.size(); i++)
+    {
+        NativeLayer &l = layers[i];
+        l.name = r.getString();
+        l.type = r.getString();
+
+        unsigned nparams = r.get<unsigned>();
+        for (unsigned j = 0; j < nparams; j++)
+        {
+            String key = r.getString();
+            l.params.set(key, readParam(r));
+        }
+
+        count = r.get<unsigned>();
+        r.requireItems(count, 2*sizeof(int) + sizeof(uint64));
+        l.params.blobs.resize(count);
+        for (size_t j = 0; j < l.params.blobs.size(); j++)
+        {
+            int type = r.get<int>();
+            int dims = r.get<int>();
+            if (type != CV_MAT_TYPE(type) || dims <= 0 || dims > 32)
+                CV_Error(Error::StsParseError, "Native network file \"" + path + "\" is corrupted");
+
+            //the blob must fit into the weights section, the size is accumulated without overflow
+            uint64 bytes = CV_ELEM_SIZE(type);
+            std::vector<int> shape(dims);
+            for (int k = 0; k < dims; k++)
+            {
+                shape[k] = r.get<int>();
+                if (shape[k] < 0 || (shape[k] > 0 && bytes > hdr.weightsSize / (uint64)shape[k]))
+                    CV_Error(Error::StsParseError, "Native network file \"" + path + "\" is corrupted");
+                bytes *= shape[k];
+            }
+            uint64 offset = r.get<uint64>();
+            if (offset > hdr.weightsSize || bytes > hdr.weightsSize - offset || offset % NATIVE_ALIGNMENT != 0)
+                CV_Error(Error::StsParseError, "Native network file \"" + path + "\" is corrupted");
+            l.params.blobs[j] = mappedFileAllocator.wrap(file, dims, &shape[0], type, weights + offset);
+        }
+
+        count = r.get<unsigned>();
+        r.requireItems(count, 2*sizeof(int));
+        l.inputs.resize(count);
+        for (size_t j = 0; j < l.inputs.size(); j++)
+        {
+            l.inputs[j].first = r.get<int>();
+            l.inputs[j].second = r.get<int>();
+            if (l.inputs[j].first < 0 || l.inputs[j].first > (int)i || l.inputs[j].second < 0)
+                CV_Error(Error::StsParseError, "Native network file \"" + path + "\" is corrupted");
+        }
+    }
+
+    //a layer gets as many output blobs as distinct outputs are consumed (the input layer at least
+    //one per net input), so every consumed output index must be below that count
+    std::vector<std::set<int> > consumed(layers.size() + 1);
+    for (size_t i = 0; i < layers.size(); i++)
+        for (size_t j = 0; j < layers[i].inputs.size(); j++)
+            consumed[layers[i].inputs[j].first].insert(layers[i].inputs[j].second);
+    for (size_t i = 0; i < consumed.size(); i++)
+    {
+        size_t numOutputs = std::max(consumed[i].size(), i == 0 ? netInputs.size() : (size_t)0);
+        if (!consumed[i].empty() && (size_t)*consumed[i].rbegin() >= numOutputs)
+            CV_Error(Error::StsParseError, "Native network file \"" + path + "\" is corrupted");
+    }
+}
+
+MappedFile::MappedFile() : ptr(0), len(0)
+{
+#ifdef _WIN32
+    fileHandle = mappingHandle = 0;
+#endif
+}
+
+MappedFile::~MappedFile()
+{
+#ifdef _WIN32
+    if (ptr)
+        UnmapViewOfFile(ptr);
+    if (mappingHandle)
+        CloseHandle((HANDLE)mappingHandle);
+    if (fileHandle && fileHandle != INVALID_HANDLE_VALUE)
+        CloseHandle((HANDLE)fileHandle);
+#else
+    if (ptr)
+        munmap(ptr, len);
+#endif
+}
+
+Ptr<MappedFile> MappedFile::open(const String &path)
+{
+    Ptr<MappedFile> file(new MappedFile());
+#ifdef _WIN32
+    HANDLE fh = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING,
+                            FILE_ATTRIBUTE_NORMAL, NULL);
+    file->fileHandle = fh;
+    if (fh == INVALID_HANDLE_VALUE)
+        CV_Error(Error::StsError, "Can't open \"" + path + "\"");
+    LARGE_INTEGER sz;
+    if (!GetFileSizeEx(fh, &sz) || sz.QuadPart == 0)
+        CV_Error(Error::StsError, "Can't map empty file \"" + path + "\"");
+    file->len = (size_t)sz.QuadPart;
+    file->mappingHandle = CreateFileMappingA(fh, NULL, PAGE_WRITECOPY, 0, 0, NULL);
+    if (!file->mappingHandle)
+        CV_Error(Error::StsError, "Can't map \"" + path + "\"");
+    file->ptr = (uchar*)MapViewOfFile((HANDLE)file->mappingHandle, FILE_MAP_COPY, 0, 0, 0);
+#else
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+        CV_Error(Error::StsError, "Can't open \"" + path + "\"");
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size == 0)
+    {
+        ::close(fd);
+        CV_Error(Error::StsError, "Can't map empty file \"" + path + "\"");
+    }
+    file->len = (size_t)st.st_size;
+    void* p = mmap(NULL, file->len, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    file->ptr = p == MAP_FAILED ? 0 : (uchar*)p;
+#endif
+    if (!file->ptr)
+        CV_Error(Error::StsError, "Can't map \"" + path + "\"");
+    return file;
+}
+
+}
+}
@@ -0,0 +1,98 @@
+/*M///////////////////////////////////////////////////////////////////////////////////////
+//
+//  IMPORTANT: READ BEFORE DOWNLOADING, COPYING, INSTALLING OR USING.
+//
+//  By downloading, copying, installing or using the software you agree to this license.
+//  If you do not agree to this license, do not download, install,
+//  copy or use the software.
+//
+//
+//                           License Agreement
+//                For Open Source Computer Vision Library
+//
+// Copyright (C) 2013, OpenCV Foundation, all rights reserved.
+// Third party copyrights are property of their respective owners.
+//
+// Redistribution and use in source and binary forms, with or without modification,
+// are permitted provided that the following conditions are met:
+//
+//   * Redistribution's of source code must retain the above copyright notice,
+//     this list of conditions and the following disclaimer.
+//
+//   * Redistribution's in binary form must reproduce the above copyright notice,
+//     this list of conditions and the following disclaimer in the documentation
+//     and/or other materials provided with the distribution.
+//
+//   * The name of the copyright holders may not be used to endorse or promote products
+//     derived from this software without specific prior written permission.
+//
+// This software is provided by the copyright holders and contributors "as is" and
+// any express or implied warranties, including, but not limited to, the implied
+// warranties of merchantability and fitness for a particular purpose are disclaimed.
+// In no event shall the Intel Corporation or contributors be liable for any direct,
+// indirect, incidental, special, exemplary, or consequential damages
+// (including, but not limited to, procurement of substitute goods or services;
+// loss of use, data, or profits; or business interruption) however caused
+// and on any theory of liability, whether in contract, strict liability,
+// or tort (including negligence or otherwise) arising in any way out of
+// the use of this software, even if advised of the possibility of such damage.
+//
+//M*/
+
+#ifndef __OPENCV_DNN_NATIVE_IO_HPP__
+#define __OPENCV_DNN_NATIVE_IO_HPP__
+#include "../precomp.hpp"
+
+namespace cv
+{
+namespace dnn
+{
+
+//Read-only view of a file mapped into memory. Pages are mapped copy-on-write,
+//so layers may modify their weights in place without touching the file.
+class MappedFile
+{
+public:
+    static Ptr<MappedFile> open(const String &path);
+    ~MappedFile();
+
+    const uchar* data() const { return ptr; }
+    size_t size() const { return len; }
+
+private:
+    MappedFile();
+
+    uchar* ptr;
+    size_t len;
+#ifdef _WIN32
+    void* fileHandle;
+    void* mappingHandle;
+#endif
+};
+
+//Description of a single layer of the native format.
+//Inputs are (layer index, output index) pairs, layer index 0 refers to network inputs
+//and index i > 0 to the (i - 1)-th layer of the list.
+struct NativeLayer
+{
+    String name;
+    String type;
+    LayerParams params;
+    std::vector<std::pair<int, int> > inputs;
+};
+
+//Writes graph and weights into the file. Weights are stored as a separate section
+//with every blob aligned to NATIVE_ALIGNMENT bytes.
+void writeNativeNet(const String &path, const std::vector<String> &netInputs,
+                    const std::vector<NativeLayer> &layers);
+
+//Maps the file and parses the graph. Blobs of the returned layers are headers over
+//the mapped memory, each of them holds a reference to the mapping.
+void readNativeNet(const String &path, std::vector<String> &netInputs,
+                   std::vector<NativeLayer> &layers);
+
+enum { NATIVE_ALIGNMENT = 64 };
+
+}
+}
+#endif
@@ -43,3 +43,12 @@
 #include "cvconfig.h"
 #include <opencv2/dnn.hpp>
 #include <opencv2/dnn/all_layers.hpp>
+
+#ifndef __OPENCV_DNN_LIMIT_STRIPES__
+#define __OPENCV_DNN_LIMIT_STRIPES__
+namespace cv { namespace dnn {
+//caps the nstripes argument of parallel_for_ with the Net::setNumThreads() limit of the network
+//running on the calling thread, layers pass the result to all their parallel_for_ calls
+double limitStripes(double nstripes = -1.);
+}}
+#endif
@@ -85,4 +85,48 @@ TEST(Reproducibility_GoogLeNet, Accuracy)
     launchGoogleNetTest();
 }
 
+//compares 8-bit inference with the floating point reference
+TEST(Reproducibility_GoogLeNet, Int8)
+{
+    Net net;
+    {
+        const string proto = findDataFile("dnn/bvlc_googlenet.prototxt", false);
+        const string model = findDataFile("dnn/bvlc_googlenet.caffemodel", false);
+        Ptr<Importer> importer = createCaffeImporter(proto, model);
+        ASSERT_TRUE(importer != NULL);
+        importer->populateNet(net);
+    }
+
+    std::vector<Mat> inpMats;
+    inpMats.push_back( imread(_tf("googlenet_0.jpg")) );
+    inpMats.push_back( imread(_tf("googlenet_1.jpg")) );
+    ASSERT_TRUE(!inpMats[0].empty() && !inpMats[1].empty());
+    Mat inp = blobFromImages(inpMats, 1.);
+
+    net.calibrate(std::vector<Mat>(1, inp), ".data");
+    net.enableInt8();
+    net.setBlob(".data", inp);
+    net.forward();
+
+    Mat out = net.getBlob("prob");
+    Mat ref = blobFromNPY(_tf("googlenet_prob.npy"));
+    out = out.reshape(1, ref.size[0]);
+    ref = ref.reshape(1, ref.size[0]);
+
+    //per image the probabilities may move by 0.2 in total and by 0.05 at most,
+    //a wrong quantization scale flattens or sharpens the whole distribution
+    for (int i = 0; i < ref.rows; i++)
+    {
+        double normL1 = cvtest::norm(ref.row(i), out.row(i), NORM_L1);
+        double normInf = cvtest::norm(ref.row(i), out.row(i), NORM_INF);
+        EXPECT_LE(normL1, 0.2) << "image " << i;
+        EXPECT_LE(normInf, 0.05) << "image " << i;
+
+        Point refClass, outClass;
+        minMaxLoc(ref.row(i), 0, 0, 0, &refClass);
+        minMaxLoc(out.row(i), 0, 0, 0, &outClass);
+        EXPECT_EQ(refClass.x, outClass.x);
+    }
+}
+
 }
@@ -42,6 +42,8 @@
 #include "test_precomp.hpp"
 #include <opencv2/core/ocl.hpp>
 #include <iostream>
+#include <fstream>
+#include <iterator>
 #include "npy_blob.hpp"
 #include <opencv2/dnn/all_layers.hpp>
 #include <opencv2/ts/ocl_test.hpp>
@@ -204,6 +206,153 @@ TEST(Layer_Test_BatchNorm, Accuracy)
 //    );
 //}
 
+//straightforward convolution used as reference for the specialized kernels
+static void refConvolution(const Mat &inp, const Mat &weights, const Mat &bias, int group,
+                           int stride, int pad, int dilation, Mat &out)
+{
+    int numImg = inp.size[0], inpCn = inp.size[1], inpH = inp.size[2], inpW = inp.size[3];
+    int outCn = weights.size[0], kH = weights.size[2], kW = weights.size[3];
+    int outH = (inpH + 2*pad - (dilation*(kH - 1) + 1)) / stride + 1;
+    int outW = (inpW + 2*pad - (dilation*(kW - 1) + 1)) / stride + 1;
+    int inpGroupCn = inpCn / group, outGroupCn = outCn / group;
+
+    int sz[] = {numImg, outCn, outH, outW};
+    out.create(4, sz, CV_32F);
+
+    for (int n = 0; n < numImg; n++)
+        for (int k = 0; k < outCn; k++)
+            for (int oy = 0; oy < outH; oy++)
+                for (int ox = 0; ox < outW; ox++)
+                {
+                    int g = k / outGroupCn;
+                    double s = bias.empty() ? 0. : bias.at<float>(k);
+                    for (int c = 0; c < inpGroupCn; c++)
+                        for (int ky = 0; ky < kH; ky++)
+                            for (int kx = 0; kx < kW; kx++)
+                            {
+                                int iy = oy*stride - pad + ky*dilation, ix = ox*stride - pad + kx*dilation;
+                                if (iy < 0 || iy >= inpH || ix < 0 || ix >= inpW)
+                                    continue;
+                                int inpIdx[] = {n, g*inpGroupCn + c, iy, ix}, wIdx[] = {k, c, ky, kx};
+                                s += inp.at<float>(inpIdx) * weights.at<float>(wIdx);
+                            }
+                    int outIdx[] = {n, k, oy, ox};
+                    out.at<float>(outIdx) = (float)s;
+                }
+}
+
+typedef testing::TestWithParam<std::tr1::tuple<int, int, int, int, int, int, int> > Layer_Test_Convolution_Engines;
+TEST_P(Layer_Test_Convolution_Engines, Accuracy)
+{
+    int inpCn    = std::tr1::get<0>(GetParam());
+    int outCn    = std::tr1::get<1>(GetParam());
+    int ksz      = std::tr1::get<2>(GetParam());
+    int stride   = std::tr1::get<3>(GetParam());
+    int pad      = std::tr1::get<4>(GetParam());
+    int group    = std::tr1::get<5>(GetParam());
+    int dilation = std::tr1::get<6>(GetParam());
+
+    RNG rng(0);
+    int inpSz[] = {2, inpCn, 19, 22}, wSz[] = {outCn, inpCn / group, ksz, ksz};
+    Mat inp(4, inpSz, CV_32F), weights(4, wSz, CV_32F), bias(outCn, 1, CV_32F);
+    rng.fill(inp, RNG::UNIFORM, -1, 1);
+    rng.fill(weights, RNG::UNIFORM, -1, 1);
+    rng.fill(bias, RNG::UNIFORM, -1, 1);
+
+    LayerParams lp;
+    lp.set("num_output", outCn);
+    lp.set("group", group);
+    lp.set("kernel_size", ksz);
+    lp.set("stride", stride);
+    lp.set("pad", pad);
+    lp.set("dilation", dilation);
+    lp.blobs.push_back(weights);
+    lp.blobs.push_back(bias);
+
+    std::vector<Mat> inps(1, inp), outs;
+    runLayer(LayerFactory::createLayerInstance("Convolution", lp), inps, outs);
+
+    Mat ref;
+    refConvolution(inp, weights, bias, group, stride, pad, dilation, ref);
+    normAssert(ref, outs[0]);
+}
+
+INSTANTIATE_TEST_CASE_P(/**/, Layer_Test_Convolution_Engines, testing::Values(
+    //inpCn, outCn, kernel, stride, pad, group, dilation
+    std::tr1::make_tuple(16, 24, 3, 1, 1, 1, 1),  //Winograd F(4x4, 3x3)
+    std::tr1::make_tuple(16, 16, 3, 1, 0, 2, 1),  //Winograd, groups
+    std::tr1::make_tuple(16, 8, 1, 1, 0, 1, 1),   //1x1
+    std::tr1::make_tuple(8, 8, 3, 2, 1, 8, 1),    //depthwise
+    std::tr1::make_tuple(8, 8, 5, 1, 4, 8, 2),    //depthwise, dilation
+    std::tr1::make_tuple(4, 8, 3, 1, 1, 1, 1),    //im2row
+    std::tr1::make_tuple(8, 8, 5, 2, 2, 2, 1)     //im2row
+));
+
+//outputs smaller than 8x8 use the Winograd F(2x2, 3x3) tiles
+TEST(Layer_Test_Convolution_Winograd, small_output)
+{
+    //inpH, inpW, pad
+    int sizes[][3] = {{4, 4, 0}, {4, 4, 1}, {7, 5, 1}, {9, 6, 1}, {3, 3, 0}};
+    const int inpCn = 8, outCn = 16;
+
+    RNG rng(0);
+    for (int i = 0; i < (int)(sizeof(sizes) / sizeof(sizes[0])); i++)
+    {
+        int inpSz[] = {2, inpCn, sizes[i][0], sizes[i][1]}, wSz[] = {outCn, inpCn, 3, 3};
+        Mat inp(4, inpSz, CV_32F), weights(4, wSz, CV_32F), bias(outCn, 1, CV_32F);
+        rng.fill(inp, RNG::UNIFORM, -1, 1);
+        rng.fill(weights, RNG::UNIFORM, -1, 1);
+        rng.fill(bias, RNG::UNIFORM, -1, 1);
+
+        LayerParams lp;
+        lp.set("num_output", outCn);
+        lp.set("kernel_size", 3);
+        lp.set("pad", sizes[i][2]);
+        lp.blobs.push_back(weights);
+        lp.blobs.push_back(bias);
+
+        std::vector<Mat> inps(1, inp), outs;
+        runLayer(LayerFactory::createLayerInstance("Convolution", lp), inps, outs);
+
+        Mat ref;
+        refConvolution(inp, weights, bias, 1, 1, sizes[i][2], 1, ref);
+        normAssert(ref, outs[0], format("input %dx%d, pad %d", sizes[i][0], sizes[i][1], sizes[i][2]).c_str());
+    }
+}
+
+//sizes are not multiples of the GEMM register and cache blocks
+typedef testing::TestWithParam<std::tr1::tuple<int, int, int> > Layer_Test_InnerProduct_Sizes;
+TEST_P(Layer_Test_InnerProduct_Sizes, Accuracy)
+{
+    int numSamples = std::tr1::get<0>(GetParam());
+    int innerSize  = std::tr1::get<1>(GetParam());
+    int numOutput  = std::tr1::get<2>(GetParam());
+
+    RNG rng(0);
+    Mat inp(numSamples, innerSize, CV_32F), weights(numOutput, innerSize, CV_32F), bias(1, numOutput, CV_32F);
+    rng.fill(inp, RNG::UNIFORM, -1, 1);
+    rng.fill(weights, RNG::UNIFORM, -1, 1);
+    rng.fill(bias, RNG::UNIFORM, -1, 1);
+
+    LayerParams lp;
+    lp.set("num_output", numOutput);
+    lp.blobs.push_back(weights);
+    lp.blobs.push_back(bias);
+
+    std::vector<Mat> inps(1, inp), outs;
+    runLayer(LayerFactory::createLayerInstance("InnerProduct", lp), inps, outs);
+
+    Mat ref = inp * weights.t() + repeat(bias, numSamples, 1);
+    normAssert(ref, outs[0]);
+}
+
+INSTANTIATE_TEST_CASE_P(/**/, Layer_Test_InnerProduct_Sizes, testing::Values(
+    //numSamples, innerSize, numOutput
+    std::tr1::make_tuple(1, 1000, 10),
+    std::tr1::make_tuple(7, 300, 13),
+    std::tr1::make_tuple(70, 17, 270)
+));
+
 static void test_Reshape_Split_Slice_layers()
 {
     Net net;
@@ -228,6 +377,667 @@ TEST(Layer_Test_Reshape_Split_Slice, Accuracy)
     test_Reshape_Split_Slice_layers();
 }
 
+static LayerParams convParams(const String &name, int inpCn, int outCn, int kernel, RNG &rng)
+{
+    LayerParams lp;
+    lp.name = name;
+    lp.type = "Convolution";
+    lp.set("kernel_size", kernel);
+    lp.set("pad", kernel / 2);
+    lp.set("num_output", outCn);
+
+    int wsz[] = {outCn, inpCn, kernel, kernel};
+    lp.blobs.push_back(Mat(4, wsz, CV_32F));
+    lp.blobs.push_back(Mat(outCn, 1, CV_32F));
+    rng.fill(lp.blobs[0], RNG::UNIFORM, -0.5, 0.5);
+    rng.fill(lp.blobs[1], RNG::UNIFORM, -0.5, 0.5);
+    return lp;
+}
+
+//conv1 -> relu1 -> conv2 -> bn -> scale -> relu2 -> conv3
+static Net buildConvBnScaleNet()
+{
+    const int cn = 8;
+    RNG rng(0);
+    Net net;
+
+    LayerParams conv1 = convParams("conv1", 3, cn, 3, rng);
+    net.connect(0, 0, net.addLayer(conv1.name, conv1.type, conv1), 0);
+
+    LayerParams relu1;
+    net.addLayerToPrev("relu1", "ReLU", relu1);
+
+    LayerParams conv2 = convParams("conv2", cn, cn, 3, rng);
+    net.addLayerToPrev(conv2.name, conv2.type, conv2);
+
+    LayerParams bn;
+    bn.set("has_weight", false);
+    bn.set("has_bias", false);
+    bn.blobs.push_back(Mat(cn, 1, CV_32F));
+    bn.blobs.push_back(Mat(cn, 1, CV_32F));
+    bn.blobs.push_back(Mat::ones(1, 1, CV_32F));
+    rng.fill(bn.blobs[0], RNG::UNIFORM, -1, 1);
+    rng.fill(bn.blobs[1], RNG::UNIFORM, 0.5, 2);
+    net.addLayerToPrev("bn", "BatchNorm", bn);
+
+    LayerParams scale;
+    scale.set("bias_term", true);
+    scale.blobs.push_back(Mat(cn, 1, CV_32F));
+    scale.blobs.push_back(Mat(cn, 1, CV_32F));
+    rng.fill(scale.blobs[0], RNG::UNIFORM, 0.5, 2);
+    rng.fill(scale.blobs[1], RNG::UNIFORM, -1, 1);
+    net.addLayerToPrev("scale", "Scale", scale);
+
+    LayerParams relu2;
+    net.addLayerToPrev("relu2", "ReLU", relu2);
+
+    LayerParams conv3 = convParams("conv3", cn, 4, 1, rng);
+    net.addLayerToPrev(conv3.name, conv3.type, conv3);
+
+    return net;
+}
+
+TEST(Net_MemoryReuse, Accuracy)
+{
+    int sz[] = {2, 3, 10, 12};
+    Mat input(4, sz, CV_32F);
+    RNG rng(0);
+    rng.fill(input, RNG::UNIFORM, -1, 1);
+
+    //BatchNorm and Scale layers are computed in-place instead of merging into convolution
+    Net net = buildConvBnScaleNet();
+    net.enableFusion(false);
+    net.setBlob("", input);
+    net.forward();
+    Mat ref = net.getBlob("conv3").clone();
+    Mat refConv1 = net.getBlob("conv1").clone();
+
+    size_t blobsBytes = 0, plannedBytes = 0;
+    net.getMemoryConsumption(blobsBytes, plannedBytes);
+    EXPECT_EQ(blobsBytes, plannedBytes);
+
+    Net reuseNet = buildConvBnScaleNet();
+    reuseNet.enableFusion(false);
+    reuseNet.enableMemoryReuse();
+    reuseNet.keepBlobs(std::vector<String>(1, "conv1"));
+    reuseNet.setBlob("", input);
+    reuseNet.forward();
+    normAssert(ref, reuseNet.getBlob("conv3"));
+    normAssert(refConv1, reuseNet.getBlob("conv1"));
+    EXPECT_ANY_THROW(reuseNet.getBlob("conv2"));
+
+    size_t reuseBlobsBytes = 0, reusePlannedBytes = 0;
+    reuseNet.getMemoryConsumption(reuseBlobsBytes, reusePlannedBytes);
+    EXPECT_EQ(blobsBytes, reuseBlobsBytes);
+    EXPECT_LT(reusePlannedBytes, reuseBlobsBytes);
+
+    //the net is replanned for a new input shape
+    sz[0] = 1;
+    Mat input2(4, sz, CV_32F);
+    rng.fill(input2, RNG::UNIFORM, -1, 1);
+    net.setBlob("", input2);
+    net.forward();
+    reuseNet.setBlob("", input2);
+    reuseNet.forward();
+    normAssert(net.getBlob("conv3"), reuseNet.getBlob("conv3"));
+}
+
+//conv1 -> sum(2 * conv1, 3 * conv1) -> conv2
+static Net buildSharedInputEltwiseNet()
+{
+    RNG rng(0);
+    Net net;
+
+    LayerParams conv1 = convParams("conv1", 3, 4, 3, rng);
+    int conv1Id = net.addLayer(conv1.name, conv1.type, conv1);
+    net.connect(0, 0, conv1Id, 0);
+
+    LayerParams sum;
+    int coeffs[] = {2, 3};
+    sum.set("operation", "sum");
+    sum.set("coeff", DictValue::arrayInt(coeffs, 2));
+    int sumId = net.addLayer("sum", "Eltwise", sum);
+    net.connect(conv1Id, 0, sumId, 0);
+    net.connect(conv1Id, 0, sumId, 1);
+
+    LayerParams conv2 = convParams("conv2", 4, 4, 1, rng);
+    net.addLayerToPrev(conv2.name, conv2.type, conv2);
+
+    return net;
+}
+
+TEST(Net_MemoryReuse, SharedInput)
+{
+    int sz[] = {1, 3, 10, 12};
+    Mat input(4, sz, CV_32F);
+    RNG rng(0);
+    rng.fill(input, RNG::UNIFORM, -1, 1);
+
+    Net net = buildSharedInputEltwiseNet();
+    net.setBlob("", input);
+    net.forward();
+    Mat ref = net.getBlob("conv2").clone();
+    normAssert(net.getBlob("conv1") * 5, net.getBlob("sum"));
+
+    //Eltwise reads the same buffer twice, so it must not write over it
+    Net reuseNet = buildSharedInputEltwiseNet();
+    reuseNet.enableMemoryReuse();
+    reuseNet.setBlob("", input);
+    reuseNet.forward();
+    normAssert(ref, reuseNet.getBlob("conv2"));
+}
+
+TEST(Net_Fusion, Accuracy)
+{
+    int sz[] = {2, 3, 10, 12};
+    Mat input(4, sz, CV_32F);
+    RNG rng(0);
+    rng.fill(input, RNG::UNIFORM, -1, 1);
+
+    Net net = buildConvBnScaleNet();
+    net.enableFusion(false);
+    net.setBlob("", input);
+    net.forward();
+    Mat ref = net.getBlob("conv3").clone();
+    Mat refBn = net.getBlob("bn").clone();
+
+    Net fusedNet = buildConvBnScaleNet();
+    fusedNet.setBlob("", input);
+    fusedNet.forward();
+    normAssert(ref, fusedNet.getBlob("conv3"));
+    EXPECT_ANY_THROW(fusedNet.getBlob("conv2"));
+    EXPECT_ANY_THROW(fusedNet.getBlob("bn"));
+
+    //explicitly requested blob splits the chain
+    fusedNet.keepBlobs(std::vector<String>(1, "bn"));
+    fusedNet.forward();
+    normAssert(ref, fusedNet.getBlob("conv3"));
+    normAssert(refBn, fusedNet.getBlob("bn"));
+
+    fusedNet.enableFusion(false);
+    fusedNet.forward();
+    normAssert(ref, fusedNet.getBlob("conv3"));
+    normAssert(refBn, fusedNet.getBlob("bn"));
+}
+
+TEST(Net_NumThreads, Accuracy)
+{
+    int sz[] = {4, 3, 10, 12};
+    Mat input(4, sz, CV_32F);
+    RNG rng(0);
+    rng.fill(input, RNG::UNIFORM, -1, 1);
+
+    Net net = buildConvBnScaleNet();
+    net.setBlob("", input);
+    net.forward();
+    Mat ref = net.getBlob("conv3").clone();
+
+    int nthreads = getNumThreads();
+    Net limitedNet = buildConvBnScaleNet();
+    limitedNet.setNumThreads(1);
+    limitedNet.setBlob("", input);
+    limitedNet.forward();
+    normAssert(ref, limitedNet.getBlob("conv3"));
+    EXPECT_EQ(nthreads, getNumThreads());
+}
+
+TEST(Layer_Test_Eltwise, Accuracy)
+{
+    int sz[] = {2, 3, 40, 57};
+    RNG rng(0);
+    std::vector<Mat> inps(3);
+    for (size_t i = 0; i < inps.size(); i++)
+    {
+        inps[i].create(4, sz, CV_32F);
+        rng.fill(inps[i], RNG::UNIFORM, -1, 1);
+    }
+
+    const char* ops[] = {"sum", "prod", "max"};
+    for (int k = 0; k < 3; k++)
+    {
+        LayerParams lp;
+        lp.set("operation", ops[k]);
+        std::vector<Mat> outs;
+        runLayer(LayerFactory::createLayerInstance("Eltwise", lp), inps, outs);
+
+        Mat ref = inps[0].clone();
+        for (size_t i = 1; i < inps.size(); i++)
+        {
+            if (k == 0)
+                ref += inps[i];
+            else if (k == 1)
+                ref = ref.mul(inps[i]);
+            else
+                ref = cv::max(ref, inps[i]);
+        }
+        normAssert(ref, outs[0], ops[k]);
+    }
+}
+
+TEST(Layer_Test_NormalizeBBox, zero_pixel)
+{
+    const int cn = 4, rows = 5, cols = 6;
+    int sz[] = {2, cn, rows, cols};
+    RNG rng(0);
+    std::vector<Mat> inps(1);
+    inps[0].create(4, sz, CV_32F);
+    rng.fill(inps[0], RNG::UNIFORM, -1, 1);
+    // an all-zero pixel, as left by ReLU
+    for (int n = 0; n < 2; n++)
+        for (int c = 0; c < cn; c++)
+            inps[0].at<float>(n, c, 2, 3) = 0.f;
+
+    Mat scale(1, cn, CV_32F);
+    rng.fill(scale, RNG::UNIFORM, 1, 2);
+    LayerParams lp;
+    lp.set("across_spatial", false);
+    lp.set("channel_shared", false);
+    lp.blobs.push_back(scale);
+    std::vector<Mat> outs;
+    runLayer(LayerFactory::createLayerInstance("NormalizeBBox", lp), inps, outs);
+
+    Mat ref(4, sz, CV_32F);
+    for (int n = 0; n < 2; n++)
+        for (int y = 0; y < rows; y++)
+            for (int x = 0; x < cols; x++)
+            {
+                double sq = 0;
+                for (int c = 0; c < cn; c++)
+                    sq += inps[0].at<float>(n, c, y, x) * inps[0].at<float>(n, c, y, x);
+                for (int c = 0; c < cn; c++)
+                    ref.at<float>(n, c, y, x) = sq > 0 ? (float)(inps[0].at<float>(n, c, y, x) / std::sqrt(sq) * scale.at<float>(c)) : 0.f;
+            }
+    EXPECT_TRUE(checkRange(outs[0]));
+    normAssert(ref, outs[0]);
+}
+
+typedef std::pair<float, std::pair<int, int> > ScoreLabelIndex;
+static bool scoreGreater(const ScoreLabelIndex& a, const ScoreLabelIndex& b) { return a.first > b.first; }
+static bool labelLess(const ScoreLabelIndex& a, const ScoreLabelIndex& b) { return a.second.first < b.second.first; }
+
+static Mat detectionOutputRef(const Mat& loc, const Mat& conf, const Mat& priors,
+                              int numClasses, float confThreshold, float nmsThreshold,
+                              int topK, int keepTopK)
+{
+    int num = loc.size[0], numPriors = priors.size[2] / 4;
+    const float* p = priors.ptr<float>();
+    const float* var = p + numPriors * 4;
+    std::vector<float> rows;
+    for (int i = 0; i < num; i++)
+    {
+        const float* l = loc.ptr<float>(i);
+        const float* s = conf.ptr<float>(i);
+        std::vector<Vec4f> boxes(numPriors);
+        for (int k = 0; k < numPriors; k++)
+        {
+            float pw = p[k*4+2] - p[k*4], ph = p[k*4+3] - p[k*4+1];
+            float cx = var[k*4] * l[k*4] * pw + (p[k*4] + p[k*4+2]) * 0.5f;
+            float cy = var[k*4+1] * l[k*4+1] * ph + (p[k*4+1] + p[k*4+3]) * 0.5f;
+            float w = std::exp(var[k*4+2] * l[k*4+2]) * pw, h = std::exp(var[k*4+3] * l[k*4+3]) * ph;
+            boxes[k] = Vec4f(cx - w/2, cy - h/2, cx + w/2, cy + h/2);
+        }
+
+        std::vector<ScoreLabelIndex> dets;
+        for (int c = 1; c < numClasses; c++)
+        {
+            std::vector<std::pair<float, int> > cand;
+            for (int k = 0; k < numPriors; k++)
+                if (s[k*numClasses + c] > confThreshold)
+                    cand.push_back(std::make_pair(-s[k*numClasses + c], k));
+            std::stable_sort(cand.begin(), cand.end());
+            if ((int)cand.size() > topK)
+                cand.resize(topK);
+
+            std::vector<int> kept;
+            for (size_t j = 0; j < cand.size(); j++)
+            {
+                const Vec4f& a = boxes[cand[j].second];
+                bool keep = true;
+                for (size_t k = 0; k < kept.size() && keep; k++)
+                {
+                    const Vec4f& b = boxes[kept[k]];
+                    float w = std::min(a[2], b[2]) - std::max(a[0], b[0]);
+                    float h = std::min(a[3], b[3]) - std::max(a[1], b[1]);
+                    if (w > 0 && h > 0)
+                    {
+                        float inter = w * h;
+                        float areaA = (a[2] - a[0]) * (a[3] - a[1]), areaB = (b[2] - b[0]) * (b[3] - b[1]);
+                        keep = inter / (areaA + areaB - inter) <= nmsThreshold;
+                    }
+                }
+                if (keep)
+                {
+                    kept.push_back(cand[j].second);
+                    dets.push_back(std::make_pair(-cand[j].first, std::make_pair(c, cand[j].second)));
+                }
+            }
+        }
+        if ((int)dets.size() > keepTopK)
+        {
+            std::stable_sort(dets.begin(), dets.end(), scoreGreater);
+            dets.resize(keepTopK);
+            std::stable_sort(dets.begin(), dets.end(), labelLess);
+        }
+        for (size_t j = 0; j < dets.size(); j++)
+        {
+            const Vec4f& b = boxes[dets[j].second.second];
+            float row[] = {(float)i, (float)dets[j].second.first, dets[j].first,
+                           std::max(std::min(b[0], 1.f), 0.f), std::max(std::min(b[1], 1.f), 0.f),
+                           std::max(std::min(b[2], 1.f), 0.f), std::max(std::min(b[3], 1.f), 0.f)};
+            rows.insert(rows.end(), row, row + 7);
+        }
+    }
+    return Mat(rows, true).reshape(1, (int)rows.size() / 7);
+}
+
+TEST(Layer_Test_DetectionOutput, Accuracy)
+{
+    const int num = 2, numPriors = 301, numClasses = 5;
+    RNG rng(0);
+
+    int priorsSize[] = {1, 2, numPriors * 4};
+    Mat priors(3, priorsSize, CV_32F);
+    float* p = priors.ptr<float>();
+    for (int k = 0; k < numPriors; k++)
+    {
+        float cx = rng.uniform(0.f, 1.f), cy = rng.uniform(0.f, 1.f);
+        float w = rng.uniform(0.05f, 0.5f), h = rng.uniform(0.05f, 0.5f);
+        p[k*4] = cx - w/2; p[k*4+1] = cy - h/2;
+        p[k*4+2] = cx + w/2; p[k*4+3] = cy + h/2;
+        float variances[] = {0.1f, 0.1f, 0.2f, 0.2f};
+        std::copy(variances, variances + 4, p + (numPriors + k) * 4);
+    }
+    Mat loc(num, numPriors * 4, CV_32F), conf(num, numPriors * numClasses, CV_32F);
+    rng.fill(loc, RNG::UNIFORM, -1, 1);
+    rng.fill(conf, RNG::UNIFORM, 0, 1);
+
+    LayerParams lp;
+    lp.set("num_classes", numClasses);
+    lp.set("share_location", true);
+    lp.set("background_label_id", 0);
+    lp.set("nms_threshold", 0.45f);
+    lp.set("top_k", 100);
+    lp.set("keep_top_k", 150);
+    lp.set("confidence_threshold", 0.3f);
+    lp.set("code_type", "CENTER_SIZE");
+
+    std::vector<Mat> inps, outs;
+    inps.push_back(loc);
+    inps.push_back(conf);
+    inps.push_back(priors);
+    runLayer(LayerFactory::createLayerInstance("DetectionOutput", lp), inps, outs);
+
+    Mat ref = detectionOutputRef(loc, conf, priors, numClasses, 0.3f, 0.45f, 100, 150);
+    ASSERT_EQ(4, outs[0].dims);
+    ASSERT_EQ(ref.rows, outs[0].size[2]);
+    normAssert(ref, outs[0].reshape(1, ref.rows));
+}
+
+#ifdef CV_DNN_ASYNC
+TEST(Net_ForwardAsync, Accuracy)
+{
+    int sz[] = {2, 3, 10, 12};
+    RNG rng(0);
+    std::vector<Mat> inputs(6), refs(6);
+
+    Net net = buildConvBnScaleNet();
+    for (size_t i = 0; i < inputs.size(); i++)
+    {
+        inputs[i].create(4, sz, CV_32F);
+        rng.fill(inputs[i], RNG::UNIFORM, -1, 1);
+
+        net.setBlob("", inputs[i]);
+        net.forward();
+        refs[i] = net.getBlob("conv3").clone();
+    }
+
+    Net asyncNet = buildConvBnScaleNet();
+    asyncNet.setAsyncQueueSize(3);
+    std::vector<std::future<std::vector<Mat> > > results;
+    for (size_t i = 0; i < inputs.size(); i++)
+        results.push_back(asyncNet.forwardAsync(std::vector<Mat>(1, inputs[i]), std::vector<String>(1, "conv3")));
+
+    for (size_t i = 0; i < results.size(); i++)
+    {
+        std::vector<Mat> outs = results[i].get();
+        ASSERT_EQ(1u, outs.size());
+        normAssert(refs[i], outs[0]);
+    }
+
+    AsyncForwardStats stats = asyncNet.getAsyncStats();
+    EXPECT_EQ(0u, stats.queueDepth);
+    EXPECT_EQ(inputs.size(), stats.completedRequests);
+    EXPECT_EQ(stats.layerNames.size(), stats.layerTimes.size());
+    EXPECT_GT(stats.forwardTime, 0.);
+}
+#endif
+
+TEST(Net_Int8, Accuracy)
+{
+    int sz[] = {2, 3, 10, 12};
+    RNG rng(0);
+    std::vector<Mat> samples(3);
+    for (size_t i = 0; i < samples.size(); i++)
+    {
+        samples[i].create(4, sz, CV_32F);
+        rng.fill(samples[i], RNG::UNIFORM, -1, 1);
+    }
+
+    Net net = buildConvBnScaleNet();
+    net.setBlob("", samples[0]);
+    net.forward();
+    Mat ref = net.getBlob("conv3").clone();
+
+    //8-bit mode without ranges computes in floating point
+    net.enableInt8();
+    net.forward();
+    normAssert(ref, net.getBlob("conv3"));
+
+    net.calibrate(samples);
+    net.setBlob("", samples[0]);
+    net.forward();
+    Mat out = net.getBlob("conv3");
+    double maxRef = cvtest::norm(ref, NORM_INF);
+    EXPECT_LE(cvtest::norm(ref, out, NORM_INF), 0.05*maxRef);
+    EXPECT_GT(cvtest::norm(ref, out, NORM_INF), 0.);
+
+    net.enableInt8(false);
+    net.forward();
+    normAssert(ref, net.getBlob("conv3"));
+}
+
+static Mat blobFromImageRef(const Mat& img, Size size, const Scalar& mean, double scale, bool swapRB, bool crop)
+{
+    Mat image;
+    img.convertTo(image, CV_32F);
+    if (crop)
+    {
+        float rf = std::max(size.width / (float)img.cols, size.height / (float)img.rows);
+        Size rsize(cvRound(img.cols * rf), cvRound(img.rows * rf));
+        resize(image, image, rsize);
+        image = image(Rect((rsize.width - size.width) / 2, (rsize.height - size.height) / 2,
+                           size.width, size.height)).clone();
+    }
+    else if (image.size() != size)
+        resize(image, image, size);
+
+    int sz[] = { 1, 3, size.height, size.width };
+    Mat blob(4, sz, CV_32F);
+    std::vector<Mat> ch;
+    split(image, ch);
+    for (int c = 0; c < 3; c++)
+    {
+        int oc = swapRB ? 2 - c : c;
+        Mat plane(size, CV_32F, blob.ptr<float>(0, oc));
+        ch[c].convertTo(plane, CV_32F, scale, -mean[oc]*scale);
+    }
+    return blob;
+}
+
+typedef testing::TestWithParam<std::tr1::tuple<Size, int, bool> > Blob_FromImages;
+TEST_P(Blob_FromImages, Accuracy)
+{
+    Size size = std::tr1::get<0>(GetParam());
+    int type  = std::tr1::get<1>(GetParam());
+    bool crop = std::tr1::get<2>(GetParam());
+    Scalar mean(104, 117, 123);
+    double scale = 1./58;
+
+    std::vector<Mat> images(3);
+    for (size_t i = 0; i < images.size(); i++)
+    {
+        images[i].create(Size(61 + 10*(int)i, 45), type);
+        randu(images[i], 0, 255);
+    }
+
+    // The batch is packed into a preallocated blob.
+    int sz[] = { (int)images.size(), 3, size.height, size.width };
+    Mat blob(4, sz, CV_32F);
+    const float* data = blob.ptr<float>();
+    blobFromImages(images, blob, size, mean, scale, true, crop);
+    ASSERT_EQ(data, blob.ptr<float>());
+
+    for (int i = 0; i < (int)images.size(); i++)
+    {
+        Mat ref = blobFromImageRef(images[i], size, mean, scale, true, crop);
+        Mat out(3*size.height, size.width, CV_32F, blob.ptr<float>(i));
+        normAssert(Mat(3*size.height, size.width, CV_32F, ref.ptr<float>()), out);
+    }
+}
+
+INSTANTIATE_TEST_CASE_P(/**/, Blob_FromImages, testing::Combine(
+    testing::Values(Size(64, 48), Size(32, 32), Size(71, 45)),
+    testing::Values(CV_8UC3, CV_8UC4, CV_32FC3),
+    testing::Bool()
+));
+
+TEST(Blob_FromImage, Legacy)
+{
+    Mat img(20, 35, CV_8UC3);
+    randu(img, 0, 255);
+    Mat blob = blobFromImage(img, 1./255, true);
+    normAssert(blobFromImageRef(img, img.size(), Scalar(), 1./255, true, false), blob);
+}
+
+TEST(Net_Native, Accuracy)
+{
+    int sz[] = {2, 3, 10, 12};
+    Mat input(4, sz, CV_32F);
+    RNG rng(0);
+    rng.fill(input, RNG::UNIFORM, -1, 1);
+
+    Net net = buildConvBnScaleNet();
+    net.setBlob("", input);
+    net.forward();
+    Mat ref = net.getBlob("conv3");
+
+    String path = cv::tempfile(".cvdnn");
+    net.writeNative(path);
+    {
+        Mat w;
+        {
+            Net loaded = readNetFromNative(path);
+            ASSERT_FALSE(loaded.empty());
+            EXPECT_TRUE(loaded.getLayerNames() == net.getLayerNames());
+
+            loaded.setBlob("", input);
+            loaded.forward();
+            normAssert(ref, loaded.getBlob("conv3"));
+
+            //weights are mapped, not copied
+            w = loaded.getParam(loaded.getLayerId("conv2"), 0);
+            EXPECT_EQ(0, (int)((size_t)w.data % 64));
+        }
+        //the blob keeps the mapping alive after the network is destroyed
+        normAssert(net.getParam(net.getLayerId("conv2"), 0), w);
+    }
+
+    //offsets and sizes pointing outside of the file are rejected
+    std::vector<char> content;
+    {
+        std::ifstream fs(path.c_str(), std::ios::binary);
+        content.assign(std::istreambuf_iterator<char>(fs), std::istreambuf_iterator<char>());
+    }
+    ASSERT_GT(content.size(), (size_t)48);
+    for (int field = 0; field < 4; field++)
+    {
+        //header: magic, version, reserved, graph offset/size, weights offset/size
+        std::vector<char> corrupted = content;
+        uint64 value = (uint64)-1 - 16;
+        memcpy(&corrupted[16 + field*8], &value, sizeof(value));
+        std::ofstream(path.c_str(), std::ios::binary).write(&corrupted[0], corrupted.size());
+        EXPECT_ANY_THROW(readNetFromNative(path)) << "header field " << field;
+    }
+    {
+        //the graph ends with the output index of the last input of the last layer
+        uint64 graphOffset, graphSize;
+        memcpy(&graphOffset, &content[16], sizeof(graphOffset));
+        memcpy(&graphSize, &content[24], sizeof(graphSize));
+        ASSERT_LE(graphOffset + graphSize, (uint64)content.size());
+        int outputIndices[] = { 5, -1 };
+        for (int k = 0; k < 2; k++)
+        {
+            std::vector<char> corrupted = content;
+            memcpy(&corrupted[(size_t)(graphOffset + graphSize) - sizeof(int)], &outputIndices[k], sizeof(int));
+            std::ofstream(path.c_str(), std::ios::binary).write(&corrupted[0], corrupted.size());
+            EXPECT_ANY_THROW(readNetFromNative(path)) << "output index " << outputIndices[k];
+        }
+    }
+    std::ofstream(path.c_str(), std::ios::binary).write(&content[0], content.size() - 64);
+    EXPECT_ANY_THROW(readNetFromNative(path));
+
+    remove(path.c_str());
+}
+
+TEST(Net_Profiling, Accuracy)
+{
+    int sz[] = {2, 3, 10, 12};
+    Mat input(4, sz, CV_32F);
+    RNG rng(0);
+    rng.fill(input, RNG::UNIFORM, -1, 1);
+
+    Net net = buildConvBnScaleNet();
+    net.setBlob("", input);
+    net.enableProfiling();
+    for (int i = 0; i < 3; i++)
+        net.forward();
+    net.enableProfiling(false);
+    net.forward();
+
+    NetProfile profile = net.getProfile();
+    EXPECT_EQ(3, profile.runs);
+    EXPECT_GT(profile.meanTime, 0.);
+    ASSERT_EQ(7u, profile.layers.size());
+
+    const char* names[] = {"conv1", "relu1", "conv2", "bn", "scale", "relu2", "conv3"};
+    for (size_t i = 0; i < profile.layers.size(); i++)
+    {
+        const LayerProfile &lp = profile.layers[i];
+        EXPECT_EQ(String(names[i]), lp.name);
+        EXPECT_EQ(lp.fused ? 0 : 3, lp.runs);
+        EXPECT_GT(lp.flops, 0);
+        ASSERT_EQ(1u, lp.outputShapes.size());
+        EXPECT_EQ(4u, lp.outputShapes[0].size());
+    }
+    EXPECT_FALSE(profile.layers[0].fused);
+    EXPECT_TRUE(profile.layers[1].fused);
+
+    //8 output channels of 3x3 convolution over 3 channels
+    Mat conv1 = net.getBlob("conv1");
+    EXPECT_EQ(2 * (int64)conv1.total() * 3 * 9, profile.layers[0].flops);
+    EXPECT_EQ((int64)(conv1.total() * sizeof(float)), profile.layers[0].outputBytes);
+    EXPECT_GT(profile.layers[0].bytes, profile.layers[0].outputBytes);
+
+    String path = cv::tempfile(".json");
+    net.writeTrace(path);
+    std::ifstream fs(path.c_str());
+    std::string trace((std::istreambuf_iterator<char>(fs)), std::istreambuf_iterator<char>());
+    fs.close();
+    EXPECT_EQ(0u, trace.find("{\"traceEvents\":["));
+    EXPECT_NE(std::string::npos, trace.find("\"name\":\"conv3\""));
+    remove(path.c_str());
+}
+
 class Layer_LSTM_Test : public ::testing::Test
 {
 public:
@@ -114,9 +114,72 @@ public:
     * @param z_k - measurement vector.
     */
     virtual void measurementFunction( const Mat& x_k, const Mat& n_k, Mat& z_k ) = 0;
+
+    /** The function for computing the next states of a batch of filters. Every column of the matrices
+    * belongs to one filter. The default implementation calls stateConversionFunction for every column,
+    * override it to process the whole batch at once.
+    * @param x_k - previous state vectors, DP x N,
+    * @param u_k - control vectors, CP x N, or an empty matrix,
+    * @param v_k - noise vectors, DP x N,
+    * @param x_kplus1 - next state vectors, DP x N, preallocated.
+    */
+    virtual void stateConversionFunctionBatch( const Mat& x_k, const Mat& u_k, const Mat& v_k, Mat& x_kplus1 );
+    /** The function for computing the measurements of a batch of filters. Every column of the matrices
+    * belongs to one filter. The default implementation calls measurementFunction for every column.
+    * @param x_k - state vectors, DP x N,
+    * @param n_k - noise vectors, MP x N,
+    * @param z_k - measurement vectors, MP x N, preallocated.
+    */
+    virtual void measurementFunctionBatch( const Mat& x_k, const Mat& n_k, Mat& z_k );
 };
 
 
+/** @brief The interface for a batch of Unscented Kalman filters.
+* All the filters of a batch share the dimensions, the noise covariances and the system model, and are advanced
+* together. States are returned as DP x N matrices, one column per filter.
+*/
+class CV_EXPORTS UnscentedKalmanFilterBatch
+{
+public:
+
+    virtual ~UnscentedKalmanFilterBatch(){}
+
+    /** The function performs prediction step of the algorithm for all the filters
+    * @param control - the current control vectors, CP x N, or an empty matrix,
+    * @return the predicted estimates of the states, DP x N.
+    */
+    virtual Mat predict( InputArray control = noArray() ) = 0;
+
+    /** The function performs correction step of the algorithm for all the filters
+    * @param measurement - the current measurement vectors, MP x N,
+    * @return the corrected estimates of the states, DP x N.
+    */
+    virtual Mat correct( InputArray measurement ) = 0;
+
+    /** The function resets the state of one filter
+    * @param idx - index of the filter,
+    * @param state - the new state, DP x 1,
+    * @param errorCov - the new error cross-covariance matrix, DP x DP.
+    */
+    virtual void setState( int idx, InputArray state, InputArray errorCov ) = 0;
+
+    /**
+    * @return the number of filters.
+    */
+    virtual int getNumFilters() const = 0;
+
+    /**
+    * @return the current estimates of the states, DP x N.
+    */
+    virtual Mat getState() const = 0;
+
+    /**
+    * @param idx - index of the filter,
+    * @return the error cross-covariance matrix of the filter.
+    */
+    virtual Mat getErrorCov( int idx ) const = 0;
+};
+
 /** @brief Unscented Kalman filter parameters.
 * The class for initialization parameters of Unscented Kalman filter
 */
@@ -213,6 +276,16 @@ public:
 * @return pointer to the object of the UnscentedKalmanFilterImpl class implementing UnscentedKalmanFilter.
 */
 CV_EXPORTS Ptr<UnscentedKalmanFilter> createUnscentedKalmanFilter( const UnscentedKalmanFilterParams &params );
+/** @brief Batched Unscented Kalman Filter factory method
+
+* The class advances numFilters Unscented Kalman filters with the same parameters in one call. States and covariances
+* are stored element by element across the filters, so the Cholesky decompositions and the sigma point statistics of
+* all the filters are computed in the same loops. Every filter starts from params.stateInit and params.errorCovInit.
+* @param params - an object of the UnscentedKalmanFilterParams class containing UKF parameters,
+* @param numFilters - number of filters in the batch.
+* @return pointer to the object implementing UnscentedKalmanFilterBatch.
+*/
+CV_EXPORTS Ptr<UnscentedKalmanFilterBatch> createUnscentedKalmanFilterBatch( const UnscentedKalmanFilterParams &params, int numFilters );
 /** @brief Augmented Unscented Kalman Filter factory method
 
 * The class implements an Augmented Unscented Kalman filter http://becs.aalto.fi/en/research/bayes/ekfukf/documentation.pdf, page 31-33.
@@ -1399,6 +1399,18 @@ public:
   */
   bool update(const Mat& image);
 
+  /** @brief Update all trackers from the tracking-list in parallel
+  @param image The current frame
+  @param success Output vector, success[i] is nonzero if the i-th target was located in the current frame
+
+  Unlike update(const Mat&), every tracker is updated even if some of the targets are lost. The data the
+  trackers derive from the whole frame (the grayscale image, integral images) is computed once and shared
+  between them.
+
+  @return True if all targets were located
+  */
+  bool update(const Mat& image, std::vector<uchar>& success);
+
   /** @brief Current number of targets in tracking-list
   */
   int targetNum;
@@ -413,3 +413,36 @@ PERF_TEST_P(tracking, GOTURN, testing::Combine(TESTSET_NAMES, SEGMENTS))
   SANITY_CHECK(bbs_mat, 15, ERROR_RELATIVE);
 
 }
+
+PERF_TEST(tracking, kcf_multiple_targets)
+{
+  // a synthetic 1080p stream with 50 targets moving by a few pixels per frame
+  const int numTargets = 50;
+  RNG rng(0);
+  Mat background(1080 + 16, 1920 + 16, CV_8UC3);
+  rng.fill(background, RNG::UNIFORM, 0, 255);
+  GaussianBlur(background, background, Size(7, 7), 0);
+
+  Mat frames[2];
+  frames[0] = background(Rect(0, 0, 1920, 1080));
+  frames[1] = background(Rect(4, 3, 1920, 1080));
+
+  vector<Ptr<Tracker> > trackers(numTargets);
+  vector<Rect2d> bbs(numTargets);
+  for (int i = 0; i < numTargets; i++)
+  {
+    bbs[i] = Rect2d(100 + (i % 10) * 170, 100 + (i / 10) * 180, 48 + (i % 3) * 8, 64);
+    trackers[i] = Tracker::create("KCF");
+    ASSERT_TRUE(trackers[i]->init(frames[0], bbs[i]));
+  }
+
+  int frameCounter = 0;
+  TEST_CYCLE()
+  {
+    const Mat& frame = frames[++frameCounter % 2];
+    for (int i = 0; i < numTargets; i++)
+      trackers[i]->update(frame, bbs[i]);
+  }
+
+  SANITY_CHECK_NOTHING();
+}
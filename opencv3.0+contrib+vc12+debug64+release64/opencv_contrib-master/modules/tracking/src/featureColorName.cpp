@@ -32813,4 +32813,19 @@ namespace cv{
       {0.0030858,-0.016151,0.013017,0.0072284,-0.53357,0.30985,0.0041336,-0.012531,0.00142,-0.33842},
       {0.0087778,-0.015645,0.004769,0.011785,-0.54199,0.31505,0.00020476,-0.020282,0.00021236,-0.34675}
   };
+
+  static Mutex colorNamesMutex;
+  static std::vector<float> colorNamesFloat;
+
+  const float* getColorNamesFloat(){
+    AutoLock lock(colorNamesMutex);
+    if(colorNamesFloat.empty()){
+      const int rows=(int)(sizeof(ColorNames)/sizeof(ColorNames[0]));
+      colorNamesFloat.resize(rows*10);
+      for(int i=0;i<rows;i++)
+        for(int k=0;k<10;k++)
+          colorNamesFloat[i*10+k]=(float)ColorNames[i][k];
+    }
+    return &colorNamesFloat[0];
+  }
 }
\ No newline at end of file
@@ -0,0 +1,145 @@
+/*M///////////////////////////////////////////////////////////////////////////////////////
+//
+//  IMPORTANT: READ BEFORE DOWNLOADING, COPYING, INSTALLING OR USING.
+//
+//  By downloading, copying, installing or using the software you agree to this license.
+//  If you do not agree to this license, do not download, install,
+//  copy or use the software.
+//
+//
+//                           License Agreement
+//                For Open Source Computer Vision Library
+//
+// Copyright (C) 2013, OpenCV Foundation, all rights reserved.
+// Third party copyrights are property of their respective owners.
+//
+// Redistribution and use in source and binary forms, with or without modification,
+// are permitted provided that the following conditions are met:
+//
+//   * Redistribution's of source code must retain the above copyright notice,
+//     this list of conditions and the following disclaimer.
+//
+//   * Redistribution's in binary form must reproduce the above copyright notice,
+//     this list of conditions and the following disclaimer in the documentation
+//     and/or other materials provided with the distribution.
+//
+//   * The name of the copyright holders may not be used to endorse or promote products
+//     derived from this software without specific prior written permission.
+//
+// This software is provided by the copyright holders and contributors "as is" and
+// any express or implied warranties, including, but not limited to, the implied
+// warranties of merchantability and fitness for a particular purpose are disclaimed.
+// In no event shall the Intel Corporation or contributors be liable for any direct,
+// indirect, incidental, special, exemplary, or consequential damages
+// (including, but not limited to, procurement of substitute goods or services;
+// loss of use, data, or profits; or business interruption) however caused
+// and on any theory of liability, whether in contract, strict liability,
+// or tort (including negligence or otherwise) arising in any way out of
+// the use of this software, even if advised of the possibility of such damage.
+//
+//M*/
+
+
+#include "frameCache.hpp"
+
+namespace cv
+{
+namespace tracking
+{
+
+enum { GRAY = 0, INTEGRALS = 1 << 16, FIRST_CHANNEL_INTEGRAL = 2 << 16 };
+
+static Mutex registryMutex;
+static std::vector<FrameCache*> registry;
+
+FrameCache::FrameCache(const Mat& _frame) : frame(_frame)
+{
+    AutoLock lock(registryMutex);
+    registry.push_back(this);
+}
+
+FrameCache::~FrameCache()
+{
+    AutoLock lock(registryMutex);
+    registry.erase(std::find(registry.begin(), registry.end(), this));
+}
+
+FrameCache* FrameCache::find(const Mat& frame)
+{
+    AutoLock lock(registryMutex);
+    for (size_t i = 0; i < registry.size(); i++)
+    {
+        const Mat& cached = registry[i]->frame;
+        if (cached.data == frame.data && cached.size() == frame.size() &&
+            cached.type() == frame.type() && cached.step == frame.step)
+            return registry[i];
+    }
+    return NULL;
+}
+
+FrameCache::Item* FrameCache::lookup(int key)
+{
+    for (size_t i = 0; i < items.size(); i++)
+        if (items[i].key == key)
+            return &items[i];
+    return NULL;
+}
+
+Mat FrameCache::gray(int code)
+{
+    if (frame.channels() == 1)
+        return frame;
+
+    AutoLock lock(mutex);
+    Item* item = lookup(GRAY + code);
+    if (!item)
+    {
+        Item newItem;
+        newItem.key = GRAY + code;
+        cvtColor(frame, newItem.data[0], code);
+        items.push_back(newItem);
+        item = &items.back();
+    }
+    return item->data[0];
+}
+
+void FrameCache::integrals(int code, Mat& sum, Mat& sqsum)
+{
+    Mat image = gray(code);
+
+    AutoLock lock(mutex);
+    Item* item = lookup(INTEGRALS + code);
+    if (!item)
+    {
+        Item newItem;
+        newItem.key = INTEGRALS + code;
+        integral(image, newItem.data[0], newItem.data[1], CV_32S, CV_64F);
+        items.push_back(newItem);
+        item = &items.back();
+    }
+    sum = item->data[0];
+    sqsum = item->data[1];
+}
+
+Mat FrameCache::firstChannelIntegral()
+{
+    AutoLock lock(mutex);
+    Item* item = lookup(FIRST_CHANNEL_INTEGRAL);
+    if (!item)
+    {
+        Item newItem;
+        newItem.key = FIRST_CHANNEL_INTEGRAL;
+        Mat channel;
+        if (frame.channels() == 1)
+            channel = frame;
+        else
+            extractChannel(frame, channel, 0);
+        integral(channel, newItem.data[0], CV_32F);
+        items.push_back(newItem);
+        item = &items.back();
+    }
+    return item->data[0];
+}
+
+}
+}
@@ -0,0 +1,100 @@
+/*M///////////////////////////////////////////////////////////////////////////////////////
+//
+//  IMPORTANT: READ BEFORE DOWNLOADING, COPYING, INSTALLING OR USING.
+//
+//  By downloading, copying, installing or using the software you agree to this license.
+//  If you do not agree to this license, do not download, install,
+//  copy or use the software.
+//
+//
+//                           License Agreement
+//                For Open Source Computer Vision Library
+//
+// Copyright (C) 2013, OpenCV Foundation, all rights reserved.
+// Third party copyrights are property of their respective owners.
+//
+// Redistribution and use in source and binary forms, with or without modification,
+// are permitted provided that the following conditions are met:
+//
+//   * Redistribution's of source code must retain the above copyright notice,
+//     this list of conditions and the following disclaimer.
+//
+//   * Redistribution's in binary form must reproduce the above copyright notice,
+//     this list of conditions and the following disclaimer in the documentation
+//     and/or other materials provided with the distribution.
+//
+//   * The name of the copyright holders may not be used to endorse or promote products
+//     derived from this software without specific prior written permission.
+//
+// This software is provided by the copyright holders and contributors "as is" and
+// any express or implied warranties, including, but not limited to, the implied
+// warranties of merchantability and fitness for a particular purpose are disclaimed.
+// In no event shall the Intel Corporation or contributors be liable for any direct,
+// indirect, incidental, special, exemplary, or consequential damages
+// (including, but not limited to, procurement of substitute goods or services;
+// loss of use, data, or profits; or business interruption) however caused
+// and on any theory of liability, whether in contract, strict liability,
+// or tort (including negligence or otherwise) arising in any way out of
+// the use of this software, even if advised of the possibility of such damage.
+//
+//M*/
+
+
+#ifndef OPENCV_TRACKING_FRAME_CACHE
+#define OPENCV_TRACKING_FRAME_CACHE
+
+#include "precomp.hpp"
+
+namespace cv
+{
+namespace tracking
+{
+
+/* Per-frame data shared by the trackers that are updated on the same frame.
+ *
+ * MultiTracker_Alt registers a cache for the frame before updating its trackers in
+ * parallel. A tracker looks the cache up by the frame it was given and takes the
+ * grayscale image or the integral images from it instead of computing its own copy;
+ * every item is computed once, by the first tracker that needs it. If no cache is
+ * registered for the frame the tracker computes the data itself.
+ *
+ * The returned matrices are shared and must not be modified.
+ */
+class FrameCache
+{
+public:
+    explicit FrameCache(const Mat& frame);
+    ~FrameCache();
+
+    /* returns the cache registered for the frame or NULL */
+    static FrameCache* find(const Mat& frame);
+
+    /* the frame converted to grayscale with the cvtColor code, the frame itself for 1-channel input */
+    Mat gray(int code = COLOR_BGR2GRAY);
+
+    /* integral and squared integral images of gray(code), CV_32S and CV_64F */
+    void integrals(int code, Mat& sum, Mat& sqsum);
+
+    /* CV_32F integral image of the first channel of the frame */
+    Mat firstChannelIntegral();
+
+private:
+    FrameCache(const FrameCache&);
+    FrameCache& operator=(const FrameCache&);
+
+    struct Item
+    {
+        int key;
+        Mat data[2];
+    };
+    Item* lookup(int key);
+
+    Mat frame;
+    std::vector<Item> items;
+    Mutex mutex;
+};
+
+}
+}
+
+#endif
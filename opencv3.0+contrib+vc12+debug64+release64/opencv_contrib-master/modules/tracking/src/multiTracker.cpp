@@ -40,6 +40,7 @@
 //M*/
 
 #include "multiTracker.hpp"
+#include "frameCache.hpp"
 
 namespace cv
 {
@@ -82,6 +83,40 @@ namespace cv
 		return true;
 	}
 
+	class MultiTrackerUpdateInvoker : public ParallelLoopBody
+	{
+	public:
+		MultiTrackerUpdateInvoker(const Mat& _image, std::vector<Ptr<Tracker> >& _trackers,
+			std::vector<Rect2d>& _boundingBoxes, std::vector<uchar>& _success)
+			: image(_image), trackers(_trackers), boundingBoxes(_boundingBoxes), success(_success)
+		{
+		}
+
+		void operator()(const Range& range) const
+		{
+			for (int i = range.start; i < range.end; i++)
+				success[i] = trackers[i]->update(image, boundingBoxes[i]) ? 1 : 0;
+		}
+
+	private:
+		const Mat& image;
+		std::vector<Ptr<Tracker> >& trackers;
+		std::vector<Rect2d>& boundingBoxes;
+		std::vector<uchar>& success;
+	};
+
+	bool MultiTracker_Alt::update(const Mat& image, std::vector<uchar>& success)
+	{
+		success.assign(trackers.size(), 0);
+
+		//Frame data shared by the trackers, released when the update is done
+		tracking::FrameCache cache(image);
+		parallel_for_(Range(0, (int)trackers.size()),
+			MultiTrackerUpdateInvoker(image, trackers, boundingBoxes, success));
+
+		return std::find(success.begin(), success.end(), 0) == success.end();
+	}
+
 	//Multitracker TLD
 	/*Optimized update method for TLD Multitracker */
 	bool MultiTrackerTLD::update_opt(const Mat& image)
@@ -135,6 +135,38 @@ void ClfMilBoost::init( const ClfMilBoost::Params &parameters )
   _counter = 0;
 }
 
+// trains every weak classifier on the new samples and stores its predictions
+class ParallelWeakClassifierUpdate : public cv::ParallelLoopBody
+{
+ public:
+  ParallelWeakClassifierUpdate( std::vector<ClfOnlineStump*>& weakclf, const Mat& posx, const Mat& negx,
+                                std::vector<std::vector<float> >& pospred, std::vector<std::vector<float> >& negpred ) :
+      _weakclf( weakclf ),
+      _posx( posx ),
+      _negx( negx ),
+      _pospred( pospred ),
+      _negpred( negpred )
+  {
+  }
+
+  virtual void operator()( const cv::Range &r ) const
+  {
+    for ( int m = r.start; m < r.end; m++ )
+    {
+      _weakclf[m]->update( _posx, _negx );
+      _pospred[m] = _weakclf[m]->classifySetF( _posx );
+      _negpred[m] = _weakclf[m]->classifySetF( _negx );
+    }
+  }
+
+ private:
+  std::vector<ClfOnlineStump*>& _weakclf;
+  const Mat& _posx;
+  const Mat& _negx;
+  std::vector<std::vector<float> >& _pospred;
+  std::vector<std::vector<float> >& _negpred;
+};
+
 void ClfMilBoost::update( const Mat& posx, const Mat& negx )
 {
   int numneg = negx.rows;
@@ -157,15 +189,7 @@ void ClfMilBoost::update( const Mat& posx, const Mat& negx )
   std::vector<std::vector<float> > pospred( _weakclf.size() ), negpred( _weakclf.size() );
 
   // train all weak classifiers without weights
-#ifdef _OPENMP
-#pragma omp parallel for
-#endif
-  for ( int m = 0; m < _myParams._numFeat; m++ )
-  {
-    _weakclf[m]->update( posx, negx );
-    pospred[m] = _weakclf[m]->classifySetF( posx );
-    negpred[m] = _weakclf[m]->classifySetF( negx );
-  }
+  parallel_for_( Range( 0, _myParams._numFeat ), ParallelWeakClassifierUpdate( _weakclf, posx, negx, pospred, negpred ) );
 
   // pick the best features
   for ( int s = 0; s < _myParams._numSel; s++ )
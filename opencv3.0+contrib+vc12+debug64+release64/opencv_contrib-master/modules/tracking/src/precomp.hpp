@@ -51,6 +51,8 @@
 namespace cv
 {
 	extern const double ColorNames[][10];
+	// ColorNames converted to float on the first call, rows of 10 values
+	const float* getColorNamesFloat();
 
     namespace tracking {
 
@@ -40,6 +40,7 @@
 //M*/
 
 #include "tldDetector.hpp"
+#include "tldDetectorCheck.hpp"
 
 #include <opencv2/core/utility.hpp>
 
@@ -64,6 +65,138 @@ namespace cv
 			return p;
 		}
 
+		// Windows handed to the batched ensemble classifier at once
+		static const int ENSEMBLE_BATCH = 64;
+
+		// Classify a batch of windows of one image, given as offsets from data. The fern codes of all
+		// windows are built together measurement by measurement, so the inner loop runs over windows
+		// with the same pair of pixel offsets, and the posteriors are accumulated in the same order as
+		// in ensembleClassifierNum(). A batch is dropped as soon as none of its windows can reach the
+		// threshold even if every remaining classifier votes 1.
+		void TLDDetector::ensembleClassifierBatch(const uchar* data, const int* offsets, int count, uchar* accepted) const
+		{
+			const int n = (int)classifiers.size();
+			int codes[ENSEMBLE_BATCH];
+			double sums[ENSEMBLE_BATCH];
+
+			for (int b = 0; b < count; b += ENSEMBLE_BATCH)
+			{
+				const int m = std::min(ENSEMBLE_BATCH, count - b);
+				const int* off = offsets + b;
+				bool rejected = false;
+
+				for (int w = 0; w < m; w++)
+					sums[w] = 0.0;
+
+				for (int k = 0; k < n && !rejected; k++)
+				{
+					const TLDEnsembleClassifier& classifier = classifiers[k];
+					for (int w = 0; w < m; w++)
+						codes[w] = 0;
+					for (int i = 0; i < (int)classifier.offset.size(); i++)
+					{
+						const uchar* p1 = data + classifier.offset[i].x;
+						const uchar* p2 = data + classifier.offset[i].y;
+						for (int w = 0; w < m; w++)
+							codes[w] = (codes[w] << 1) | (p1[off[w]] < p2[off[w]] ? 1 : 0);
+					}
+
+					double maxSum = 0.0;
+					for (int w = 0; w < m; w++)
+					{
+						const Point2i& pn = classifier.posAndNeg[codes[w]];
+						if (pn.x != 0 || pn.y != 0)
+							sums[w] += (double)pn.x / ((double)pn.x + (double)pn.y);
+						maxSum = std::max(maxSum, sums[w]);
+					}
+					rejected = (maxSum + (n - k - 1)) / n <= ENSEMBLE_THRESHOLD;
+				}
+
+				for (int w = 0; w < m; w++)
+					accepted[b + w] = (uchar)(!rejected && sums[w] / n > ENSEMBLE_THRESHOLD);
+			}
+		}
+
+		// Subtract the mean of a standard patch and scale it to unit norm, so that the NCC of two
+		// normalized patches is their dot product. Returns false for a constant patch.
+		bool TLDDetector::normalizePatch(const uchar* patch, float* dst)
+		{
+			const int N = STANDARD_PATCH_SIZE * STANDARD_PATCH_SIZE;
+			double mean = 0.0, sq = 0.0;
+			for (int i = 0; i < N; i++)
+				mean += patch[i];
+			mean /= N;
+			for (int i = 0; i < N; i++)
+				sq += (patch[i] - mean) * (patch[i] - mean);
+			if (sq <= 0.0)
+			{
+				std::fill(dst, dst + N, 0.0f);
+				return false;
+			}
+			const double norm = 1.0 / std::sqrt(sq);
+			for (int i = 0; i < N; i++)
+				dst[i] = (float)((patch[i] - mean) * norm);
+			return true;
+		}
+
+		// Normalize the NN model once per frame. Constant examples never match anything and are
+		// skipped; posConservative marks the older half of the positive examples used by Sc.
+		void TLDDetector::prepareNNModel()
+		{
+			const int N = STANDARD_PATCH_SIZE * STANDARD_PATCH_SIZE;
+			const int med = timeStampsPositive->empty() ? 0 : getMedian((*timeStampsPositive));
+
+			posModel.create(*posNum, N, CV_32F);
+			posValid.resize(*posNum);
+			posConservative.resize(*posNum);
+			for (int i = 0; i < *posNum; i++)
+			{
+				posValid[i] = (uchar)normalizePatch(posExp->ptr<uchar>() + i * N, posModel.ptr<float>(i));
+				posConservative[i] = (uchar)((int)(*timeStampsPositive)[i] <= med);
+			}
+
+			negModel.create(*negNum, N, CV_32F);
+			negValid.resize(*negNum);
+			for (int i = 0; i < *negNum; i++)
+				negValid[i] = (uchar)normalizePatch(negExp->ptr<uchar>() + i * N, negModel.ptr<float>(i));
+		}
+
+		// Sr and Sc of a batch of normalized patches (one per row) against the prepared NN model.
+		// All the correlations of the batch are obtained by two matrix products.
+		void TLDDetector::batchSrSc(const Mat& patches, const uchar* constant, double* resultSr, double* resultSc) const
+		{
+			Mat posNCC, negNCC;
+			if (*posNum > 0)
+				gemm(patches, posModel, 1.0, noArray(), 0.0, posNCC, GEMM_2_T);
+			if (*negNum > 0)
+				gemm(patches, negModel, 1.0, noArray(), 0.0, negNCC, GEMM_2_T);
+
+			for (int id = 0; id < patches.rows; id++)
+			{
+				double splusR = 0.0, splusC = 0.0, sminus = 0.0;
+				for (int i = 0; i < *posNum; i++)
+				{
+					if (!posValid[i])
+						continue;
+					// NCC against a constant patch is 1 by definition
+					const double s = constant[id] ? 1.0 : 0.5 * (posNCC.at<float>(id, i) + 1.0);
+					splusR = std::max(splusR, s);
+					if (posConservative[i])
+						splusC = std::max(splusC, s);
+				}
+				for (int i = 0; i < *negNum; i++)
+				{
+					if (!negValid[i])
+						continue;
+					const double s = constant[id] ? 1.0 : 0.5 * (negNCC.at<float>(id, i) + 1.0);
+					sminus = std::max(sminus, s);
+				}
+
+				resultSr[id] = splusR + sminus == 0.0 ? 0.0 : splusR / (sminus + splusR);
+				resultSc[id] = splusC + sminus == 0.0 ? 0.0 : splusC / (sminus + splusC);
+			}
+		}
+
 		// Calculate Relative similarity of the patch (NN-Model)
 		double TLDDetector::Sr(const Mat_<uchar>& patch) const
 		{
@@ -303,27 +436,37 @@ namespace cv
 		class CalcScSrParallelLoopBody: public cv::ParallelLoopBody
 		{
 		public:
-			explicit CalcScSrParallelLoopBody (TLDDetector * detector, Size initSize):
+			explicit CalcScSrParallelLoopBody (TLDDetector * detector, Size initSize, int batchSize):
 				detectorF (detector),
-				initSizeF (initSize)
+				initSizeF (initSize),
+				batchSizeF (batchSize)
 			{
 			}
 
 			virtual void operator () (const cv::Range & r) const
 			{
-				for (int ind = r.start; ind < r.end; ++ind)
+				Mat_<uchar> standardPatch(STANDARD_PATCH_SIZE, STANDARD_PATCH_SIZE);
+				Mat patches;
+				std::vector<uchar> constant;
+				for (int b = r.start; b < r.end; ++b)
 				{
-					resample(detectorF->resized_imgs[detectorF->ensScaleIDs[ind]],
-						Rect2d(detectorF->ensBuffer[ind], initSizeF),
-						detectorF->standardPatches[ind]);
-
-					detectorF->scValues[ind] = detectorF->Sc (detectorF->standardPatches[ind]);
-					detectorF->srValues[ind] = detectorF->Sr (detectorF->standardPatches[ind]);
+					const int begin = b * batchSizeF;
+					const int end = std::min(begin + batchSizeF, (int)detectorF->ensBuffer.size());
+					patches.create(end - begin, STANDARD_PATCH_SIZE * STANDARD_PATCH_SIZE, CV_32F);
+					constant.resize(end - begin);
+					for (int ind = begin; ind < end; ++ind)
+					{
+						resample(detectorF->resized_imgs[detectorF->ensScaleIDs[ind]],
+							Rect2d(detectorF->ensBuffer[ind], initSizeF), standardPatch);
+						constant[ind - begin] = (uchar)!TLDDetector::normalizePatch(standardPatch.ptr<uchar>(), patches.ptr<float>(ind - begin));
+					}
+					detectorF->batchSrSc(patches, &constant[0], &detectorF->srValues[begin], &detectorF->scValues[begin]);
 				}
 			}
 
 			TLDDetector * detectorF;
 			const Size initSizeF;
+			const int batchSizeF;
 		private:
 			CalcScSrParallelLoopBody (const CalcScSrParallelLoopBody&);
 			CalcScSrParallelLoopBody& operator= (const CalcScSrParallelLoopBody&);
@@ -378,33 +521,39 @@ namespace cv
 			} while (size.width >= initSize.width && size.height >= initSize.height);
 
 			//Encsemble classification
-			for (int i = 0; i < (int)varBuffer.size(); i++)
+			//Windows are pushed scale by scale, so every scale is classified as one run of offsets
+			std::vector<int> offsets;
+			std::vector<uchar> accepted;
+			for (int i = 0; i < (int)varBuffer.size();)
 			{
-				prepareClassifiers(static_cast<int> (blurred_imgs[varScaleIDs[i]].step[0]));
-				if (ensembleClassifierNum(&blurred_imgs[varScaleIDs[i]].at<uchar>(varBuffer[i].y, varBuffer[i].x)) <= ENSEMBLE_THRESHOLD)
-					continue;
-				ensBuffer.push_back(varBuffer[i]);
-				ensScaleIDs.push_back(varScaleIDs[i]);
+				const int sid = varScaleIDs[i];
+				const int rowstep = static_cast<int> (blurred_imgs[sid].step[0]);
+				offsets.clear();
+				for (int j = i; j < (int)varBuffer.size() && varScaleIDs[j] == sid; j++)
+					offsets.push_back(varBuffer[j].y * rowstep + varBuffer[j].x);
+				accepted.resize(offsets.size());
+
+				prepareClassifiers(rowstep);
+				ensembleClassifierBatch(blurred_imgs[sid].ptr<uchar>(), &offsets[0], (int)offsets.size(), &accepted[0]);
+				for (int k = 0; k < (int)offsets.size(); k++)
+				{
+					if (!accepted[k])
+						continue;
+					ensBuffer.push_back(varBuffer[i + k]);
+					ensScaleIDs.push_back(sid);
+				}
+				i += (int)offsets.size();
 			}
 
 			//Batch preparation
 			srValues.resize (ensBuffer.size());
 			scValues.resize (ensBuffer.size());
-
-			//Carefully resize standard patches with reference-counted Mat members
-			const int oldPatchesSize = (int)standardPatches.size();
-			standardPatches.resize (ensBuffer.size());
-			if ((int)ensBuffer.size() > oldPatchesSize)
-			{
-				Mat_<uchar> standardPatch(STANDARD_PATCH_SIZE, STANDARD_PATCH_SIZE);
-				for (int i = oldPatchesSize; i < (int)ensBuffer.size(); ++i)
-				{
-					standardPatches[i] = standardPatch.clone();
-				}
-			}
+			prepareNNModel();
 
 			//Batch calculation
-			cv::parallel_for_ (cv::Range (0, (int)ensBuffer.size ()), CalcScSrParallelLoopBody (this, initSize));
+			const int batchSize = 64;
+			const int batchNum = ((int)ensBuffer.size() + batchSize - 1) / batchSize;
+			cv::parallel_for_ (cv::Range (0, batchNum), CalcScSrParallelLoopBody (this, initSize, batchSize));
 
 			//NN classification
 			for (int i = 0; i < (int)ensBuffer.size(); i++)
@@ -591,5 +740,93 @@ namespace cv
 			return ((p2 - p * p) > VARIANCE_THRESHOLD * *originalVariance);
 		}
 
+		// Build a synthetic model and run the batched ensemble classifier and Sr/Sc on it next to the
+		// per-patch versions, so that the tests can check that both give the same answers.
+		void tld_compareBatchedDetector(int seed, int& ensembleMismatches, int& ensembleAccepted, double& maxSrDiff, double& maxScDiff)
+		{
+			const int N = STANDARD_PATCH_SIZE * STANDARD_PATCH_SIZE;
+			const Size imgSize(96, 96), initSize(24, 24);
+			RNG rng(seed);
+
+			Mat img(imgSize, CV_8U);
+			rng.fill(img, RNG::UNIFORM, 0, 256);
+			GaussianBlur(img, img, Size(5, 5), 0.0);
+
+			TLDDetector detector;
+			TLDEnsembleClassifier::makeClassifiers(initSize, MEASURES_PER_CLASSIFIER, GRIDSIZE, detector.classifiers);
+
+			// Windows of the left half are mostly positive, the rest mostly negative
+			std::vector<int> offsets;
+			const int rowstep = (int)img.step[0];
+			for (int y = 0; y + initSize.height <= imgSize.height; y += 2)
+				for (int x = 0; x + initSize.width <= imgSize.width; x += 2)
+				{
+					Mat_<uchar> patch = img(Rect(Point(x, y), initSize));
+					const bool isPositive = (x < imgSize.width / 2) == (rng.uniform(0, 10) < 8);
+					for (int k = 0; k < (int)detector.classifiers.size(); k++)
+						detector.classifiers[k].integrate(patch, isPositive);
+					offsets.push_back(y * rowstep + x);
+				}
+
+			std::vector<uchar> accepted(offsets.size());
+			detector.prepareClassifiers(rowstep);
+			detector.ensembleClassifierBatch(img.ptr<uchar>(), &offsets[0], (int)offsets.size(), &accepted[0]);
+			ensembleMismatches = ensembleAccepted = 0;
+			for (int i = 0; i < (int)offsets.size(); i++)
+			{
+				const bool expected = detector.ensembleClassifierNum(img.ptr<uchar>() + offsets[i]) > ENSEMBLE_THRESHOLD;
+				ensembleMismatches += expected != (accepted[i] != 0);
+				ensembleAccepted += accepted[i] != 0;
+			}
+
+			// NN model of random standard patches
+			Mat posExp(MAX_EXAMPLES_IN_MODEL, N, CV_8U), negExp(MAX_EXAMPLES_IN_MODEL, N, CV_8U);
+			int posNum = 60, negNum = 80;
+			std::vector<int> timeStampsPositive, timeStampsNegative;
+			const Size patchSize(STANDARD_PATCH_SIZE, STANDARD_PATCH_SIZE);
+			for (int i = 0; i < posNum; i++)
+			{
+				Mat(img(Rect(Point(rng.uniform(0, imgSize.width / 2), rng.uniform(0, imgSize.height - patchSize.height)), patchSize)).clone())
+					.reshape(1, 1).copyTo(posExp.row(i));
+				timeStampsPositive.push_back(rng.uniform(0, 10));
+			}
+			for (int i = 0; i < negNum; i++)
+			{
+				Mat(img(Rect(Point(rng.uniform(imgSize.width / 2, imgSize.width - patchSize.width), rng.uniform(0, imgSize.height - patchSize.height)), patchSize)).clone())
+					.reshape(1, 1).copyTo(negExp.row(i));
+				timeStampsNegative.push_back(rng.uniform(0, 10));
+			}
+			detector.posExp = &posExp;
+			detector.negExp = &negExp;
+			detector.posNum = &posNum;
+			detector.negNum = &negNum;
+			detector.timeStampsPositive = &timeStampsPositive;
+			detector.timeStampsNegative = &timeStampsNegative;
+			detector.prepareNNModel();
+
+			// Query patches from the whole image, the last one constant
+			const int numPatches = 100;
+			std::vector<Mat_<uchar> > queries(numPatches);
+			Mat patches(numPatches, N, CV_32F);
+			std::vector<uchar> constant(numPatches);
+			for (int i = 0; i < numPatches; i++)
+			{
+				if (i == numPatches - 1)
+					queries[i] = Mat_<uchar>(patchSize, (uchar)128);
+				else
+					queries[i] = img(Rect(Point(rng.uniform(0, imgSize.width - patchSize.width), rng.uniform(0, imgSize.height - patchSize.height)), patchSize)).clone();
+				constant[i] = (uchar)!TLDDetector::normalizePatch(queries[i].ptr<uchar>(), patches.ptr<float>(i));
+			}
+
+			std::vector<double> sr(numPatches), sc(numPatches);
+			detector.batchSrSc(patches, &constant[0], &sr[0], &sc[0]);
+			maxSrDiff = maxScDiff = 0.0;
+			for (int i = 0; i < numPatches; i++)
+			{
+				maxSrDiff = std::max(maxSrDiff, std::abs(sr[i] - detector.Sr(queries[i])));
+				maxScDiff = std::max(maxScDiff, std::abs(sc[i] - detector.Sc(queries[i])));
+			}
+		}
+
 	}
 }
@@ -74,9 +74,13 @@ namespace cv
 			TLDDetector(){}
 			~TLDDetector(){}
 			double ensembleClassifierNum(const uchar* data);
+			void ensembleClassifierBatch(const uchar* data, const int* offsets, int count, uchar* accepted) const;
 			void prepareClassifiers(int rowstep);
 			double Sr(const Mat_<uchar>& patch) const;
 			double Sc(const Mat_<uchar>& patch) const;
+			void prepareNNModel();
+			void batchSrSc(const Mat& patches, const uchar* constant, double* resultSr, double* resultSc) const;
+			static bool normalizePatch(const uchar* patch, float* dst);
 #ifdef HAVE_OPENCL
 			double ocl_Sr(const Mat_<uchar>& patch);
 			double ocl_Sc(const Mat_<uchar>& patch);
@@ -90,7 +94,10 @@ namespace cv
 			std::vector<int> *timeStampsPositive, *timeStampsNegative;
 			double *originalVariancePtr;
 			std::vector<double> scValues, srValues;
-			std::vector<Mat_<uchar> > standardPatches;
+
+			// NN model for the batched Sr/Sc: zero-mean, unit-norm examples, one per row
+			Mat posModel, negModel;
+			std::vector<uchar> posValid, negValid, posConservative;
 
 			std::vector <Mat> resized_imgs, blurred_imgs;
 			std::vector <Point> varBuffer, ensBuffer;
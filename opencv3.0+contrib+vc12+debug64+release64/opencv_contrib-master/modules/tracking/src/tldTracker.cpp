@@ -40,6 +40,7 @@
  //M*/
 
 #include "tldTracker.hpp"
+#include "frameCache.hpp"
 
 
 namespace cv
@@ -115,7 +116,11 @@ bool TrackerTLDImpl::initImpl(const Mat& image, const Rect2d& boundingBox)
 bool TrackerTLDImpl::updateImpl(const Mat& image, Rect2d& boundingBox)
 {
     Mat image_gray, image_blurred, imageForDetector;
-    cvtColor( image, image_gray, COLOR_BGR2GRAY );
+    tracking::FrameCache* cache = tracking::FrameCache::find(image);
+    if (cache)
+        image_gray = cache->gray(COLOR_BGR2GRAY);
+    else
+        cvtColor( image, image_gray, COLOR_BGR2GRAY );
     double scale = data->getScale();
     if( scale > 1.0 )
         resize(image_gray, imageForDetector, Size(cvRound(image.cols*scale), cvRound(image.rows*scale)), 0, 0, DOWNSCALE_MODE);
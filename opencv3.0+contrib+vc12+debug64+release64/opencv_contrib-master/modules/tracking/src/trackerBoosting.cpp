@@ -41,6 +41,7 @@
 
 #include "precomp.hpp"
 #include "trackerBoostingModel.hpp"
+#include "frameCache.hpp"
 
 namespace cv
 {
@@ -204,9 +205,20 @@ bool TrackerBoostingImpl::updateImpl( const Mat& image, Rect2d& boundingBox )
 {
   Mat_<int> intImage;
   Mat_<double> intSqImage;
-  Mat image_;
-  cvtColor( image, image_, CV_RGB2GRAY );
-  integral( image_, intImage, intSqImage, CV_32S );
+  tracking::FrameCache* cache = tracking::FrameCache::find( image );
+  if( cache )
+  {
+    Mat sum, sqsum;
+    cache->integrals( CV_RGB2GRAY, sum, sqsum );
+    intImage = sum;
+    intSqImage = sqsum;
+  }
+  else
+  {
+    Mat image_;
+    cvtColor( image, image_, CV_RGB2GRAY );
+    integral( image_, intImage, intSqImage, CV_32S );
+  }
   //get the last location [AAM] X(k-1)
   Ptr<TrackerTargetState> lastLocation = model->getLastTargetState();
   Rect lastBoundingBox( (int)lastLocation->getTargetPosition().x, (int)lastLocation->getTargetPosition().y, lastLocation->getTargetWidth(),
@@ -195,6 +195,107 @@ bool TrackerFeatureHAAR::swapFeature( int source, int target )
   return true;
 }
 
+/*
+ * Dense Haar feature engine: the samples produced by the CSC sampler are ROIs of one integral image,
+ * so every rectangle corner of a feature lies at the same element offset from each sample origin.
+ * The offsets are computed once per call and all (feature, sample) pairs are evaluated as a dense
+ * matrix, one feature row at a time, giving the same values as FeatureHaar::eval().
+ */
+class HaarDenseEvaluator : public cv::ParallelLoopBody
+{
+ public:
+  HaarDenseEvaluator( const std::vector<CvHaarEvaluator::FeatureHaar>& features, const std::vector<int>& featureIds,
+                      const std::vector<Mat>& images, Mat& response ) :
+      ids( featureIds ),
+      response_( response )
+  {
+    const Mat& first = images[0];
+    const int elemStep = (int) ( first.step[0] / first.elemSize() );
+    areaStart.resize( ids.size() + 1 );
+    areaStart[0] = 0;
+    for ( size_t j = 0; j < ids.size(); j++ )
+    {
+      const CvHaarEvaluator::FeatureHaar& feature = features[ids[j]];
+      const std::vector<Rect>& areas = feature.getAreas();
+      const std::vector<float>& weights = feature.getWeights();
+      for ( size_t a = 0; a < areas.size(); a++ )
+      {
+        //same clipping as FeatureHaar::getSum
+        int x = areas[a].x, y = areas[a].y, w = areas[a].width, h = areas[a].height;
+        if( x + w >= first.cols - 1 )
+          w = ( first.cols - 1 ) - x;
+        if( y + h >= first.rows - 1 )
+          h = ( first.rows - 1 ) - y;
+        corners.push_back( ( y + h ) * elemStep + x + w );
+        corners.push_back( y * elemStep + x );
+        corners.push_back( y * elemStep + x + w );
+        corners.push_back( ( y + h ) * elemStep + x );
+        scaleWeights.push_back( (float) weights[a] / (float) ( areas[a].width * areas[a].height ) );
+      }
+      areaStart[j + 1] = (int) scaleWeights.size();
+    }
+
+    origins.resize( images.size() );
+    for ( size_t i = 0; i < images.size(); i++ )
+      origins[i] = images[i].data;
+    depth = first.depth();
+  }
+
+  // all the samples must be single-channel ROIs of the same integral image
+  static bool isApplicable( const std::vector<Mat>& images )
+  {
+    const Mat& first = images[0];
+    if( first.channels() != 1 || ( first.depth() != CV_32S && first.depth() != CV_32F && first.depth() != CV_64F ) )
+      return false;
+    for ( size_t i = 1; i < images.size(); i++ )
+    {
+      if( images[i].size() != first.size() || images[i].type() != first.type() || images[i].step[0] != first.step[0] )
+        return false;
+    }
+    return true;
+  }
+
+  virtual void operator()( const cv::Range &r ) const
+  {
+    if( depth == CV_32S )
+      evaluate<int>( r );
+    else if( depth == CV_32F )
+      evaluate<float>( r );
+    else
+      evaluate<double>( r );
+  }
+
+ private:
+  template<typename T>
+  void evaluate( const cv::Range &r ) const
+  {
+    const int nsamples = (int) origins.size();
+    for ( int j = r.start; j < r.end; j++ )
+    {
+      float* dst = (float*) response_.ptr( ids[j] );
+      for ( int i = 0; i < nsamples; i++ )
+      {
+        const T* p = (const T*) origins[i];
+        float res = 0.0f;
+        for ( int a = areaStart[j]; a < areaStart[j + 1]; a++ )
+        {
+          const int* c = &corners[4 * a];
+          res += static_cast<float>( p[c[0]] + p[c[1]] - p[c[2]] - p[c[3]] ) * scaleWeights[a];
+        }
+        dst[i] = res;
+      }
+    }
+  }
+
+  const std::vector<int>& ids;
+  Mat response_;
+  std::vector<int> areaStart;
+  std::vector<int> corners;
+  std::vector<float> scaleWeights;
+  std::vector<const uchar*> origins;
+  int depth;
+};
+
 bool TrackerFeatureHAAR::extractSelected( const std::vector<int> selFeatures, const std::vector<Mat>& images, Mat& response )
 {
   if( images.empty() )
@@ -209,6 +310,13 @@ bool TrackerFeatureHAAR::extractSelected( const std::vector<int> selFeatures, co
   response.create( Size( (int)images.size(), numFeatures ), CV_32F );
   response.setTo( 0 );
 
+  if( HaarDenseEvaluator::isApplicable( images ) )
+  {
+    parallel_for_( Range( 0, numSelFeatures ),
+                   HaarDenseEvaluator( featureEvaluator->getFeatures(), selFeatures, images, response ) );
+    return true;
+  }
+
   //double t = getTickCount();
   //for each sample compute #n_feature -> put each feature (n Rect) in response
   for ( size_t i = 0; i < images.size(); i++ )
@@ -275,7 +383,15 @@ bool TrackerFeatureHAAR::computeImpl( const std::vector<Mat>& images, Mat& respo
 
   response = Mat_<float>( Size( (int)images.size(), numFeatures ) );
 
-  std::vector<CvHaarEvaluator::FeatureHaar> f = featureEvaluator->getFeatures();
+  if( HaarDenseEvaluator::isApplicable( images ) )
+  {
+    std::vector<int> ids( numFeatures );
+    for ( int j = 0; j < numFeatures; j++ )
+      ids[j] = j;
+    parallel_for_( Range( 0, numFeatures ), HaarDenseEvaluator( featureEvaluator->getFeatures(), ids, images, response ) );
+    return true;
+  }
+
   //for each sample compute #n_feature -> put each feature (n Rect) in response
   parallel_for_( Range( 0, (int)images.size() ), Parallel_compute( featureEvaluator, images, response ) );
 
@@ -65,6 +65,79 @@ namespace cv{
 |---------------------------*/
 namespace cv{
 
+  /*
+   * The spectra are kept in the CCS packed format produced by dft() for real
+   * input (see the dft() documentation): the first column, and the last one
+   * when the width is even, hold the spectrum of a real column with real
+   * values at the top (and the bottom for even height) and (re, im) pairs
+   * down the column, the other columns hold (re, im) pairs along the rows.
+   * The functor is called with the positions of the real and imaginary parts
+   * of every element, the imaginary part is -1 for the purely real ones.
+   */
+  template<typename Op> static void forEachSpectrumElement(const Size sz, Op& op){
+    int lastCol = sz.width % 2 == 0 && sz.width > 1 ? sz.width - 1 : 0;
+    for(int c = 0; ; c = lastCol){
+      op(0, c, -1, -1);
+      int i = 1;
+      for(; i + 1 < sz.height; i += 2)
+        op(i, c, i + 1, c);
+      if(i < sz.height)
+        op(i, c, -1, -1);
+      if(c == lastCol)
+        break;
+    }
+
+    int endCol = sz.width % 2 == 0 ? sz.width - 1 : sz.width;
+    for(int i = 0; i < sz.height; i++){
+      for(int j = 1; j < endCol; j += 2)
+        op(i, j, i, j + 1);
+    }
+  }
+
+  // dst = a / b
+  struct DivSpectrumsOp{
+    DivSpectrumsOp(const Mat& _a, const Mat& _b, Mat& _dst) : a(_a), b(_b), dst(_dst){}
+    void operator()(int r0, int c0, int r1, int c1){
+      float ar = a.at<float>(r0, c0), br = b.at<float>(r0, c0);
+      if(r1 < 0){
+        dst.at<float>(r0, c0) = ar / br;
+        return;
+      }
+      //z=(a+bi)/(c+di)=[(ac+bd)+i(bc-ad)]/(c^2+d^2)
+      float ai = a.at<float>(r1, c1), bi = b.at<float>(r1, c1);
+      float den = 1.f / (br * br + bi * bi);
+      dst.at<float>(r0, c0) = (ar * br + ai * bi) * den;
+      dst.at<float>(r1, c1) = (ai * br - ar * bi) * den;
+    }
+    const Mat& a;
+    const Mat& b;
+    Mat& dst;
+  };
+
+  // adds a real value to every element of the spectrum
+  struct AddRealOp{
+    AddRealOp(Mat& _dst, float _value) : dst(_dst), value(_value){}
+    void operator()(int r0, int c0, int, int){
+      dst.at<float>(r0, c0) += value;
+    }
+    Mat& dst;
+    float value;
+  };
+
+  static void divSpectrums(const Mat& a, const Mat& b, Mat& dst){
+    CV_Assert(a.type() == CV_32FC1 && b.type() == CV_32FC1 && a.size() == b.size());
+    dst.create(a.size(), CV_32FC1);
+    DivSpectrumsOp op(a, b, dst);
+    forEachSpectrumElement(a.size(), op);
+  }
+
+  static void addRealSpectrum(const Mat& src, float value, Mat& dst){
+    CV_Assert(src.type() == CV_32FC1);
+    src.copyTo(dst);
+    AddRealOp op(dst, value);
+    forEachSpectrumElement(src.size(), op);
+  }
+
   /*
  * Prototype
  */
@@ -94,7 +167,7 @@ namespace cv{
     void inline pixelWiseMult(const std::vector<Mat> src1, const std::vector<Mat>  src2, std::vector<Mat>  & dest, const int flags, const bool conjB=false) const;
     void inline sumChannels(std::vector<Mat> src, Mat & dest) const;
     void inline updateProjectionMatrix(const Mat src, Mat & old_cov,Mat &  proj_matrix,double pca_rate, int compressed_sz,
-                                       std::vector<Mat> & layers_pca,std::vector<Scalar> & average, Mat pca_data, Mat new_cov, Mat w, Mat u, Mat v) const;
+                                       Mat & pca_mean, Mat & new_cov, Mat & w, Mat & u, Mat & vt) const;
     void inline compress(const Mat proj_matrix, const Mat src, Mat & dest, Mat & data, Mat & compressed) const;
     bool getSubWindow(const Mat img, const Rect roi, Mat& feat, Mat& patch, TrackerKCF::MODE desc = GRAY) const;
     bool getSubWindow(const Mat img, const Rect roi, Mat& feat, void (*f)(const Mat, const Rect, Mat& )) const;
@@ -111,8 +184,7 @@ namespace cv{
   private:
     double output_sigma;
     Rect2d roi;
-    Mat hann; 	//hann window filter
-    Mat hann_cn; //10 dimensional hann-window filter for CN features,
+    Mat hann; 	//hann window filter, applied to every feature channel
 
     Mat y,yf; 	// training response and its FFT
     Mat x; 	// observation and its FFT
@@ -130,9 +202,8 @@ namespace cv{
     std::vector<Mat> vxf,vyf,vxyf;
     Mat xy_data,xyf_data;
     Mat data_temp, compress_data;
-    std::vector<Mat> layers_pca_data;
-    std::vector<Scalar> average_data;
     Mat img_Patch;
+    Mat img_resized;
 
     // storage for the extracted features, KRLS model, KRLS compressed model
     Mat X[2],Z[2],Zc[2];
@@ -144,7 +215,7 @@ namespace cv{
     std::vector<MODE> descriptors_npca;
 
     // optimization variables for updateProjectionMatrix
-    Mat data_pca, new_covar,w_data,u_data,vt_data;
+    Mat mean_pca, new_covar,w_data,u_data,vt_data;
 
     // custom feature extractor
     bool use_custom_extractor_pca;
@@ -212,17 +283,13 @@ namespace cv{
     roi.height*=2;
 
     // initialize the hann window filter
-    createHanningWindow(hann, roi.size(), CV_64F);
-
-    // hann window filter for CN feature
-    Mat _layer[] = {hann, hann, hann, hann, hann, hann, hann, hann, hann, hann};
-    merge(_layer, 10, hann_cn);
+    createHanningWindow(hann, roi.size(), CV_32F);
 
     // create gaussian response
-    y=Mat::zeros((int)roi.height,(int)roi.width,CV_64F);
+    y=Mat::zeros((int)roi.height,(int)roi.width,CV_32F);
     for(unsigned i=0;i<roi.height;i++){
       for(unsigned j=0;j<roi.width;j++){
-        y.at<double>(i,j)=(i-roi.height/2+1)*(i-roi.height/2+1)+(j-roi.width/2+1)*(j-roi.width/2+1);
+        y.at<float>(i,j)=(float)((i-roi.height/2+1)*(i-roi.height/2+1)+(j-roi.width/2+1)*(j-roi.width/2+1));
       }
     }
 
@@ -271,12 +338,15 @@ namespace cv{
     double minVal, maxVal;	// min-max response
     Point minLoc,maxLoc;	// min-max location
 
-    Mat img=image.clone();
     // check the channels of the input image, grayscale is preferred
-    CV_Assert(img.channels() == 1 || img.channels() == 3);
+    CV_Assert(image.channels() == 1 || image.channels() == 3);
 
-    // resize the image whenever needed
-    if(resizeImage)resize(img,img,Size(img.cols/2,img.rows/2));
+    // resize the image whenever needed, the frame itself is only read
+    Mat img=image;
+    if(resizeImage){
+      resize(image,img_resized,Size(image.cols/2,image.rows/2));
+      img=img_resized;
+    }
 
     // detection part
     if(frame>0){
@@ -328,7 +398,6 @@ namespace cv{
 
       // compute the fourier transform of the kernel
       fft2(k,kf);
-      if(frame==1)spec2=Mat_<Vec2d >(kf.rows, kf.cols);
 
       // calculate filter response
       if(params.split_coeff)
@@ -380,13 +449,8 @@ namespace cv{
 
     if(params.desc_pca !=0 || use_custom_extractor_pca){
       // initialize the vector of Mat variables
-      if(frame==0){
-        layers_pca_data.resize(Z[0].channels());
-        average_data.resize(Z[0].channels());
-      }
-
       // feature compression
-      updateProjectionMatrix(Z[0],old_cov_mtx,proj_mtx,params.pca_learning_rate,params.compressed_size,layers_pca_data,average_data,data_pca, new_covar,w_data,u_data,vt_data);
+      updateProjectionMatrix(Z[0],old_cov_mtx,proj_mtx,params.pca_learning_rate,params.compressed_size,mean_pca,new_covar,w_data,u_data,vt_data);
       compress(proj_mtx,X[0],X[0],data_temp,compress_data);
     }
 
@@ -404,7 +468,6 @@ namespace cv{
       vxf.resize(x.channels());
       vyf.resize(x.channels());
       vxyf.resize(vyf.size());
-      new_alphaf=Mat_<Vec2d >(yf.rows, yf.cols);
     }
 
     // Kernel Regularized Least-Squares, calculate alphas
@@ -412,23 +475,13 @@ namespace cv{
 
     // compute the fourier transform of the kernel and add a small value
     fft2(k,kf);
-    kf_lambda=kf+params.lambda;
+    addRealSpectrum(kf,(float)params.lambda,kf_lambda);
 
-    double den;
     if(params.split_coeff){
       mulSpectrums(yf,kf,new_alphaf,0);
       mulSpectrums(kf,kf_lambda,new_alphaf_den,0);
     }else{
-      for(int i=0;i<yf.rows;i++){
-        for(int j=0;j<yf.cols;j++){
-          den = 1.0/(kf_lambda.at<Vec2d>(i,j)[0]*kf_lambda.at<Vec2d>(i,j)[0]+kf_lambda.at<Vec2d>(i,j)[1]*kf_lambda.at<Vec2d>(i,j)[1]);
-
-          new_alphaf.at<Vec2d>(i,j)[0]=
-          (yf.at<Vec2d>(i,j)[0]*kf_lambda.at<Vec2d>(i,j)[0]+yf.at<Vec2d>(i,j)[1]*kf_lambda.at<Vec2d>(i,j)[1])*den;
-          new_alphaf.at<Vec2d>(i,j)[1]=
-          (yf.at<Vec2d>(i,j)[1]*kf_lambda.at<Vec2d>(i,j)[0]-yf.at<Vec2d>(i,j)[0]*kf_lambda.at<Vec2d>(i,j)[1])*den;
-        }
-      }
+      divSpectrums(yf,kf_lambda,new_alphaf);
     }
 
     // update the RLS model
@@ -491,14 +544,14 @@ namespace cv{
    * simplification of fourier transform function in opencv
    */
   void inline TrackerKCFImpl::fft2(const Mat src, Mat & dest) const {
-    dft(src,dest,DFT_COMPLEX_OUTPUT);
+    dft(src,dest); // CCS packed spectrum of the real input
   }
 
   void inline TrackerKCFImpl::fft2(const Mat src, std::vector<Mat> & dest, std::vector<Mat> & layers_data) const {
     split(src, layers_data);
 
     for(int i=0;i<src.channels();i++){
-      dft(layers_data[i],dest[i],DFT_COMPLEX_OUTPUT);
+      dft(layers_data[i],dest[i]);
     }
   }
 
@@ -532,35 +585,28 @@ namespace cv{
    * obtains the projection matrix using PCA
    */
   void inline TrackerKCFImpl::updateProjectionMatrix(const Mat src, Mat & old_cov,Mat &  proj_matrix, double pca_rate, int compressed_sz,
-                                                     std::vector<Mat> & layers_pca,std::vector<Scalar> & average, Mat pca_data, Mat new_cov, Mat w, Mat u, Mat vt) const {
+                                                     Mat & pca_mean, Mat & new_cov, Mat & w, Mat & u, Mat & vt) const {
     CV_Assert(compressed_sz<=src.channels());
 
-    split(src,layers_pca);
-
-    for (int i=0;i<src.channels();i++){
-      average[i]=mean(layers_pca[i]);
-      layers_pca[i]-=average[i];
-    }
-
-    // calc covariance matrix
-    merge(layers_pca,pca_data);
-    pca_data=pca_data.reshape(1,src.rows*src.cols);
-
-    new_cov=1.0/(double)(src.rows*src.cols-1)*(pca_data.t()*pca_data);
+    // calc covariance matrix of the channels, accumulated in double precision
+    Mat pca_data=src.reshape(1,src.rows*src.cols);
+    calcCovarMatrix(pca_data, new_cov, pca_mean, COVAR_NORMAL | COVAR_ROWS, CV_64F);
+    new_cov*=1.0/(double)(src.rows*src.cols-1);
     if(old_cov.rows==0)old_cov=new_cov.clone();
 
     // calc PCA
     SVD::compute((1.0-pca_rate)*old_cov+pca_rate*new_cov, w, u, vt);
 
     // extract the projection matrix
-    proj_matrix=u(Rect(0,0,compressed_sz,src.channels())).clone();
-    Mat proj_vars=Mat::eye(compressed_sz,compressed_sz,proj_matrix.type());
+    Mat proj=u(Rect(0,0,compressed_sz,src.channels()));
+    Mat proj_vars=Mat::eye(compressed_sz,compressed_sz,proj.type());
     for(int i=0;i<compressed_sz;i++){
       proj_vars.at<double>(i,i)=w.at<double>(i);
     }
 
     // update the covariance matrix
-    old_cov=(1.0-pca_rate)*old_cov+pca_rate*proj_matrix*proj_vars*proj_matrix.t();
+    old_cov=(1.0-pca_rate)*old_cov+pca_rate*proj*proj_vars*proj.t();
+    proj.convertTo(proj_matrix,CV_32F);
   }
 
   /*
@@ -603,21 +649,30 @@ namespace cv{
     copyMakeBorder(patch,patch,addTop,addBottom,addLeft,addRight,BORDER_REPLICATE);
     if(patch.rows==0 || patch.cols==0)return false;
 
-    // extract the desired descriptors
+    // extract the desired descriptors, the hann window filter is applied on the fly
     switch(desc){
       case CN:
         CV_Assert(img.channels() == 3);
         extractCN(patch,feat);
-        feat=feat.mul(hann_cn); // hann window filter
         break;
       default: // GRAY
         if(img.channels()>1)
-          cvtColor(patch,feat, CV_BGR2GRAY);
-        else
-          feat=patch;
-        feat.convertTo(feat,CV_64F);
-        feat=feat/255.0-0.5; // normalize to range -0.5 .. 0.5
-        feat=feat.mul(hann); // hann window filter
+          cvtColor(patch,patch, CV_BGR2GRAY);
+        CV_Assert(patch.channels() == 1 && patch.size() == hann.size());
+        if(patch.depth()!=CV_8U){
+          // other depths are normalized the same way, just not through the 8-bit fast path
+          patch.convertTo(feat,CV_32F,1.0/255.0,-0.5);
+          feat=feat.mul(hann);
+          break;
+        }
+        feat.create(patch.size(),CV_32F);
+        for(int i=0;i<patch.rows;i++){
+          const uchar* src=patch.ptr<uchar>(i);
+          const float* w=hann.ptr<float>(i);
+          float* dst=feat.ptr<float>(i);
+          for(int j=0;j<patch.cols;j++)
+            dst[j]=(src[j]*(1.f/255.f)-0.5f)*w[j]; // normalize to range -0.5 .. 0.5
+        }
         break;
     }
 
@@ -644,37 +699,37 @@ namespace cv{
       printf("Rules: roi.width==feat.cols && roi.height = feat.rows \n");
     }
 
-    Mat hann_win;
-    std::vector<Mat> _layers;
-
-    for(int i=0;i<feat.channels();i++)
-      _layers.push_back(hann);
-
-    merge(_layers, hann_win);
-
-    feat=feat.mul(hann_win); // hann window filter
+    // hann window filter
+    feat.convertTo(feat,CV_32F);
+    int cn=feat.channels();
+    for(int i=0;i<feat.rows;i++){
+      const float* w=hann.ptr<float>(i);
+      float* dst=feat.ptr<float>(i);
+      for(int j=0;j<feat.cols;j++,dst+=cn){
+        for(int _k=0;_k<cn;_k++)
+          dst[_k]*=w[j];
+      }
+    }
 
     return true;
   }
 
-  /* Convert BGR to ColorNames
+  /* Convert BGR to ColorNames multiplied by the hann window
    */
   void TrackerKCFImpl::extractCN(Mat patch_data, Mat & cnFeatures) const {
-    Vec3b & pixel = patch_data.at<Vec3b>(0,0);
-    unsigned index;
-
-    if(cnFeatures.type() != CV_64FC(10))
-      cnFeatures = Mat::zeros(patch_data.rows,patch_data.cols,CV_64FC(10));
+    CV_Assert(patch_data.type() == CV_8UC3 && patch_data.size() == hann.size());
+    cnFeatures.create(patch_data.rows,patch_data.cols,CV_32FC(10));
+    const float* colorNames=getColorNamesFloat();
 
     for(int i=0;i<patch_data.rows;i++){
-      for(int j=0;j<patch_data.cols;j++){
-        pixel=patch_data.at<Vec3b>(i,j);
-        index=(unsigned)(floor((float)pixel[2]/8)+32*floor((float)pixel[1]/8)+32*32*floor((float)pixel[0]/8));
-
-        //copy the values
-        for(int _k=0;_k<10;_k++){
-          cnFeatures.at<Vec<double,10> >(i,j)[_k]=ColorNames[index][_k];
-        }
+      const uchar* pixel=patch_data.ptr<uchar>(i);
+      const float* w=hann.ptr<float>(i);
+      float* dst=cnFeatures.ptr<float>(i);
+      for(int j=0;j<patch_data.cols;j++,pixel+=3,dst+=10){
+        // the table is indexed by the 5 most significant bits of R, G and B
+        const float* cn=colorNames+((pixel[2]>>3)+((pixel[1]>>3)<<5)+((pixel[0]>>3)<<10))*10;
+        for(int _k=0;_k<10;_k++)
+          dst[_k]=cn[_k]*w[j];
       }
     }
 
@@ -704,19 +759,16 @@ namespace cv{
       shiftCols(xyf, x_data.cols/2);
     }
 
-    //(xx + yy - 2 * xy) / numel(x)
-    xy=(normX+normY-2*xyf)/(x_data.rows*x_data.cols*x_data.channels());
-
-    // TODO: check wether we really need thresholding or not
-    //threshold(xy,xy,0.0,0.0,THRESH_TOZERO);//max(0, (xx + yy - 2 * xy) / numel(x))
-    for(int i=0;i<xy.rows;i++){
-      for(int j=0;j<xy.cols;j++){
-        if(xy.at<double>(i,j)<0.0)xy.at<double>(i,j)=0.0;
-      }
+    //-max(0, (xx + yy - 2 * xy) / numel(x)) / sigma^2
+    float scale=(float)(-1.0/(sigma*sigma*x_data.rows*x_data.cols*x_data.channels()));
+    float norm_sum=(float)(normX+normY);
+    xy.create(xyf.size(),CV_32F);
+    for(int i=0;i<xyf.rows;i++){
+      const float* src=xyf.ptr<float>(i);
+      float* dst=xy.ptr<float>(i);
+      for(int j=0;j<xyf.cols;j++)
+        dst[j]=std::max(norm_sum-2.f*src[j],0.f)*scale;
     }
-
-    double sig=-1.0/(sigma*sigma);
-    xy=sig*xy;
     exp(xy,k_data);
 
   }
@@ -787,19 +839,7 @@ namespace cv{
   void TrackerKCFImpl::calcResponse(const Mat alphaf_data, const Mat _alphaf_den, const Mat kf_data, Mat & response_data, Mat & spec_data, Mat & spec2_data) const {
 
     mulSpectrums(alphaf_data,kf_data,spec_data,0,false);
-
-    //z=(a+bi)/(c+di)=[(ac+bd)+i(bc-ad)]/(c^2+d^2)
-    double den;
-    for(int i=0;i<kf_data.rows;i++){
-      for(int j=0;j<kf_data.cols;j++){
-        den=1.0/(_alphaf_den.at<Vec2d>(i,j)[0]*_alphaf_den.at<Vec2d>(i,j)[0]+_alphaf_den.at<Vec2d>(i,j)[1]*_alphaf_den.at<Vec2d>(i,j)[1]);
-        spec2_data.at<Vec2d>(i,j)[0]=
-          (spec_data.at<Vec2d>(i,j)[0]*_alphaf_den.at<Vec2d>(i,j)[0]+spec_data.at<Vec2d>(i,j)[1]*_alphaf_den.at<Vec2d>(i,j)[1])*den;
-        spec2_data.at<Vec2d>(i,j)[1]=
-          (spec_data.at<Vec2d>(i,j)[1]*_alphaf_den.at<Vec2d>(i,j)[0]-spec_data.at<Vec2d>(i,j)[0]*_alphaf_den.at<Vec2d>(i,j)[1])*den;
-      }
-    }
-
+    divSpectrums(spec_data,_alphaf_den,spec2_data);
     ifft2(spec2_data,response_data);
   }
 
@@ -41,6 +41,7 @@
 
 #include "precomp.hpp"
 #include "trackerMILModel.hpp"
+#include "frameCache.hpp"
 
 namespace cv
 {
@@ -198,7 +199,11 @@ bool TrackerMILImpl::initImpl( const Mat& image, const Rect2d& boundingBox )
 bool TrackerMILImpl::updateImpl( const Mat& image, Rect2d& boundingBox )
 {
   Mat intImage;
-  compute_integral( image, intImage );
+  tracking::FrameCache* cache = tracking::FrameCache::find( image );
+  if( cache )
+    intImage = cache->firstChannelIntegral();
+  else
+    compute_integral( image, intImage );
 
   //get the last location [AAM] X(k-1)
   Ptr<TrackerTargetState> lastLocation = model->getLastTargetState();
@@ -40,8 +40,11 @@
  //M*/
 
 #include "precomp.hpp"
+#include "frameCache.hpp"
+#include "trackerMedianFlowScale.hpp"
 #include "opencv2/video/tracking.hpp"
 #include "opencv2/imgproc.hpp"
+#include "opencv2/core/hal/intrin.hpp"
 #include <algorithm>
 #include <limits.h>
 
@@ -79,7 +82,9 @@ public:
 private:
     bool initImpl( const Mat& image, const Rect2d& boundingBox );
     bool updateImpl( const Mat& image, Rect2d& boundingBox );
-    bool medianFlowImpl(Mat oldImage,Mat newImage,Rect2d& oldBox);
+    void toGray(const Mat& image, Mat& gray) const;
+    bool medianFlowImpl(const Mat& oldImage_gray,const std::vector<Mat>& oldImagePyr,
+                        const Mat& newImage_gray,const std::vector<Mat>& newImagePyr,Rect2d& oldBox);
     Rect2d vote(const std::vector<Point2f>& oldPoints,const std::vector<Point2f>& newPoints,const Rect2d& oldRect,Point2f& mD);
     float dist(Point2f p1,Point2f p2);
     std::string type2str(int type);
@@ -98,6 +103,47 @@ T getMedian( const std::vector<T>& values );
 template<typename T>
 T getMedianAndDoPartition( std::vector<T>& values );
 
+// Sums, sums of squares and the cross product of two 8-bit patches of the same
+// size, gathered in a single pass
+void patchMoments(const Mat& p1, const Mat& p2, double& s1, double& s2, double& n1sq, double& n2sq, double& prod)
+{
+    CV_Assert(p1.size() == p2.size() && p1.type() == CV_8UC1 && p2.type() == CV_8UC1);
+    int64 S1 = 0, S2 = 0, N1 = 0, N2 = 0, P = 0;
+    for (int y = 0; y < p1.rows; y++)
+    {
+        const uchar* a = p1.ptr<uchar>(y);
+        const uchar* b = p2.ptr<uchar>(y);
+        int x = 0;
+#if CV_SIMD128
+        v_uint32x4 vs1 = v_setzero_u32(), vs2 = v_setzero_u32();
+        v_int32x4 vn1 = v_setzero_s32(), vn2 = v_setzero_s32(), vp = v_setzero_s32();
+        for (; x <= p1.cols - 8; x += 8)
+        {
+            v_uint16x8 ua = v_load_expand(a + x), ub = v_load_expand(b + x);
+            v_int16x8 ia = v_reinterpret_as_s16(ua), ib = v_reinterpret_as_s16(ub);
+            v_uint32x4 lo, hi;
+            v_expand(ua, lo, hi);
+            vs1 += lo + hi;
+            v_expand(ub, lo, hi);
+            vs2 += lo + hi;
+            vn1 += v_dotprod(ia, ia);
+            vn2 += v_dotprod(ib, ib);
+            vp += v_dotprod(ia, ib);
+        }
+        S1 += v_reduce_sum(vs1); S2 += v_reduce_sum(vs2);
+        N1 += v_reduce_sum(vn1); N2 += v_reduce_sum(vn2); P += v_reduce_sum(vp);
+#endif
+        for (; x < p1.cols; x++)
+        {
+            int va = a[x], vb = b[x];
+            S1 += va; S2 += vb;
+            N1 += va * va; N2 += vb * vb; P += va * vb;
+        }
+    }
+    s1 = (double)S1; s2 = (double)S2;
+    n1sq = (double)N1; n2sq = (double)N2; prod = (double)P;
+}
+
 Mat getPatch(Mat image, Size patch_size, Point2f patch_center)
 {
     Mat patch;
@@ -120,16 +166,36 @@ Mat getPatch(Mat image, Size patch_size, Point2f patch_center)
     return patch;
 }
 
+// The model keeps the grayscale previous frame together with its LK pyramid,
+// so that every frame is converted and decimated only once.
 class TrackerMedianFlowModel : public TrackerModel{
 public:
     TrackerMedianFlowModel(TrackerMedianFlow::Params /*params*/){}
     Rect2d getBoundingBox(){return boundingBox_;}
     void setBoudingBox(Rect2d boundingBox){boundingBox_=boundingBox;}
     Mat getImage(){return image_;}
-    void setImage(const Mat& image){image.copyTo(image_);}
+    const std::vector<Mat>& getPyramid(const TrackerMedianFlow::Params& params){
+        if(pyramid_.empty() || pyrWinSize_ != params.winSize || pyrMaxLevel_ != params.maxLevel)
+            setImage(image_, params);
+        return pyramid_;
+    }
+    void setImage(const Mat& image, const TrackerMedianFlow::Params& params){
+        std::vector<Mat> pyramid;
+        buildOpticalFlowPyramid(image, pyramid, params.winSize, params.maxLevel, false);
+        setImage(image, pyramid, params);
+    }
+    void setImage(const Mat& image, std::vector<Mat>& pyramid, const TrackerMedianFlow::Params& params){
+        image_=image;
+        pyramid_.swap(pyramid);
+        pyrWinSize_=params.winSize;
+        pyrMaxLevel_=params.maxLevel;
+    }
 protected:
     Rect2d boundingBox_;
     Mat image_;
+    std::vector<Mat> pyramid_;
+    Size pyrWinSize_;
+    int pyrMaxLevel_;
     void modelEstimationImpl( const std::vector<Mat>& /*responses*/ ){}
     void modelUpdateImpl(){}
 };
@@ -144,23 +210,43 @@ void TrackerMedianFlowImpl::write( cv::FileStorage& fs ) const
     params.write( fs );
 }
 
+// Grayscale copy of the frame, owned by the tracker
+void TrackerMedianFlowImpl::toGray(const Mat& image, Mat& gray) const{
+    tracking::FrameCache* cache = tracking::FrameCache::find(image);
+    if (cache && image.channels() != 1)
+        gray = cache->gray(COLOR_BGR2GRAY);
+    else if (image.channels() != 1)
+        cvtColor( image, gray, COLOR_BGR2GRAY );
+    else
+        image.copyTo(gray);
+}
+
 bool TrackerMedianFlowImpl::initImpl( const Mat& image, const Rect2d& boundingBox ){
     model=Ptr<TrackerMedianFlowModel>(new TrackerMedianFlowModel(params));
-    ((TrackerMedianFlowModel*)static_cast<TrackerModel*>(model))->setImage(image);
+    Mat image_gray;
+    toGray(image, image_gray);
+    ((TrackerMedianFlowModel*)static_cast<TrackerModel*>(model))->setImage(image_gray, params);
     ((TrackerMedianFlowModel*)static_cast<TrackerModel*>(model))->setBoudingBox(boundingBox);
     return true;
 }
 
 bool TrackerMedianFlowImpl::updateImpl( const Mat& image, Rect2d& boundingBox ){
-    Mat oldImage=((TrackerMedianFlowModel*)static_cast<TrackerModel*>(model))->getImage();
+    TrackerMedianFlowModel* medianFlowModel=((TrackerMedianFlowModel*)static_cast<TrackerModel*>(model));
+    Mat oldImage_gray=medianFlowModel->getImage();
+    const std::vector<Mat>& oldImagePyr=medianFlowModel->getPyramid(params);
+
+    Mat newImage_gray;
+    toGray(image, newImage_gray);
+    std::vector<Mat> newImagePyr;
+    buildOpticalFlowPyramid(newImage_gray, newImagePyr, params.winSize, params.maxLevel, false);
 
-    Rect2d oldBox=((TrackerMedianFlowModel*)static_cast<TrackerModel*>(model))->getBoundingBox();
-    if(!medianFlowImpl(oldImage,image,oldBox)){
+    Rect2d oldBox=medianFlowModel->getBoundingBox();
+    if(!medianFlowImpl(oldImage_gray,oldImagePyr,newImage_gray,newImagePyr,oldBox)){
         return false;
     }
     boundingBox=oldBox;
-    ((TrackerMedianFlowModel*)static_cast<TrackerModel*>(model))->setImage(image);
-    ((TrackerMedianFlowModel*)static_cast<TrackerModel*>(model))->setBoudingBox(oldBox);
+    medianFlowModel->setImage(newImage_gray, newImagePyr, params);
+    medianFlowModel->setBoudingBox(oldBox);
     return true;
 }
 
@@ -197,20 +283,10 @@ size_t filterPointsInVectors(std::vector<T>& status, std::vector<Point2f>& vec1,
     return first_bad_idx;
 }
 
-bool TrackerMedianFlowImpl::medianFlowImpl(Mat oldImage,Mat newImage,Rect2d& oldBox){
+bool TrackerMedianFlowImpl::medianFlowImpl(const Mat& oldImage_gray,const std::vector<Mat>& oldImagePyr,
+                                           const Mat& newImage_gray,const std::vector<Mat>& newImagePyr,Rect2d& oldBox){
     std::vector<Point2f> pointsToTrackOld,pointsToTrackNew;
 
-    Mat oldImage_gray,newImage_gray;
-    if (oldImage.channels() != 1)
-        cvtColor( oldImage, oldImage_gray, COLOR_BGR2GRAY );
-    else
-        oldImage.copyTo(oldImage_gray);
-
-    if (newImage.channels() != 1)
-        cvtColor( newImage, newImage_gray, COLOR_BGR2GRAY );
-    else
-        newImage.copyTo(newImage_gray);
-
     //"open ended" grid
     for(int i=0;i<params.pointsInGrid;i++){
         for(int j=0;j<params.pointsInGrid;j++){
@@ -223,12 +299,6 @@ bool TrackerMedianFlowImpl::medianFlowImpl(Mat oldImage,Mat newImage,Rect2d& old
     std::vector<uchar> status(pointsToTrackOld.size());
     std::vector<float> errors(pointsToTrackOld.size());
 
-    std::vector<Mat> oldImagePyr;
-    buildOpticalFlowPyramid(oldImage_gray, oldImagePyr, params.winSize, params.maxLevel, false);
-
-    std::vector<Mat> newImagePyr;
-    buildOpticalFlowPyramid(newImage_gray, newImagePyr, params.winSize, params.maxLevel, false);
-
     calcOpticalFlowPyrLK(oldImagePyr,newImagePyr,pointsToTrackOld,pointsToTrackNew,status,errors,
                          params.winSize, params.maxLevel, params.termCriteria, 0);
 
@@ -315,17 +385,7 @@ Rect2d TrackerMedianFlowImpl::vote(const std::vector<Point2f>& oldPoints,const s
     newCenter.y+=yshift;
     mD=Point2f((float)xshift,(float)yshift);
 
-    std::vector<double> buf_for_scale(n*(n-1)/2, 0.0);
-    for(size_t i=0,ctr=0;i<n;i++){
-        for(size_t j=0;j<i;j++){
-            double nd=norm(newPoints[i] - newPoints[j]);
-            double od=norm(oldPoints[i] - oldPoints[j]);
-            buf_for_scale[ctr]=(od==0.0)?0.0:(nd/od);
-            ctr++;
-        }
-    }
-
-    double scale=getMedianAndDoPartition(buf_for_scale);
+    double scale=medianFlowScaleChange(oldPoints,newPoints);
     dprintf(("xshift, yshift, scale = %f %f %f\n",xshift,yshift,scale));
     newRect.x=newCenter.x-scale*oldRect.width/2.0;
     newRect.y=newCenter.y-scale*oldRect.height/2.0;
@@ -379,6 +439,7 @@ void TrackerMedianFlowImpl::check_FB(const std::vector<Mat>& oldImagePyr, const
 void TrackerMedianFlowImpl::check_NCC(const Mat& oldImage,const Mat& newImage,
                                       const std::vector<Point2f>& oldPoints,const std::vector<Point2f>& newPoints,std::vector<bool>& status){
 
+    CV_Assert(oldImage.type() == CV_8UC1 && newImage.type() == CV_8UC1);
     std::vector<float> NCC(oldPoints.size(),0.0);
     Mat p1,p2;
 
@@ -387,10 +448,9 @@ void TrackerMedianFlowImpl::check_NCC(const Mat& oldImage,const Mat& newImage,
         p2 = getPatch(newImage, params.winSizeNCC, newPoints[i]);
 
         const int patch_area=params.winSizeNCC.area();
-        double s1=sum(p1)(0),s2=sum(p2)(0);
-        double n1=norm(p1),n2=norm(p2);
-        double prod=p1.dot(p2);
-        double sq1=sqrt(n1*n1-s1*s1/patch_area),sq2=sqrt(n2*n2-s2*s2/patch_area);
+        double s1,s2,n1sq,n2sq,prod;
+        patchMoments(p1,p2,s1,s2,n1sq,n2sq,prod);
+        double sq1=sqrt(n1sq-s1*s1/patch_area),sq2=sqrt(n2sq-s2*s2/patch_area);
         double ares=(sq2==0)?sq1/abs(sq1):(prod-s1*s2/patch_area)/sq1/sq2;
 
         NCC[i] = (float)ares;
@@ -482,6 +542,39 @@ void TrackerMedianFlow::Params::write( cv::FileStorage& fs ) const{
     fs << "maxMedianLengthOfDisplacementDifference" << maxMedianLengthOfDisplacementDifference;
 }
 
+double medianFlowScaleChange(const std::vector<Point2f>& oldPoints,const std::vector<Point2f>& newPoints){
+    CV_DbgAssert(oldPoints.size()==newPoints.size() && oldPoints.size()>=2);
+    const size_t n=oldPoints.size();
+    const size_t maxPairs=5000;
+
+    // For dense grids the median of all n(n-1)/2 distance ratios is estimated
+    // from a fixed-seed random subset of the pairs, drawn uniformly over all of them.
+    std::vector<double> buf_for_scale;
+    if(n*(n-1)/2 <= maxPairs){
+        buf_for_scale.resize(n*(n-1)/2);
+        for(size_t i=0,ctr=0;i<n;i++){
+            for(size_t j=0;j<i;j++){
+                double nd=norm(newPoints[i] - newPoints[j]);
+                double od=norm(oldPoints[i] - oldPoints[j]);
+                buf_for_scale[ctr]=(od==0.0)?0.0:(nd/od);
+                ctr++;
+            }
+        }
+    }else{
+        buf_for_scale.resize(maxPairs);
+        RNG rng(0x12345678);
+        for(size_t ctr=0;ctr<maxPairs;ctr++){
+            size_t i=rng.uniform(0,(int)n);
+            size_t j=rng.uniform(0,(int)n-1);
+            if(j>=i) ++j;
+            double nd=norm(newPoints[i] - newPoints[j]);
+            double od=norm(oldPoints[i] - oldPoints[j]);
+            buf_for_scale[ctr]=(od==0.0)?0.0:(nd/od);
+        }
+    }
+    return getMedianAndDoPartition(buf_for_scale);
+}
+
 Ptr<TrackerMedianFlow> TrackerMedianFlow::createTracker(const TrackerMedianFlow::Params &parameters){
     return Ptr<TrackerMedianFlowImpl>(new TrackerMedianFlowImpl(parameters));
 }
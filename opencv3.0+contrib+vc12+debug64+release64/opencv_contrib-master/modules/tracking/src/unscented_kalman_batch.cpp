@@ -0,0 +1,486 @@
+/*M///////////////////////////////////////////////////////////////////////////////////////
+ //
+ //  IMPORTANT: READ BEFORE DOWNLOADING, COPYING, INSTALLING OR USING.
+ //
+ //  By downloading, copying, installing or using the software you agree to this license.
+ //  If you do not agree to this license, do not download, install,
+ //  copy or use the software.
+ //
+ //
+ //                           License Agreement
+ //                For Open Source Computer Vision Library
+ //
+ // Copyright (C) 2015, OpenCV Foundation, all rights reserved.
+ // Third party copyrights are property of their respective owners.
+ //
+ // Redistribution and use in source and binary forms, with or without modification,
+ // are permitted provided that the following conditions are met:
+ //
+ //   * Redistribution's of source code must retain the above copyright notice,
+ //     this list of conditions and the following disclaimer.
+ //
+ //   * Redistribution's in binary form must reproduce the above copyright notice,
+ //     this list of conditions and the following disclaimer in the documentation
+ //     and/or other materials provided with the distribution.
+ //
+ //   * The name of the copyright holders may not be used to endorse or promote products
+ //     derived from this software without specific prior written permission.
+ //
+ // This software is provided by the copyright holders and contributors "as is" and
+ // any express or implied warranties, including, but not limited to, the implied
+ // warranties of merchantability and fitness for a particular purpose are disclaimed.
+ // In no event shall the Intel Corporation or contributors be liable for any direct,
+ // indirect, incidental, special, exemplary, or consequential damages
+ // (including, but not limited to, procurement of substitute goods or services;
+ // loss of use, data, or profits; or business interruption) however caused
+ // and on any theory of liability, whether in contract, strict liability,
+ // or tort (including negligence or otherwise) arising in any way out of
+ // the use of this software, even if advised of the possibility of such damage.
+ //
+ //M*/
+
+#include "precomp.hpp"
+#include "opencv2/tracking/kalman_filters.hpp"
+
+namespace cv
+{
+namespace tracking
+{
+
+void UkfSystemModel::stateConversionFunctionBatch( const Mat& x_k, const Mat& u_k, const Mat& v_k, Mat& x_kplus1 )
+{
+    CV_Assert( x_kplus1.cols == x_k.cols && v_k.cols == x_k.cols );
+    CV_Assert( u_k.empty() || u_k.cols == x_k.cols );
+    Mat u;
+    for ( int i = 0; i < x_k.cols; i++ )
+    {
+        Mat dst = x_kplus1.col( i );
+        Mat fx = dst;
+        if ( !u_k.empty() )
+            u = u_k.col( i );
+        stateConversionFunction( x_k.col( i ), u, v_k.col( i ), fx );
+        if ( fx.data != dst.data )
+            fx.copyTo( dst );
+    }
+}
+
+void UkfSystemModel::measurementFunctionBatch( const Mat& x_k, const Mat& n_k, Mat& z_k )
+{
+    CV_Assert( z_k.cols == x_k.cols && n_k.cols == x_k.cols );
+    for ( int i = 0; i < x_k.cols; i++ )
+    {
+        Mat dst = z_k.col( i );
+        Mat hx = dst;
+        measurementFunction( x_k.col( i ), n_k.col( i ), hx );
+        if ( hx.data != dst.data )
+            hx.copyTo( dst );
+    }
+}
+
+/*
+ * All the matrices of the batched filter are stored element by element: row ( i*cols + j ) of a
+ * matrix holds element ( i, j ) of that matrix for every filter of the batch. The innermost loops
+ * therefore run over the filters with unit stride, and the dense algebra of the UKF is vectorised
+ * across the batch instead of being spread over many small Mat operations.
+ */
+
+// L = cholesky( A ) for every n x n matrix of the batch; the upper triangle of L is not touched
+template<typename T>
+static void batchCholesky( const Mat& A, Mat& L, int n )
+{
+    const int N = A.cols;
+    for ( int i = 0; i < n; i++ )
+    {
+        for ( int j = 0; j <= i; j++ )
+        {
+            T* l = L.ptr<T>( i*n + j );
+            const T* a = A.ptr<T>( i*n + j );
+            for ( int f = 0; f < N; f++ )
+                l[f] = a[f];
+            for ( int k = 0; k < j; k++ )
+            {
+                const T* lik = L.ptr<T>( i*n + k );
+                const T* ljk = L.ptr<T>( j*n + k );
+                for ( int f = 0; f < N; f++ )
+                    l[f] -= lik[f]*ljk[f];
+            }
+            if ( i == j )
+            {
+                for ( int f = 0; f < N; f++ )
+                    l[f] = l[f] > 0 ? std::sqrt( l[f] ) : (T)0;
+            }
+            else
+            {
+                const T* ljj = L.ptr<T>( j*n + j );
+                for ( int f = 0; f < N; f++ )
+                    l[f] = ljj[f] > 0 ? l[f]/ljj[f] : (T)0;
+            }
+        }
+    }
+}
+
+// x_0 = mean, x_(1+j) = mean + coef*L_j, x_(1+n+j) = mean - coef*L_j, where L_j is column j of L
+template<typename T>
+static void batchSigmaPoints( const Mat& mean, const Mat& L, T coef, int n, Mat& points )
+{
+    const int N = mean.cols;
+    for ( int d = 0; d < n; d++ )
+    {
+        const T* m = mean.ptr<T>( d );
+        T* p0 = points.ptr<T>( d );
+        for ( int f = 0; f < N; f++ )
+            p0[f] = m[f];
+
+        for ( int j = 0; j < n; j++ )
+        {
+            T* pplus = points.ptr<T>( ( 1 + j )*n + d );
+            T* pminus = points.ptr<T>( ( 1 + n + j )*n + d );
+            if ( d < j )
+            {
+                for ( int f = 0; f < N; f++ )
+                    pplus[f] = pminus[f] = m[f];
+                continue;
+            }
+            const T* l = L.ptr<T>( d*n + j );
+            for ( int f = 0; f < N; f++ )
+            {
+                T v = coef*l[f];
+                pplus[f] = m[f] + v;
+                pminus[f] = m[f] - v;
+            }
+        }
+    }
+}
+
+// mean = SUM_s( Wm[s]*vals_s ), then vals_s = vals_s - mean
+template<typename T>
+static void batchMeanAndCenter( Mat& vals, const std::vector<T>& Wm, int n, Mat& mean )
+{
+    const int N = vals.cols;
+    const int numPoints = (int)Wm.size();
+    for ( int d = 0; d < n; d++ )
+    {
+        T* m = mean.ptr<T>( d );
+        for ( int f = 0; f < N; f++ )
+            m[f] = 0;
+        for ( int s = 0; s < numPoints; s++ )
+        {
+            const T* v = vals.ptr<T>( s*n + d );
+            const T w = Wm[s];
+            for ( int f = 0; f < N; f++ )
+                m[f] += w*v[f];
+        }
+        for ( int s = 0; s < numPoints; s++ )
+        {
+            T* v = vals.ptr<T>( s*n + d );
+            for ( int f = 0; f < N; f++ )
+                v[f] -= m[f];
+        }
+    }
+}
+
+// cov = SUM_s( Wc[s]*a_s*b_s.t ) + noise, a_s and b_s are centered, noise is optional
+template<typename T>
+static void batchCovariance( const Mat& a, int na, const Mat& b, int nb, const std::vector<T>& Wc, const Mat& noise, Mat& cov )
+{
+    const int N = a.cols;
+    const int numPoints = (int)Wc.size();
+    for ( int i = 0; i < na; i++ )
+    {
+        for ( int j = 0; j < nb; j++ )
+        {
+            T* c = cov.ptr<T>( i*nb + j );
+            const T c0 = noise.empty() ? (T)0 : noise.at<T>( i, j );
+            for ( int f = 0; f < N; f++ )
+                c[f] = c0;
+            for ( int s = 0; s < numPoints; s++ )
+            {
+                const T* pa = a.ptr<T>( s*na + i );
+                const T* pb = b.ptr<T>( s*nb + j );
+                const T w = Wc[s];
+                for ( int f = 0; f < N; f++ )
+                    c[f] += w*pa[f]*pb[f];
+            }
+        }
+    }
+}
+
+class UnscentedKalmanFilterBatchImpl: public UnscentedKalmanFilterBatch
+{
+    int DP;                                     // dimensionality of the state vector
+    int MP;                                     // dimensionality of the measurement vector
+    int CP;                                     // dimensionality of the control vector
+    int dataType;                               // type of elements of vectors and matrices
+    int N;                                      // number of filters
+
+    Mat state;                                  // estimates of the system states (x*), DP x N
+    Mat errorCov;                               // estimates of the state cross-covariance matrices (P), DP*DP x N
+
+    Mat processNoiseCov;                        // process noise cross-covariance matrix (Q), DP x DP
+    Mat measurementNoiseCov;                    // measurement noise cross-covariance matrix (R), MP x MP
+
+    Ptr<UkfSystemModel> model;                  // object of the class containing functions for computing the next state and the measurement.
+
+    double tmpLambda;                           // internal parameter, tmpLambda = alpha*alpha*( DP + k )
+
+// Workspaces, allocated once
+    Mat covL;                                   // cholesky( P ), DP*DP x N
+    Mat sigmaPoints;                            // sigma points, (2*DP+1)*DP x N
+    Mat transitionSPFuncVals;                   // centered f-function values at sigma points, (2*DP+1)*DP x N
+    Mat measurementSPFuncVals;                  // centered h-function values at sigma points, (2*DP+1)*MP x N
+    Mat measurementEstimate;                    // estimates of current measurements (y*), MP x N
+    Mat xyCov;                                  // Sxy, DP*MP x N
+    Mat yyCov;                                  // Syy, MP*MP x N
+    Mat yyCovL;                                 // cholesky( Syy ), MP*MP x N
+    Mat gain;                                   // Kalman gains (K), DP*MP x N
+    Mat q;                                      // zero process noise vectors, DP x N
+    Mat r;                                      // zero measurement noise vectors, MP x N
+
+    std::vector<double> Wm, Wc;                 // weights for estimate mean and covariance, 2*DP+1
+
+    template<typename T> void predictImpl( const Mat& control );
+    template<typename T> void correctImpl( const Mat& measurement );
+
+public:
+
+    UnscentedKalmanFilterBatchImpl( const UnscentedKalmanFilterParams& params, int numFilters );
+
+    Mat predict( InputArray control = noArray() );
+    Mat correct( InputArray measurement );
+
+    void setState( int idx, InputArray state, InputArray errorCov );
+    int getNumFilters() const;
+    Mat getState() const;
+    Mat getErrorCov( int idx ) const;
+};
+
+UnscentedKalmanFilterBatchImpl::UnscentedKalmanFilterBatchImpl( const UnscentedKalmanFilterParams& params, int numFilters )
+{
+    CV_Assert( numFilters > 0 );
+    CV_Assert( params.DP > 0 && params.MP > 0 );
+    CV_Assert( params.dataType == CV_32F || params.dataType == CV_64F );
+    DP = params.DP;
+    MP = params.MP;
+    CP = std::max( params.CP, 0 );
+    dataType = params.dataType;
+    N = numFilters;
+
+    model = params.model;
+
+    CV_Assert( params.stateInit.cols == 1 && params.stateInit.rows == DP && params.stateInit.type() == dataType );
+    CV_Assert( params.errorCovInit.cols == DP && params.errorCovInit.rows == DP && params.errorCovInit.type() == dataType );
+    CV_Assert( params.processNoiseCov.cols == DP && params.processNoiseCov.rows == DP && params.processNoiseCov.type() == dataType );
+    CV_Assert( params.measurementNoiseCov.cols == MP && params.measurementNoiseCov.rows == MP && params.measurementNoiseCov.type() == dataType );
+    processNoiseCov = params.processNoiseCov.clone();
+    measurementNoiseCov = params.measurementNoiseCov.clone();
+
+    state = repeat( params.stateInit, 1, N );
+    errorCov = repeat( params.errorCovInit.clone().reshape( 1, DP*DP ), 1, N );
+
+    const int numPoints = 2*DP+1;
+    covL = Mat::zeros( DP*DP, N, dataType );
+    sigmaPoints = Mat::zeros( numPoints*DP, N, dataType );
+    transitionSPFuncVals = Mat::zeros( numPoints*DP, N, dataType );
+    measurementSPFuncVals = Mat::zeros( numPoints*MP, N, dataType );
+    measurementEstimate = Mat::zeros( MP, N, dataType );
+    xyCov = Mat::zeros( DP*MP, N, dataType );
+    yyCov = Mat::zeros( MP*MP, N, dataType );
+    yyCovL = Mat::zeros( MP*MP, N, dataType );
+    gain = Mat::zeros( DP*MP, N, dataType );
+    q = Mat::zeros( DP, N, dataType );
+    r = Mat::zeros( MP, N, dataType );
+
+    double lambda = params.alpha*params.alpha*( DP + params.k ) - DP;
+    tmpLambda = lambda + DP;
+
+    Wm.assign( numPoints, 0.5/tmpLambda );
+    Wc.assign( numPoints, 0.5/tmpLambda );
+    Wm[0] = lambda/tmpLambda;
+    Wc[0] = lambda/tmpLambda + 1.0 - params.alpha*params.alpha + params.beta;
+}
+
+template<typename T>
+void UnscentedKalmanFilterBatchImpl::predictImpl( const Mat& control )
+{
+    const int numPoints = 2*DP+1;
+    std::vector<T> wm( Wm.begin(), Wm.end() ), wc( Wc.begin(), Wc.end() );
+
+// get sigma points from x* and P
+    batchCholesky<T>( errorCov, covL, DP );
+    batchSigmaPoints<T>( state, covL, (T)std::sqrt( tmpLambda ), DP, sigmaPoints );
+
+// f_i = f(x_i, control, 0), i = 0..2*DP, for all the filters at once
+    for ( int i = 0; i < numPoints; i++ )
+    {
+        Mat fx = transitionSPFuncVals.rowRange( i*DP, (i+1)*DP );
+        model->stateConversionFunctionBatch( sigmaPoints.rowRange( i*DP, (i+1)*DP ), control, q, fx );
+    }
+
+// x* = SUM_{i=0}^{2*DP}( Wm[i]*f_i ), fc_i = f_i - x*
+    batchMeanAndCenter<T>( transitionSPFuncVals, wm, DP, state );
+
+// P = SUM_{i=0}^{2*DP}( Wc[i]*fc_i*fc_i.t ) + Q
+    batchCovariance<T>( transitionSPFuncVals, DP, transitionSPFuncVals, DP, wc, processNoiseCov, errorCov );
+}
+
+template<typename T>
+void UnscentedKalmanFilterBatchImpl::correctImpl( const Mat& measurement )
+{
+    const int numPoints = 2*DP+1;
+    std::vector<T> wm( Wm.begin(), Wm.end() ), wc( Wc.begin(), Wc.end() );
+
+// get sigma points from x* and P
+    batchCholesky<T>( errorCov, covL, DP );
+    batchSigmaPoints<T>( state, covL, (T)std::sqrt( tmpLambda ), DP, sigmaPoints );
+
+// h_i = h(x_i, 0), i = 0..2*DP
+    for ( int i = 0; i < numPoints; i++ )
+    {
+        Mat hx = measurementSPFuncVals.rowRange( i*MP, (i+1)*MP );
+        model->measurementFunctionBatch( sigmaPoints.rowRange( i*DP, (i+1)*DP ), r, hx );
+    }
+
+// y* = SUM_{i=0}^{2*DP}( Wm[i]*h_i ), hc_i = h_i - y*
+    batchMeanAndCenter<T>( measurementSPFuncVals, wm, MP, measurementEstimate );
+
+// Syy = SUM_{i=0}^{2*DP}( Wc[i]*hc_i*hc_i.t ) + R
+    batchCovariance<T>( measurementSPFuncVals, MP, measurementSPFuncVals, MP, wc, measurementNoiseCov, yyCov );
+
+// Sxy = SUM_{i=0}^{2*DP}( Wc[i]*fc_i*hc_i.t ), fc_i are kept from the prediction step
+    batchCovariance<T>( transitionSPFuncVals, DP, measurementSPFuncVals, MP, wc, Mat(), xyCov );
+
+// K = Sxy * Syy^(-1): every row k of K solves Syy*k.t = Sxy_row.t by forward and back substitution
+    batchCholesky<T>( yyCov, yyCovL, MP );
+    for ( int i = 0; i < DP; i++ )
+    {
+        for ( int m = 0; m < MP; m++ )
+        {
+            T* k = gain.ptr<T>( i*MP + m );
+            const T* sxy = xyCov.ptr<T>( i*MP + m );
+            for ( int f = 0; f < N; f++ )
+                k[f] = sxy[f];
+            for ( int j = 0; j < m; j++ )
+            {
+                const T* l = yyCovL.ptr<T>( m*MP + j );
+                const T* kj = gain.ptr<T>( i*MP + j );
+                for ( int f = 0; f < N; f++ )
+                    k[f] -= l[f]*kj[f];
+            }
+            const T* lmm = yyCovL.ptr<T>( m*MP + m );
+            for ( int f = 0; f < N; f++ )
+                k[f] = lmm[f] > 0 ? k[f]/lmm[f] : (T)0;
+        }
+        for ( int m = MP-1; m >= 0; m-- )
+        {
+            T* k = gain.ptr<T>( i*MP + m );
+            for ( int j = m+1; j < MP; j++ )
+            {
+                const T* l = yyCovL.ptr<T>( j*MP + m );
+                const T* kj = gain.ptr<T>( i*MP + j );
+                for ( int f = 0; f < N; f++ )
+                    k[f] -= l[f]*kj[f];
+            }
+            const T* lmm = yyCovL.ptr<T>( m*MP + m );
+            for ( int f = 0; f < N; f++ )
+                k[f] = lmm[f] > 0 ? k[f]/lmm[f] : (T)0;
+        }
+    }
+
+// x* = x* + K*(y - y*), y - current measurement
+    for ( int m = 0; m < MP; m++ )
+    {
+        T* y = measurementEstimate.ptr<T>( m );
+        const T* z = measurement.ptr<T>( m );
+        for ( int f = 0; f < N; f++ )
+            y[f] = z[f] - y[f];
+    }
+    for ( int i = 0; i < DP; i++ )
+    {
+        T* x = state.ptr<T>( i );
+        for ( int m = 0; m < MP; m++ )
+        {
+            const T* k = gain.ptr<T>( i*MP + m );
+            const T* e = measurementEstimate.ptr<T>( m );
+            for ( int f = 0; f < N; f++ )
+                x[f] += k[f]*e[f];
+        }
+    }
+
+// P = P - K*Sxy.t
+    for ( int i = 0; i < DP; i++ )
+    {
+        for ( int j = 0; j < DP; j++ )
+        {
+            T* p = errorCov.ptr<T>( i*DP + j );
+            for ( int m = 0; m < MP; m++ )
+            {
+                const T* k = gain.ptr<T>( i*MP + m );
+                const T* sxy = xyCov.ptr<T>( j*MP + m );
+                for ( int f = 0; f < N; f++ )
+                    p[f] -= k[f]*sxy[f];
+            }
+        }
+    }
+}
+
+Mat UnscentedKalmanFilterBatchImpl::predict( InputArray _control )
+{
+    Mat control = _control.getMat();
+    CV_Assert( control.empty() || ( control.cols == N && control.type() == dataType ) );
+
+    if ( dataType == CV_64F )
+        predictImpl<double>( control );
+    else
+        predictImpl<float>( control );
+
+    return state.clone();
+}
+
+Mat UnscentedKalmanFilterBatchImpl::correct( InputArray _measurement )
+{
+    Mat measurement = _measurement.getMat();
+    CV_Assert( measurement.rows == MP && measurement.cols == N && measurement.type() == dataType );
+
+    if ( dataType == CV_64F )
+        correctImpl<double>( measurement );
+    else
+        correctImpl<float>( measurement );
+
+    return state.clone();
+}
+
+void UnscentedKalmanFilterBatchImpl::setState( int idx, InputArray _state, InputArray _errorCov )
+{
+    CV_Assert( 0 <= idx && idx < N );
+    Mat x = _state.getMat(), P = _errorCov.getMat();
+    CV_Assert( x.rows == DP && x.cols == 1 && x.type() == dataType );
+    CV_Assert( P.rows == DP && P.cols == DP && P.type() == dataType );
+
+    x.copyTo( state.col( idx ) );
+    P.clone().reshape( 1, DP*DP ).copyTo( errorCov.col( idx ) );
+}
+
+int UnscentedKalmanFilterBatchImpl::getNumFilters() const
+{
+    return N;
+}
+
+Mat UnscentedKalmanFilterBatchImpl::getState() const
+{
+    return state.clone();
+}
+
+Mat UnscentedKalmanFilterBatchImpl::getErrorCov( int idx ) const
+{
+    CV_Assert( 0 <= idx && idx < N );
+    return errorCov.col( idx ).clone().reshape( 1, DP );
+}
+
+Ptr<UnscentedKalmanFilterBatch> createUnscentedKalmanFilterBatch( const UnscentedKalmanFilterParams &params, int numFilters )
+{
+    Ptr<UnscentedKalmanFilterBatch> kfu( new UnscentedKalmanFilterBatchImpl( params, numFilters ) );
+    return kfu;
+}
+
+} // tracking
+} // cv
@@ -41,6 +41,8 @@
 
 #include "test_precomp.hpp"
 #include "opencv2/tracking.hpp"
+#include "../src/tldDetectorCheck.hpp"
+#include "../src/trackerMedianFlowScale.hpp"
 #include <fstream>
 
 using namespace cv;
@@ -538,4 +540,91 @@ TEST_P(DistanceAndOverlap, DISABLED_GOTURN)
 
 INSTANTIATE_TEST_CASE_P( Tracking, DistanceAndOverlap, TESTSET_NAMES);
 
+TEST(MultiTracker_Alt, parallel_update)
+{
+  // textured frames, the second one shifted by a few pixels
+  RNG rng(0);
+  Mat background(256 + 8, 320 + 8, CV_8UC3);
+  rng.fill(background, RNG::UNIFORM, 0, 255);
+  GaussianBlur(background, background, Size(5, 5), 0);
+  Mat frames[] = { background(Rect(0, 0, 320, 256)), background(Rect(3, 2, 320, 256)) };
+
+  const char* algorithms[] = { "MEDIANFLOW", "KCF", "MEDIANFLOW", "KCF" };
+  const int numTargets = 4;
+  MultiTracker_Alt multiTracker;
+  vector<Ptr<Tracker> > references;
+  vector<Rect2d> referenceBoxes;
+  for (int i = 0; i < numTargets; i++)
+  {
+    Rect2d bb(40 + i * 60, 60 + (i % 2) * 80, 40, 48);
+    ASSERT_TRUE(multiTracker.addTarget(frames[0], bb, algorithms[i]));
+    references.push_back(Tracker::create(algorithms[i]));
+    ASSERT_TRUE(references.back()->init(frames[0], bb));
+    referenceBoxes.push_back(bb);
+  }
+
+  for (int k = 1; k <= 4; k++)
+  {
+    const Mat& frame = frames[k % 2];
+    vector<uchar> success;
+    multiTracker.update(frame, success);
+    ASSERT_EQ((size_t)numTargets, success.size());
+
+    for (int i = 0; i < numTargets; i++)
+    {
+      bool located = references[i]->update(frame, referenceBoxes[i]);
+      EXPECT_EQ(located, success[i] != 0) << algorithms[i] << " target " << i;
+      if (located)
+      {
+        EXPECT_EQ(referenceBoxes[i].x, multiTracker.boundingBoxes[i].x);
+        EXPECT_EQ(referenceBoxes[i].y, multiTracker.boundingBoxes[i].y);
+        EXPECT_EQ(referenceBoxes[i].width, multiTracker.boundingBoxes[i].width);
+        EXPECT_EQ(referenceBoxes[i].height, multiTracker.boundingBoxes[i].height);
+      }
+    }
+  }
+}
+
+TEST(MEDIAN_FLOW, sampled_scale_matches_exhaustive_median)
+{
+  // points of a 40x40 grid (pointsInGrid = 40, far more pairs than are sampled), with the lower rows
+  // stretched more than the upper ones so that a sample biased towards some rows has a different median
+  const int pointsInGrid = 40;
+  RNG rng(0);
+  vector<Point2f> oldPoints, newPoints;
+  const Point2f center(40.f, 40.f);
+  for (int y = 0; y < pointsInGrid; y++)
+    for (int x = 0; x < pointsInGrid; x++)
+    {
+      Point2f p(2.f * x + .5f, 2.f * y + .5f);
+      float s = 1.f + 0.2f * y / (pointsInGrid - 1);
+      oldPoints.push_back(p);
+      newPoints.push_back(center + (p - center) * s + Point2f((float)rng.gaussian(0.05), (float)rng.gaussian(0.05)));
+    }
+
+  const int n = (int)oldPoints.size();
+  vector<double> ratios;
+  for (int i = 0; i < n; i++)
+    for (int j = 0; j < i; j++)
+      ratios.push_back(norm(newPoints[i] - newPoints[j]) / norm(oldPoints[i] - oldPoints[j]));
+  std::nth_element(ratios.begin(), ratios.begin() + ratios.size() / 2, ratios.end());
+  const double exhaustive = ratios[ratios.size() / 2];
+
+  EXPECT_NEAR(exhaustive, medianFlowScaleChange(oldPoints, newPoints), 0.005);
+}
+
+TEST(TLD, batched_detector_matches_per_patch)
+{
+  for (int seed = 0; seed < 3; seed++)
+  {
+    int mismatches = -1, accepted = 0;
+    double srDiff = -1, scDiff = -1;
+    cv::tld::tld_compareBatchedDetector(seed, mismatches, accepted, srDiff, scDiff);
+    EXPECT_EQ(0, mismatches) << "seed " << seed;
+    EXPECT_GT(accepted, 0) << "seed " << seed;
+    EXPECT_LE(srDiff, 1e-4) << "seed " << seed;
+    EXPECT_LE(scDiff, 1e-4) << "seed " << seed;
+  }
+}
+
 /* End of file. */
@@ -204,6 +204,102 @@ TEST(UKF, br_landing_point)
     ASSERT_NEAR(landing_coordinate, landing_y, abs_error);
 }
 
+TEST(UKF, br_batch_matches_single_filters)
+{
+    const int nFilters = 3;
+    const int nIterations = 200;
+
+    int MP = 2;
+    int DP = 5;
+    int CP = 0;
+    int type = CV_64F;
+
+    Mat processNoiseCov = Mat::zeros( DP, DP, type );
+    processNoiseCov.at<double>(0, 0) = 1e-14;
+    processNoiseCov.at<double>(1, 1) = 1e-14;
+    processNoiseCov.at<double>(2, 2) = 2.4065 * 1e-5;
+    processNoiseCov.at<double>(3, 3) = 2.4065 * 1e-5;
+    processNoiseCov.at<double>(4, 4) = 1e-6;
+
+    Mat measurementNoiseCov = Mat::zeros( MP, MP, type );
+    measurementNoiseCov.at<double>(0, 0) = 1e-3*1e-3;
+    measurementNoiseCov.at<double>(1, 1) = 0.13*0.13;
+
+    Mat state( DP, 1, type );
+    state.at<double>(0, 0) = 6500.4;
+    state.at<double>(1, 0) = 349.14;
+    state.at<double>(2, 0) = -1.8093;
+    state.at<double>(3, 0) = -6.7967;
+    state.at<double>(4, 0) = 0.6932;
+
+    Mat initState = state.clone();
+    initState.at<double>(4, 0) = 0.0;
+
+    Mat P = 1e-6 * Mat::eye( DP, DP, type );
+    P.at<double>(4, 4) = 1.0;
+
+    Ptr<BallisticModel> model( new BallisticModel() );
+    UnscentedKalmanFilterParams params( DP, MP, CP, 0, 0, model );
+    params.stateInit = initState.clone();
+    params.errorCovInit = P.clone();
+    params.measurementNoiseCov = measurementNoiseCov.clone();
+    params.processNoiseCov = processNoiseCov.clone();
+    params.alpha = 1;
+    params.beta = 2.0;
+    params.k = -2.0;
+
+    // every filter of the batch follows its own target
+    std::vector<Ptr<UnscentedKalmanFilter> > filters;
+    std::vector<Mat> states;
+    for (int j = 0; j < nFilters; j++)
+    {
+        Mat s = state.clone();
+        s.at<double>(1, 0) += 10.0*j;
+        params.stateInit = initState.clone();
+        params.stateInit.at<double>(1, 0) += 10.0*j;
+        filters.push_back( createUnscentedKalmanFilter(params) );
+        states.push_back( s );
+    }
+
+    Ptr<UnscentedKalmanFilterBatch> batch = createUnscentedKalmanFilterBatch( params, nFilters );
+    for (int j = 0; j < nFilters; j++)
+    {
+        Mat s = initState.clone();
+        s.at<double>(1, 0) += 10.0*j;
+        batch->setState( j, s, P );
+    }
+
+    Mat u = Mat::zeros( DP, 1, type );
+    Mat uBatch = Mat::zeros( DP, nFilters, type );
+    Mat zero = Mat::zeros( MP, 1, type );
+    Mat measurement( MP, 1, type );
+    Mat measurements( MP, nFilters, type );
+    Mat q = Mat::zeros( DP, 1, type );
+
+    for (int i = 0; i < nIterations; i++)
+    {
+        for (int j = 0; j < nFilters; j++)
+        {
+            model->stateConversionFunction(states[j], u, q, states[j]);
+            model->measurementFunction(states[j], zero, measurement);
+            measurement.copyTo( measurements.col(j) );
+
+            filters[j]->predict( u );
+            filters[j]->correct( measurement );
+        }
+        batch->predict( uBatch );
+        batch->correct( measurements );
+    }
+
+    Mat batchState = batch->getState();
+    for (int j = 0; j < nFilters; j++)
+    {
+        Mat singleState = filters[j]->getState();
+        for (int d = 0; d < DP; d++)
+            ASSERT_NEAR( singleState.at<double>(d, 0), batchState.at<double>(d, j), 1e-6 * std::max(1.0, fabs(singleState.at<double>(d, 0))) );
+    }
+}
+
 TEST(UKF, DISABLED_br_mean_squared_error)
 {
     const double velocity_treshold = 0.09;
@@ -97,6 +97,19 @@ public:
                              float patternScale = 22.0f,
                              int nOctaves = 4,
                              const std::vector<int>& selectedPairs = std::vector<int>());
+
+    /** @brief Enables sharing of the integral image with the other binary descriptor extractors.
+
+    When enabled, the images derived from the input (integral images, box filtered images) by FREAK,
+    BriefDescriptorExtractor and LUCID instances with caching enabled are kept for the last few input
+    images and reused when one of them is called again on the same image, so that extracting several
+    binary descriptors from one frame integrates or smooths it only once. A cached image is reused
+    only when the pixels of the new input are the same, so a buffer refilled with the next frame is
+    processed again. Disabled by default; disabling it affects only this instance, and the cached
+    images are dropped once no extractor has caching enabled.
+     */
+    CV_WRAP virtual void setImageCaching(bool enable) = 0;
+    CV_WRAP virtual bool getImageCaching() const = 0;
 };
 
 
@@ -126,6 +139,11 @@ class CV_EXPORTS_W BriefDescriptorExtractor : public Feature2D
 {
 public:
     CV_WRAP static Ptr<BriefDescriptorExtractor> create( int bytes = 32, bool use_orientation = false );
+
+    /** @brief Enables sharing of the integral image of 8-bit grayscale input, see FREAK::setImageCaching
+     */
+    CV_WRAP virtual void setImageCaching(bool enable) = 0;
+    CV_WRAP virtual bool getImageCaching() const = 0;
 };
 
 /** @brief Class implementing the locally uniform comparison image descriptor, described in @cite LUCID
@@ -143,6 +161,11 @@ public:
      * @param blur_kernel kernel for blurring image prior to descriptor construction, where 1=3x3, 2=5x5, 3=7x7 and so forth
      */
     CV_WRAP static Ptr<LUCID> create(const int lucid_kernel = 1, const int blur_kernel = 2);
+
+    /** @brief Enables sharing of the box filtered input image, see FREAK::setImageCaching
+     */
+    CV_WRAP virtual void setImageCaching(bool enable) = 0;
+    CV_WRAP virtual bool getImageCaching() const = 0;
 };
 
 
@@ -224,6 +247,37 @@ public:
      */
     virtual void compute( InputArray image, OutputArray descriptors ) = 0;
 
+    /** @brief Receiver of dense descriptors computed band by band, see compute(InputArray, Rect, BandCallback&, int)
+     */
+    class CV_EXPORTS BandCallback
+    {
+    public:
+        virtual ~BandCallback() {}
+        /**
+         * @param rows image rows covered by the band
+         * @param descriptors descriptors of the band pixels in row-major order, one row per pixel of the roi
+         * columns; the buffer is reused for the next band, copy it to keep the data
+         */
+        virtual void operator()( const Range& rows, const Mat& descriptors ) = 0;
+    };
+
+    /** @overload
+     * Dense descriptors are computed and handed to the callback in bands of bandRows image rows, so
+     * only one band of descriptors is in memory at a time. Internal buffers are kept between calls
+     * on images of the same size.
+     * @param image image to extract descriptors
+     * @param roi region of interest within image
+     * @param callback receiver of the descriptor bands
+     * @param bandRows number of image rows in a band
+     */
+    virtual void compute( InputArray image, Rect roi, BandCallback& callback, int bandRows = 32 ) = 0;
+
+    /** @brief Keeps the smoothed histogram cubes in half precision, halving their memory at a small
+     * loss of descriptor precision. Disabled by default.
+     */
+    virtual void setHalfPrecisionCubes( bool enable ) = 0;
+    virtual bool getHalfPrecisionCubes() const = 0;
+
     /**
      * @param y position y on image
      * @param x position x on image
@@ -823,6 +877,8 @@ public:
     /**
     * @brief Computes Signature Quadratic Form Distance between the reference signature
     *       and each of the other image signatures.
+    *       The packed image signatures are kept, so repeated queries against the same
+    *       signatures (or the ones passed to setIndexSignatures) do not pack them again.
     * @param sourceSignature The signature to measure distance of other signatures from.
     * @param imageSignatures Vector of signatures to measure distance from the source signature.
     * @param distances Output vector of measured distances.
@@ -832,6 +888,37 @@ public:
         const std::vector<Mat>& imageSignatures,
         std::vector<float>& distances) const = 0;
 
+    /**
+    * @brief Builds the signature index used by searchNearest.
+    * @param imageSignatures Database signatures. They are copied into a packed
+    *       store together with their self-similarities and bounding boxes,
+    *       so the input vector may be released afterwards.
+    *       An empty vector clears the index.
+    */
+    CV_WRAP virtual void setIndexSignatures(
+        const std::vector<Mat>& imageSignatures) = 0;
+
+    /**
+    * @brief Returns the number of signatures in the index.
+    */
+    CV_WRAP virtual int getIndexSize() const = 0;
+
+    /**
+    * @brief Finds the k indexed signatures closest to the query signature.
+    * @param querySignature The signature to search for.
+    * @param k Number of neighbours to return.
+    * @param indices Output indices into the vector passed to setIndexSignatures,
+    *       ordered by increasing distance.
+    * @param distances Output Signature Quadratic Form Distances of the returned signatures.
+    * @note Candidates are rejected using a lower bound of the distance,
+    *       the result is equal to that of a full scan (ties are broken by the lower index).
+    */
+    CV_WRAP virtual void searchNearest(
+        InputArray querySignature,
+        int k,
+        CV_OUT std::vector<int>& indices,
+        CV_OUT std::vector<float>& distances) const = 0;
+
 };
 
 /**
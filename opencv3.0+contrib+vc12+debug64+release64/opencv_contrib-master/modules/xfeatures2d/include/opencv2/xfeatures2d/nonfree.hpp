@@ -79,6 +79,17 @@ public:
     CV_WRAP static Ptr<SIFT> create( int nfeatures = 0, int nOctaveLayers = 3,
                                     double contrastThreshold = 0.04, double edgeThreshold = 10,
                                     double sigma = 1.6);
+
+    /** @brief Enables keeping the scale space of the last image between calls.
+
+    When enabled, the Gaussian and DoG pyramids of the last processed image are kept and reused by the next
+    call on an identical image, so that detect() followed by compute() builds them only once. The cached
+    image is compared byte by byte before reuse. The cache is guarded by a lock, so an instance with
+    caching enabled may still be shared between threads. Disabled by default, since the pyramids of a
+    large image take a lot of memory.
+     */
+    CV_WRAP virtual void setScaleSpaceCaching(bool enable) = 0;
+    CV_WRAP virtual bool getScaleSpaceCaching() const = 0;
 };
 
 typedef SIFT SiftFeatureDetector;
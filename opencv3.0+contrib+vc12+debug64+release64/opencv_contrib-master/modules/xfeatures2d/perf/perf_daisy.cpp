@@ -31,3 +31,28 @@ PERF_TEST_P(daisy, extract, testing::Values(DAISY_IMAGES))
 
     SANITY_CHECK_NOTHING();
 }
+
+struct DaisyBandSink : public DAISY::BandCallback
+{
+    void operator()( const Range&, const Mat& descriptors ) { sum += descriptors.at<float>(0, 0); }
+    float sum;
+};
+
+PERF_TEST_P(daisy, extract_bands_half, testing::Values(DAISY_IMAGES))
+{
+    string filename = getDataPath(GetParam());
+    Mat frame = imread(filename, IMREAD_GRAYSCALE);
+    ASSERT_FALSE(frame.empty()) << "Unable to load source image " << filename;
+
+    declare.in(frame).time(90);
+
+    Ptr<DAISY> descriptor = DAISY::create();
+    descriptor->setHalfPrecisionCubes(true);
+
+    DaisyBandSink sink;
+    sink.sum = 0;
+    // stream all daisies in image band by band
+    TEST_CYCLE() descriptor->compute(frame, Rect(0, 0, frame.cols, frame.rows), sink, 32);
+
+    SANITY_CHECK_NOTHING();
+}
@@ -41,6 +41,7 @@
 //M*/
 
 #include "precomp.hpp"
+#include "descriptor_image_cache.hpp"
 #include <algorithm>
 #include <vector>
 
@@ -72,11 +73,18 @@ public:
 
     virtual void compute(InputArray image, std::vector<KeyPoint>& keypoints, OutputArray descriptors);
 
+    virtual ~BriefDescriptorExtractorImpl() { DescriptorImageCache::setEnabled( image_caching_, false ); }
+
+    virtual void setImageCaching(bool enable) { DescriptorImageCache::setEnabled( image_caching_, enable ); }
+    virtual bool getImageCaching() const { return image_caching_; }
+
+    typedef void(*PixelTestFn)(const Mat&, const std::vector<KeyPoint>&, Mat&, bool use_orientation, const Range& range );
+
 protected:
-    typedef void(*PixelTestFn)(InputArray, const std::vector<KeyPoint>&, OutputArray, bool use_orientation );
 
     int bytes_;
     bool use_orientation_;
+    bool image_caching_;
     PixelTestFn test_fn_;
 };
 
@@ -105,13 +113,12 @@ inline int smoothedSum(const Mat& sum, const KeyPoint& pt, int y, int x, bool us
            + sum.at<int>(img_y - HALF_KERNEL, img_x - HALF_KERNEL);
 }
 
-static void pixelTests16(InputArray _sum, const std::vector<KeyPoint>& keypoints, OutputArray _descriptors, bool use_orientation )
+static void pixelTests16(const Mat& sum, const std::vector<KeyPoint>& keypoints, Mat& descriptors, bool use_orientation, const Range& range)
 {
     Matx21f R;
-    Mat sum = _sum.getMat(), descriptors = _descriptors.getMat();
-    for (size_t i = 0; i < keypoints.size(); ++i)
+    for (int i = range.start; i < range.end; ++i)
     {
-        uchar* desc = descriptors.ptr(static_cast<int>(i));
+        uchar* desc = descriptors.ptr(i);
         const KeyPoint& pt = keypoints[i];
         if ( use_orientation )
         {
@@ -125,13 +132,12 @@ static void pixelTests16(InputArray _sum, const std::vector<KeyPoint>& keypoints
     }
 }
 
-static void pixelTests32(InputArray _sum, const std::vector<KeyPoint>& keypoints, OutputArray _descriptors, bool use_orientation)
+static void pixelTests32(const Mat& sum, const std::vector<KeyPoint>& keypoints, Mat& descriptors, bool use_orientation, const Range& range)
 {
     Matx21f R;
-    Mat sum = _sum.getMat(), descriptors = _descriptors.getMat();
-    for (size_t i = 0; i < keypoints.size(); ++i)
+    for (int i = range.start; i < range.end; ++i)
     {
-        uchar* desc = descriptors.ptr(static_cast<int>(i));
+        uchar* desc = descriptors.ptr(i);
         const KeyPoint& pt = keypoints[i];
         if ( use_orientation )
         {
@@ -145,13 +151,12 @@ static void pixelTests32(InputArray _sum, const std::vector<KeyPoint>& keypoints
     }
 }
 
-static void pixelTests64(InputArray _sum, const std::vector<KeyPoint>& keypoints, OutputArray _descriptors, bool use_orientation)
+static void pixelTests64(const Mat& sum, const std::vector<KeyPoint>& keypoints, Mat& descriptors, bool use_orientation, const Range& range)
 {
     Matx21f R;
-    Mat sum = _sum.getMat(), descriptors = _descriptors.getMat();
-    for (size_t i = 0; i < keypoints.size(); ++i)
+    for (int i = range.start; i < range.end; ++i)
     {
-        uchar* desc = descriptors.ptr(static_cast<int>(i));
+        uchar* desc = descriptors.ptr(i);
         const KeyPoint& pt = keypoints[i];
         if ( use_orientation )
         {
@@ -166,7 +171,7 @@ static void pixelTests64(InputArray _sum, const std::vector<KeyPoint>& keypoints
 }
 
 BriefDescriptorExtractorImpl::BriefDescriptorExtractorImpl(int bytes, bool use_orientation) :
-    bytes_(bytes), test_fn_(NULL)
+    bytes_(bytes), image_caching_(false), test_fn_(NULL)
 {
     use_orientation_ = use_orientation;
 
@@ -201,6 +206,26 @@ int BriefDescriptorExtractorImpl::defaultNorm() const
     return NORM_HAMMING;
 }
 
+// Multi-threaded pixel tests over the keypoints
+struct BriefTestsInvoker : ParallelLoopBody
+{
+    BriefTestsInvoker( BriefDescriptorExtractorImpl::PixelTestFn _test_fn, const Mat& _sum,
+                       const std::vector<KeyPoint>& _keypoints, Mat& _descriptors, bool _use_orientation )
+        : test_fn(_test_fn), sum(&_sum), keypoints(&_keypoints), descriptors(&_descriptors),
+          use_orientation(_use_orientation) {}
+
+    void operator()(const Range& range) const
+    {
+        test_fn(*sum, *keypoints, *descriptors, use_orientation, range);
+    }
+
+    BriefDescriptorExtractorImpl::PixelTestFn test_fn;
+    const Mat* sum;
+    const std::vector<KeyPoint>* keypoints;
+    Mat* descriptors;
+    bool use_orientation;
+};
+
 void BriefDescriptorExtractorImpl::read( const FileNode& fn)
 {
     int dSize = fn["descriptorSize"];
@@ -236,19 +261,18 @@ void BriefDescriptorExtractorImpl::compute(InputArray image,
     Mat grayImage = image.getMat();
     if( image.type() != CV_8U ) cvtColor( image, grayImage, COLOR_BGR2GRAY );
 
-    ///TODO allow the user to pass in a precomputed integral image
-    //if(image.type() == CV_32S)
-    //  sum = image;
-    //else
-
-    integral( grayImage, sum, CV_32S);
+    // shared with the other extractors run on the same image when enabled; a converted
+    // image is a new buffer every time, so only grayscale input is worth caching
+    sum = DescriptorImageCache::integral( grayImage, CV_32S, image_caching_ && image.type() == CV_8U );
 
     //Remove keypoints very close to the border
     KeyPointsFilter::runByImageBorder(keypoints, image.size(), PATCH_SIZE/2 + KERNEL_SIZE/2);
 
     descriptors.create((int)keypoints.size(), bytes_, CV_8U);
     descriptors.setTo(Scalar::all(0));
-    test_fn_(sum, keypoints, descriptors, use_orientation_);
+    Mat desc = descriptors.getMat();
+    parallel_for_(Range(0, (int)keypoints.size()),
+                  BriefTestsInvoker(test_fn_, sum, keypoints, desc, use_orientation_));
 }
 
 }
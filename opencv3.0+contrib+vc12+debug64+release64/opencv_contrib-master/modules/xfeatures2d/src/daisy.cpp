@@ -135,6 +135,17 @@ public:
      */
     virtual void compute( InputArray image, OutputArray descriptors );
 
+    /** @overload
+     * @param image image to extract descriptors
+     * @param roi region of interest within image
+     * @param callback receiver of the descriptor bands
+     * @param bandRows number of image rows in a band
+     */
+    virtual void compute( InputArray image, Rect roi, BandCallback& callback, int bandRows );
+
+    virtual void setHalfPrecisionCubes( bool enable ) { m_half_cubes = enable; }
+    virtual bool getHalfPrecisionCubes() const { return m_half_cubes; }
+
     /**
      * @param y position y on image
      * @param x position x on image
@@ -218,6 +229,9 @@ protected:
     // switch to enable sample by keypoints orientation
     bool m_use_orientation;
 
+    // if set to true, the histogram cubes are stored in half precision
+    bool m_half_cubes;
+
     /*
      * DAISY arrays
      */
@@ -232,10 +246,17 @@ protected:
     Rect m_roi;
 
     // stores the layered gradients in successively smoothed form :
-    // layer[n] = m_gradient_layers * gaussian( sigma_n );
-    // n>= 1; layer[0] is the layered_gradient
+    // layer[n] = m_gradient_layers * gaussian( sigma_n+1 );
+    // as (y,x,h) cubes, CV_32F or CV_16S half floats
     std::vector<Mat> m_smoothed_gradient_layers;
 
+    // two (h,y,x) CV_32F cubes used in turn for the incremental smoothing,
+    // released once the histogram cubes are built
+    std::vector<Mat> m_work_layers;
+
+    // descriptors of the current band in banded dense mode
+    Mat m_band_descriptors;
+
     // hold the scales of the pixels
     Mat m_scale_map;
 
@@ -282,8 +303,8 @@ private:
     // releases unused memory after descriptor computation is completed.
     inline void release_auxiliary();
 
-    // computes the descriptors for every pixel in the image.
-    inline void compute_descriptors( Mat* m_dense_descriptors );
+    // computes the descriptors for every pixel of the roi rows [y_off, y_end).
+    inline void compute_descriptors( Mat* m_dense_descriptors, int y_off, int y_end );
 
     // computes scales for every pixel and scales the structure grid so that the
     // resulting descriptors are scale invariant.  you must set
@@ -302,9 +323,6 @@ private:
     // computes the histogram at yx; the size of histogram is m_hist_th_q_no
     inline void compute_histogram( float* hcube, int y, int x, float* histogram );
 
-    // reorganizes the cube data so that histograms are sequential in memory.
-    inline void compute_histograms();
-
     // computes the sigma's of layers from descriptor parameters if the user did
     // not sets it. these define the size of the petals of the descriptor.
     inline void compute_cube_sigmas();
@@ -338,6 +356,9 @@ inline void DAISY_Impl::reset()
     for (size_t i=0; i<m_smoothed_gradient_layers.size(); i++)
       m_smoothed_gradient_layers[i].release();
     m_smoothed_gradient_layers.clear();
+
+    m_work_layers.clear();
+    m_band_descriptors.release();
 }
 
 inline void DAISY_Impl::release_auxiliary()
@@ -572,7 +593,33 @@ static void normalize_descriptor( float* desc, const int nrm_type, const int _gr
         CV_Error( Error::StsInternal, "No such normalization" );
 }
 
-static void ni_get_histogram( float* histogram, const int y, const int x, const int shift, const Mat* hcube )
+// half float (IEEE 754 binary16) to float
+static inline float half_to_float( short hval )
+{
+    unsigned int h = (unsigned short)hval;
+    unsigned int sign = (h & 0x8000) << 16;
+    unsigned int exponent = (h >> 10) & 0x1f;
+    unsigned int mantissa = h & 0x3ff;
+
+    Cv32suf out;
+    if( exponent == 0 )
+    {
+      // zero and subnormals
+      out.f = mantissa * (1.f/16777216.f);
+      out.u |= sign;
+    }
+    else if( exponent == 0x1f )
+      out.u = sign | 0x7f800000 | (mantissa << 13);
+    else
+      out.u = sign | ((exponent + 112) << 23) | (mantissa << 13);
+    return out.f;
+}
+
+static inline float cube_value( const float* p, int i ) { return p[i]; }
+static inline float cube_value( const short* p, int i ) { return half_to_float( p[i] ); }
+
+template<typename T>
+static void ni_get_histogram_( float* histogram, const int y, const int x, const int shift, const Mat* hcube )
 {
 
     if ( ! Point( x, y ).inside(
@@ -580,16 +627,25 @@ static void ni_get_histogram( float* histogram, const int y, const int x, const
        ) return;
 
     int _hist_th_q_no = hcube->size[2];
-    const float* hptr = hcube->ptr<float>(y,x,0);
+    const T* hptr = hcube->ptr<T>(y,x,0);
     for( int h=0; h<_hist_th_q_no; h++ )
     {
       int hi = h+shift;
       if( hi >= _hist_th_q_no ) hi -= _hist_th_q_no;
-      histogram[h] = hptr[hi];
+      histogram[h] = cube_value( hptr, hi );
     }
 }
 
-static void bi_get_histogram( float* histogram, const double y, const double x, const int shift, const Mat* hcube )
+static void ni_get_histogram( float* histogram, const int y, const int x, const int shift, const Mat* hcube )
+{
+    if( hcube->depth() == CV_16S )
+      ni_get_histogram_<short>( histogram, y, x, shift, hcube );
+    else
+      ni_get_histogram_<float>( histogram, y, x, shift, hcube );
+}
+
+template<typename T>
+static void bi_get_histogram_( float* histogram, const double y, const double x, const int shift, const Mat* hcube )
 {
     int mnx = int( x );
     int mny = int( y );
@@ -602,10 +658,10 @@ static void bi_get_histogram( float* histogram, const double y, const double x,
 
     // A C --> pixel positions
     // B D
-    const float* A = hcube->ptr<float>( mny   ,  mnx   , 0);
-    const float* B = hcube->ptr<float>((mny+1),  mnx   , 0);
-    const float* C = hcube->ptr<float>( mny   , (mnx+1), 0);
-    const float* D = hcube->ptr<float>((mny+1), (mnx+1), 0);
+    const T* A = hcube->ptr<T>( mny   ,  mnx   , 0);
+    const T* B = hcube->ptr<T>((mny+1),  mnx   , 0);
+    const T* C = hcube->ptr<T>( mny   , (mnx+1), 0);
+    const T* D = hcube->ptr<T>((mny+1), (mnx+1), 0);
 
     double alpha = mnx+1-x;
     double beta  = mny+1-y;
@@ -618,23 +674,31 @@ static void bi_get_histogram( float* histogram, const double y, const double x,
     int h;
 
     for( h=0; h<_hist_th_q_no; h++ ) {
-      if( h+shift < _hist_th_q_no ) histogram[h] = w0 * A[h+shift];
-      else                          histogram[h] = w0 * A[h+shift-_hist_th_q_no];
+      if( h+shift < _hist_th_q_no ) histogram[h] = w0 * cube_value( A, h+shift );
+      else                          histogram[h] = w0 * cube_value( A, h+shift-_hist_th_q_no );
     }
     for( h=0; h<_hist_th_q_no; h++ ) {
-      if( h+shift < _hist_th_q_no ) histogram[h] += w1 * C[h+shift];
-      else                          histogram[h] += w1 * C[h+shift-_hist_th_q_no];
+      if( h+shift < _hist_th_q_no ) histogram[h] += w1 * cube_value( C, h+shift );
+      else                          histogram[h] += w1 * cube_value( C, h+shift-_hist_th_q_no );
     }
     for( h=0; h<_hist_th_q_no; h++ ) {
-      if( h+shift < _hist_th_q_no ) histogram[h] += w2 * B[h+shift];
-      else                          histogram[h] += w2 * B[h+shift-_hist_th_q_no];
+      if( h+shift < _hist_th_q_no ) histogram[h] += w2 * cube_value( B, h+shift );
+      else                          histogram[h] += w2 * cube_value( B, h+shift-_hist_th_q_no );
     }
     for( h=0; h<_hist_th_q_no; h++ ) {
-      if( h+shift < _hist_th_q_no ) histogram[h] += w3 * D[h+shift];
-      else                          histogram[h] += w3 * D[h+shift-_hist_th_q_no];
+      if( h+shift < _hist_th_q_no ) histogram[h] += w3 * cube_value( D, h+shift );
+      else                          histogram[h] += w3 * cube_value( D, h+shift-_hist_th_q_no );
     }
 }
 
+static void bi_get_histogram( float* histogram, const double y, const double x, const int shift, const Mat* hcube )
+{
+    if( hcube->depth() == CV_16S )
+      bi_get_histogram_<short>( histogram, y, x, shift, hcube );
+    else
+      bi_get_histogram_<float>( histogram, y, x, shift, hcube );
+}
+
 static void ti_get_histogram( float* histogram, const double y, const double x, const double shift, const Mat* hcube )
 {
     int ishift = int( shift );
@@ -986,11 +1050,12 @@ inline void DAISY_Impl::compute_grid_points()
 
 struct ComputeDescriptorsInvoker : ParallelLoopBody
 {
-    ComputeDescriptorsInvoker( Mat* _descriptors, Mat* _image, Rect* _roi,
+    ComputeDescriptorsInvoker( Mat* _descriptors, Mat* _image, Rect* _roi, int _y_off,
                                std::vector<Mat>* _layers, Mat* _orientation_map,
                                Mat* _oriented_grid_points, double* _orientation_shift_table,
                                int _th_q_no, bool _enable_interpolation )
     {
+      y_off = _y_off;
       x_off = _roi->x;
       x_end = _roi->x + _roi->width;
       image = _image;
@@ -1010,7 +1075,8 @@ struct ComputeDescriptorsInvoker : ParallelLoopBody
       {
         for( int x = x_off; x < x_end; x++ )
         {
-          index = y*image->cols + x;
+          // descriptors hold the roi pixels from row y_off on
+          index = (y - y_off)*(x_end - x_off) + (x - x_off);
           orientation = 0;
           if( !orientation_map->empty() )
               orientation = (int) orientation_map->at<ushort>( y, x );
@@ -1024,7 +1090,7 @@ struct ComputeDescriptorsInvoker : ParallelLoopBody
     }
 
     int th_q_no;
-    int x_off, x_end;
+    int y_off, x_off, x_end;
     std::vector<Mat>* layers;
     Mat *descriptors;
     Mat *orientation_map;
@@ -1034,18 +1100,12 @@ struct ComputeDescriptorsInvoker : ParallelLoopBody
 };
 
 // Computes the descriptor by sampling convoluted orientation maps.
-inline void DAISY_Impl::compute_descriptors( Mat* m_dense_descriptors )
+inline void DAISY_Impl::compute_descriptors( Mat* m_dense_descriptors, int y_off, int y_end )
 {
-    int y_off = m_roi.y;
-    int y_end = m_roi.y + m_roi.height;
-
-    if( m_scale_invariant    ) compute_scales();
-    if( m_rotation_invariant ) compute_orientations();
-
     m_dense_descriptors->setTo( Scalar(0) );
 
     parallel_for_( Range(y_off, y_end),
-        ComputeDescriptorsInvoker( m_dense_descriptors, &m_image, &m_roi, &m_smoothed_gradient_layers,
+        ComputeDescriptorsInvoker( m_dense_descriptors, &m_image, &m_roi, y_off, &m_smoothed_gradient_layers,
                                    &m_orientation_map, &m_oriented_grid_points, m_orientation_shift_table,
                                    m_th_q_no, m_enable_interpolation )
     );
@@ -1083,7 +1143,7 @@ struct NormalizeDescriptorsInvoker : ParallelLoopBody
 inline void DAISY_Impl::normalize_descriptors( Mat* m_dense_descriptors )
 {
     CV_Assert( !m_dense_descriptors->empty() );
-    int number_of_descriptors =  m_roi.width * m_roi.height;
+    int number_of_descriptors = m_dense_descriptors->rows;
 
     parallel_for_( Range(0, number_of_descriptors),
         NormalizeDescriptorsInvoker( m_dense_descriptors, m_nrm_type, m_grid_point_number, m_hist_th_q_no, m_descriptor_size )
@@ -1096,18 +1156,18 @@ inline void DAISY_Impl::initialize()
     CV_Assert(m_image.rows != 0);
     CV_Assert(m_image.cols != 0);
 
-    // (m_rad_q_no + 1) cubes
+    // 2 work cubes, only alive until the smoothed layers are built
     // 3 dims tensor (idhist, img_y, img_x);
-    m_smoothed_gradient_layers.resize( m_rad_q_no + 1 );
+    m_work_layers.resize( 2 );
 
     int dims[3] = { m_hist_th_q_no, m_image.rows, m_image.cols };
-    for ( int c=0; c<=m_rad_q_no; c++)
-      m_smoothed_gradient_layers[c] = Mat( 3, dims, CV_32F );
+    for ( int c=0; c<2; c++)
+      m_work_layers[c].create( 3, dims, CV_32F );
 
-    layered_gradient( m_image, &m_smoothed_gradient_layers[0] );
+    layered_gradient( m_image, &m_work_layers[0] );
 
     // assuming a 0.5 image smoothness, we pull this to 1.6 as in sift
-    smooth_layers( &m_smoothed_gradient_layers[0], (float)sqrt(g_sigma_init*g_sigma_init-0.25f) );
+    smooth_layers( &m_work_layers[0], (float)sqrt(g_sigma_init*g_sigma_init-0.25f) );
 
 }
 
@@ -1137,61 +1197,57 @@ inline void DAISY_Impl::update_selected_cubes()
     }
 }
 
+// remap cubes from Mat(h,y,x) -> Mat(y,x,h)
+// final sampling is speeded up by aligned h dim
 struct ComputeHistogramsInvoker : ParallelLoopBody
 {
-    ComputeHistogramsInvoker( std::vector<Mat>* _layers, int _r )
+    ComputeHistogramsInvoker( const Mat* _src, Mat* _dst )
     {
-      r = _r;
-      layers = _layers;
-      _hist_th_q_no = layers->at(r).size[2];
+      src = _src;
+      dst = _dst;
+      _hist_th_q_no = src->size[0];
     }
 
     void operator ()(const cv::Range& range) const
     {
+      int w = src->size[2];
+      bool half = dst->depth() == CV_16S;
+      AutoBuffer<float> buf( half ? w*_hist_th_q_no : 0 );
+
       for (int y = range.start; y < range.end; ++y)
       {
-        for( int x = 0; x < layers->at(r).size[1]; x++ )
+        float* row = half ? (float*)buf : dst->ptr<float>(y,0,0);
+        for( int x = 0; x < w; x++ )
         {
-          float* hist = layers->at(r).ptr<float>(y,x,0);
+          float* hist = row + x*_hist_th_q_no;
           for( int h = 0; h < _hist_th_q_no; h++ )
           {
-            hist[h] = layers->at(r+1).at<float>(h,y,x);
+            hist[h] = src->at<float>(h,y,x);
           }
         }
+        if( half )
+        {
+          Mat frow( 1, w*_hist_th_q_no, CV_32F, row );
+          Mat hrow( 1, w*_hist_th_q_no, CV_16S, dst->ptr<short>(y,0,0) );
+          convertFp16( frow, hrow );
+        }
       }
     }
 
-    int r, _hist_th_q_no;
-    std::vector<Mat> *layers;
+    int _hist_th_q_no;
+    const Mat *src;
+    Mat *dst;
 };
 
-inline void DAISY_Impl::compute_histograms()
+inline void DAISY_Impl::compute_smoothed_gradient_layers()
 {
-    for( int r=0; r<m_rad_q_no; r++ )
-    {
-      // remap cubes from Mat(h,y,x) -> Mat(y,x,h)
-      // final sampling is speeded up by aligned h dim
-      int m_h = m_smoothed_gradient_layers.at(r).size[0];
-      int m_y = m_smoothed_gradient_layers.at(r).size[1];
-      int m_x = m_smoothed_gradient_layers.at(r).size[2];
-
-      // empty targeted cube
-      m_smoothed_gradient_layers.at(r).release();
+    // (m_rad_q_no) cubes
+    // 3 dims tensor (img_y, img_x, idhist);
+    m_smoothed_gradient_layers.resize( m_rad_q_no );
 
-      // recreate cube space
-      int dims[3] = { m_y, m_x, m_h };
-      m_smoothed_gradient_layers.at(r) = Mat( 3, dims, CV_32F );
+    int dims[3] = { m_image.rows, m_image.cols, m_hist_th_q_no };
+    int cube_type = m_half_cubes ? CV_16S : CV_32F;
 
-      // copy backward all cubes and realign structure
-      parallel_for_( Range(0, m_image.rows), ComputeHistogramsInvoker( &m_smoothed_gradient_layers, r ) );
-    }
-    // trim unused region from collection of cubes
-    m_smoothed_gradient_layers[m_rad_q_no].release();
-    m_smoothed_gradient_layers.pop_back();
-}
-
-inline void DAISY_Impl::compute_smoothed_gradient_layers()
-{
     double sigma;
     for( int r=0; r<m_rad_q_no; r++ )
     {
@@ -1204,14 +1260,23 @@ inline void DAISY_Impl::compute_smoothed_gradient_layers()
 
       int ks = filter_size( sigma, 5.0f );
 
+      Mat& src = m_work_layers[r%2];
+      Mat& dst = m_work_layers[(r+1)%2];
       for( int th=0; th<m_hist_th_q_no; th++ )
       {
-        Mat cvI( m_image.rows, m_image.cols, CV_32F, m_smoothed_gradient_layers[r  ].ptr<float>(th,0,0) );
-        Mat cvO( m_image.rows, m_image.cols, CV_32F, m_smoothed_gradient_layers[r+1].ptr<float>(th,0,0) );
+        Mat cvI( m_image.rows, m_image.cols, CV_32F, src.ptr<float>(th,0,0) );
+        Mat cvO( m_image.rows, m_image.cols, CV_32F, dst.ptr<float>(th,0,0) );
         GaussianBlur( cvI, cvO, Size(ks, ks), sigma, sigma, BORDER_REPLICATE );
       }
+
+      // reuses the cube of the previous image if it has the same size
+      m_smoothed_gradient_layers[r].create( 3, dims, cube_type );
+      parallel_for_( Range(0, m_image.rows), ComputeHistogramsInvoker( &dst, &m_smoothed_gradient_layers[r] ) );
     }
-    compute_histograms();
+
+    // only the final cubes are needed from here on; keeping the float work cubes
+    // around would cost more than the half precision cubes save
+    m_work_layers.clear();
 }
 
 inline void DAISY_Impl::compute_oriented_grid_points()
@@ -1453,9 +1518,11 @@ inline void DAISY_Impl::set_parameters( )
 // daisy internals use CV_32F image with norm to 1.0f
 inline void DAISY_Impl::set_image( InputArray _image )
 {
-    // release previous image
-    // and previous workspace
-    reset();
+    // release previous image, the cubes
+    // are reused for images of same size
+    m_image.release();
+    m_scale_map.release();
+    m_orientation_map.release();
     // fetch new image
     Mat image = _image.getMat();
     // image cannot be empty
@@ -1547,22 +1614,36 @@ void DAISY_Impl::compute( InputArray _image, Rect roi, OutputArray _descriptors
 
     set_image( _image );
 
+    CV_Assert( 0 <= roi.x && 0 <= roi.width && roi.x + roi.width <= m_image.cols &&
+               0 <= roi.y && 0 <= roi.height && roi.y + roi.height <= m_image.rows );
     m_roi = roi;
 
     set_parameters();
     initialize_single_descriptor_mode();
 
+    if( m_scale_invariant    ) compute_scales();
+    if( m_rotation_invariant ) compute_orientations();
+
     _descriptors.create( m_roi.width*m_roi.height, m_descriptor_size, CV_32F );
 
     Mat descriptors = _descriptors.getMat();
 
     // compute full desc
-    compute_descriptors( &descriptors );
+    compute_descriptors( &descriptors, m_roi.y, m_roi.y + m_roi.height );
     normalize_descriptors( &descriptors );
 }
 
 // full scope
 void DAISY_Impl::compute( InputArray _image, OutputArray _descriptors )
+{
+    Mat image = _image.getMat();
+
+    // whole image
+    compute( image, Rect( 0, 0, image.cols, image.rows ), _descriptors );
+}
+
+// full scope with roi, by bands of rows
+void DAISY_Impl::compute( InputArray _image, Rect roi, BandCallback& callback, int bandRows )
 {
     // do nothing if no image
     if( _image.getMat().empty() )
@@ -1570,22 +1651,34 @@ void DAISY_Impl::compute( InputArray _image, OutputArray _descriptors )
 
     CV_Assert( m_h_matrix.empty() );
     CV_Assert( ! m_use_orientation );
+    CV_Assert( bandRows > 0 );
 
     set_image( _image );
 
-    // whole image
-    m_roi = Rect( 0, 0, m_image.cols, m_image.rows );
+    CV_Assert( 0 <= roi.x && 0 <= roi.width && roi.x + roi.width <= m_image.cols &&
+               0 <= roi.y && 0 <= roi.height && roi.y + roi.height <= m_image.rows );
+    m_roi = roi;
 
     set_parameters();
     initialize_single_descriptor_mode();
 
-    _descriptors.create( m_roi.width*m_roi.height, m_descriptor_size, CV_32F );
+    if( m_scale_invariant    ) compute_scales();
+    if( m_rotation_invariant ) compute_orientations();
 
-    Mat descriptors = _descriptors.getMat();
+    // one band of desc at a time
+    m_band_descriptors.create( bandRows*m_roi.width, m_descriptor_size, CV_32F );
 
-    // compute full desc
-    compute_descriptors( &descriptors );
-    normalize_descriptors( &descriptors );
+    int y_end = m_roi.y + m_roi.height;
+    for( int y = m_roi.y; y < y_end; y += bandRows )
+    {
+      int band_end = std::min( y + bandRows, y_end );
+      Mat band = m_band_descriptors.rowRange( 0, (band_end - y)*m_roi.width );
+
+      compute_descriptors( &band, y, band_end );
+      normalize_descriptors( &band );
+
+      callback( Range( y, band_end ), band );
+    }
 }
 
 // constructor
@@ -1598,6 +1691,7 @@ DAISY_Impl::DAISY_Impl( float _radius, int _q_radius, int _q_theta, int _q_hist,
     m_descriptor_size = 0;
     m_grid_point_number = 0;
 
+    m_half_cubes = false;
     m_scale_invariant = false;
     m_rotation_invariant = false;
     m_orientation_resolution = 36;
@@ -0,0 +1,223 @@
+/*M///////////////////////////////////////////////////////////////////////////////////////
+//
+//  IMPORTANT: READ BEFORE DOWNLOADING, COPYING, INSTALLING OR USING.
+//
+//  By downloading, copying, installing or using the software you agree to this license.
+//  If you do not agree to this license, do not download, install,
+//  copy or use the software.
+//
+//
+//                           License Agreement
+//                For Open Source Computer Vision Library
+//
+// Copyright (C) 2000-2008, Intel Corporation, all rights reserved.
+// Copyright (C) 2009, Willow Garage Inc., all rights reserved.
+// Third party copyrights are property of their respective owners.
+//
+// Redistribution and use in source and binary forms, with or without modification,
+// are permitted provided that the following conditions are met:
+//
+//   * Redistribution's of source code must retain the above copyright notice,
+//     this list of conditions and the following disclaimer.
+//
+//   * Redistribution's in binary form must reproduce the above copyright notice,
+//     this list of conditions and the following disclaimer in the documentation
+//     and/or other materials provided with the distribution.
+//
+//   * The name of the copyright holders may not be used to endorse or promote products
+//     derived from this software without specific prior written permission.
+//
+// This software is provided by the copyright holders and contributors "as is" and
+// any express or implied warranties, including, but not limited to, the implied
+// warranties of merchantability and fitness for a particular purpose are disclaimed.
+// In no event shall the Intel Corporation or contributors be liable for any direct,
+// indirect, incidental, special, exemplary, or consequential damages
+// (including, but not limited to, procurement of substitute goods or services;
+// loss of use, data, or profits; or business interruption) however caused
+// and on any theory of liability, whether in contract, strict liability,
+// or tort (including negligence or otherwise) arising in any way out of
+// the use of this software, even if advised of the possibility of such damage.
+//
+//M*/
+
+#include "precomp.hpp"
+#include "descriptor_image_cache.hpp"
+
+namespace cv
+{
+namespace xfeatures2d
+{
+
+namespace
+{
+
+enum { CACHED_INTEGRAL = 0, CACHED_BOX_BLUR = 1 };
+
+// number of source images whose derived images are kept, enough for a grayscale and a color
+// version of the same frame
+enum { MAX_CACHED_SOURCES = 4 };
+
+struct CachedImage
+{
+    int kind, param;
+    Mat image;
+};
+
+struct CachedSource
+{
+    // private copy of the source pixels, never written once stored, so it can be compared
+    // with a new input outside the lock
+    Mat source;
+    std::vector<CachedImage> derived;
+};
+
+struct ImageCache
+{
+    ImageCache() : users(0), hits(0) {}
+
+    // number of extractors with caching enabled, the cache is dropped when it falls to zero
+    int users;
+    int64 hits;
+    // most recently extended first, the last one is dropped when a new source comes in
+    std::vector<CachedSource> sources;
+};
+
+Mutex& getCacheMutex()
+{
+    static Mutex* m = new Mutex();
+    return *m;
+}
+
+ImageCache& getCache()
+{
+    static ImageCache* cache = new ImageCache();
+    return *cache;
+}
+
+bool isSameImage( const Mat& a, const Mat& b )
+{
+    if( a.size() != b.size() || a.type() != b.type() )
+        return false;
+    size_t rowSize = a.cols*a.elemSize();
+    for( int y = 0; y < a.rows; y++ )
+        if( memcmp(a.ptr(y), b.ptr(y), rowSize) != 0 )
+            return false;
+    return true;
+}
+
+void compute( const Mat& src, int kind, int param, Mat& dst )
+{
+    if( kind == CACHED_INTEGRAL )
+        cv::integral( src, dst, param );
+    else
+        blur( src, dst, Size(param, param) );
+}
+
+Mat getDerived( const Mat& src, int kind, int param, bool useCache )
+{
+    Mat dst;
+    if( !useCache )
+    {
+        compute( src, kind, param, dst );
+        return dst;
+    }
+
+    // Candidates of the same size and type are taken under the lock, their pixels are compared
+    // with the input outside of it: the input buffer may have been rewritten since it was cached
+    std::vector<CachedSource> candidates;
+    {
+        AutoLock lock(getCacheMutex());
+        const std::vector<CachedSource>& sources = getCache().sources;
+        for( size_t i = 0; i < sources.size(); i++ )
+            if( sources[i].source.size() == src.size() && sources[i].source.type() == src.type() )
+                candidates.push_back( sources[i] );
+    }
+
+    Mat source;
+    for( size_t i = 0; i < candidates.size() && source.empty(); i++ )
+    {
+        if( !isSameImage( src, candidates[i].source ) )
+            continue;
+        source = candidates[i].source;
+        const std::vector<CachedImage>& derived = candidates[i].derived;
+        for( size_t k = 0; k < derived.size(); k++ )
+            if( derived[k].kind == kind && derived[k].param == param )
+            {
+                AutoLock lock(getCacheMutex());
+                getCache().hits++;
+                return derived[k].image;
+            }
+    }
+
+    // cached images are never written to, callers share them read-only
+    compute( src, kind, param, dst );
+    if( source.empty() )
+        source = src.clone();
+
+    AutoLock lock(getCacheMutex());
+    ImageCache& cache = getCache();
+    if( cache.users == 0 )
+        return dst;
+
+    // the stored copy identifies the entry; it may have been dropped meanwhile
+    size_t i = 0;
+    while( i < cache.sources.size() && cache.sources[i].source.data != source.data )
+        i++;
+    if( i == cache.sources.size() )
+    {
+        CachedSource entry;
+        entry.source = source;
+        cache.sources.insert( cache.sources.begin(), entry );
+        if( cache.sources.size() > MAX_CACHED_SOURCES )
+            cache.sources.pop_back();
+    }
+    else
+        std::rotate( cache.sources.begin(), cache.sources.begin() + i, cache.sources.begin() + i + 1 );
+
+    std::vector<CachedImage>& derived = cache.sources[0].derived;
+    for( size_t k = 0; k < derived.size(); k++ )
+        if( derived[k].kind == kind && derived[k].param == param )
+            return derived[k].image;
+    CachedImage item;
+    item.kind = kind;
+    item.param = param;
+    item.image = dst;
+    derived.push_back( item );
+    return dst;
+}
+
+}
+
+Mat DescriptorImageCache::integral( const Mat& src, int sdepth, bool useCache )
+{
+    CV_Assert( sdepth == CV_32S || sdepth == CV_64F );
+    return getDerived( src, CACHED_INTEGRAL, sdepth, useCache );
+}
+
+Mat DescriptorImageCache::boxBlur( const Mat& src, int ksize, bool useCache )
+{
+    CV_Assert( ksize > 0 );
+    return getDerived( src, CACHED_BOX_BLUR, ksize, useCache );
+}
+
+void DescriptorImageCache::setEnabled( bool& enabled, bool enable )
+{
+    if( enabled == enable )
+        return;
+    enabled = enable;
+
+    AutoLock lock(getCacheMutex());
+    ImageCache& cache = getCache();
+    cache.users += enable ? 1 : -1;
+    if( cache.users == 0 )
+        cache.sources.clear();
+}
+
+int64 DescriptorImageCache::hits()
+{
+    AutoLock lock(getCacheMutex());
+    return getCache().hits;
+}
+
+}
+}
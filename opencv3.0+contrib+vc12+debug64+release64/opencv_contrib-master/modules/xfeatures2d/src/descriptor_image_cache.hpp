@@ -0,0 +1,37 @@
+///////////// see LICENSE.txt in the OpenCV root directory //////////////
+
+#ifndef __OPENCV_XFEATURES2D_DESCRIPTOR_IMAGE_CACHE_HPP__
+#define __OPENCV_XFEATURES2D_DESCRIPTOR_IMAGE_CACHE_HPP__
+
+namespace cv
+{
+namespace xfeatures2d
+{
+
+/*
+ Images derived by the binary descriptor extractors from their input. For an extractor with
+ image caching enabled (setImageCaching) the results are kept for the last few input images
+ and shared with the other extractors; a cached image is reused only when the new input has
+ the same pixels. Otherwise they are simply computed. Exported only for the tests.
+ */
+class CV_EXPORTS DescriptorImageCache
+{
+public:
+    //! integral image of src with sdepth CV_32S or CV_64F
+    static Mat integral( const Mat& src, int sdepth, bool useCache );
+
+    //! src filtered by a normalized ksize x ksize box filter
+    static Mat boxBlur( const Mat& src, int ksize, bool useCache );
+
+    //! switches the caching flag of one extractor; the cached images are dropped
+    //! when no extractor uses the cache any more
+    static void setEnabled( bool& enabled, bool enable );
+
+    //! number of derived images taken from the cache so far
+    static int64 hits();
+};
+
+}
+}
+
+#endif
@@ -31,6 +31,8 @@
 //  the use of this software, even if advised of the possibility of such damage.
 
 #include "precomp.hpp"
+#include "descriptor_image_cache.hpp"
+#include "opencv2/core/hal/intrin.hpp"
 #include <fstream>
 #include <stdlib.h>
 #include <algorithm>
@@ -87,25 +89,35 @@ public:
                                  const double corrThresh = 0.7, bool verbose = true );
     virtual void compute( InputArray image, std::vector<KeyPoint>& keypoints, OutputArray descriptors );
 
+    virtual void setImageCaching(bool enable) { DescriptorImageCache::setEnabled( imageCaching, enable ); }
+    virtual bool getImageCaching() const { return imageCaching; }
+
 protected:
 
     void buildPattern();
 
     template <typename imgType, typename iiType>
-    imgType meanIntensity( InputArray image, InputArray integral, const float kp_x, const float kp_y,
-                          const unsigned int scale, const unsigned int rot, const unsigned int point );
+    imgType meanIntensity( const Mat& image, const Mat& integral, const float kp_x, const float kp_y,
+                          const unsigned int scale, const unsigned int rot, const unsigned int point ) const;
 
     template <typename srcMatType, typename iiMatType>
     void computeDescriptors( InputArray image, std::vector<KeyPoint>& keypoints, OutputArray descriptors );
 
+    template <typename srcMatType, typename iiMatType>
+    void describeKeypoints( const Mat& image, const Mat& integral, std::vector<KeyPoint>& keypoints,
+                            const std::vector<int>& kpScaleIdx, Mat& descriptors, const Range& range ) const;
+
     template <typename srcMatType>
-    void extractDescriptor(srcMatType *pointsValue, void ** ptr);
+    void extractDescriptor(srcMatType *pointsValue, void ** ptr) const;
+
+    template <typename srcMatType, typename iiMatType> friend struct FREAKDescriptorInvoker;
 
     bool orientationNormalized; //true if the orientation is normalized, false otherwise
     bool scaleNormalized; //true if the scale is normalized, false otherwise
     double patternScale; //scaling of the pattern
     int nOctaves; //number of octaves
     bool extAll; // true if all pairs need to be extracted for pairs selection
+    bool imageCaching; // true if the integral image is shared with the other extractors
 
     double patternScale0;
     int nOctaves0;
@@ -322,6 +334,30 @@ void FREAK_Impl::buildPattern()
     }
 }
 
+// Multi-threaded description of the keypoints
+template <typename srcMatType, typename iiMatType>
+struct FREAKDescriptorInvoker : ParallelLoopBody
+{
+    FREAKDescriptorInvoker( const FREAK_Impl* _freak, const Mat& _image, const Mat& _integral,
+                            std::vector<KeyPoint>& _keypoints, const std::vector<int>& _kpScaleIdx,
+                            Mat& _descriptors )
+        : freak(_freak), image(&_image), integral(&_integral), keypoints(&_keypoints),
+          kpScaleIdx(&_kpScaleIdx), descriptors(&_descriptors) {}
+
+    void operator()(const Range& range) const
+    {
+        freak->describeKeypoints<srcMatType, iiMatType>(*image, *integral, *keypoints, *kpScaleIdx,
+                                                        *descriptors, range);
+    }
+
+    const FREAK_Impl* freak;
+    const Mat* image;
+    const Mat* integral;
+    std::vector<KeyPoint>* keypoints;
+    const std::vector<int>* kpScaleIdx;
+    Mat* descriptors;
+};
+
 void FREAK_Impl::compute( InputArray _image, std::vector<KeyPoint>& keypoints, OutputArray _descriptors )
 {
     Mat image = _image.getMat();
@@ -363,7 +399,7 @@ void FREAK_Impl::compute( InputArray _image, std::vector<KeyPoint>& keypoints, O
 }
 
 template <typename srcMatType>
-void FREAK_Impl::extractDescriptor(srcMatType *pointsValue, void ** ptr)
+void FREAK_Impl::extractDescriptor(srcMatType *pointsValue, void ** ptr) const
 {
     std::bitset<FREAK_NB_PAIRS>** ptrScalar = (std::bitset<FREAK_NB_PAIRS>**) ptr;
 
@@ -380,66 +416,47 @@ void FREAK_Impl::extractDescriptor(srcMatType *pointsValue, void ** ptr)
             }
         }
     }
-    --(*ptrScalar);
 }
 
-#if CV_SSE2
+#if CV_SIMD128
 template <>
-void FREAK_Impl::extractDescriptor(uchar *pointsValue, void ** ptr)
+void FREAK_Impl::extractDescriptor(uchar *pointsValue, void ** ptr) const
 {
-    __m128i** ptrSSE = (__m128i**) ptr;
+    v_uint8x16** ptrSIMD = (v_uint8x16**) ptr;
+    uchar* dst = (uchar*) *ptrSIMD;
 
     // note that comparisons order is modified in each block (but first 128 comparisons remain globally the same-->does not affect the 128,384 bits segmanted matching strategy)
+    // 16 pairs are gathered and compared at once, the first pair going to the last lane
     int cnt = 0;
-    for( int n = FREAK_NB_PAIRS/128; n-- ; )
+    for( int n = 0; n < FREAK_NB_PAIRS/128; n++ )
     {
-        __m128i result128 = _mm_setzero_si128();
+        v_uint8x16 result128 = v_setzero_u8();
         for( int m = 128/16; m--; cnt += 16 )
         {
-            __m128i operand1 = _mm_set_epi8(pointsValue[descriptionPairs[cnt+0].i],
-                                            pointsValue[descriptionPairs[cnt+1].i],
-                                            pointsValue[descriptionPairs[cnt+2].i],
-                                            pointsValue[descriptionPairs[cnt+3].i],
-                                            pointsValue[descriptionPairs[cnt+4].i],
-                                            pointsValue[descriptionPairs[cnt+5].i],
-                                            pointsValue[descriptionPairs[cnt+6].i],
-                                            pointsValue[descriptionPairs[cnt+7].i],
-                                            pointsValue[descriptionPairs[cnt+8].i],
-                                            pointsValue[descriptionPairs[cnt+9].i],
-                                            pointsValue[descriptionPairs[cnt+10].i],
-                                            pointsValue[descriptionPairs[cnt+11].i],
-                                            pointsValue[descriptionPairs[cnt+12].i],
-                                            pointsValue[descriptionPairs[cnt+13].i],
-                                            pointsValue[descriptionPairs[cnt+14].i],
-                                            pointsValue[descriptionPairs[cnt+15].i]);
-
-            __m128i operand2 = _mm_set_epi8(pointsValue[descriptionPairs[cnt+0].j],
-                                            pointsValue[descriptionPairs[cnt+1].j],
-                                            pointsValue[descriptionPairs[cnt+2].j],
-                                            pointsValue[descriptionPairs[cnt+3].j],
-                                            pointsValue[descriptionPairs[cnt+4].j],
-                                            pointsValue[descriptionPairs[cnt+5].j],
-                                            pointsValue[descriptionPairs[cnt+6].j],
-                                            pointsValue[descriptionPairs[cnt+7].j],
-                                            pointsValue[descriptionPairs[cnt+8].j],
-                                            pointsValue[descriptionPairs[cnt+9].j],
-                                            pointsValue[descriptionPairs[cnt+10].j],
-                                            pointsValue[descriptionPairs[cnt+11].j],
-                                            pointsValue[descriptionPairs[cnt+12].j],
-                                            pointsValue[descriptionPairs[cnt+13].j],
-                                            pointsValue[descriptionPairs[cnt+14].j],
-                                            pointsValue[descriptionPairs[cnt+15].j]);
-
-            __m128i workReg = _mm_min_epu8(operand1, operand2); // emulated "not less than" for 8-bit UNSIGNED integers
-            workReg = _mm_cmpeq_epi8(workReg, operand2);        // emulated "not less than" for 8-bit UNSIGNED integers
-
-            workReg = _mm_and_si128(_mm_set1_epi16(short(0x8080 >> m)), workReg); // merge the last 16 bits with the 128bits std::vector until full
-            result128 = _mm_or_si128(result128, workReg);
+            const DescriptionPair* pairs = descriptionPairs + cnt;
+            v_uint8x16 operand1(pointsValue[pairs[15].i], pointsValue[pairs[14].i],
+                                pointsValue[pairs[13].i], pointsValue[pairs[12].i],
+                                pointsValue[pairs[11].i], pointsValue[pairs[10].i],
+                                pointsValue[pairs[9].i],  pointsValue[pairs[8].i],
+                                pointsValue[pairs[7].i],  pointsValue[pairs[6].i],
+                                pointsValue[pairs[5].i],  pointsValue[pairs[4].i],
+                                pointsValue[pairs[3].i],  pointsValue[pairs[2].i],
+                                pointsValue[pairs[1].i],  pointsValue[pairs[0].i]);
+
+            v_uint8x16 operand2(pointsValue[pairs[15].j], pointsValue[pairs[14].j],
+                                pointsValue[pairs[13].j], pointsValue[pairs[12].j],
+                                pointsValue[pairs[11].j], pointsValue[pairs[10].j],
+                                pointsValue[pairs[9].j],  pointsValue[pairs[8].j],
+                                pointsValue[pairs[7].j],  pointsValue[pairs[6].j],
+                                pointsValue[pairs[5].j],  pointsValue[pairs[4].j],
+                                pointsValue[pairs[3].j],  pointsValue[pairs[2].j],
+                                pointsValue[pairs[1].j],  pointsValue[pairs[0].j]);
+
+            // merge the last 16 bits with the 128bits std::vector until full
+            result128 |= (operand1 >= operand2) & v_setall_u8((uchar)(0x80 >> m));
         }
-        (**ptrSSE) = result128;
-        ++(*ptrSSE);
+        v_store(dst + n*16, result128);
     }
-    (*ptrSSE) -= 8;
 }
 #endif
 
@@ -447,16 +464,12 @@ template <typename srcMatType, typename iiMatType>
 void FREAK_Impl::computeDescriptors( InputArray _image, std::vector<KeyPoint>& keypoints, OutputArray _descriptors ){
 
     Mat image = _image.getMat();
-    Mat imgIntegral;
-    integral(image, imgIntegral, DataType<iiMatType>::type);
+    // shared with the other extractors run on the same image when enabled
+    Mat imgIntegral = DescriptorImageCache::integral(image, DataType<iiMatType>::type, imageCaching);
     std::vector<int> kpScaleIdx(keypoints.size()); // used to save pattern scale index corresponding to each keypoints
     const std::vector<int>::iterator ScaleIdxBegin = kpScaleIdx.begin(); // used in std::vector erase function
     const std::vector<cv::KeyPoint>::iterator kpBegin = keypoints.begin(); // used in std::vector erase function
     const float sizeCst = static_cast<float>(FREAK_NB_SCALES/(FREAK_LOG2* nOctaves));
-    srcMatType pointsValue[FREAK_NB_POINTS];
-    int thetaIdx = 0;
-    int direction0;
-    int direction1;
 
     // compute the scale index corresponding to the keypoint size and remove keypoints close to the border
     if( scaleNormalized )
@@ -501,118 +514,81 @@ void FREAK_Impl::computeDescriptors( InputArray _image, std::vector<KeyPoint>& k
         }
     }
 
-    // allocate descriptor memory, estimate orientations, extract descriptors
-    if( !extAll )
-    {
-        // extract the best comparisons only
-        _descriptors.create((int)keypoints.size(), FREAK_NB_PAIRS/8, CV_8U);
-        _descriptors.setTo(Scalar::all(0));
-        Mat descriptors = _descriptors.getMat();
+    // allocate descriptor memory, all possible comparisons are extracted for selection
+    _descriptors.create((int)keypoints.size(), extAll ? 128 : FREAK_NB_PAIRS/8, CV_8U);
+    _descriptors.setTo(Scalar::all(0));
+    Mat descriptors = _descriptors.getMat();
 
-        void *ptr = descriptors.data+(keypoints.size()-1)*descriptors.step[0];
-
-        for( size_t k = keypoints.size(); k--; ) {
-            // estimate orientation (gradient)
-            if( !orientationNormalized )
-            {
-                thetaIdx = 0; // assign 0° to all keypoints
-                keypoints[k].angle = 0.0;
-            }
-            else
-            {
-                // get the points intensity value in the un-rotated pattern
-                for( int i = FREAK_NB_POINTS; i--; ) {
-                    pointsValue[i] = meanIntensity<srcMatType, iiMatType>(image, imgIntegral,
-                                                                          keypoints[k].pt.x, keypoints[k].pt.y,
-                                                                          kpScaleIdx[k], 0, i);
-                }
-                direction0 = 0;
-                direction1 = 0;
-                for( int m = 45; m--; )
-                {
-                    //iterate through the orientation pairs
-                    const int delta = (pointsValue[ orientationPairs[m].i ]-pointsValue[ orientationPairs[m].j ]);
-                    direction0 += delta*(orientationPairs[m].weight_dx)/2048;
-                    direction1 += delta*(orientationPairs[m].weight_dy)/2048;
-                }
-
-                keypoints[k].angle = static_cast<float>(atan2((float)direction1,(float)direction0)*(180.0/CV_PI));//estimate orientation
-
-                if(keypoints[k].angle < 0.f)
-                    thetaIdx = int(FREAK_NB_ORIENTATION*keypoints[k].angle*(1/360.0)-0.5);
-                else
-                    thetaIdx = int(FREAK_NB_ORIENTATION*keypoints[k].angle*(1/360.0)+0.5);
+    // estimate orientations, extract descriptors
+    parallel_for_( Range(0, (int)keypoints.size()),
+                   FREAKDescriptorInvoker<srcMatType, iiMatType>(this, image, imgIntegral, keypoints,
+                                                                 kpScaleIdx, descriptors) );
+}
 
-                if( thetaIdx < 0 )
-                    thetaIdx += FREAK_NB_ORIENTATION;
+template <typename srcMatType, typename iiMatType>
+void FREAK_Impl::describeKeypoints( const Mat& image, const Mat& imgIntegral, std::vector<KeyPoint>& keypoints,
+                                    const std::vector<int>& kpScaleIdx, Mat& descriptors, const Range& range ) const
+{
+    srcMatType pointsValue[FREAK_NB_POINTS];
+    int thetaIdx = 0;
+    int direction0;
+    int direction1;
 
-                if( thetaIdx >= FREAK_NB_ORIENTATION )
-                    thetaIdx -= FREAK_NB_ORIENTATION;
-            }
-            // extract descriptor at the computed orientation
+    for( int k = range.start; k < range.end; k++ )
+    {
+        // estimate orientation (gradient)
+        if( !orientationNormalized )
+        {
+            thetaIdx = 0; // assign 0° to all keypoints
+            keypoints[k].angle = 0.0;
+        }
+        else
+        {
+            // get the points intensity value in the un-rotated pattern
             for( int i = FREAK_NB_POINTS; i--; ) {
                 pointsValue[i] = meanIntensity<srcMatType, iiMatType>(image, imgIntegral,
                                                                       keypoints[k].pt.x, keypoints[k].pt.y,
-                                                                      kpScaleIdx[k], thetaIdx, i);
+                                                                      kpScaleIdx[k], 0, i);
             }
-
-            // Extract descriptor
-            extractDescriptor<srcMatType>(pointsValue, &ptr);
-        }
-    }
-    else // extract all possible comparisons for selection
-    {
-        _descriptors.create((int)keypoints.size(), 128, CV_8U);
-        _descriptors.setTo(Scalar::all(0));
-        Mat descriptors = _descriptors.getMat();
-        std::bitset<1024>* ptr = (std::bitset<1024>*) (descriptors.data+(keypoints.size()-1)*descriptors.step[0]);
-
-        for( size_t k = keypoints.size(); k--; )
-        {
-            //estimate orientation (gradient)
-            if( !orientationNormalized )
+            direction0 = 0;
+            direction1 = 0;
+            for( int m = 45; m--; )
             {
-                thetaIdx = 0;//assign 0° to all keypoints
-                keypoints[k].angle = 0.0;
+                //iterate through the orientation pairs
+                const int delta = (pointsValue[ orientationPairs[m].i ]-pointsValue[ orientationPairs[m].j ]);
+                direction0 += delta*(orientationPairs[m].weight_dx)/2048;
+                direction1 += delta*(orientationPairs[m].weight_dy)/2048;
             }
-            else
-            {
-                //get the points intensity value in the un-rotated pattern
-                for( int i = FREAK_NB_POINTS;i--; )
-                    pointsValue[i] = meanIntensity<srcMatType, iiMatType>(image, imgIntegral,
-                                                                          keypoints[k].pt.x,keypoints[k].pt.y,
-                                                                          kpScaleIdx[k], 0, i);
-
-                direction0 = 0;
-                direction1 = 0;
-                for( int m = 45; m--; )
-                {
-                    //iterate through the orientation pairs
-                    const int delta = (pointsValue[ orientationPairs[m].i ]-pointsValue[ orientationPairs[m].j ]);
-                    direction0 += delta*(orientationPairs[m].weight_dx)/2048;
-                    direction1 += delta*(orientationPairs[m].weight_dy)/2048;
-                }
 
-                keypoints[k].angle = static_cast<float>(atan2((float)direction1,(float)direction0)*(180.0/CV_PI)); //estimate orientation
+            keypoints[k].angle = static_cast<float>(atan2((float)direction1,(float)direction0)*(180.0/CV_PI));//estimate orientation
 
-                if(keypoints[k].angle < 0.f)
-                    thetaIdx = int(FREAK_NB_ORIENTATION*keypoints[k].angle*(1/360.0)-0.5);
-                else
-                    thetaIdx = int(FREAK_NB_ORIENTATION*keypoints[k].angle*(1/360.0)+0.5);
+            if(keypoints[k].angle < 0.f)
+                thetaIdx = int(FREAK_NB_ORIENTATION*keypoints[k].angle*(1/360.0)-0.5);
+            else
+                thetaIdx = int(FREAK_NB_ORIENTATION*keypoints[k].angle*(1/360.0)+0.5);
 
-                if( thetaIdx < 0 )
-                    thetaIdx += FREAK_NB_ORIENTATION;
+            if( thetaIdx < 0 )
+                thetaIdx += FREAK_NB_ORIENTATION;
 
-                if( thetaIdx >= FREAK_NB_ORIENTATION )
-                    thetaIdx -= FREAK_NB_ORIENTATION;
-            }
-            // get the points intensity value in the rotated pattern
-            for( int i = FREAK_NB_POINTS; i--; ) {
-                pointsValue[i] = meanIntensity<srcMatType, iiMatType>(image, imgIntegral,
-                                                                      keypoints[k].pt.x, keypoints[k].pt.y,
-                                                                      kpScaleIdx[k], thetaIdx, i);
-            }
+            if( thetaIdx >= FREAK_NB_ORIENTATION )
+                thetaIdx -= FREAK_NB_ORIENTATION;
+        }
+        // get the points intensity value in the rotated pattern
+        for( int i = FREAK_NB_POINTS; i--; ) {
+            pointsValue[i] = meanIntensity<srcMatType, iiMatType>(image, imgIntegral,
+                                                                  keypoints[k].pt.x, keypoints[k].pt.y,
+                                                                  kpScaleIdx[k], thetaIdx, i);
+        }
 
+        if( !extAll )
+        {
+            // Extract descriptor
+            void *ptr = descriptors.ptr(k);
+            extractDescriptor<srcMatType>(pointsValue, &ptr);
+        }
+        else // extract all possible comparisons for selection
+        {
+            std::bitset<1024>* ptr = (std::bitset<1024>*) descriptors.ptr(k);
             int cnt(0);
             for( int i = 1; i < FREAK_NB_POINTS; ++i )
             {
@@ -623,21 +599,19 @@ void FREAK_Impl::computeDescriptors( InputArray _image, std::vector<KeyPoint>& k
                     ++cnt;
                 }
             }
-            --ptr;
         }
     }
 }
 
 // simply take average on a square patch, not even gaussian approx
 template <typename imgType, typename iiType>
-imgType FREAK_Impl::meanIntensity( InputArray _image, InputArray _integral,
+imgType FREAK_Impl::meanIntensity( const Mat& image, const Mat& integral,
                               const float kp_x,
                               const float kp_y,
                               const unsigned int scale,
                               const unsigned int rot,
-                              const unsigned int point)
+                              const unsigned int point) const
 {
-    Mat image = _image.getMat(), integral = _integral.getMat();
     // get point position in image
     const PatternPoint& FreakPoint = patternLookup[scale*FREAK_NB_ORIENTATION*FREAK_NB_POINTS + rot*FREAK_NB_POINTS + point];
     const float xf = FreakPoint.x+kp_x;
@@ -811,13 +785,14 @@ void FREAKImpl::drawPattern()
 FREAK_Impl::FREAK_Impl( bool _orientationNormalized, bool _scaleNormalized
             , float _patternScale, int _nOctaves, const std::vector<int>& _selectedPairs )
     : orientationNormalized(_orientationNormalized), scaleNormalized(_scaleNormalized),
-    patternScale(_patternScale), nOctaves(_nOctaves), extAll(false),
+    patternScale(_patternScale), nOctaves(_nOctaves), extAll(false), imageCaching(false),
     patternScale0(0.0), nOctaves0(0), selectedPairs0(_selectedPairs)
 {
 }
 
 FREAK_Impl::~FREAK_Impl()
 {
+    DescriptorImageCache::setEnabled( imageCaching, false );
 }
 
 int FREAK_Impl::descriptorSize() const
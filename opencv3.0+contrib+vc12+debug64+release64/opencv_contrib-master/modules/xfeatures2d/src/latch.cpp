@@ -44,6 +44,8 @@
 //M*/
 
 #include "precomp.hpp"
+#include "latch_reference.hpp"
+#include "opencv2/core/hal/intrin.hpp"
 #include <algorithm>
 #include <vector>
 
@@ -74,11 +76,13 @@ namespace cv
 
             virtual void compute(InputArray image, std::vector<KeyPoint>& keypoints, OutputArray descriptors);
 
+            //! the same descriptors computed by the plain scalar loop
+            void computeReference(InputArray image, std::vector<KeyPoint>& keypoints, OutputArray descriptors);
+
         protected:
-            typedef void(*PixelTestFn)(const Mat& input_image, const std::vector<KeyPoint>& keypoints, OutputArray, const std::vector<int> &points, bool rotationInvariance, int half_ssd_size);
+            void prepare(InputArray image, std::vector<KeyPoint>& keypoints, OutputArray _descriptors, Mat& grayImage, Mat& descriptors);
             void setSamplingPoints();
             int bytes_;
-            PixelTestFn test_fn_;
             bool rotationInvariance_;
             int half_ssd_size_;
 
@@ -90,344 +94,146 @@ namespace cv
         {
             return makePtr<LATCHDescriptorExtractorImpl>(bytes, rotationInvariance, half_ssd_size);
         }
-        void CalcuateSums(int count, const std::vector<int> &points, bool rotationInvariance, const Mat &grayImage, const KeyPoint &pt, int &suma, int &sumc, float cos_theta, float sin_theta, int half_ssd_size);
-
-
-        static void pixelTests1(const Mat& grayImage, const std::vector<KeyPoint>& keypoints, OutputArray _descriptors, const std::vector<int> &points, bool rotationInvariance, int half_ssd_size)
-        {
-            Mat descriptors = _descriptors.getMat();
-            for (int i = 0; i < (int)keypoints.size(); ++i)
-            {
-                uchar* desc = descriptors.ptr(i);
-                const KeyPoint& pt = keypoints[i];
-                int count = 0;
-
-                //handling keypoint orientation
-                float angle = pt.angle;
-                angle *= (float)(CV_PI / 180.f);
-                float cos_theta = cos(angle);
-                float sin_theta = sin(angle);
-                for (int ix = 0; ix < 1; ix++){
-                    desc[ix] = 0;
-                    for (int j = 7; j >= 0; j--){
-
-                        int suma = 0;
-                        int sumc = 0;
-
-                        CalcuateSums(count, points, rotationInvariance, grayImage, pt, suma, sumc, cos_theta, sin_theta, half_ssd_size);
-                        desc[ix] += (uchar)((suma < sumc) << j);
-
-                        count += 6;
-                    }
-                }
-            }
-        }
-
-
-        static void pixelTests2(const Mat& grayImage, const std::vector<KeyPoint>& keypoints, OutputArray _descriptors, const std::vector<int> &points, bool rotationInvariance, int half_ssd_size)
-        {
-            Mat descriptors = _descriptors.getMat();
-            for (int i = 0; i < (int)keypoints.size(); ++i)
-            {
-                uchar* desc = descriptors.ptr(i);
-                const KeyPoint& pt = keypoints[i];
-                int count = 0;
-
-                //handling keypoint orientation
-                float angle = pt.angle;
-                angle *= (float)(CV_PI / 180.f);
-                float cos_theta = cos(angle);
-                float sin_theta = sin(angle);
-                for (int ix = 0; ix < 2; ix++){
-                    desc[ix] = 0;
-                    for (int j = 7; j >= 0; j--){
-
-                        int suma = 0;
-                        int sumc = 0;
-
-                        CalcuateSums(count, points, rotationInvariance, grayImage, pt, suma, sumc, cos_theta, sin_theta, half_ssd_size);
-                        desc[ix] += (uchar)((suma < sumc) << j);
-
-                        count += 6;
-                    }
-                }
-            }
-        }
-
-
-        static void pixelTests4(const Mat& grayImage, const std::vector<KeyPoint>& keypoints, OutputArray _descriptors, const std::vector<int> &points, bool rotationInvariance, int half_ssd_size)
-        {
-            Mat descriptors = _descriptors.getMat();
-            for (int i = 0; i < (int)keypoints.size(); ++i)
-            {
-                uchar* desc = descriptors.ptr(i);
-                const KeyPoint& pt = keypoints[i];
-                int count = 0;
-
-                //handling keypoint orientation
-                float angle = pt.angle;
-                angle *= (float)(CV_PI / 180.f);
-                float cos_theta = cos(angle);
-                float sin_theta = sin(angle);
-                for (int ix = 0; ix < 4; ix++){
-                    desc[ix] = 0;
-                    for (int j = 7; j >= 0; j--){
-
-                        int suma = 0;
-                        int sumc = 0;
-
-                        CalcuateSums(count, points, rotationInvariance, grayImage, pt, suma, sumc, cos_theta, sin_theta, half_ssd_size);
-                        desc[ix] += (uchar)((suma < sumc) << j);
-
-                        count += 6;
-                    }
-                }
-            }
-        }
-
-
-
-        static void pixelTests8(const Mat& grayImage, const std::vector<KeyPoint>& keypoints, OutputArray _descriptors, const std::vector<int> &points, bool rotationInvariance, int half_ssd_size)
-        {
-            Mat descriptors = _descriptors.getMat();
-            for (int i = 0; i < (int)keypoints.size(); ++i)
-            {
-                uchar* desc = descriptors.ptr(i);
-                const KeyPoint& pt = keypoints[i];
-                int count = 0;
-
-                //handling keypoint orientation
-                float angle = pt.angle;
-                angle *= (float)(CV_PI / 180.f);
-                float cos_theta = cos(angle);
-                float sin_theta = sin(angle);
-                for (int ix = 0; ix < 8; ix++){
-                    desc[ix] = 0;
-                    for (int j = 7; j >= 0; j--){
-
-                        int suma = 0;
-                        int sumc = 0;
-
-                        CalcuateSums(count, points, rotationInvariance, grayImage, pt, suma, sumc, cos_theta, sin_theta, half_ssd_size);
-                        desc[ix] += (uchar)((suma < sumc) << j);
-
-                        count += 6;
-                    }
-                }
-            }
-        }
-
-
-        static void pixelTests16(const Mat& grayImage, const std::vector<KeyPoint>& keypoints, OutputArray _descriptors, const std::vector<int> &points, bool rotationInvariance, int half_ssd_size)
+        /*
+        * Sums of squared differences between the patches a, b and c, b being the shared middle patch of
+        * the triplet. The rows are processed 8 pixels at a time; lanes past the patch width are masked out,
+        * so the integer sums are the same as those of the scalar loop.
+        */
+        static inline void tripletSSD(const uchar* a, const uchar* b, const uchar* c, size_t step, int width, bool simd, int& suma, int& sumc)
         {
-            Mat descriptors = _descriptors.getMat();
-            for (int i = 0; i < (int)keypoints.size(); ++i)
+            suma = 0;
+            sumc = 0;
+#if CV_SIMD128
+            if (simd)
             {
-                uchar* desc = descriptors.ptr(i);
-                const KeyPoint& pt = keypoints[i];
-                int count = 0;
-
-                //handling keypoint orientation
-                float angle = pt.angle;
-                angle *= (float)(CV_PI / 180.f);
-                float cos_theta = cos(angle);
-                float sin_theta = sin(angle);
-                for (int ix = 0; ix < 16; ix++){
-                    desc[ix] = 0;
-                    for (int j = 7; j >= 0; j--){
-
-                        int suma = 0;
-                        int sumc = 0;
-
-                        CalcuateSums(count, points, rotationInvariance, grayImage, pt, suma, sumc, cos_theta, sin_theta, half_ssd_size);
-                        desc[ix] += (uchar)((suma < sumc) << j);
-
-                        count += 6;
+                static const short lanes[16] = { -1, -1, -1, -1, -1, -1, -1, -1, 0, 0, 0, 0, 0, 0, 0, 0 };
+                const int tail = width & 7;
+                const v_int16x8 tailMask = v_load(lanes + (tail ? 8 - tail : 0));
+                v_int32x4 va = v_setzero_s32(), vc = v_setzero_s32();
+                for (int iy = 0; iy < width; iy++, a += step, b += step, c += step)
+                {
+                    for (int ix = 0; ix < width; ix += 8)
+                    {
+                        v_int16x8 pb = v_reinterpret_as_s16(v_load_expand(b + ix));
+                        v_int16x8 da = v_reinterpret_as_s16(v_load_expand(a + ix)) - pb;
+                        v_int16x8 dc = v_reinterpret_as_s16(v_load_expand(c + ix)) - pb;
+                        if (ix + 8 > width)
+                        {
+                            da &= tailMask;
+                            dc &= tailMask;
+                        }
+                        va += v_dotprod(da, da);
+                        vc += v_dotprod(dc, dc);
                     }
                 }
+                suma = v_reduce_sum(va);
+                sumc = v_reduce_sum(vc);
+                return;
             }
-        }
-
-
-        static void pixelTests32(const Mat& grayImage, const std::vector<KeyPoint>& keypoints, OutputArray _descriptors, const std::vector<int> &points, bool rotationInvariance, int half_ssd_size)
-        {
-            Mat descriptors = _descriptors.getMat();
-            for (int i = 0; i < (int)keypoints.size(); ++i)
+#else
+            (void)simd;
+#endif
+            for (int iy = 0; iy < width; iy++, a += step, b += step, c += step)
             {
-                uchar* desc = descriptors.ptr(i);
-                const KeyPoint& pt = keypoints[i];
-                int count = 0;
-
-                float angle = pt.angle;
-                angle *= (float)(CV_PI / 180.f);
-                float cos_theta = cos(angle);
-                float sin_theta = sin(angle);
-                for (int ix = 0; ix < 32; ix++){
-                    desc[ix] = 0;
-                    for (int j = 7; j >= 0; j--){
-
-                        int suma = 0;
-                        int sumc = 0;
-
-                        CalcuateSums(count, points, rotationInvariance, grayImage, pt, suma, sumc, cos_theta, sin_theta, half_ssd_size);
-                        desc[ix] += (uchar)((suma < sumc) << j);
+                for (int ix = 0; ix < width; ix++)
+                {
+                    int difa = a[ix] - b[ix];
+                    suma += difa*difa;
 
-                        count += 6;
-                    }
+                    int difc = c[ix] - b[ix];
+                    sumc += difc*difc;
                 }
             }
         }
 
-
-        static void pixelTests64(const Mat& grayImage, const std::vector<KeyPoint>& keypoints, OutputArray _descriptors, const std::vector<int> &points, bool rotationInvariance, int half_ssd_size)
+        /*
+        * Computes the descriptors of a range of keypoints. For every keypoint the triplet offsets are rotated
+        * once, with the same float arithmetic and clamping as the reference implementation, and turned into
+        * pointers to the top-left corners of the three patches.
+        */
+        class LATCHInvoker : public ParallelLoopBody
         {
-            Mat descriptors = _descriptors.getMat();
-            for (int i = 0; i < (int)keypoints.size(); ++i)
+        public:
+            LATCHInvoker(const Mat& grayImage, const std::vector<KeyPoint>& keypoints, Mat& descriptors,
+                         const std::vector<int>& points, bool rotationInvariance, int half_ssd_size) :
+                grayImage_(grayImage), keypoints_(keypoints), descriptors_(descriptors),
+                points_(points), rotationInvariance_(rotationInvariance), half_ssd_size_(half_ssd_size)
             {
-                uchar* desc = descriptors.ptr(i);
-                const KeyPoint& pt = keypoints[i];
-                int count = 0;
-
-                //handling keypoint orientation
-                float angle = pt.angle;
-                angle *= (float)(CV_PI / 180.f);
-                float cos_theta = cos(angle);
-                float sin_theta = sin(angle);
-                for (int ix = 0; ix < 64; ix++){
-                    desc[ix] = 0;
-                    for (int j = 7; j >= 0; j--){
-
-                        int suma = 0;
-                        int sumc = 0;
-
-                        CalcuateSums(count, points, rotationInvariance, grayImage, pt, suma, sumc, cos_theta, sin_theta, half_ssd_size);
-                        desc[ix] += (uchar)((suma < sumc) << j);
-
-                        count += 6;
-                    }
-                }
-            }
-        }
-
-        void CalcuateSums(int count, const std::vector<int> &points, bool rotationInvariance, const Mat &grayImage, const KeyPoint &pt, int &suma, int &sumc, float cos_theta, float sin_theta, int half_ssd_size)
-
-        {
-            int ax = points[count];
-            int ay = points[count + 1];
-
-            int	bx = points[count + 2];
-            int	by = points[count + 3];
-
-            int cx = points[count + 4];
-            int cy = points[count + 5];
-
-            int ax2 = ax;
-            int ay2 = ay;
-            int bx2 = bx;
-            int by2 = by;
-            int cx2 = cx;
-            int cy2 = cy;
-
-            if (rotationInvariance){
-
-
-                ax2 =(int)(((float)ax)*cos_theta - ((float)ay)*sin_theta);
-                ay2 = (int)(((float)ax)*sin_theta + ((float)ay)*cos_theta);
-                bx2 = (int)(((float)bx)*cos_theta - ((float)by)*sin_theta);
-                by2 = (int)(((float)bx)*sin_theta + ((float)by)*cos_theta);
-                cx2 = (int)(((float)cx)*cos_theta - ((float)cy)*sin_theta);
-                cy2 = (int)(((float)cx)*sin_theta + ((float)cy)*cos_theta);
-
-
-                if (ax2 > 24)
-                    ax2 = 24;
-                if (ax2<-24)
-                    ax2 = -24;
-
-                if (ay2>24)
-                    ay2 = 24;
-                if (ay2<-24)
-                    ay2 = -24;
-
-                if (bx2>24)
-                    bx2 = 24;
-                if (bx2<-24)
-                    bx2 = -24;
-
-                if (by2>24)
-                    by2 = 24;
-                if (by2<-24)
-                    by2 = -24;
-
-                if (cx2>24)
-                    cx2 = 24;
-                if (cx2<-24)
-                    cx2 = -24;
-
-                if (cy2>24)
-                    cy2 = 24;
-                if (cy2 < -24)
-                    cy2 = -24;
-
             }
 
-
-            ax2 += (int)(pt.pt.x + 0.5);
-            ay2 += (int)(pt.pt.y + 0.5);
-
-            bx2 += (int)(pt.pt.x + 0.5);
-            by2 += (int)(pt.pt.y + 0.5);
-
-            cx2 += (int)(pt.pt.x + 0.5);
-            cy2 += (int)(pt.pt.y + 0.5);
-
-
-            int K = half_ssd_size;
-            for (int iy = -K; iy <= K; iy++)
+            void operator()(const Range& range) const
             {
-                const uchar * Mi_a = grayImage.ptr<uchar>(ay2 + iy);
-                const uchar * Mi_b = grayImage.ptr<uchar>(by2 + iy);
-                const uchar * Mi_c = grayImage.ptr<uchar>(cy2 + iy);
-
-                for (int ix = -K; ix <= K; ix++)
+                const int half_patch = LATCHDescriptorExtractorImpl::PATCH_SIZE / 2;
+                const int K = half_ssd_size_;
+                const int width = 2 * K + 1;
+                const int readWidth = (width + 7) & ~7;
+                const size_t step = grayImage_.step;
+                const int bytes = descriptors_.cols;
+
+                for (int i = range.start; i < range.end; i++)
                 {
-                    double difa = Mi_a[ax2 + ix] - Mi_b[bx2 + ix];
-                    suma += (int)((difa)*(difa));
-
-                    double difc = Mi_c[cx2 + ix] - Mi_b[bx2 + ix];
-                    sumc += (int)((difc)*(difc));
+                    uchar* desc = descriptors_.ptr(i);
+                    const KeyPoint& pt = keypoints_[i];
+                    const int px = (int)(pt.pt.x + 0.5);
+                    const int py = (int)(pt.pt.y + 0.5);
+
+                    //handling keypoint orientation
+                    float angle = pt.angle;
+                    angle *= (float)(CV_PI / 180.f);
+                    float cos_theta = cos(angle);
+                    float sin_theta = sin(angle);
+
+                    // the vector loads read up to readWidth pixels per patch row
+                    const bool simd = px - half_patch - K >= 0 && px + half_patch - K + readWidth <= grayImage_.cols;
+
+                    int count = 0;
+                    for (int ix = 0; ix < bytes; ix++)
+                    {
+                        desc[ix] = 0;
+                        for (int j = 7; j >= 0; j--, count += 6)
+                        {
+                            int xy[6];
+                            for (int k = 0; k < 6; k += 2)
+                            {
+                                int x = points_[count + k];
+                                int y = points_[count + k + 1];
+                                if (rotationInvariance_)
+                                {
+                                    int x2 = (int)(((float)x)*cos_theta - ((float)y)*sin_theta);
+                                    int y2 = (int)(((float)x)*sin_theta + ((float)y)*cos_theta);
+                                    x = std::min(std::max(x2, -half_patch), half_patch);
+                                    y = std::min(std::max(y2, -half_patch), half_patch);
+                                }
+                                xy[k] = x + px - K;
+                                xy[k + 1] = y + py - K;
+                            }
+
+                            int suma, sumc;
+                            tripletSSD(grayImage_.ptr<uchar>(xy[1]) + xy[0],
+                                       grayImage_.ptr<uchar>(xy[3]) + xy[2],
+                                       grayImage_.ptr<uchar>(xy[5]) + xy[4],
+                                       step, width, simd, suma, sumc);
+                            desc[ix] += (uchar)((suma < sumc) << j);
+                        }
+                    }
                 }
             }
 
-        }
-
-
+        private:
+            const Mat& grayImage_;
+            const std::vector<KeyPoint>& keypoints_;
+            Mat& descriptors_;
+            const std::vector<int>& points_;
+            bool rotationInvariance_;
+            int half_ssd_size_;
+        };
 
         LATCHDescriptorExtractorImpl::LATCHDescriptorExtractorImpl(int bytes, bool rotationInvariance, int half_ssd_size) :
-            bytes_(bytes), test_fn_(NULL), rotationInvariance_(rotationInvariance), half_ssd_size_(half_ssd_size)
+            bytes_(bytes), rotationInvariance_(rotationInvariance), half_ssd_size_(half_ssd_size)
         {
             switch (bytes)
             {
-            case 1:
-                test_fn_ = pixelTests1;
-                break;
-            case 2:
-                test_fn_ = pixelTests2;
-                break;
-            case 4:
-                test_fn_ = pixelTests4;
-                break;
-            case 8:
-                test_fn_ = pixelTests8;
-                break;
-            case 16:
-                test_fn_ = pixelTests16;
-                break;
-            case 32:
-                test_fn_ = pixelTests32;
-                break;
-            case 64:
-                test_fn_ = pixelTests64;
+            case 1: case 2: case 4: case 8: case 16: case 32: case 64:
                 break;
             default:
                 CV_Error(Error::StsBadArg, "descriptorSize must be 1,2, 4, 8, 16, 32, or 64");
@@ -456,26 +262,7 @@ namespace cv
             int dSize = fn["descriptorSize"];
             switch (dSize)
             {
-            case 1:
-                test_fn_ = pixelTests1;
-                break;
-            case 2:
-                test_fn_ = pixelTests2;
-                break;
-            case 4:
-                test_fn_ = pixelTests4;
-                break;
-            case 8:
-                test_fn_ = pixelTests8;
-                break;
-            case 16:
-                test_fn_ = pixelTests16;
-                break;
-            case 32:
-                test_fn_ = pixelTests32;
-                break;
-            case 64:
-                test_fn_ = pixelTests64;
+            case 1: case 2: case 4: case 8: case 16: case 32: case 64:
                 break;
             default:
                 CV_Error(Error::StsBadArg, "descriptorSize must be 1,2, 4, 8, 16, 32, or 64");
@@ -488,20 +275,12 @@ namespace cv
             fs << "descriptorSize" << bytes_;
         }
 
-        void LATCHDescriptorExtractorImpl::compute(InputArray _image,
+        void LATCHDescriptorExtractorImpl::prepare(InputArray _image,
             std::vector<KeyPoint>& keypoints,
-            OutputArray _descriptors)
+            OutputArray _descriptors, Mat& grayImage, Mat& descriptors)
         {
             Mat image = _image.getMat();
 
-            if ( image.empty() )
-                return;
-
-            if ( keypoints.empty() )
-                return;
-
-
-            Mat grayImage;
             GaussianBlur(image, grayImage, cv::Size(3, 3), 2, 2);
 
             if (image.type() != CV_8U) cvtColor(image, grayImage, COLOR_BGR2GRAY);
@@ -512,7 +291,6 @@ namespace cv
             KeyPointsFilter::runByImageBorder(keypoints, image.size(), PATCH_SIZE / 2 + half_ssd_size_);
             
             bool _1d = false;
-            Mat descriptors;
 
             _1d = _descriptors.kind() == _InputArray::STD_VECTOR && _descriptors.type() == CV_8U;
             if( _1d )
@@ -525,13 +303,90 @@ namespace cv
                 _descriptors.create((int)keypoints.size(), bytes_, CV_8U);
                 descriptors = _descriptors.getMat();
             }
+        }
 
-            //_descriptors.create((int)keypoints.size(), bytes_, CV_8U);
-            // prepare descriptors as mat
-            //Mat descriptors = _descriptors.getMat();
+        void LATCHDescriptorExtractorImpl::compute(InputArray _image,
+            std::vector<KeyPoint>& keypoints,
+            OutputArray _descriptors)
+        {
+            if ( _image.empty() )
+                return;
 
+            if ( keypoints.empty() )
+                return;
+
+            Mat grayImage, descriptors;
+            prepare(_image, keypoints, _descriptors, grayImage, descriptors);
+
+            parallel_for_(Range(0, (int)keypoints.size()),
+                          LATCHInvoker(grayImage, keypoints, descriptors, sampling_points_, rotationInvariance_, half_ssd_size_));
+        }
+
+        void LATCHDescriptorExtractorImpl::computeReference(InputArray _image,
+            std::vector<KeyPoint>& keypoints,
+            OutputArray _descriptors)
+        {
+            if ( _image.empty() || keypoints.empty() )
+                return;
+
+            Mat grayImage, descriptors;
+            prepare(_image, keypoints, _descriptors, grayImage, descriptors);
+
+            const int half_patch = PATCH_SIZE / 2;
+            const int K = half_ssd_size_;
+            for (int i = 0; i < (int)keypoints.size(); i++)
+            {
+                uchar* desc = descriptors.ptr(i);
+                const KeyPoint& pt = keypoints[i];
+                float angle = pt.angle * (float)(CV_PI / 180.f);
+                float cos_theta = cos(angle);
+                float sin_theta = sin(angle);
 
-            test_fn_(grayImage, keypoints, descriptors, sampling_points_, rotationInvariance_, half_ssd_size_);
+                int count = 0;
+                for (int ix = 0; ix < bytes_; ix++)
+                {
+                    desc[ix] = 0;
+                    for (int j = 7; j >= 0; j--, count += 6)
+                    {
+                        int xy[6];
+                        for (int k = 0; k < 6; k += 2)
+                        {
+                            int x = sampling_points_[count + k], y = sampling_points_[count + k + 1];
+                            if (rotationInvariance_)
+                            {
+                                int x2 = (int)(((float)x)*cos_theta - ((float)y)*sin_theta);
+                                int y2 = (int)(((float)x)*sin_theta + ((float)y)*cos_theta);
+                                x = std::min(std::max(x2, -half_patch), half_patch);
+                                y = std::min(std::max(y2, -half_patch), half_patch);
+                            }
+                            xy[k] = x + (int)(pt.pt.x + 0.5);
+                            xy[k + 1] = y + (int)(pt.pt.y + 0.5);
+                        }
+
+                        int suma = 0, sumc = 0;
+                        for (int iy = -K; iy <= K; iy++)
+                        {
+                            const uchar* Mi_a = grayImage.ptr<uchar>(xy[1] + iy);
+                            const uchar* Mi_b = grayImage.ptr<uchar>(xy[3] + iy);
+                            const uchar* Mi_c = grayImage.ptr<uchar>(xy[5] + iy);
+                            for (int dx = -K; dx <= K; dx++)
+                            {
+                                int difa = Mi_a[xy[0] + dx] - Mi_b[xy[2] + dx];
+                                suma += difa*difa;
+                                int difc = Mi_c[xy[4] + dx] - Mi_b[xy[2] + dx];
+                                sumc += difc*difc;
+                            }
+                        }
+                        desc[ix] += (uchar)((suma < sumc) << j);
+                    }
+                }
+            }
+        }
+
+        void computeLATCHReference(InputArray image, std::vector<KeyPoint>& keypoints, OutputArray descriptors,
+                                   int bytes, bool rotationInvariance, int half_ssd_size)
+        {
+            LATCHDescriptorExtractorImpl(bytes, rotationInvariance, half_ssd_size).computeReference(image, keypoints, descriptors);
         }
 
 
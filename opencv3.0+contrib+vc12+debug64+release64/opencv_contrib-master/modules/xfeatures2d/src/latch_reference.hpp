@@ -0,0 +1,24 @@
+///////////// see LICENSE.txt in the OpenCV root directory //////////////
+
+#ifndef __OPENCV_XFEATURES2D_LATCH_REFERENCE_HPP__
+#define __OPENCV_XFEATURES2D_LATCH_REFERENCE_HPP__
+
+#include "opencv2/features2d.hpp"
+
+namespace cv
+{
+namespace xfeatures2d
+{
+
+/*
+ LATCH descriptors computed by the plain per-triplet scalar loop, without the vectorized triplet
+ SSD and the parallel keypoint loop of LATCH::compute. Not part of the public API, exported only
+ for the tests (test/test_features2d.cpp), which check that both give the same bits.
+ */
+CV_EXPORTS void computeLATCHReference( InputArray image, std::vector<KeyPoint>& keypoints, OutputArray descriptors,
+                                       int bytes, bool rotationInvariance, int half_ssd_size );
+
+}
+}
+
+#endif
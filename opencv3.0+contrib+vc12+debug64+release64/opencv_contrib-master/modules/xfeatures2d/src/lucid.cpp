@@ -47,6 +47,7 @@ the use of this software, even if advised of the possibility of such damage.
 */
 
 #include "precomp.hpp"
+#include "descriptor_image_cache.hpp"
 
 namespace cv {
     namespace xfeatures2d {
@@ -72,8 +73,14 @@ namespace cv {
 
                 virtual void compute(InputArray _src, std::vector<KeyPoint> &keypoints, OutputArray _desc);
 
+                virtual ~LUCIDImpl() { DescriptorImageCache::setEnabled(image_caching, false); }
+
+                virtual void setImageCaching(bool enable) { DescriptorImageCache::setEnabled(image_caching, enable); }
+                virtual bool getImageCaching() const { return image_caching; }
+
             protected:
                 int l_kernel, b_kernel;
+                bool image_caching;
         };
 
         Ptr<LUCID> LUCID::create(const int lucid_kernel, const int blur_kernel) {
@@ -83,6 +90,7 @@ namespace cv {
         LUCIDImpl::LUCIDImpl(const int lucid_kernel, const int blur_kernel) {
             l_kernel = lucid_kernel;
             b_kernel = blur_kernel*2+1;
+            image_caching = false;
         }
 
         int LUCIDImpl::descriptorSize() const {
@@ -97,6 +105,44 @@ namespace cv {
             return NORM_HAMMING;
         }
 
+        // copies the (l_kernel*2+1)^2 blurred pixels around each keypoint, wrapping around the image borders
+        struct LUCIDInvoker : ParallelLoopBody {
+            LUCIDInvoker(const Mat_<Vec3b> &_src, const std::vector<KeyPoint> &_keypoints, Mat_<uchar> &_desc, int _l_kernel)
+                : src(&_src), keypoints(&_keypoints), desc(&_desc), l_kernel(_l_kernel) {}
+
+            void operator()(const Range &range) const {
+                int x, y, j, d, p, width = src->cols, height = src->rows, c;
+
+                for (int i = range.start; i < range.end; ++i) {
+                    x = static_cast<int>((*keypoints)[i].pt.x)-l_kernel, y = static_cast<int>((*keypoints)[i].pt.y)-l_kernel, d = x+2*l_kernel, p = y+2*l_kernel, j = x, c = 0;
+                    uchar *row = desc->ptr<uchar>(i);
+
+                    while (x <= d) {
+                        const Vec3b &pix = (*src)((y < 0 ? height+y : y >= height ? y-height : y), (x < 0 ? width+x : x >= width ? x-width : x));
+
+                        row[c++] = pix[0];
+                        row[c++] = pix[1];
+                        row[c++] = pix[2];
+
+                        ++x;
+                        if (x > d) {
+                            if (y < p) {
+                                ++y;
+                                x = j;
+                            }
+                            else
+                                break;
+                        }
+                    }
+                }
+            }
+
+            const Mat_<Vec3b> *src;
+            const std::vector<KeyPoint> *keypoints;
+            Mat_<uchar> *desc;
+            int l_kernel;
+        };
+
         // gliese581h suggested filling a cv::Mat with descriptors to enable BFmatcher compatibility
         // speed-ups and enhancements by gliese581h
         void LUCIDImpl::compute(InputArray _src, std::vector<KeyPoint> &keypoints, OutputArray _desc) {
@@ -105,35 +151,14 @@ namespace cv {
                 return;
             CV_Assert(src_input.depth() == CV_8U && src_input.channels() == 3);
 
-            Mat_<Vec3b> src;
+            // shared with the other extractors run on the same image when enabled
+            Mat_<Vec3b> src = DescriptorImageCache::boxBlur(src_input, b_kernel, image_caching);
 
-            blur(src_input, src, cv::Size(b_kernel, b_kernel));
-
-            int x, y, j, d, p, m = (l_kernel*2+1)*(l_kernel*2+1)*3, width = src.cols, height = src.rows, r, c;
+            int m = (l_kernel*2+1)*(l_kernel*2+1)*3;
 
             Mat_<uchar> desc(static_cast<int>(keypoints.size()), m);
 
-            for (std::size_t i = 0; i < keypoints.size(); ++i) {
-                x = static_cast<int>(keypoints[i].pt.x)-l_kernel, y = static_cast<int>(keypoints[i].pt.y)-l_kernel, d = x+2*l_kernel, p = y+2*l_kernel, j = x, r = static_cast<int>(i), c = 0;
-
-                while (x <= d) {
-                    Vec3b &pix = src((y < 0 ? height+y : y >= height ? y-height : y), (x < 0 ? width+x : x >= width ? x-width : x));
-
-                    desc(r, c++) = pix[0];
-                    desc(r, c++) = pix[1];
-                    desc(r, c++) = pix[2];
-
-                    ++x;
-                    if (x > d) {
-                        if (y < p) {
-                            ++y;
-                            x = j;
-                        }
-                        else
-                            break;
-                    }
-                }
-            }
+            parallel_for_(Range(0, static_cast<int>(keypoints.size())), LUCIDInvoker(src, keypoints, desc, l_kernel));
 
             if (_desc.needed())
                 sort(desc, _desc, SORT_EVERY_ROW | SORT_ASCENDING);
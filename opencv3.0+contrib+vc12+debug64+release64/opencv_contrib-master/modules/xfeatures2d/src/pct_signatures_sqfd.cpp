@@ -58,15 +58,308 @@ References:
 */
 #include "precomp.hpp"
 
+#include "opencv2/core/hal/intrin.hpp"
+
 #include "pct_signatures/constants.hpp"
 #include "pct_signatures/similarity.hpp"
 
+#include <algorithm>
+#include <cfloat>
+
 namespace cv
 {
     namespace xfeatures2d
     {
         namespace pct_signatures
         {
+            /**
+            * @brief Number of centroid coordinates (signature columns without the weight).
+            */
+            const int PACKED_DIMENSION = SIGNATURE_DIMENSION - 1;
+
+
+            /**
+            * @brief Signatures packed into a structure of arrays.
+            *       Centroids of all signatures are stored one after another and the coordinates
+            *       are stored dimension by dimension, so the kernel can load several centroids at once.
+            */
+            struct PackedSignatures
+            {
+                PackedSignatures()
+                    : count(0), total(0)
+                {
+
+                }
+
+                const float* coord(int d) const
+                {
+                    return &coords[(size_t)d * total];
+                }
+
+                int count;                          // number of signatures
+                int total;                          // number of centroids of all signatures
+                std::vector<int> offsets;           // first centroid of each signature, count + 1 items
+                std::vector<float> weights;         // centroid weights, total items
+                std::vector<float> coords;          // PACKED_DIMENSION x total, dimension-major
+                std::vector<float> weightSums;      // sum of weights of each signature
+                std::vector<float> selfTerms;       // partial SQFD of each signature with itself
+                std::vector<float> boxMin;          // count x PACKED_DIMENSION bounding boxes of centroids
+                std::vector<float> boxMax;
+                std::vector<uchar> nonNegative;     // all weights of the signature are non-negative
+                std::vector<Mat> signatures;        // kept only when there is no packed kernel
+            };
+
+
+            /**
+            * @brief Checks whether the packed signatures hold exactly the given signatures.
+            */
+            static bool isPackedFrom(const std::vector<Mat>& signatures, const PackedSignatures& packed)
+            {
+                if ((int)signatures.size() != packed.count)
+                {
+                    return false;
+                }
+                for (int i = 0; i < packed.count; i++)
+                {
+                    const Mat& signature = signatures[i];
+                    if (signature.cols != SIGNATURE_DIMENSION || signature.type() != CV_32F
+                        || signature.rows != packed.offsets[i + 1] - packed.offsets[i])
+                    {
+                        return false;
+                    }
+                    for (int r = 0; r < signature.rows; r++)
+                    {
+                        const float* row = signature.ptr<float>(r);
+                        const int idx = packed.offsets[i] + r;
+                        if (row[WEIGHT_IDX] != packed.weights[idx])
+                        {
+                            return false;
+                        }
+                        for (int d = 0; d < PACKED_DIMENSION; d++)
+                        {
+                            if (row[d + 1] != packed.coord(d)[idx])
+                            {
+                                return false;
+                            }
+                        }
+                    }
+                }
+                return true;
+            }
+
+
+            template <int DISTANCE>
+            static inline float packedDistance(const float* q, const PackedSignatures& p, int j)
+            {
+                float result = (float)0.0;
+                for (int d = 0; d < PACKED_DIMENSION; d++)
+                {
+                    float difference = q[d] - p.coord(d)[j];
+                    result += DISTANCE == PCTSignatures::L1 ? std::abs(difference) : difference * difference;
+                }
+                return DISTANCE == PCTSignatures::L2 ? (float)std::sqrt(result) : result;
+            }
+
+
+            template <int SIMILARITY>
+            static inline float packedSimilarity(float distance, float alpha)
+            {
+                switch (SIMILARITY)
+                {
+                case PCTSignatures::MINUS:
+                    return -distance;
+                case PCTSignatures::GAUSSIAN:
+                    return exp(-alpha + distance * distance);
+                default:
+                    return 1 / (alpha + distance);
+                }
+            }
+
+
+#if CV_SIMD128
+            template <int DISTANCE>
+            static inline v_float32x4 packedDistance4(const v_float32x4* q, const PackedSignatures& p, int j)
+            {
+                v_float32x4 result = v_setzero_f32();
+                for (int d = 0; d < PACKED_DIMENSION; d++)
+                {
+                    v_float32x4 difference = q[d] - v_load(p.coord(d) + j);
+                    result += DISTANCE == PCTSignatures::L1 ? v_abs(difference) : difference * difference;
+                }
+                return DISTANCE == PCTSignatures::L2 ? v_sqrt(result) : result;
+            }
+
+
+            template <int SIMILARITY>
+            static inline v_float32x4 packedSimilarity4(const v_float32x4& distance, float alpha)
+            {
+                switch (SIMILARITY)
+                {
+                case PCTSignatures::MINUS:
+                    return v_setzero_f32() - distance;
+                case PCTSignatures::HEURISTIC:
+                    return v_setall_f32(1.f) / (v_setall_f32(alpha) + distance);
+                default:
+                {
+                    float buf[4];
+                    v_store(buf, distance);
+                    for (int k = 0; k < 4; k++)
+                    {
+                        buf[k] = packedSimilarity<SIMILARITY>(buf[k], alpha);
+                    }
+                    return v_load(buf);
+                }
+                }
+            }
+#endif
+
+
+            /**
+            * @brief Partial SQFD of two packed signatures:
+            *       sum of w_i * w_j * similarity(c_i, c_j) over all pairs of their centroids.
+            */
+            template <int DISTANCE, int SIMILARITY>
+            static float packedPartialSQFD(
+                const PackedSignatures& a, int ia,
+                const PackedSignatures& b, int ib,
+                float alpha)
+            {
+                const int bStart = b.offsets[ib], bEnd = b.offsets[ib + 1];
+                const float* bWeights = &b.weights[0];
+                float result = 0;
+                for (int i = a.offsets[ia]; i < a.offsets[ia + 1]; i++)
+                {
+                    float q[PACKED_DIMENSION];
+                    for (int d = 0; d < PACKED_DIMENSION; d++)
+                    {
+                        q[d] = a.coord(d)[i];
+                    }
+
+                    float rowSum = 0;
+                    int j = bStart;
+#if CV_SIMD128
+                    v_float32x4 vq[PACKED_DIMENSION];
+                    for (int d = 0; d < PACKED_DIMENSION; d++)
+                    {
+                        vq[d] = v_setall_f32(q[d]);
+                    }
+                    v_float32x4 vRowSum = v_setzero_f32();
+                    for (; j <= bEnd - 4; j += 4)
+                    {
+                        vRowSum += v_load(bWeights + j)
+                            * packedSimilarity4<SIMILARITY>(packedDistance4<DISTANCE>(vq, b, j), alpha);
+                    }
+                    rowSum = v_reduce_sum(vRowSum);
+#endif
+                    for (; j < bEnd; j++)
+                    {
+                        rowSum += bWeights[j] * packedSimilarity<SIMILARITY>(packedDistance<DISTANCE>(q, b, j), alpha);
+                    }
+                    result += a.weights[i] * rowSum;
+                }
+                return result;
+            }
+
+
+            typedef float (*PackedPartialSQFDFn)(
+                const PackedSignatures&, int,
+                const PackedSignatures&, int,
+                float);
+
+
+            template <int DISTANCE>
+            static PackedPartialSQFDFn getPackedPartialSQFD_(int similarityFunction)
+            {
+                switch (similarityFunction)
+                {
+                case PCTSignatures::MINUS:
+                    return packedPartialSQFD<DISTANCE, PCTSignatures::MINUS>;
+                case PCTSignatures::GAUSSIAN:
+                    return packedPartialSQFD<DISTANCE, PCTSignatures::GAUSSIAN>;
+                case PCTSignatures::HEURISTIC:
+                    return packedPartialSQFD<DISTANCE, PCTSignatures::HEURISTIC>;
+                default:
+                    return 0;
+                }
+            }
+
+
+            /**
+            * @brief Returns the packed kernel for the given functions,
+            *       or null if the pair is only supported by the generic path.
+            */
+            static PackedPartialSQFDFn getPackedPartialSQFD(int distanceFunction, int similarityFunction)
+            {
+                switch (distanceFunction)
+                {
+                case PCTSignatures::L1:
+                    return getPackedPartialSQFD_<PCTSignatures::L1>(similarityFunction);
+                case PCTSignatures::L2:
+                    return getPackedPartialSQFD_<PCTSignatures::L2>(similarityFunction);
+                case PCTSignatures::L2SQUARED:
+                    return getPackedPartialSQFD_<PCTSignatures::L2SQUARED>(similarityFunction);
+                default:
+                    return 0;
+                }
+            }
+
+
+            /**
+            * @brief Distance of a centroid pair whose coordinates differ at least by gap[d] in each dimension.
+            * @note All supported distance functions except L_INFINITY are non-decreasing
+            *       in the absolute coordinate differences, for L_INFINITY zero is returned.
+            */
+            static float gapDistance(int distanceFunction, const float* gap)
+            {
+                float result = (float)0.0;
+                switch (distanceFunction)
+                {
+                case PCTSignatures::L1:
+                    for (int d = 0; d < PACKED_DIMENSION; d++)
+                    {
+                        result += gap[d];
+                    }
+                    return result;
+                case PCTSignatures::L2:
+                case PCTSignatures::L2SQUARED:
+                    for (int d = 0; d < PACKED_DIMENSION; d++)
+                    {
+                        result += gap[d] * gap[d];
+                    }
+                    return distanceFunction == PCTSignatures::L2 ? (float)std::sqrt(result) : result;
+                case PCTSignatures::L_INFINITY:
+                    return result;
+                default:
+                {
+                    float zero[SIGNATURE_DIMENSION] = { 0 };
+                    float point[SIGNATURE_DIMENSION] = { 0 };
+                    for (int d = 0; d < PACKED_DIMENSION; d++)
+                    {
+                        point[d + 1] = gap[d];
+                    }
+                    return computeDistance(distanceFunction,
+                        Mat(1, SIGNATURE_DIMENSION, CV_32F, zero), 0,
+                        Mat(1, SIGNATURE_DIMENSION, CV_32F, point), 0);
+                }
+                }
+            }
+
+
+            /**
+            * @brief Index candidate ordered by its lower bound, ties are broken by the index.
+            */
+            struct SQFDCandidate
+            {
+                float bound;
+                int idx;
+
+                bool operator<(const SQFDCandidate& other) const
+                {
+                    return bound < other.bound || (bound == other.bound && idx < other.idx);
+                }
+            };
+
+
             class PCTSignaturesSQFD_Impl : public PCTSignaturesSQFD
             {
             public:
@@ -76,7 +369,8 @@ namespace cv
                     const float similarityParameter)
                     : mDistanceFunction(distanceFunction),
                     mSimilarityFunction(similarityFunction),
-                    mSimilarityParameter(similarityParameter)
+                    mSimilarityParameter(similarityParameter),
+                    mPackedPartialSQFD(getPackedPartialSQFD(distanceFunction, similarityFunction))
                 {
 
                 }
@@ -91,16 +385,110 @@ namespace cv
                     const std::vector<Mat>& imageSignatures,
                     std::vector<float>& distances) const;
 
+                void setIndexSignatures(
+                    const std::vector<Mat>& imageSignatures);
+
+                int getIndexSize() const
+                {
+                    return mIndex.count;
+                }
+
+                void searchNearest(
+                    InputArray querySignature,
+                    int k,
+                    std::vector<int>& indices,
+                    std::vector<float>& distances) const;
+
+
+                /**
+                * @brief Partial SQFD of two packed signatures using the packed kernel if available.
+                */
+                float partialSQFD(
+                    const PackedSignatures& a, int ia,
+                    const PackedSignatures& b, int ib) const
+                {
+                    if (mPackedPartialSQFD)
+                    {
+                        return mPackedPartialSQFD(a, ia, b, ib, mSimilarityParameter);
+                    }
+                    return computePartialSQFD(a.signatures[ia], b.signatures[ib]);
+                }
+
+                /**
+                * @brief SQFD of two packed signatures.
+                */
+                float packedSQFD(
+                    const PackedSignatures& a, int ia,
+                    const PackedSignatures& b, int ib) const
+                {
+                    float result = 0;
+                    result += a.selfTerms[ia];
+                    result += b.selfTerms[ib];
+                    result -= partialSQFD(a, ia, b, ib) * 2;
+
+                    return sqrt(std::max(result, 0.f));
+                }
+
+                float computeSQFDLowerBound(
+                    const PackedSignatures& query, int iq,
+                    const PackedSignatures& packed, int ip) const;
+
 
             private:
                 int mDistanceFunction;
                 int mSimilarityFunction;
                 float mSimilarityParameter;
+                PackedPartialSQFDFn mPackedPartialSQFD;
+                PackedSignatures mIndex;
+
+                // database of the last computeQuadraticFormDistances call,
+                // reused while the same signatures are passed
+                mutable Mutex mDatabaseMutex;
+                mutable Ptr<PackedSignatures> mDatabase;
 
                 float computePartialSQFD(
                     const Mat& signature0,
                     const Mat& signature1) const;
 
+                void packSignatures(
+                    const std::vector<Mat>& signatures,
+                    PackedSignatures& packed) const;
+
+                void detachSignatures(
+                    PackedSignatures& packed) const;
+
+                Ptr<PackedSignatures> getPackedDatabase(
+                    const std::vector<Mat>& imageSignatures) const;
+
+            };
+
+
+            /**
+            * @brief Class implementing parallel computing of the self terms of packed signatures.
+            */
+            class Parallel_computeSelfTerms : public ParallelLoopBody
+            {
+            private:
+                const PCTSignaturesSQFD_Impl* mPctSignaturesSQFDAlgorithm;
+                PackedSignatures* mPacked;
+
+            public:
+                Parallel_computeSelfTerms(
+                    const PCTSignaturesSQFD_Impl* pctSignaturesSQFDAlgorithm,
+                    PackedSignatures* packed)
+                    : mPctSignaturesSQFDAlgorithm(pctSignaturesSQFDAlgorithm),
+                    mPacked(packed)
+                {
+
+                }
+
+                void operator()(const Range& range) const
+                {
+                    for (int i = range.start; i < range.end; i++)
+                    {
+                        mPacked->selfTerms[i] = mPctSignaturesSQFDAlgorithm->partialSQFD(*mPacked, i, *mPacked, i);
+                    }
+                }
             };
 
 
@@ -110,41 +498,109 @@ namespace cv
             class Parallel_computeSQFDs : public ParallelLoopBody
             {
             private:
-                const PCTSignaturesSQFD* mPctSignaturesSQFDAlgorithm;
-                const Mat* mSourceSignature;
-                const std::vector<Mat>* mImageSignatures;
+                const PCTSignaturesSQFD_Impl* mPctSignaturesSQFDAlgorithm;
+                const PackedSignatures* mSourceSignature;
+                const PackedSignatures* mImageSignatures;
                 std::vector<float>* mDistances;
 
             public:
                 Parallel_computeSQFDs(
-                    const PCTSignaturesSQFD* pctSignaturesSQFDAlgorithm,
-                    const Mat* sourceSignature,
-                    const std::vector<Mat>* imageSignatures,
+                    const PCTSignaturesSQFD_Impl* pctSignaturesSQFDAlgorithm,
+                    const PackedSignatures* sourceSignature,
+                    const PackedSignatures* imageSignatures,
                     std::vector<float>* distances)
                     : mPctSignaturesSQFDAlgorithm(pctSignaturesSQFDAlgorithm),
                     mSourceSignature(sourceSignature),
                     mImageSignatures(imageSignatures),
                     mDistances(distances)
                 {
-                    mDistances->resize(imageSignatures->size());
+                    mDistances->resize(imageSignatures->count);
                 }
 
                 void operator()(const Range& range) const
                 {
-                    if (mSourceSignature->empty())
+                    for (int i = range.start; i < range.end; i++)
                     {
-                        CV_Error(Error::StsBadArg, "Source signature is empty!");
+                        (*mDistances)[i] = mPctSignaturesSQFDAlgorithm->packedSQFD(
+                            *mSourceSignature, 0, *mImageSignatures, i);
                     }
+                }
+            };
 
-                    for (int i = range.start; i < range.end; i++)
+
+            /**
+            * @brief Class implementing parallel top-k scan of the signature index.
+            *       Each stripe visits every stripes-th candidate in the order of increasing
+            *       lower bound and stops once the bound exceeds its own k-th best distance.
+            *       The local k-th distance is never lower than the global one,
+            *       so the merged result is the same as that of a full scan.
+            */
+            class Parallel_searchNearest : public ParallelLoopBody
+            {
+            private:
+                const PCTSignaturesSQFD_Impl* mPctSignaturesSQFDAlgorithm;
+                const PackedSignatures* mQuery;
+                const PackedSignatures* mIndex;
+                const std::vector<SQFDCandidate>* mCandidates;
+                int mK;
+                int mStripes;
+                std::vector<std::vector<std::pair<float, int> > >* mResults;
+
+            public:
+                Parallel_searchNearest(
+                    const PCTSignaturesSQFD_Impl* pctSignaturesSQFDAlgorithm,
+                    const PackedSignatures* query,
+                    const PackedSignatures* index,
+                    const std::vector<SQFDCandidate>* candidates,
+                    int k,
+                    std::vector<std::vector<std::pair<float, int> > >* results)
+                    : mPctSignaturesSQFDAlgorithm(pctSignaturesSQFDAlgorithm),
+                    mQuery(query),
+                    mIndex(index),
+                    mCandidates(candidates),
+                    mK(k),
+                    mStripes((int)results->size()),
+                    mResults(results)
+                {
+
+                }
+
+                void operator()(const Range& range) const
+                {
+                    const int candidateCount = (int)mCandidates->size();
+                    for (int s = range.start; s < range.end; s++)
                     {
-                        if (mImageSignatures[i].empty())
+                        // max-heap on (distance, index) holding the best k candidates of the stripe
+                        std::vector<std::pair<float, int> >& heap = (*mResults)[s];
+                        heap.clear();
+                        heap.reserve(mK);
+                        for (int n = s; n < candidateCount; n += mStripes)
                         {
-                            CV_Error_(Error::StsBadArg, ("Signature ID: %d is empty!", i));
+                            const SQFDCandidate& candidate = (*mCandidates)[n];
+                            if ((int)heap.size() == mK)
+                            {
+                                float worst = heap.front().first;
+                                if (candidate.bound > worst * worst * (1 + 8 * FLT_EPSILON))
+                                {
+                                    break;
+                                }
+                            }
+
+                            std::pair<float, int> item(
+                                mPctSignaturesSQFDAlgorithm->packedSQFD(*mQuery, 0, *mIndex, candidate.idx),
+                                candidate.idx);
+                            if ((int)heap.size() < mK)
+                            {
+                                heap.push_back(item);
+                                std::push_heap(heap.begin(), heap.end());
+                            }
+                            else if (item < heap.front())
+                            {
+                                std::pop_heap(heap.begin(), heap.end());
+                                heap.back() = item;
+                                std::push_heap(heap.begin(), heap.end());
+                            }
                         }
-
-                        (*mDistances)[i] = mPctSignaturesSQFDAlgorithm->computeQuadraticFormDistance(
-                            *mSourceSignature, (*mImageSignatures)[i]);
                     }
                 }
             };
@@ -174,12 +630,13 @@ namespace cv
                 }
 
                 // compute sqfd
-                float result = 0;
-                result += computePartialSQFD(signature0, signature0);
-                result += computePartialSQFD(signature1, signature1);
-                result -= computePartialSQFD(signature0, signature1) * 2;
+                PackedSignatures packed;
+                std::vector<Mat> signatures(2);
+                signatures[0] = signature0;
+                signatures[1] = signature1;
+                packSignatures(signatures, packed);
 
-                return sqrt(result);
+                return packedSQFD(packed, 0, packed, 1);
             }
 
             void PCTSignaturesSQFD_Impl::computeQuadraticFormDistances(
@@ -187,8 +644,245 @@ namespace cv
                       const std::vector<Mat>& imageSignatures,
                       std::vector<float>& distances) const
             {
-                parallel_for_(Range(0, (int)imageSignatures.size()),
-                    Parallel_computeSQFDs(this, &sourceSignature, &imageSignatures, &distances));
+                if (sourceSignature.empty())
+                {
+                    CV_Error(Error::StsBadArg, "Source signature is empty!");
+                }
+
+                PackedSignatures packedSource;
+                packSignatures(std::vector<Mat>(1, sourceSignature), packedSource);
+
+                // the database and its self terms are packed once for all queries against it
+                Ptr<PackedSignatures> database;
+                const PackedSignatures* packedImages = &mIndex;
+                if (!isPackedFrom(imageSignatures, mIndex))
+                {
+                    database = getPackedDatabase(imageSignatures);
+                    packedImages = database.get();
+                }
+
+                parallel_for_(Range(0, packedImages->count),
+                    Parallel_computeSQFDs(this, &packedSource, packedImages, &distances));
+            }
+
+            Ptr<PackedSignatures> PCTSignaturesSQFD_Impl::getPackedDatabase(
+                      const std::vector<Mat>& imageSignatures) const
+            {
+                {
+                    AutoLock lock(mDatabaseMutex);
+                    if (mDatabase && isPackedFrom(imageSignatures, *mDatabase))
+                    {
+                        return mDatabase;
+                    }
+                }
+
+                // packed outside of the lock, a stored database is never modified
+                Ptr<PackedSignatures> database = makePtr<PackedSignatures>();
+                packSignatures(imageSignatures, *database);
+                detachSignatures(*database);
+
+                AutoLock lock(mDatabaseMutex);
+                mDatabase = database;
+                return database;
+            }
+
+            void PCTSignaturesSQFD_Impl::setIndexSignatures(
+                      const std::vector<Mat>& imageSignatures)
+            {
+                PackedSignatures packed;
+                packSignatures(imageSignatures, packed);
+                detachSignatures(packed);
+                std::swap(mIndex, packed);
+            }
+
+            void PCTSignaturesSQFD_Impl::searchNearest(
+                      InputArray _querySignature,
+                      int k,
+                      std::vector<int>& indices,
+                      std::vector<float>& distances) const
+            {
+                if (_querySignature.empty())
+                {
+                    CV_Error(Error::StsBadArg, "Query signature is empty!");
+                }
+                if (k <= 0)
+                {
+                    CV_Error(Error::StsBadArg, "Number of neighbours must be greater than 0!");
+                }
+
+                indices.clear();
+                distances.clear();
+                if (mIndex.count == 0)
+                {
+                    return;
+                }
+                k = std::min(k, mIndex.count);
+
+                PackedSignatures query;
+                packSignatures(std::vector<Mat>(1, _querySignature.getMat()), query);
+
+                // visit the candidates by increasing lower bound, so the threshold tightens early
+                std::vector<SQFDCandidate> candidates(mIndex.count);
+                for (int i = 0; i < mIndex.count; i++)
+                {
+                    candidates[i].bound = computeSQFDLowerBound(query, 0, mIndex, i);
+                    candidates[i].idx = i;
+                }
+                std::sort(candidates.begin(), candidates.end());
+
+                int stripes = std::max(1, std::min(mIndex.count / k, getNumThreads() * 4));
+                std::vector<std::vector<std::pair<float, int> > > results(stripes);
+                parallel_for_(Range(0, stripes),
+                    Parallel_searchNearest(this, &query, &mIndex, &candidates, k, &results));
+
+                std::vector<std::pair<float, int> > merged;
+                for (int s = 0; s < stripes; s++)
+                {
+                    merged.insert(merged.end(), results[s].begin(), results[s].end());
+                }
+                k = std::min(k, (int)merged.size());
+                std::partial_sort(merged.begin(), merged.begin() + k, merged.end());
+
+                indices.resize(k);
+                distances.resize(k);
+                for (int i = 0; i < k; i++)
+                {
+                    distances[i] = merged[i].first;
+                    indices[i] = merged[i].second;
+                }
+            }
+
+            /**
+            * @brief Lower bound of the squared SQFD of the query and the packed signature.
+            *       The similarity of a query centroid to any centroid of the other signature
+            *       is bounded by the similarity at the distance to its bounding box.
+            *       With non-negative weights this bounds the cross term by
+            *       W * sum_i(w_i * maxSimilarity_i), W being the weight sum of the other signature.
+            *       The bound is loosened by the worst case rounding error of the computed terms.
+            * @return The bound, or -FLT_MAX if the similarity function is not bounded this way.
+            */
+            float PCTSignaturesSQFD_Impl::computeSQFDLowerBound(
+                      const PackedSignatures& query, int iq,
+                      const PackedSignatures& packed, int ip) const
+            {
+                if (!query.nonNegative[iq] || !packed.nonNegative[ip])
+                {
+                    return -FLT_MAX;
+                }
+                // gaussian similarity of this implementation grows with distance
+                if (mSimilarityFunction == PCTSignatures::GAUSSIAN
+                    || (mSimilarityFunction == PCTSignatures::HEURISTIC && !(mSimilarityParameter > 0)))
+                {
+                    return -FLT_MAX;
+                }
+
+                const float* boxMin = &packed.boxMin[(size_t)ip * PACKED_DIMENSION];
+                const float* boxMax = &packed.boxMax[(size_t)ip * PACKED_DIMENSION];
+                float cross = 0, crossMagnitude = 0;
+                for (int i = query.offsets[iq]; i < query.offsets[iq + 1]; i++)
+                {
+                    float gap[PACKED_DIMENSION];
+                    for (int d = 0; d < PACKED_DIMENSION; d++)
+                    {
+                        float c = query.coord(d)[i];
+                        gap[d] = std::max(std::max(boxMin[d] - c, c - boxMax[d]), 0.f);
+                    }
+                    float distance = gapDistance(mDistanceFunction, gap);
+                    float similarity = mSimilarityFunction == PCTSignatures::MINUS
+                        ? -distance : 1 / (mSimilarityParameter + distance);
+                    cross += query.weights[i] * similarity;
+                    crossMagnitude += query.weights[i] * std::abs(similarity);
+                }
+                cross *= packed.weightSums[ip];
+                crossMagnitude *= packed.weightSums[ip];
+
+                float result = query.selfTerms[iq] + packed.selfTerms[ip] - 2 * cross;
+                float magnitude = std::abs(query.selfTerms[iq]) + std::abs(packed.selfTerms[ip]) + 2 * crossMagnitude;
+                int terms = (query.offsets[iq + 1] - query.offsets[iq]) + (packed.offsets[ip + 1] - packed.offsets[ip]);
+                return result - 4 * FLT_EPSILON * (terms + 4) * magnitude;
+            }
+
+            void PCTSignaturesSQFD_Impl::packSignatures(
+                      const std::vector<Mat>& signatures,
+                      PackedSignatures& packed) const
+            {
+                packed.count = (int)signatures.size();
+                packed.offsets.resize(packed.count + 1);
+                packed.offsets[0] = 0;
+                for (int i = 0; i < packed.count; i++)
+                {
+                    const Mat& signature = signatures[i];
+                    if (signature.empty())
+                    {
+                        CV_Error_(Error::StsBadArg, ("Signature ID: %d is empty!", i));
+                    }
+                    if (signature.cols != SIGNATURE_DIMENSION || signature.type() != CV_32F)
+                    {
+                        CV_Error_(Error::StsBadArg, ("Signature ID: %d must be a CV_32F matrix with %d columns!",
+                            i, SIGNATURE_DIMENSION));
+                    }
+                    packed.offsets[i + 1] = packed.offsets[i] + signature.rows;
+                }
+
+                packed.total = packed.offsets[packed.count];
+                packed.weights.resize(packed.total);
+                packed.coords.resize((size_t)PACKED_DIMENSION * packed.total);
+                packed.weightSums.resize(packed.count);
+                packed.selfTerms.resize(packed.count);
+                packed.boxMin.resize((size_t)PACKED_DIMENSION * packed.count);
+                packed.boxMax.resize((size_t)PACKED_DIMENSION * packed.count);
+                packed.nonNegative.resize(packed.count);
+                packed.signatures.clear();
+                if (!mPackedPartialSQFD)
+                {
+                    packed.signatures = signatures;
+                }
+
+                for (int i = 0; i < packed.count; i++)
+                {
+                    const Mat& signature = signatures[i];
+                    float* boxMin = &packed.boxMin[(size_t)i * PACKED_DIMENSION];
+                    float* boxMax = &packed.boxMax[(size_t)i * PACKED_DIMENSION];
+                    for (int d = 0; d < PACKED_DIMENSION; d++)
+                    {
+                        boxMin[d] = FLT_MAX;
+                        boxMax[d] = -FLT_MAX;
+                    }
+
+                    float weightSum = 0;
+                    bool nonNegative = true;
+                    for (int r = 0; r < signature.rows; r++)
+                    {
+                        const float* row = signature.ptr<float>(r);
+                        const int idx = packed.offsets[i] + r;
+                        packed.weights[idx] = row[WEIGHT_IDX];
+                        weightSum += row[WEIGHT_IDX];
+                        nonNegative = nonNegative && row[WEIGHT_IDX] >= 0;
+                        for (int d = 0; d < PACKED_DIMENSION; d++)
+                        {
+                            float value = row[d + 1];
+                            packed.coords[(size_t)d * packed.total + idx] = value;
+                            boxMin[d] = std::min(boxMin[d], value);
+                            boxMax[d] = std::max(boxMax[d], value);
+                        }
+                    }
+                    packed.weightSums[i] = weightSum;
+                    packed.nonNegative[i] = nonNegative;
+                }
+
+                parallel_for_(Range(0, packed.count), Parallel_computeSelfTerms(this, &packed));
+            }
+
+            /**
+            * @brief Makes the kept signatures independent of the caller's data.
+            */
+            void PCTSignaturesSQFD_Impl::detachSignatures(
+                      PackedSignatures& packed) const
+            {
+                for (size_t i = 0; i < packed.signatures.size(); i++)
+                {
+                    packed.signatures[i] = packed.signatures[i].clone();
+                }
             }
 
             float PCTSignaturesSQFD_Impl::computePartialSQFD(
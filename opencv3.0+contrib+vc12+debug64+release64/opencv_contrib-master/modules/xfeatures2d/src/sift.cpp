@@ -106,6 +106,7 @@
 #include <iostream>
 #include <stdarg.h>
 #include <opencv2/core/hal/hal.hpp>
+#include <opencv2/core/hal/intrin.hpp>
 
 namespace cv
 {
@@ -145,12 +146,28 @@ public:
     void findScaleSpaceExtrema( const std::vector<Mat>& gauss_pyr, const std::vector<Mat>& dog_pyr,
                                std::vector<KeyPoint>& keypoints ) const;
 
+    void setScaleSpaceCaching(bool enable);
+    bool getScaleSpaceCaching() const { return cacheScaleSpace; }
+
 protected:
+    void buildScaleSpace( const Mat& image, int firstOctave, int nOctaves,
+                          std::vector<Mat>& gpyr, std::vector<Mat>& dogpyr );
+    void releaseScaleSpace();
+
     CV_PROP_RW int nfeatures;
     CV_PROP_RW int nOctaveLayers;
     CV_PROP_RW double contrastThreshold;
     CV_PROP_RW double edgeThreshold;
     CV_PROP_RW double sigma;
+
+    // scale space of the last image, kept when caching is enabled; the cache members are
+    // guarded by cacheMutex, so that one instance can still be used from several threads
+    Mutex cacheMutex;
+    bool cacheScaleSpace;
+    Mat cachedImage;
+    int cachedFirstOctave;
+    int cachedNOctaves;
+    std::vector<Mat> cachedGpyr, cachedDogpyr;
 };
 
 Ptr<SIFT> SIFT::create( int _nfeatures, int _nOctaveLayers,
@@ -197,7 +214,16 @@ static const float SIFT_DESCR_MAG_THR = 0.2f;
 // factor used to convert floating-point descriptor to unsigned char
 static const float SIFT_INT_DESCR_FCTR = 512.f;
 
-#if 0
+// build with SIFT_USE_FIXPT=1 to keep the pyramids in 16-bit fixed point, which halves their
+// memory traffic on large images at the cost of some precision
+#ifndef SIFT_USE_FIXPT
+#define SIFT_USE_FIXPT 0
+#endif
+
+// number of DoG rows handled by one extrema detection task
+static const int SIFT_EXTREMA_ROWS_PER_TASK = 32;
+
+#if SIFT_USE_FIXPT
 // intermediate type used for DoG pyramids
 typedef short sift_wt;
 static const int SIFT_FIXPT_SCALE = 48;
@@ -572,34 +598,85 @@ static bool adjustLocalExtrema( const std::vector<Mat>& dog_pyr, KeyPoint& kpt,
 //
 // Detects features at extrema in DoG scale space.  Bad features are discarded
 // based on contrast and ratio of principal curvatures.
-void SIFT_Impl::findScaleSpaceExtrema( const std::vector<Mat>& gauss_pyr, const std::vector<Mat>& dog_pyr,
-                                  std::vector<KeyPoint>& keypoints ) const
+// The work is split into tasks of SIFT_EXTREMA_ROWS_PER_TASK rows of one DoG layer; every task
+// collects its keypoints separately and they are concatenated in task order, so the result does
+// not depend on the number of threads.
+class findScaleSpaceExtremaComputer : public ParallelLoopBody
 {
-    int nOctaves = (int)gauss_pyr.size()/(nOctaveLayers + 3);
-    int threshold = cvFloor(0.5 * contrastThreshold / nOctaveLayers * 255 * SIFT_FIXPT_SCALE);
-    const int n = SIFT_ORI_HIST_BINS;
-    float hist[n];
-    KeyPoint kpt;
-
-    keypoints.clear();
+public:
+    findScaleSpaceExtremaComputer(
+        const std::vector<Vec4i>& _tasks,
+        int _nOctaveLayers,
+        int _threshold,
+        float _contrastThreshold,
+        float _edgeThreshold,
+        float _sigma,
+        const std::vector<Mat>& _gauss_pyr,
+        const std::vector<Mat>& _dog_pyr,
+        std::vector<std::vector<KeyPoint> >& _taskKeypoints)
+        : tasks(_tasks),
+          nOctaveLayers(_nOctaveLayers),
+          threshold(_threshold),
+          contrastThreshold(_contrastThreshold),
+          edgeThreshold(_edgeThreshold),
+          sigma(_sigma),
+          gauss_pyr(_gauss_pyr),
+          dog_pyr(_dog_pyr),
+          taskKeypoints(_taskKeypoints) { }
 
-    for( int o = 0; o < nOctaves; o++ )
-        for( int i = 1; i <= nOctaveLayers; i++ )
+    void operator()( const cv::Range& range ) const
+    {
+        for( int t = range.start; t < range.end; t++ )
         {
+            const int o = tasks[t][0], i = tasks[t][1];
+            std::vector<KeyPoint>& keypoints = taskKeypoints[t];
+
             int idx = o*(nOctaveLayers+2)+i;
             const Mat& img = dog_pyr[idx];
             const Mat& prev = dog_pyr[idx-1];
             const Mat& next = dog_pyr[idx+1];
             int step = (int)img.step1();
-            int rows = img.rows, cols = img.cols;
+            int cols = img.cols;
 
-            for( int r = SIFT_IMG_BORDER; r < rows-SIFT_IMG_BORDER; r++)
+            for( int r = tasks[t][2]; r < tasks[t][3]; r++)
             {
                 const sift_wt* currptr = img.ptr<sift_wt>(r);
                 const sift_wt* prevptr = prev.ptr<sift_wt>(r);
                 const sift_wt* nextptr = next.ptr<sift_wt>(r);
 
-                for( int c = SIFT_IMG_BORDER; c < cols-SIFT_IMG_BORDER; c++)
+                int c = SIFT_IMG_BORDER;
+#if CV_SIMD128 && !SIFT_USE_FIXPT
+                // 4 pixels at a time: a pixel is an extremum iff it is not below the maximum (not above the
+                // minimum) of its 26 neighbours, which gives the same answer as the comparisons below
+                const v_float32x4 vthr = v_setall_f32((float)threshold), vnthr = v_setall_f32(-(float)threshold);
+                for( ; c <= cols-SIFT_IMG_BORDER-4; c += 4)
+                {
+                    v_float32x4 val = v_load(currptr + c);
+                    v_float32x4 vmax = v_load(currptr + c - 1), vmin = vmax;
+                    v_float32x4 x = v_load(currptr + c + 1);
+                    vmax = v_max(vmax, x); vmin = v_min(vmin, x);
+                    for( int dy = -step; dy <= step; dy += step )
+                    {
+                        for( int dx = -1; dx <= 1; dx++ )
+                        {
+                            if( dy != 0 )
+                            {
+                                x = v_load(currptr + c + dy + dx);
+                                vmax = v_max(vmax, x); vmin = v_min(vmin, x);
+                            }
+                            x = v_load(prevptr + c + dy + dx);
+                            vmax = v_max(vmax, x); vmin = v_min(vmin, x);
+                            x = v_load(nextptr + c + dy + dx);
+                            vmax = v_max(vmax, x); vmin = v_min(vmin, x);
+                        }
+                    }
+                    int mask = v_signmask(((val > vthr) & (val >= vmax)) | ((val < vnthr) & (val <= vmin)));
+                    for( int k = 0; mask != 0; k++, mask >>= 1 )
+                        if( mask & 1 )
+                            addKeypoints(o, i, r, c + k, keypoints);
+                }
+#endif
+                for( ; c < cols-SIFT_IMG_BORDER; c++)
                 {
                     sift_wt val = currptr[c];
 
@@ -624,39 +701,86 @@ void SIFT_Impl::findScaleSpaceExtrema( const std::vector<Mat>& gauss_pyr, const
                          val <= prevptr[c-step-1] && val <= prevptr[c-step] && val <= prevptr[c-step+1] &&
                          val <= prevptr[c+step-1] && val <= prevptr[c+step] && val <= prevptr[c+step+1])))
                     {
-                        int r1 = r, c1 = c, layer = i;
-                        if( !adjustLocalExtrema(dog_pyr, kpt, o, layer, r1, c1,
-                                                nOctaveLayers, (float)contrastThreshold,
-                                                (float)edgeThreshold, (float)sigma) )
-                            continue;
-                        float scl_octv = kpt.size*0.5f/(1 << o);
-                        float omax = calcOrientationHist(gauss_pyr[o*(nOctaveLayers+3) + layer],
-                                                         Point(c1, r1),
-                                                         cvRound(SIFT_ORI_RADIUS * scl_octv),
-                                                         SIFT_ORI_SIG_FCTR * scl_octv,
-                                                         hist, n);
-                        float mag_thr = (float)(omax * SIFT_ORI_PEAK_RATIO);
-                        for( int j = 0; j < n; j++ )
-                        {
-                            int l = j > 0 ? j - 1 : n - 1;
-                            int r2 = j < n-1 ? j + 1 : 0;
-
-                            if( hist[j] > hist[l]  &&  hist[j] > hist[r2]  &&  hist[j] >= mag_thr )
-                            {
-                                float bin = j + 0.5f * (hist[l]-hist[r2]) / (hist[l] - 2*hist[j] + hist[r2]);
-                                bin = bin < 0 ? n + bin : bin >= n ? bin - n : bin;
-                                kpt.angle = 360.f - (float)((360.f/n) * bin);
-                                if(std::abs(kpt.angle - 360.f) < FLT_EPSILON)
-                                    kpt.angle = 0.f;
-                                keypoints.push_back(kpt);
-                            }
-                        }
+                        addKeypoints(o, i, r, c, keypoints);
                     }
                 }
             }
         }
-}
+    }
 
+private:
+    // refines the extremum at (r, c) and adds a keypoint for every dominant orientation
+    void addKeypoints( int o, int i, int r, int c, std::vector<KeyPoint>& keypoints ) const
+    {
+        const int n = SIFT_ORI_HIST_BINS;
+        float hist[n];
+        KeyPoint kpt;
+
+        int r1 = r, c1 = c, layer = i;
+        if( !adjustLocalExtrema(dog_pyr, kpt, o, layer, r1, c1,
+                                nOctaveLayers, contrastThreshold,
+                                edgeThreshold, sigma) )
+            return;
+        float scl_octv = kpt.size*0.5f/(1 << o);
+        float omax = calcOrientationHist(gauss_pyr[o*(nOctaveLayers+3) + layer],
+                                         Point(c1, r1),
+                                         cvRound(SIFT_ORI_RADIUS * scl_octv),
+                                         SIFT_ORI_SIG_FCTR * scl_octv,
+                                         hist, n);
+        float mag_thr = (float)(omax * SIFT_ORI_PEAK_RATIO);
+        for( int j = 0; j < n; j++ )
+        {
+            int l = j > 0 ? j - 1 : n - 1;
+            int r2 = j < n-1 ? j + 1 : 0;
+
+            if( hist[j] > hist[l]  &&  hist[j] > hist[r2]  &&  hist[j] >= mag_thr )
+            {
+                float bin = j + 0.5f * (hist[l]-hist[r2]) / (hist[l] - 2*hist[j] + hist[r2]);
+                bin = bin < 0 ? n + bin : bin >= n ? bin - n : bin;
+                kpt.angle = 360.f - (float)((360.f/n) * bin);
+                if(std::abs(kpt.angle - 360.f) < FLT_EPSILON)
+                    kpt.angle = 0.f;
+                keypoints.push_back(kpt);
+            }
+        }
+    }
+
+    const std::vector<Vec4i>& tasks;
+    int nOctaveLayers;
+    int threshold;
+    float contrastThreshold;
+    float edgeThreshold;
+    float sigma;
+    const std::vector<Mat>& gauss_pyr;
+    const std::vector<Mat>& dog_pyr;
+    std::vector<std::vector<KeyPoint> >& taskKeypoints;
+};
+
+void SIFT_Impl::findScaleSpaceExtrema( const std::vector<Mat>& gauss_pyr, const std::vector<Mat>& dog_pyr,
+                                  std::vector<KeyPoint>& keypoints ) const
+{
+    int nOctaves = (int)gauss_pyr.size()/(nOctaveLayers + 3);
+    int threshold = cvFloor(0.5 * contrastThreshold / nOctaveLayers * 255 * SIFT_FIXPT_SCALE);
+
+    // tasks: ( octave, layer, first row, end row )
+    std::vector<Vec4i> tasks;
+    for( int o = 0; o < nOctaves; o++ )
+        for( int i = 1; i <= nOctaveLayers; i++ )
+        {
+            int rows = dog_pyr[o*(nOctaveLayers+2)+i].rows;
+            for( int r = SIFT_IMG_BORDER; r < rows-SIFT_IMG_BORDER; r += SIFT_EXTREMA_ROWS_PER_TASK )
+                tasks.push_back(Vec4i(o, i, r, std::min(r + SIFT_EXTREMA_ROWS_PER_TASK, rows-SIFT_IMG_BORDER)));
+        }
+
+    std::vector<std::vector<KeyPoint> > taskKeypoints(tasks.size());
+    parallel_for_(Range(0, (int)tasks.size()),
+                  findScaleSpaceExtremaComputer(tasks, nOctaveLayers, threshold, (float)contrastThreshold,
+                                                (float)edgeThreshold, (float)sigma, gauss_pyr, dog_pyr, taskKeypoints));
+
+    keypoints.clear();
+    for( size_t t = 0; t < taskKeypoints.size(); t++ )
+        keypoints.insert(keypoints.end(), taskKeypoints[t].begin(), taskKeypoints[t].end());
+}
 
 static void calcSIFTDescriptor( const Mat& img, Point2f ptf, float ori, float scl,
                                int d, int n, float* dst )
@@ -1012,10 +1136,71 @@ static void calcDescriptors(const std::vector<Mat>& gpyr, const std::vector<KeyP
 SIFT_Impl::SIFT_Impl( int _nfeatures, int _nOctaveLayers,
            double _contrastThreshold, double _edgeThreshold, double _sigma )
     : nfeatures(_nfeatures), nOctaveLayers(_nOctaveLayers),
-    contrastThreshold(_contrastThreshold), edgeThreshold(_edgeThreshold), sigma(_sigma)
+    contrastThreshold(_contrastThreshold), edgeThreshold(_edgeThreshold), sigma(_sigma),
+    cacheScaleSpace(false), cachedFirstOctave(0), cachedNOctaves(0)
 {
 }
 
+static bool isSameImage( const Mat& a, const Mat& b )
+{
+    if( a.size() != b.size() || a.type() != b.type() )
+        return false;
+    size_t rowSize = a.cols*a.elemSize();
+    for( int y = 0; y < a.rows; y++ )
+        if( memcmp(a.ptr(y), b.ptr(y), rowSize) != 0 )
+            return false;
+    return true;
+}
+
+// Builds the Gaussian and DoG pyramids of the image, or takes them from the cache when
+// the previous call had the same image and a compatible octave range.
+void SIFT_Impl::buildScaleSpace( const Mat& image, int firstOctave, int nOctaves,
+                                 std::vector<Mat>& gpyr, std::vector<Mat>& dogpyr )
+{
+    {
+        AutoLock lock(cacheMutex);
+        if( cacheScaleSpace && cachedFirstOctave == firstOctave && cachedNOctaves >= nOctaves &&
+            isSameImage(image, cachedImage) )
+        {
+            gpyr.assign(cachedGpyr.begin(), cachedGpyr.begin() + nOctaves*(nOctaveLayers + 3));
+            dogpyr.assign(cachedDogpyr.begin(), cachedDogpyr.begin() + nOctaves*(nOctaveLayers + 2));
+            return;
+        }
+    }
+
+    // built outside the lock; the cached pyramids are only replaced, never written to
+    Mat base = createInitialImage(image, firstOctave < 0, (float)sigma);
+    buildGaussianPyramid(base, gpyr, nOctaves);
+    buildDoGPyramid(gpyr, dogpyr);
+
+    AutoLock lock(cacheMutex);
+    if( cacheScaleSpace )
+    {
+        image.copyTo(cachedImage);
+        cachedFirstOctave = firstOctave;
+        cachedNOctaves = nOctaves;
+        cachedGpyr = gpyr;
+        cachedDogpyr = dogpyr;
+    }
+}
+
+void SIFT_Impl::setScaleSpaceCaching( bool enable )
+{
+    AutoLock lock(cacheMutex);
+    cacheScaleSpace = enable;
+    if( !enable )
+        releaseScaleSpace();
+}
+
+// called with cacheMutex held
+void SIFT_Impl::releaseScaleSpace()
+{
+    cachedImage.release();
+    cachedGpyr.clear();
+    cachedDogpyr.clear();
+    cachedFirstOctave = cachedNOctaves = 0;
+}
+
 int SIFT_Impl::descriptorSize() const
 {
     return SIFT_DESCR_WIDTH*SIFT_DESCR_WIDTH*SIFT_DESCR_HIST_BINS;
@@ -1065,14 +1250,14 @@ void SIFT_Impl::detectAndCompute(InputArray _image, InputArray _mask,
         actualNOctaves = maxOctave - firstOctave + 1;
     }
 
-    Mat base = createInitialImage(image, firstOctave < 0, (float)sigma);
     std::vector<Mat> gpyr, dogpyr;
-    int nOctaves = actualNOctaves > 0 ? actualNOctaves : cvRound(std::log( (double)std::min( base.cols, base.rows ) ) / std::log(2.) - 2) - firstOctave;
+    // the base image is twice the input size for firstOctave == -1
+    int baseSize = firstOctave < 0 ? 2*std::min( image.cols, image.rows ) : std::min( image.cols, image.rows );
+    int nOctaves = actualNOctaves > 0 ? actualNOctaves : cvRound(std::log( (double)baseSize ) / std::log(2.) - 2) - firstOctave;
 
     //double t, tf = getTickFrequency();
     //t = (double)getTickCount();
-    buildGaussianPyramid(base, gpyr, nOctaves);
-    buildDoGPyramid(gpyr, dogpyr);
+    buildScaleSpace(image, firstOctave, nOctaves, gpyr, dogpyr);
 
     //t = (double)getTickCount() - t;
     //printf("pyramid construction time: %g\n", t*1000./tf);
@@ -128,6 +128,11 @@ static const int SURF_HAAR_SIZE0 = 9;
 // above and below are aligned correctly.
 static const int SURF_HAAR_SIZE_INC = 6;
 
+// Number of layer rows processed at once by the detector. Only the
+// determinant and trace of one band (plus one row above and below for the
+// non-maxima suppression) are kept in memory for each thread.
+static const int SURF_BAND_ROWS = 32;
+
 
 struct SurfHF
 {
@@ -164,11 +169,12 @@ resizeHaarPattern( const int src[][5], SurfHF* dst, int n, int oldSize, int newS
 }
 
 /*
- * Calculate the determinant and trace of the Hessian for a layer of the
- * scale-space pyramid
+ * Calculate the determinant and trace of the Hessian for the layer rows
+ * [rowStart, rowStart + det.rows) of the scale-space pyramid. Samples whose
+ * kernel does not fit in the image are left unchanged.
  */
 static void calcLayerDetAndTrace( const Mat& sum, int size, int sampleStep,
-                                  Mat& det, Mat& trace )
+                                  Mat& det, Mat& trace, int rowStart )
 {
     const int NX=3, NY=3, NXY=4;
     const int dx_s[NX][5] = { {0, 2, 3, 7, 1}, {3, 2, 6, 7, -2}, {6, 2, 9, 7, 1} };
@@ -191,11 +197,14 @@ static void calcLayerDetAndTrace( const Mat& sum, int size, int sampleStep,
     /* Ignore pixels where some of the kernel is outside the image */
     int margin = (size/2)/sampleStep;
 
-    for( int i = 0; i < samples_i; i++ )
+    int i0 = std::max( rowStart - margin, 0 );
+    int i1 = std::min( rowStart + det.rows - margin, samples_i );
+
+    for( int i = i0; i < i1; i++ )
     {
         const int* sum_ptr = sum.ptr<int>(i*sampleStep);
-        float* det_ptr = &det.at<float>(i+margin, margin);
-        float* trace_ptr = &trace.at<float>(i+margin, margin);
+        float* det_ptr = &det.at<float>(i+margin-rowStart, margin);
+        float* trace_ptr = &trace.at<float>(i+margin-rowStart, margin);
         for( int j = 0; j < samples_j; j++ )
         {
             float dx  = calcHaarPattern( sum_ptr, Dx , 3 );
@@ -260,49 +269,23 @@ interpolateKeypoint( float N9[3][9], int dx, int dy, int ds, KeyPoint& kpt )
     return ok;
 }
 
-// Multi-threaded construction of the scale-space pyramid
-struct SURFBuildInvoker : ParallelLoopBody
-{
-    SURFBuildInvoker( const Mat& _sum, const std::vector<int>& _sizes,
-                      const std::vector<int>& _sampleSteps,
-                      std::vector<Mat>& _dets, std::vector<Mat>& _traces )
-    {
-        sum = &_sum;
-        sizes = &_sizes;
-        sampleSteps = &_sampleSteps;
-        dets = &_dets;
-        traces = &_traces;
-    }
-
-    void operator()(const Range& range) const
-    {
-        for( int i=range.start; i<range.end; i++ )
-            calcLayerDetAndTrace( *sum, (*sizes)[i], (*sampleSteps)[i], (*dets)[i], (*traces)[i] );
-    }
-
-    const Mat *sum;
-    const std::vector<int> *sizes;
-    const std::vector<int> *sampleSteps;
-    std::vector<Mat>* dets;
-    std::vector<Mat>* traces;
-};
-
-// Multi-threaded search of the scale-space pyramid for keypoints
+// Multi-threaded search of the scale-space pyramid for keypoints. The
+// pyramid is processed in horizontal bands of SURF_BAND_ROWS layer rows per
+// octave: each band computes the Hessian responses of all layers of its
+// octave into band-sized buffers and runs the non-maxima suppression on them
+// right away, so memory does not grow with the image height.
 struct SURFFindInvoker : ParallelLoopBody
 {
     SURFFindInvoker( const Mat& _sum, const Mat& _mask_sum,
-                     const std::vector<Mat>& _dets, const std::vector<Mat>& _traces,
                      const std::vector<int>& _sizes, const std::vector<int>& _sampleSteps,
-                     const std::vector<int>& _middleIndices, std::vector<KeyPoint>& _keypoints,
+                     const std::vector<Vec3i>& _bands, std::vector<std::vector<KeyPoint> >& _keypoints,
                      int _nOctaveLayers, float _hessianThreshold )
     {
         sum = &_sum;
         mask_sum = &_mask_sum;
-        dets = &_dets;
-        traces = &_traces;
         sizes = &_sizes;
         sampleSteps = &_sampleSteps;
-        middleIndices = &_middleIndices;
+        bands = &_bands;
         keypoints = &_keypoints;
         nOctaveLayers = _nOctaveLayers;
         hessianThreshold = _hessianThreshold;
@@ -311,45 +294,68 @@ struct SURFFindInvoker : ParallelLoopBody
     static void findMaximaInLayer( const Mat& sum, const Mat& mask_sum,
                    const std::vector<Mat>& dets, const std::vector<Mat>& traces,
                    const std::vector<int>& sizes, std::vector<KeyPoint>& keypoints,
-                   int octave, int layer, float hessianThreshold, int sampleStep );
+                   int octave, int layer, float hessianThreshold, int sampleStep,
+                   int rowStart, int rowEnd, int bufferRow0 );
 
     void operator()(const Range& range) const
     {
-        for( int i=range.start; i<range.end; i++ )
+        int nLayers = nOctaveLayers+2;
+        std::vector<Mat> dets(nLayers), traces(nLayers);
+        std::vector<int> octaveSizes(nLayers);
+
+        for( int b=range.start; b<range.end; b++ )
         {
-            int layer = (*middleIndices)[i];
-            int octave = i / nOctaveLayers;
-            findMaximaInLayer( *sum, *mask_sum, *dets, *traces, *sizes,
-                               *keypoints, octave, layer, hessianThreshold,
-                               (*sampleSteps)[layer] );
+            int octave = (*bands)[b][0];
+            int rowStart = (*bands)[b][1], rowEnd = (*bands)[b][2];
+            int first = octave*nLayers;
+            int sampleStep = (*sampleSteps)[first];
+
+            /* The integral image sum is one pixel bigger than the source image*/
+            int layer_rows = (sum->rows-1)/sampleStep;
+            int layer_cols = (sum->cols-1)/sampleStep;
+
+            // One extra row on each side for the 3x3x3 neighbourhood
+            int bufferRow0 = std::max( rowStart-1, 0 );
+            int bufferRows = std::min( rowEnd+1, layer_rows ) - bufferRow0;
+
+            for( int l = 0; l < nLayers; l++ )
+            {
+                octaveSizes[l] = (*sizes)[first+l];
+                dets[l].create( bufferRows, layer_cols, CV_32F );
+                traces[l].create( bufferRows, layer_cols, CV_32F );
+                dets[l] = Scalar::all(0);
+                traces[l] = Scalar::all(0);
+                calcLayerDetAndTrace( *sum, octaveSizes[l], sampleStep, dets[l], traces[l], bufferRow0 );
+            }
+
+            for( int l = 1; l <= nOctaveLayers; l++ )
+                findMaximaInLayer( *sum, *mask_sum, dets, traces, octaveSizes,
+                                   (*keypoints)[b], octave, l, hessianThreshold,
+                                   sampleStep, rowStart, rowEnd, bufferRow0 );
         }
     }
 
     const Mat *sum;
     const Mat *mask_sum;
-    const std::vector<Mat>* dets;
-    const std::vector<Mat>* traces;
     const std::vector<int>* sizes;
     const std::vector<int>* sampleSteps;
-    const std::vector<int>* middleIndices;
-    std::vector<KeyPoint>* keypoints;
+    const std::vector<Vec3i>* bands;
+    std::vector<std::vector<KeyPoint> >* keypoints;
     int nOctaveLayers;
     float hessianThreshold;
-
-    static Mutex findMaximaInLayer_m;
 };
 
-Mutex SURFFindInvoker::findMaximaInLayer_m;
-
 
 /*
- * Find the maxima in the determinant of the Hessian in a layer of the
- * scale-space pyramid
+ * Find the maxima in the determinant of the Hessian in the layer rows
+ * [rowStart, rowEnd) of the scale-space pyramid. The det/trace buffers hold
+ * the layer rows starting from bufferRow0.
  */
 void SURFFindInvoker::findMaximaInLayer( const Mat& sum, const Mat& mask_sum,
                    const std::vector<Mat>& dets, const std::vector<Mat>& traces,
                    const std::vector<int>& sizes, std::vector<KeyPoint>& keypoints,
-                   int octave, int layer, float hessianThreshold, int sampleStep )
+                   int octave, int layer, float hessianThreshold, int sampleStep,
+                   int rowStart, int rowEnd, int bufferRow0 )
 {
     // Wavelet Data
     const int NM=1;
@@ -370,10 +376,13 @@ void SURFFindInvoker::findMaximaInLayer( const Mat& sum, const Mat& mask_sum,
 
     int step = (int)(dets[layer].step/dets[layer].elemSize());
 
-    for( int i = margin; i < layer_rows - margin; i++ )
+    int i0 = std::max( margin, rowStart );
+    int i1 = std::min( layer_rows - margin, rowEnd );
+
+    for( int i = i0; i < i1; i++ )
     {
-        const float* det_ptr = dets[layer].ptr<float>(i);
-        const float* trace_ptr = traces[layer].ptr<float>(i);
+        const float* det_ptr = dets[layer].ptr<float>(i - bufferRow0);
+        const float* trace_ptr = traces[layer].ptr<float>(i - bufferRow0);
         for( int j = margin; j < layer_cols-margin; j++ )
         {
             float val0 = det_ptr[j];
@@ -388,9 +397,9 @@ void SURFFindInvoker::findMaximaInLayer( const Mat& sum, const Mat& mask_sum,
                 /* The 3x3x3 neighbouring samples around the maxima.
                    The maxima is included at N9[1][4] */
 
-                const float *det1 = &dets[layer-1].at<float>(i, j);
-                const float *det2 = &dets[layer].at<float>(i, j);
-                const float *det3 = &dets[layer+1].at<float>(i, j);
+                const float *det1 = &dets[layer-1].at<float>(i - bufferRow0, j);
+                const float *det2 = &dets[layer].at<float>(i - bufferRow0, j);
+                const float *det3 = &dets[layer+1].at<float>(i - bufferRow0, j);
                 float N9[3][9] = { { det1[-step-1], det1[-step], det1[-step+1],
                                      det1[-1]  , det1[0] , det1[1],
                                      det1[step-1] , det1[step] , det1[step+1]  },
@@ -436,7 +445,6 @@ void SURFFindInvoker::findMaximaInLayer( const Mat& sum, const Mat& mask_sum,
                     if( interp_ok  )
                     {
                         /*printf( "KeyPoint %f %f %d\n", point.pt.x, point.pt.y, point.size );*/
-                        cv::AutoLock lock(findMaximaInLayer_m);
                         keypoints.push_back(kpt);
                     }
                 }
@@ -471,45 +479,40 @@ static void fastHessianDetector( const Mat& sum, const Mat& mask_sum, std::vecto
     const int SAMPLE_STEP0 = 1;
 
     int nTotalLayers = (nOctaveLayers+2)*nOctaves;
-    int nMiddleLayers = nOctaveLayers*nOctaves;
 
-    std::vector<Mat> dets(nTotalLayers);
-    std::vector<Mat> traces(nTotalLayers);
     std::vector<int> sizes(nTotalLayers);
     std::vector<int> sampleSteps(nTotalLayers);
-    std::vector<int> middleIndices(nMiddleLayers);
+    std::vector<Vec3i> bands;
 
     keypoints.clear();
 
-    // Allocate space and calculate properties of each layer
-    int index = 0, middleIndex = 0, step = SAMPLE_STEP0;
+    // Calculate properties of each layer and split every octave into bands
+    int index = 0, step = SAMPLE_STEP0;
 
     for( int octave = 0; octave < nOctaves; octave++ )
     {
         for( int layer = 0; layer < nOctaveLayers+2; layer++ )
         {
-            /* The integral image sum is one pixel bigger than the source image*/
-            dets[index].create( (sum.rows-1)/step, (sum.cols-1)/step, CV_32F );
-            traces[index].create( (sum.rows-1)/step, (sum.cols-1)/step, CV_32F );
             sizes[index] = (SURF_HAAR_SIZE0 + SURF_HAAR_SIZE_INC*layer) << octave;
             sampleSteps[index] = step;
-
-            if( 0 < layer && layer <= nOctaveLayers )
-                middleIndices[middleIndex++] = index;
             index++;
         }
+
+        /* The integral image sum is one pixel bigger than the source image*/
+        int layer_rows = (sum.rows-1)/step;
+        for( int row = 0; row < layer_rows; row += SURF_BAND_ROWS )
+            bands.push_back( Vec3i(octave, row, std::min(row + SURF_BAND_ROWS, layer_rows)) );
         step *= 2;
     }
 
-    // Calculate hessian determinant and trace samples in each layer
-    parallel_for_( Range(0, nTotalLayers),
-                   SURFBuildInvoker(sum, sizes, sampleSteps, dets, traces) );
+    // Calculate the hessian determinant and find its maxima band by band
+    std::vector<std::vector<KeyPoint> > bandKeypoints(bands.size());
+    parallel_for_( Range(0, (int)bands.size()),
+                   SURFFindInvoker(sum, mask_sum, sizes, sampleSteps, bands,
+                                   bandKeypoints, nOctaveLayers, hessianThreshold) );
 
-    // Find maxima in the determinant of the hessian
-    parallel_for_( Range(0, nMiddleLayers),
-                   SURFFindInvoker(sum, mask_sum, dets, traces, sizes,
-                                   sampleSteps, middleIndices, keypoints,
-                                   nOctaveLayers, hessianThreshold) );
+    for( size_t b = 0; b < bandKeypoints.size(); b++ )
+        keypoints.insert(keypoints.end(), bandKeypoints[b].begin(), bandKeypoints[b].end());
 
     std::sort(keypoints.begin(), keypoints.end(), KeypointGreater());
 }
@@ -54,7 +54,7 @@
  */
 
 #include "precomp.hpp"
-
+#include "opencv2/core/hal/intrin.hpp"
 
 
 using namespace cv;
@@ -151,6 +151,9 @@ private:
 // -------------------------------------------------
 /* VGG internal routines */
 
+// number of keypoints pooled and projected by one pair of GEMMs
+static const int VGG_BATCH_SIZE = 64;
+
 // sample 64x64 patch from image given keypoint
 static inline void get_patch( const KeyPoint kp, Mat& Patch, const Mat& image,
                               const bool use_scale_orientation, const float scale_factor )
@@ -168,111 +171,103 @@ static inline void get_patch( const KeyPoint kp, Mat& Patch, const Mat& image,
   const float half_rows = (float)Patch.rows / 2.0f;
 
   // sample form original image
-  for ( int x = 0; x < Patch.cols; x++ )
+  for ( int y = 0; y < Patch.rows; y++ )
   {
-    for ( int y = 0; y < Patch.rows; y++ )
+    float* prow = Patch.ptr<float>( y );
+    for ( int x = 0; x < Patch.cols; x++ )
     {
+      const float xoff = x - half_cols;
+      const float yoff = y - half_rows;
+      int img_x, img_y;
       if ( use_scale_orientation )
       {
-        const float xoff = x - half_cols;
-        const float yoff = y - half_rows;
         // the rotation shifts & scale
-        int img_x = int( (kp.pt.x + 0.5f) + xoff*tcos - yoff*tsin );
-        int img_y = int( (kp.pt.y + 0.5f) + xoff*tsin + yoff*tcos );
-        // sample only within image
-        if ( ( img_x < image.cols ) && ( img_x >= 0 )
-          && ( img_y < image.rows ) && ( img_y >= 0 ) )
-          Patch.at<float>( y, x ) = image.at<float>( img_y, img_x );
-        else
-          Patch.at<float>( y, x ) = 0.0f;
+        img_x = int( (kp.pt.x + 0.5f) + xoff*tcos - yoff*tsin );
+        img_y = int( (kp.pt.y + 0.5f) + xoff*tsin + yoff*tcos );
       }
       else
       {
-        const float xoff = x - half_cols;
-        const float yoff = y - half_rows;
         // the samples from image
-        int img_x = int( kp.pt.x + 0.5f + xoff );
-        int img_y = int( kp.pt.y + 0.5f + yoff );
-        // sample only within image
-        if ( ( img_x < image.cols ) && ( img_x >= 0 )
-          && ( img_y < image.rows ) && ( img_y >= 0 ) )
-          Patch.at<float>( y, x ) = image.at<float>( img_y, img_x );
-        else
-          Patch.at<float>( y, x ) = 0.0f;
+        img_x = int( kp.pt.x + 0.5f + xoff );
+        img_y = int( kp.pt.y + 0.5f + yoff );
       }
+      // sample only within image
+      if ( ( img_x < image.cols ) && ( img_x >= 0 )
+        && ( img_y < image.rows ) && ( img_y >= 0 ) )
+        prow[x] = image.at<float>( img_y, img_x );
+      else
+        prow[x] = 0.0f;
     }
   }
 }
 
-// get descriptor given 64x64 image patch
-static void get_desc( const Mat Patch, Mat& PatchTrans, int anglebins, bool img_normalize )
+// get feature channels given 64x64 image patch; they are written to
+// the columns [col, col + anglebins) of PatchTrans, one row per pixel
+// in column-major pixel order, GMag and GRatio are 1 x Patch.total()
+// workspaces
+static void get_desc( const Mat& Patch, Mat& PatchTrans, int col, int anglebins, bool img_normalize,
+                      Mat& GMag, Mat& GRatio, Mat& GSorted )
 {
-    Mat Ix, Iy;
-    // % compute gradient
-    float kparam[3] = { -1,  0,  1 };
-    Mat Kernel( 1, 3, CV_32F, &kparam );
-    filter2D( Patch, Ix, CV_32F, Kernel,     Point( -1, -1 ), 0, BORDER_REPLICATE );
-    filter2D( Patch, Iy, CV_32F, Kernel.t(), Point( -1, -1 ), 0, BORDER_REPLICATE );
-
-    Mat GMag, GAngle;
-
-    // % gradient magnitude
-    // % GMag = sqrt(Ix .^ 2 + Iy .^ 2);
-    magnitude( Ix, Iy, GMag );
-
-    // % gradient orientation: [0; 2 * pi]
-    // % GAngle = atan2(Iy, Ix) + pi;
-    //phase( Ix, Iy, GAngle, false ); //<- opencv is buggy
-    GAngle = Mat( GMag.rows, GMag.cols, CV_32F );
-    for ( int i = 0; i < (int)GAngle.total(); i++ )
-      GAngle.at<float>(i) = atan2( Iy.at<float>(i), Ix.at<float>(i) ) + (float)CV_PI;
+    const int rows = Patch.rows, cols = Patch.cols;
+    float* gmag = GMag.ptr<float>();
+    float* gratio = GRatio.ptr<float>();
 
     // % soft-assignment of gradients to the orientation histogram
     float AngleStep = 2.0f * (float) CV_PI / (float) anglebins;
-    Mat GAngleRatio = GAngle / AngleStep - 0.5f;
-
-    // % Offset1 = mod(GAngleRatio, 1);
-    Mat Offset1( GAngleRatio.rows, GAngleRatio.cols, CV_32F );
-    for ( int i = 0; i < (int)GAngleRatio.total(); i++ )
-      Offset1.at<float>(i) = GAngleRatio.at<float>(i) - floor( GAngleRatio.at<float>(i) );
-
-    Mat w1 = 1.0f - Offset1.t();
-    Mat w2 = Offset1.t();
 
-    Mat Bin1( GAngleRatio.rows, GAngleRatio.cols, CV_8U );
-    Mat Bin2( GAngleRatio.rows, GAngleRatio.cols, CV_8U );
+    AutoBuffer<float> _grad( 2*cols );
+    float* ix = _grad;
+    float* iy = ix + cols;
 
-    // % Bin1 = ceil(GAngleRatio);
-    // % Bin1(Bin1 == 0) = Params.nAngleBins;
-    for ( int i = 0; i < (int)GAngleRatio.total(); i++ )
+    for ( int y = 0; y < rows; y++ )
     {
-      if ( ceil( GAngleRatio.at<float>(i) - 1.0f) == -1.0f )
-        Bin1.at<uchar>(i) = (uchar) anglebins - 1;
-      else
-        Bin1.at<uchar>(i) = (uchar) ceil( GAngleRatio.at<float>(i) - 1.0f );
+      const float* prow = Patch.ptr<float>( y );
+      const float* up = Patch.ptr<float>( std::max( y - 1, 0 ) );
+      const float* dn = Patch.ptr<float>( std::min( y + 1, rows - 1 ) );
+      float* mrow = gmag + y*cols;
+
+      // % compute gradient, replicated border
+      // % GMag = sqrt(Ix .^ 2 + Iy .^ 2);
+      int x = 1;
+#if CV_SIMD128
+      for ( ; x <= cols - 5; x += 4 )
+      {
+        v_float32x4 dx = v_load( prow + x + 1 ) - v_load( prow + x - 1 );
+        v_float32x4 dy = v_load( dn + x ) - v_load( up + x );
+        v_store( ix + x, dx );
+        v_store( iy + x, dy );
+        v_store( mrow + x, v_sqrt( dx*dx + dy*dy ) );
+      }
+#endif
+      for ( ; x < cols - 1; x++ )
+      {
+        ix[x] = prow[x+1] - prow[x-1];
+        iy[x] = dn[x] - up[x];
+        mrow[x] = std::sqrt( ix[x]*ix[x] + iy[x]*iy[x] );
+      }
+      ix[0] = prow[std::min( 1, cols - 1 )] - prow[0];
+      iy[0] = dn[0] - up[0];
+      mrow[0] = std::sqrt( ix[0]*ix[0] + iy[0]*iy[0] );
+      ix[cols-1] = prow[cols-1] - prow[std::max( cols - 2, 0 )];
+      iy[cols-1] = dn[cols-1] - up[cols-1];
+      mrow[cols-1] = std::sqrt( ix[cols-1]*ix[cols-1] + iy[cols-1]*iy[cols-1] );
+
+      // % gradient orientation: [0; 2 * pi]
+      // % GAngle = atan2(Iy, Ix) + pi;
+      float* rrow = gratio + y*cols;
+      for ( x = 0; x < cols; x++ )
+        rrow[x] = ( atan2( iy[x], ix[x] ) + (float)CV_PI ) / AngleStep - 0.5f;
     }
 
-    // % Bin2 = Bin1 + 1;
-    // % Bin2(Bin2 > Params.nAngleBins) = 1;
-    for ( int i = 0; i < (int)GAngleRatio.total(); i++ )
-    {
-      if ( ( Bin1.at<uchar>(i) + 1 ) > anglebins - 1 )
-        Bin2.at<uchar>(i) = 0;
-      else
-        Bin2.at<uchar>(i) = Bin1.at<uchar>(i) + 1;
-    }
+    const int n = rows*cols;
 
     // normalize
+    float gscale = 1.0f;
     if ( img_normalize )
     {
       // % Quantile = 0.8;
       float q = 0.8f;
 
-      // % T = quantile(GMag(:), Quantile);
-      Mat GMagSorted;
-      sort( GMag.reshape( 0, 1 ), GMagSorted, SORT_ASCENDING );
-
-      int n = GMagSorted.cols;
       // scipy/stats/mstats_basic.py#L1718 mquantiles()
       // m = alphap + p*(1.-alphap-betap)
       // alphap = 0.5 betap = 0.5 => (m = 0.5)
@@ -285,29 +280,45 @@ static void get_desc( const Mat Patch, Mat& PatchTrans, int anglebins, bool img_
       float gamma = aleph - k;
       if ( gamma >= 1.0f ) gamma = 1.0f;
       if ( gamma <= 0.0f ) gamma = 0.0f;
+
+      // % T = quantile(GMag(:), Quantile);
+      // only the k-1 and k order statistics are needed
+      GMag.copyTo( GSorted );
+      float* sorted = GSorted.ptr<float>();
+      std::nth_element( sorted, sorted + k - 1, sorted + n );
+      float vk = *std::min_element( sorted + k, sorted + n );
       // quantile out from distribution
-      float T = ( 1.0f - gamma ) * GMagSorted.at<float>( k - 1 )
-              + gamma * GMagSorted.at<float>( k );
+      float T = ( 1.0f - gamma ) * sorted[k - 1] + gamma * vk;
 
       // avoid NaN
-      if ( T != 0.0f ) GMag /= ( T / anglebins );
+      if ( T != 0.0f ) gscale = (float)( 1.0 / ( T / anglebins ) );
     }
 
-    Mat Bin1T = Bin1.t();
-    Mat Bin2T = Bin2.t();
-    Mat GMagT = GMag.t();
-
     // % feature channels
-    PatchTrans = Mat( (int)Patch.total(), anglebins, CV_32F, Scalar::all(0) );
-
-    for ( int i = 0; i < anglebins; i++ )
+    // % Bin1 = ceil(GAngleRatio);
+    // % Bin1(Bin1 == 0) = Params.nAngleBins;
+    // % Bin2 = Bin1 + 1;
+    // % Bin2(Bin2 > Params.nAngleBins) = 1;
+    for ( int x = 0; x < cols; x++ )
     {
-      for ( int p = 0; p < (int)Patch.total(); p++ )
+      for ( int y = 0; y < rows; y++ )
       {
-        if ( Bin1T.at<uchar>(p) == i )
-          PatchTrans.at<float>(p,i) = w1.at<float>(p) * GMagT.at<float>(p);
-        if ( Bin2T.at<uchar>(p) == i )
-          PatchTrans.at<float>(p,i) = w2.at<float>(p) * GMagT.at<float>(p);
+        float* ptrans = PatchTrans.ptr<float>( x*rows + y ) + col;
+        for ( int i = 0; i < anglebins; i++ )
+          ptrans[i] = 0.0f;
+
+        float ratio = gratio[y*cols + x];
+        float g = gmag[y*cols + x] * gscale;
+
+        // % Offset1 = mod(GAngleRatio, 1);
+        float offset1 = ratio - floor( ratio );
+
+        int bin1 = (int) ceil( ratio - 1.0f );
+        if ( bin1 == -1 ) bin1 = anglebins - 1;
+        int bin2 = bin1 + 1 > anglebins - 1 ? 0 : bin1 + 1;
+
+        ptrans[bin1] = ( 1.0f - offset1 ) * g;
+        ptrans[bin2] = offset1 * g;
       }
     }
 }
@@ -315,6 +326,8 @@ static void get_desc( const Mat Patch, Mat& PatchTrans, int anglebins, bool img_
 // -------------------------------------------------
 /* VGG interface implementation */
 
+// Each task describes VGG_BATCH_SIZE keypoints: the feature channels of all
+// patches are put side by side so pooling and projection are single GEMMs.
 struct ComputeVGGInvoker : ParallelLoopBody
 {
     ComputeVGGInvoker( const Mat& _image, Mat* _descriptors,
@@ -324,7 +337,7 @@ struct ComputeVGGInvoker : ParallelLoopBody
                         const bool _use_scale_orientation, const float _scale_factor )
     {
       image = _image;
-      keypoints = _keypoints;
+      keypoints = &_keypoints;
       descriptors = _descriptors;
 
       Proj = _Proj;
@@ -338,28 +351,52 @@ struct ComputeVGGInvoker : ParallelLoopBody
 
     void operator ()(const cv::Range& range) const
     {
-      Mat Desc, PatchTrans;
+      // workspaces reused by all batches of the range
       Mat Patch( 64, 64, CV_32F );
-      for (int k = range.start; k < range.end; k++)
+      Mat GMag( 1, (int)Patch.total(), CV_32F );
+      Mat GRatio( 1, (int)Patch.total(), CV_32F );
+      Mat GSorted, PatchTrans, Pooled, PooledDesc;
+
+      const int nkeypoints = (int)keypoints->size();
+      for (int b = range.start; b < range.end; b++)
       {
-        // sample patch from image
-        get_patch( keypoints[k], Patch, image, use_scale_orientation, scale_factor );
-        // compute transform
-        get_desc( Patch, PatchTrans, anglebins, img_normalize );
+        const int k0 = b*VGG_BATCH_SIZE;
+        const int n = std::min( VGG_BATCH_SIZE, nkeypoints - k0 );
+
+        PatchTrans.create( (int)Patch.total(), n*anglebins, CV_32F );
+        for ( int i = 0; i < n; i++ )
+        {
+          // sample patch from image
+          get_patch( (*keypoints)[k0 + i], Patch, image, use_scale_orientation, scale_factor );
+          // compute transform
+          get_desc( Patch, PatchTrans, i*anglebins, anglebins, img_normalize, GMag, GRatio, GSorted );
+        }
+
         // pool features
-        Desc = PRFilters * PatchTrans;
-        // crop
-        min( Desc, 1.0f, Desc );
-        // reshape
-        Desc = Desc.reshape( 1, (int)Desc.total() );
+        gemm( PRFilters, PatchTrans, 1, noArray(), 0, Pooled );
+
+        // crop & gather the pooled features of each keypoint into one row
+        PooledDesc.create( n, Pooled.rows*anglebins, CV_32F );
+        for ( int r = 0; r < Pooled.rows; r++ )
+        {
+          const float* src = Pooled.ptr<float>( r );
+          for ( int i = 0; i < n; i++ )
+          {
+            float* dst = PooledDesc.ptr<float>( i ) + r*anglebins;
+            for ( int h = 0; h < anglebins; h++ )
+              dst[h] = std::min( src[i*anglebins + h], 1.0f );
+          }
+        }
+
         // project
-        descriptors->row( k ) = Desc.t() * Proj.t();
+        Mat Desc = descriptors->rowRange( k0, k0 + n );
+        gemm( PooledDesc, Proj, 1, noArray(), 0, Desc, GEMM_2_T );
       }
     }
 
     Mat image;
     Mat *descriptors;
-    vector<KeyPoint> keypoints;
+    const vector<KeyPoint>* keypoints;
 
     Mat Proj;
     Mat PRFilters;
@@ -402,7 +439,8 @@ void VGG_Impl::compute( InputArray _image, vector<KeyPoint>& keypoints, OutputAr
     Mat descriptors = _descriptors.getMat();
     descriptors.setTo( Scalar(0) );
 
-    parallel_for_( Range( 0, (int) keypoints.size() ),
+    int nbatches = ( (int) keypoints.size() + VGG_BATCH_SIZE - 1 ) / VGG_BATCH_SIZE;
+    parallel_for_( Range( 0, nbatches ),
         ComputeVGGInvoker( m_image, &descriptors, keypoints, m_PRFilters, m_Proj,
                             m_anglebins, m_img_normalize, m_use_scale_orientation,
                             m_scale_factor )
@@ -41,6 +41,8 @@
 
 #include "test_precomp.hpp"
 #include "opencv2/calib3d.hpp"
+#include "../src/latch_reference.hpp"
+#include "../src/descriptor_image_cache.hpp"
 
 using namespace std;
 using namespace cv;
@@ -1090,6 +1092,40 @@ TEST( Features2d_DescriptorExtractor_LATCH, regression )
     test.safe_run();
 }
 
+TEST( Features2d_DescriptorExtractor_LATCH, same_as_scalar_reference )
+{
+    Mat img(130, 161, CV_8U);
+    RNG rng(0x1A7C);
+    rng.fill(img, RNG::UNIFORM, 0, 256);
+
+    // interior keypoints plus every column and row near the right and bottom borders, where the
+    // vectorized rows end at the image edge and the last pixels are masked out
+    vector<KeyPoint> kp;
+    for (int y = 30; y < 100; y += 17)
+        for (int x = 30; x < 130; x += 13)
+            kp.push_back(KeyPoint(x + 0.3f, y + 0.6f, 7.f, (float)rng.uniform(0., 360.)));
+    for (int x = img.cols - 48; x < img.cols; x++)
+        kp.push_back(KeyPoint(x + 0.5f, 60.f, 7.f, (float)rng.uniform(0., 360.)));
+    for (int y = img.rows - 40; y < img.rows; y++)
+        kp.push_back(KeyPoint(80.f, y + 0.4f, 7.f, (float)rng.uniform(0., 360.)));
+    for (int d = 0; d < 16; d++)
+        kp.push_back(KeyPoint(img.cols - 40.f + d, img.rows - 40.f + d, 7.f, (float)rng.uniform(0., 360.)));
+
+    const int halfSSDSizes[] = { 1, 2, 3, 4, 5, 7 };
+    for (int s = 0; s < 6; s++)
+        for (int rot = 0; rot < 2; rot++)
+        {
+            vector<KeyPoint> k1 = kp, k2 = kp;
+            Mat d1, d2;
+            LATCH::create(32, rot != 0, halfSSDSizes[s])->compute(img, k1, d1);
+            computeLATCHReference(img, k2, d2, 32, rot != 0, halfSSDSizes[s]);
+            ASSERT_EQ(k2.size(), k1.size());
+            ASSERT_GT(k1.size(), (size_t)40);
+            EXPECT_EQ(0, cvtest::norm(d1, d2, NORM_HAMMING))
+                << "half_ssd_size " << halfSSDSizes[s] << ", rotationInvariance " << rot;
+        }
+}
+
 TEST( Features2d_DescriptorExtractor_VGG, regression )
 {
     CV_DescriptorExtractorTest<L2<float> > test( "descriptor-vgg",  0.03f,
@@ -1222,6 +1258,195 @@ TEST(Features2d_BruteForceDescriptorMatcher_knnMatch, regression)
     }
 }
 
+struct DaisyBandCollector : public DAISY::BandCallback
+{
+    void operator()( const Range& rows, const Mat& descriptors )
+    {
+        ASSERT_EQ(next_row, rows.start);
+        next_row = rows.end;
+        all.push_back(descriptors);
+    }
+
+    int next_row;
+    Mat all;
+};
+
+TEST(Features2d_DescriptorExtractor_DAISY, dense_bands)
+{
+    Mat img(64, 80, CV_8U);
+    RNG rng(0xDA15);
+    rng.fill(img, RNG::UNIFORM, 0, 256);
+    GaussianBlur(img, img, Size(5, 5), 1.5);
+
+    Ptr<DAISY> daisy = DAISY::create(15, 3, 8, 8, DAISY::NRM_FULL);
+    Rect roi(4, 6, 70, 50);
+
+    Mat full;
+    daisy->compute(img, roi, full);
+    ASSERT_EQ(roi.area(), full.rows);
+
+    // bands cover the roi in order and match the single dense call
+    DaisyBandCollector bands;
+    bands.next_row = roi.y;
+    daisy->compute(img, roi, bands, 16);
+    EXPECT_EQ(roi.y + roi.height, bands.next_row);
+    EXPECT_EQ(0, cvtest::norm(full, bands.all, NORM_INF));
+
+    // half precision cubes stay close
+    daisy->setHalfPrecisionCubes(true);
+    Mat half;
+    daisy->compute(img, roi, half);
+    EXPECT_LT(cvtest::norm(full, half, NORM_INF), 1e-2);
+}
+
+TEST(Features2d_DescriptorImageCaching, same_descriptors)
+{
+    Mat img(200, 240, CV_8UC3);
+    RNG rng(0xCAC4E);
+    rng.fill(img, RNG::UNIFORM, 0, 256);
+    GaussianBlur(img, img, Size(7, 7), 2.0);
+    Mat gray;
+    cvtColor(img, gray, COLOR_BGR2GRAY);
+
+    vector<KeyPoint> kp;
+    for (int y = 50; y < 150; y += 10)
+        for (int x = 50; x < 190; x += 10)
+            kp.push_back(KeyPoint((float)x, (float)y, 20.f));
+
+    Ptr<Feature2D> extractors[] = { BriefDescriptorExtractor::create(), FREAK::create(), LUCID::create() };
+    Mat inputs[] = { gray, gray, img };
+
+    vector<Mat> reference;
+    for (int i = 0; i < 3; i++)
+    {
+        vector<KeyPoint> k = kp;
+        Mat d;
+        extractors[i]->compute(inputs[i], k, d);
+        reference.push_back(d);
+    }
+
+    Ptr<Feature2D> cached[] = { BriefDescriptorExtractor::create(), FREAK::create(), LUCID::create() };
+    cached[0].dynamicCast<BriefDescriptorExtractor>()->setImageCaching(true);
+    cached[1].dynamicCast<FREAK>()->setImageCaching(true);
+    cached[2].dynamicCast<LUCID>()->setImageCaching(true);
+
+    for (int i = 0; i < 3; i++)
+    {
+        vector<KeyPoint> k = kp;
+        Mat d;
+        cached[i]->compute(inputs[i], k, d);
+        EXPECT_EQ(0, cvtest::norm(reference[i], d, NORM_INF)) << "extractor " << i;
+    }
+
+    // the same grayscale and color images again: every extractor takes its image from the cache
+    int64 hits = DescriptorImageCache::hits();
+    for (int i = 0; i < 3; i++)
+    {
+        vector<KeyPoint> k = kp;
+        Mat d;
+        cached[i]->compute(inputs[i], k, d);
+        EXPECT_EQ(0, cvtest::norm(reference[i], d, NORM_INF)) << "extractor " << i;
+    }
+    EXPECT_LE(hits + 3, DescriptorImageCache::hits());
+
+    // after changing both images in place the cached images of the old content must not be used
+    Mat t;
+    flip(gray, t, 1);
+    t.copyTo(gray);
+    flip(img, t, 1);
+    t.copyTo(img);
+    for (int i = 0; i < 3; i++)
+    {
+        vector<KeyPoint> k = kp, k2 = kp;
+        Mat d, changed;
+        cached[i]->compute(inputs[i], k, d);
+        extractors[i]->compute(inputs[i], k2, changed);
+        EXPECT_EQ(0, cvtest::norm(changed, d, NORM_INF)) << "extractor " << i;
+        EXPECT_GT(cvtest::norm(reference[i], d, NORM_INF), 0) << "extractor " << i;
+    }
+
+    // disabling the caching of some extractors leaves it on for the others
+    cached[1].dynamicCast<FREAK>()->setImageCaching(false);
+    cached[2].dynamicCast<LUCID>()->setImageCaching(false);
+    EXPECT_TRUE(cached[0].dynamicCast<BriefDescriptorExtractor>()->getImageCaching());
+    hits = DescriptorImageCache::hits();
+    {
+        vector<KeyPoint> k = kp, k2 = kp;
+        Mat d, changed;
+        cached[0]->compute(inputs[0], k, d);
+        extractors[0]->compute(inputs[0], k2, changed);
+        EXPECT_EQ(0, cvtest::norm(changed, d, NORM_INF));
+    }
+    EXPECT_LT(hits, DescriptorImageCache::hits());
+    cached[0].dynamicCast<BriefDescriptorExtractor>()->setImageCaching(false);
+}
+
+TEST(Features2d_PCTSignaturesSQFD, search_nearest_full_scan)
+{
+    RNG rng(0x5F0D);
+    vector<Mat> signatures;
+    for (int i = 0; i < 300; i++)
+    {
+        Mat signature(rng.uniform(3, 30), 8, CV_32F);
+        rng.fill(signature, RNG::UNIFORM, 0.f, 1.f);
+        signatures.push_back(signature);
+    }
+
+    int distances[] = { PCTSignatures::L1, PCTSignatures::L2, PCTSignatures::L5 };
+    int similarities[] = { PCTSignatures::HEURISTIC, PCTSignatures::MINUS, PCTSignatures::GAUSSIAN };
+    for (int i = 0; i < 3; i++)
+    {
+        Ptr<PCTSignaturesSQFD> sqfd = PCTSignaturesSQFD::create(distances[i], similarities[i], 1.0f);
+        sqfd->setIndexSignatures(signatures);
+        ASSERT_EQ(300, sqfd->getIndexSize());
+
+        vector<float> all;
+        sqfd->computeQuadraticFormDistances(signatures[7], signatures, all);
+        vector<pair<float, int> > expected;
+        for (int j = 0; j < (int)all.size(); j++)
+            expected.push_back(make_pair(all[j], j));
+        std::sort(expected.begin(), expected.end());
+
+        vector<int> indices;
+        vector<float> found;
+        sqfd->searchNearest(signatures[7], 10, indices, found);
+        ASSERT_EQ(10u, indices.size());
+        for (int j = 0; j < 10; j++)
+        {
+            EXPECT_EQ(expected[j].second, indices[j]) << "functions " << i << ", rank " << j;
+            EXPECT_EQ(expected[j].first, found[j]) << "functions " << i << ", rank " << j;
+        }
+        EXPECT_NEAR(all[42], sqfd->computeQuadraticFormDistance(signatures[7], signatures[42]), 1e-5);
+    }
+}
+
+TEST(Features2d_PCTSignaturesSQFD, repeated_queries)
+{
+    RNG rng(0x5F0E);
+    vector<Mat> signatures;
+    for (int i = 0; i < 50; i++)
+    {
+        Mat signature(rng.uniform(3, 30), 8, CV_32F);
+        rng.fill(signature, RNG::UNIFORM, 0.f, 1.f);
+        signatures.push_back(signature);
+    }
+
+    Ptr<PCTSignaturesSQFD> sqfd = PCTSignaturesSQFD::create();
+    for (int q = 0; q < 3; q++)
+    {
+        // the database is reused by the second query, the third one has to see the changed signature
+        if (q == 2)
+            signatures[5].row(0).setTo(Scalar::all(0.5));
+
+        vector<float> repeated, fresh;
+        sqfd->computeQuadraticFormDistances(signatures[q], signatures, repeated);
+        PCTSignaturesSQFD::create()->computeQuadraticFormDistances(signatures[q], signatures, fresh);
+        ASSERT_EQ(fresh.size(), repeated.size());
+        for (size_t j = 0; j < fresh.size(); j++)
+            EXPECT_EQ(fresh[j], repeated[j]) << "query " << q << ", signature " << j;
+    }
+}
+
 /*TEST(Features2d_DescriptorExtractorParamTest, regression)
 {
     Ptr<DescriptorExtractor> s = DescriptorExtractor::create("SURF");
@@ -1388,3 +1613,47 @@ TEST( XFeatures2d_DescriptorExtractor, batch )
         EXPECT_GT(descriptors[i].rows, 100);
     }
 }
+
+static void expectSameSIFTFeatures( const vector<KeyPoint>& kp1, const Mat& desc1,
+                                    const vector<KeyPoint>& kp2, const Mat& desc2 )
+{
+    ASSERT_EQ(kp1.size(), kp2.size());
+    for( size_t i = 0; i < kp1.size(); i++ )
+    {
+        EXPECT_EQ(kp1[i].pt, kp2[i].pt) << "keypoint " << i;
+        EXPECT_EQ(kp1[i].size, kp2[i].size) << "keypoint " << i;
+        EXPECT_EQ(kp1[i].angle, kp2[i].angle) << "keypoint " << i;
+        EXPECT_EQ(kp1[i].octave, kp2[i].octave) << "keypoint " << i;
+    }
+    EXPECT_EQ(0, cvtest::norm(desc1, desc2, NORM_INF));
+}
+
+TEST( Features2d_SIFT_ScaleSpaceCaching, same_as_detectAndCompute )
+{
+    Mat img(240, 320, CV_8U);
+    RNG rng(0x51F7);
+    rng.fill(img, RNG::UNIFORM, 0, 256);
+    GaussianBlur(img, img, Size(7, 7), 2.0);
+
+    Ptr<SIFT> cached = SIFT::create();
+    cached->setScaleSpaceCaching(true);
+
+    for( int round = 0; round < 2; round++ )
+    {
+        // the second round changes the pixels in place, so the cached pyramids must not be reused
+        if( round == 1 )
+            flip(img, img, 1);
+
+        vector<KeyPoint> kpRef;
+        Mat descRef;
+        SIFT::create()->detectAndCompute(img, noArray(), kpRef, descRef);
+        ASSERT_GT(kpRef.size(), (size_t)50);
+
+        vector<KeyPoint> kp;
+        Mat desc;
+        cached->detect(img, kp);
+        cached->compute(img, kp, desc);
+        SCOPED_TRACE(round);
+        expectSameSIFTFeatures(kpRef, descRef, kp, desc);
+    }
+}